@@ -13,6 +13,7 @@
 # RUN_MODE=multipass
 # ENABLE_LAZY=true
 # ENABLE_MULTITHREAD=true
+# ENABLE_LINEAR_SCAN_RA=true
 # TestSuite=microsuite
 # # 'cpu' or 'check'
 # CPU_EXCEPTION_TYPE='cpu'
@@ -41,6 +42,9 @@ case $RUN_MODE in
         if [ $ENABLE_LAZY = true ]; then
             EXTRA_EXE_OPTIONS="$EXTRA_EXE_OPTIONS --enable-multipass-lazy"
         fi
+        if [ "$ENABLE_LINEAR_SCAN_RA" = true ]; then
+            EXTRA_EXE_OPTIONS="$EXTRA_EXE_OPTIONS --enable-multipass-linear-scan-ra"
+        fi
         if [ $ENABLE_MULTITHREAD = true ]; then
             EXTRA_EXE_OPTIONS="$EXTRA_EXE_OPTIONS --num-multipass-threads 16"
         else
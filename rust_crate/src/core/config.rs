@@ -1,6 +1,7 @@
 // Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
 // SPDX-License-Identifier: Apache-2.0
-use super::r#extern::{ZenCreateRuntimeConfig, ZenDeleteRuntimeConfig, ZenRuntimeConfigExtern};
+use super::r#extern::*;
+use std::ffi::CString;
 
 pub enum ZenRuntimeMode {
     Interp,     // 0
@@ -10,6 +11,8 @@ pub enum ZenRuntimeMode {
 
 pub struct ZenRuntimeConfig {
     pub ptr: *mut ZenRuntimeConfigExtern,
+    // kept alive for the config which refers to it
+    profile_dir: Option<CString>,
 }
 
 impl Drop for ZenRuntimeConfig {
@@ -30,6 +33,109 @@ impl ZenRuntimeConfig {
             ZenRuntimeMode::Multipass => 2,
         };
         let ptr = unsafe { ZenCreateRuntimeConfig(mode_c_int) };
-        ZenRuntimeConfig { ptr }
+        ZenRuntimeConfig {
+            ptr,
+            profile_dir: None,
+        }
+    }
+
+    pub fn set_wasm_memory_map(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetWasmMemoryMap(self.ptr, enabled) }
+    }
+
+    pub fn set_wasi(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetWASI(self.ptr, enabled) }
+    }
+
+    pub fn set_statistics(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetStatistics(self.ptr, enabled) }
+    }
+
+    pub fn set_gdb_tracing_hook(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetGdbTracingHook(self.ptr, enabled) }
+    }
+
+    pub fn set_module_cache(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetModuleCache(self.ptr, enabled) }
+    }
+
+    /// multipass options are ignored if the library is built without multipass JIT
+    pub fn set_multipass_lazy(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetMultipassLazy(self.ptr, enabled) }
+    }
+
+    pub fn set_multipass_greedy_ra(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetMultipassGreedyRA(self.ptr, enabled) }
+    }
+
+    pub fn set_multipass_linear_scan_ra(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetMultipassLinearScanRA(self.ptr, enabled) }
+    }
+
+    /// 0 to compile in the loading thread
+    pub fn set_num_multipass_threads(&mut self, num_threads: u32) {
+        unsafe { ZenRuntimeConfigSetNumMultipassThreads(self.ptr, num_threads) }
+    }
+
+    pub fn set_num_validation_threads(&mut self, num_threads: u32) {
+        unsafe { ZenRuntimeConfigSetNumValidationThreads(self.ptr, num_threads) }
+    }
+
+    pub fn set_num_wasm_memory_pool_slots(&mut self, num_slots: u32) {
+        unsafe { ZenRuntimeConfigSetNumWasmMemoryPoolSlots(self.ptr, num_slots) }
+    }
+
+    pub fn set_wasm_memory_image(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetWasmMemoryImage(self.ptr, enabled) }
+    }
+
+    pub fn set_threads(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetThreads(self.ptr, enabled) }
+    }
+
+    /// functions are validated on their first call, interpreter and multipass lazy mode only
+    pub fn set_lazy_function_load(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetLazyFunctionLoad(self.ptr, enabled) }
+    }
+
+    /// profiles of the functions called in multipass lazy mode, None to disable
+    pub fn set_multipass_profile_dir(&mut self, dir: Option<&str>) {
+        self.profile_dir = dir.map(|dir| CString::new(dir).unwrap());
+        let dir_ptr = match &self.profile_dir {
+            Some(dir) => dir.as_ptr(),
+            None => std::ptr::null(),
+        };
+        unsafe { ZenRuntimeConfigSetMultipassProfileDir(self.ptr, dir_ptr) }
+    }
+
+    pub fn set_multipass_indirect_call_cache(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetMultipassIndirectCallCache(self.ptr, enabled) }
+    }
+
+    /// free virtual stacks kept committed process-wide, ignored if the library is built
+    /// without virtual stack
+    pub fn set_num_retained_virtual_stacks(&mut self, num_stacks: u32) {
+        unsafe { ZenRuntimeConfigSetNumRetainedVirtualStacks(self.ptr, num_stacks) }
+    }
+
+    /// 0 for unlimited
+    pub fn set_multipass_max_ra_func_instrs(&mut self, num_instrs: u32) {
+        unsafe { ZenRuntimeConfigSetMultipassMaxRAFuncInstrs(self.ptr, num_instrs) }
+    }
+
+    /// 0 for unlimited
+    pub fn set_multipass_func_budget_ms(&mut self, budget_ms: u32) {
+        unsafe { ZenRuntimeConfigSetMultipassFuncBudgetMs(self.ptr, budget_ms) }
+    }
+
+    /// the profile is written by ZenRuntime::write_wasm_profile, interval_us 0 keeps the
+    /// default, ignored if the library is built without wasm profiler
+    pub fn set_wasm_profiler(&mut self, enabled: bool, interval_us: u32) {
+        unsafe { ZenRuntimeConfigSetWasmProfiler(self.ptr, enabled, interval_us) }
+    }
+
+    /// interpreter mode only
+    pub fn set_wasm_profiler_call_counts(&mut self, enabled: bool) {
+        unsafe { ZenRuntimeConfigSetWasmProfilerCallCounts(self.ptr, enabled) }
     }
 }
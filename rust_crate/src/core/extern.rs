@@ -49,6 +49,13 @@ pub struct ZenHostModuleExtern {
     _dummy: i32,
 }
 
+#[repr(C)]
+pub struct ZenMemAccessExtern {
+    pub offset: cty::uint32_t,
+    pub size: cty::uint32_t,
+    pub data: *mut cty::c_void,
+}
+
 #[repr(C)]
 pub struct ZenValueExtern {
     pub value_type: cty::c_int, // enum ZenType, 0: i32, 1: i64, 2: f32, 3: f64
@@ -62,9 +69,65 @@ pub struct ZenValueExtern {
 extern "C" {
     pub fn ZenCreateRuntimeConfig(mode: cty::int32_t) -> *mut ZenRuntimeConfigExtern;
     pub fn ZenDeleteRuntimeConfig(config: *mut ZenRuntimeConfigExtern);
+    pub fn ZenRuntimeConfigSetWasmMemoryMap(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetWASI(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetStatistics(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetGdbTracingHook(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetModuleCache(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetMultipassLazy(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetMultipassGreedyRA(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetMultipassLinearScanRA(
+        config: *mut ZenRuntimeConfigExtern,
+        enabled: bool,
+    );
+    pub fn ZenRuntimeConfigSetNumMultipassThreads(
+        config: *mut ZenRuntimeConfigExtern,
+        num_threads: cty::uint32_t,
+    );
+    pub fn ZenRuntimeConfigSetNumValidationThreads(
+        config: *mut ZenRuntimeConfigExtern,
+        num_threads: cty::uint32_t,
+    );
+    pub fn ZenRuntimeConfigSetNumWasmMemoryPoolSlots(
+        config: *mut ZenRuntimeConfigExtern,
+        num_slots: cty::uint32_t,
+    );
+    pub fn ZenRuntimeConfigSetWasmMemoryImage(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetThreads(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetLazyFunctionLoad(config: *mut ZenRuntimeConfigExtern, enabled: bool);
+    pub fn ZenRuntimeConfigSetMultipassProfileDir(
+        config: *mut ZenRuntimeConfigExtern,
+        dir: *const cty::c_char,
+    );
+    pub fn ZenRuntimeConfigSetMultipassIndirectCallCache(
+        config: *mut ZenRuntimeConfigExtern,
+        enabled: bool,
+    );
+    pub fn ZenRuntimeConfigSetNumRetainedVirtualStacks(
+        config: *mut ZenRuntimeConfigExtern,
+        num_stacks: cty::uint32_t,
+    );
+    pub fn ZenRuntimeConfigSetMultipassMaxRAFuncInstrs(
+        config: *mut ZenRuntimeConfigExtern,
+        num_instrs: cty::uint32_t,
+    );
+    pub fn ZenRuntimeConfigSetMultipassFuncBudgetMs(
+        config: *mut ZenRuntimeConfigExtern,
+        budget_ms: cty::uint32_t,
+    );
+    pub fn ZenRuntimeConfigSetWasmProfiler(
+        config: *mut ZenRuntimeConfigExtern,
+        enabled: bool,
+        interval_us: cty::uint32_t,
+    );
+    pub fn ZenRuntimeConfigSetWasmProfilerCallCounts(
+        config: *mut ZenRuntimeConfigExtern,
+        enabled: bool,
+    );
 
     pub fn ZenCreateRuntime(config: *const ZenRuntimeConfigExtern) -> *mut ZenRuntimeExtern;
     pub fn ZenDeleteRuntime(rt: *mut ZenRuntimeExtern);
+    pub fn ZenWriteWasmProfile(rt: *mut ZenRuntimeExtern, filename: *const cty::c_char) -> bool;
 
     pub fn ZenCreateHostModuleDesc(
         rt: *mut ZenRuntimeExtern,
@@ -188,6 +251,23 @@ extern "C" {
         inst: *mut ZenInstanceExtern,
         host_addr: *const cty::c_void,
     ) -> cty::uint32_t;
+    pub fn ZenGetAppMemSlice(
+        inst: *mut ZenInstanceExtern,
+        offset: cty::uint32_t,
+        size: cty::uint32_t,
+    ) -> *mut cty::c_void;
+    // return bool
+    pub fn ZenReadAppMem(
+        inst: *mut ZenInstanceExtern,
+        accesses: *const ZenMemAccessExtern,
+        num_accesses: cty::uint32_t,
+    ) -> cty::int8_t;
+    // return bool
+    pub fn ZenWriteAppMem(
+        inst: *mut ZenInstanceExtern,
+        accesses: *const ZenMemAccessExtern,
+        num_accesses: cty::uint32_t,
+    ) -> cty::int8_t;
 
     pub fn ZenGetInstanceGasLeft(inst: *mut ZenInstanceExtern) -> cty::uint64_t;
     pub fn ZenSetInstanceGasLeft(inst: *mut ZenInstanceExtern, new_gas: cty::uint64_t);
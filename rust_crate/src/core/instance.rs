@@ -14,10 +14,11 @@ use std::rc::Rc;
 use super::{
     isolation::ZenIsolation,
     r#extern::{
-        ZenCallWasmFuncByName, ZenDeleteInstance, ZenGetAppMemOffset, ZenGetHostMemAddr,
-        ZenGetInstanceCustomData, ZenGetInstanceError, ZenGetInstanceGasLeft, ZenInstanceExit,
-        ZenInstanceExtern, ZenSetInstanceCustomData, ZenSetInstanceExceptionByHostapi,
-        ZenSetInstanceGasLeft, ZenValidateAppMemAddr, ZenValidateHostMemAddr, ZenValueExtern,
+        ZenCallWasmFuncByName, ZenDeleteInstance, ZenGetAppMemOffset, ZenGetAppMemSlice,
+        ZenGetHostMemAddr, ZenGetInstanceCustomData, ZenGetInstanceError, ZenGetInstanceGasLeft,
+        ZenInstanceExit, ZenInstanceExtern, ZenMemAccessExtern, ZenReadAppMem,
+        ZenSetInstanceCustomData, ZenSetInstanceExceptionByHostapi, ZenSetInstanceGasLeft,
+        ZenValidateAppMemAddr, ZenValidateHostMemAddr, ZenValueExtern, ZenWriteAppMem,
     },
     runtime::{ZenModule, ERROR_BUF_SIZE},
     types::ZenValue,
@@ -93,6 +94,55 @@ impl<T> ZenInstance<T> {
         bool_int != 0
     }
 
+    /// validate the linear memory range and get it without copying in one call,
+    /// None if out of bounds(the instance gets the out of bounds memory error)
+    ///
+    /// # Safety
+    ///
+    /// The slice aliases the linear memory. It must not be used after the memory
+    /// grows(e.g. after calling wasm) or the instance is deleted, and the range must
+    /// not be accessed in any other way(another slice, wasm, other threads sharing
+    /// the memory) while the slice is alive
+    #[allow(clippy::mut_from_ref)]
+    pub unsafe fn get_memory_slice(&self, offset: u32, size: u32) -> Option<&mut [u8]> {
+        let ptr = ZenGetAppMemSlice(self.ptr, offset, size) as *mut u8;
+        if ptr.is_null() {
+            return None;
+        }
+        Some(std::slice::from_raw_parts_mut(ptr, size as usize))
+    }
+
+    /// copy many linear memory ranges(offset, buffer) to the buffers in one call,
+    /// nothing copied if any range is out of bounds
+    pub fn read_memory(&self, reads: &mut [(u32, &mut [u8])]) -> bool {
+        let accesses: Vec<ZenMemAccessExtern> = reads
+            .iter_mut()
+            .map(|(offset, buf)| ZenMemAccessExtern {
+                offset: *offset,
+                size: buf.len() as u32,
+                data: buf.as_mut_ptr() as *mut cty::c_void,
+            })
+            .collect();
+        let bool_int = unsafe { ZenReadAppMem(self.ptr, accesses.as_ptr(), accesses.len() as u32) };
+        bool_int != 0
+    }
+
+    /// copy many buffers to the linear memory ranges(offset, buffer) in order in
+    /// one call, nothing copied if any range is out of bounds
+    pub fn write_memory(&self, writes: &[(u32, &[u8])]) -> bool {
+        let accesses: Vec<ZenMemAccessExtern> = writes
+            .iter()
+            .map(|(offset, buf)| ZenMemAccessExtern {
+                offset: *offset,
+                size: buf.len() as u32,
+                data: buf.as_ptr() as *mut cty::c_void,
+            })
+            .collect();
+        let bool_int =
+            unsafe { ZenWriteAppMem(self.ptr, accesses.as_ptr(), accesses.len() as u32) };
+        bool_int != 0
+    }
+
     pub fn validate_host_addr(&self, host_addr: *const u8, size: u32) -> bool {
         let bool_int =
             unsafe { ZenValidateHostMemAddr(self.ptr, host_addr as *const cty::c_void, size) };
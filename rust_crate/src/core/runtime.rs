@@ -41,6 +41,10 @@ impl ZenRuntime {
         } else {
             ZenRuntimeConfig::new(ZenRuntimeMode::Singlepass)
         };
+        Self::new_with_config(&config)
+    }
+
+    pub fn new_with_config(config: &ZenRuntimeConfig) -> Rc<ZenRuntime> {
         let ptr = unsafe { ZenCreateRuntime(config.ptr) };
         Rc::new(ZenRuntime {
             ptr,
@@ -177,6 +181,14 @@ impl ZenRuntime {
         ret_bool_int != 0
     }
 
+    /// stop the wasm profiler and write the folded stacks to the file, and the call
+    /// counts to <filename>.calls if collected
+    pub fn write_wasm_profile(&self, filename: &str) -> bool {
+        let filename_c_bytes = rust_str_to_c_str(filename);
+        let filename_cstr = CStr::from_bytes_until_nul(&filename_c_bytes).unwrap();
+        unsafe { ZenWriteWasmProfile(self.ptr, filename_cstr.as_ptr()) }
+    }
+
     /// <not thread-safe>
     pub fn load_module_from_bytes(
         self: &Rc<Self>,
@@ -21,6 +21,10 @@ mod tests {
         assert!(inst.validate_wasm_addr(0, 1));
         let memory_addr: *const u8 = inst.get_host_memory(0);
         let memory_addr_value = unsafe { *memory_addr } as i32; // this memory data is asciiOf('a') = 97
+        assert_eq!(
+            unsafe { inst.get_memory_slice(0, 1) }.unwrap()[0] as i32,
+            memory_addr_value
+        );
         println!("memory_addr_value: {memory_addr_value}");
         println!("enter get_host_number, a={a}, b={b}");
         return 100000 + memory_addr_value + a + b;
@@ -10,7 +10,9 @@
 #include "common/type.h"
 #include "runtime/module.h"
 #include "utils/wasm.h"
-#include <stack>
+#ifndef ZEN_ENABLE_SGX
+#include "runtime/atomics.h"
+#endif // ZEN_ENABLE_SGX
 #include <vector>
 
 #ifdef ZEN_ENABLE_CHECKED_ARITHMETIC
@@ -37,24 +39,30 @@ using utils::skipCurrentBlock;
 
 template <typename Operand> class WASMEvalStack {
 public:
-  void push(Operand Op) { StackImpl.push(Op); }
+  void push(Operand Op) { StackImpl.push_back(Op); }
 
   Operand pop() {
     ZEN_ASSERT(!StackImpl.empty());
-    Operand Top = StackImpl.top();
-    StackImpl.pop();
+    Operand Top = StackImpl.back();
+    StackImpl.pop_back();
     return Top;
   }
 
   Operand getTop() const {
     ZEN_ASSERT(!StackImpl.empty());
-    return StackImpl.top();
+    return StackImpl.back();
+  }
+
+  // Idx counts from the bottom of the stack
+  Operand &get(uint32_t Idx) {
+    ZEN_ASSERT(Idx < StackImpl.size());
+    return StackImpl[Idx];
   }
 
   uint32_t getSize() const { return StackImpl.size(); }
 
 private:
-  std::stack<Operand> StackImpl;
+  std::vector<Operand> StackImpl;
 };
 
 // ============================================================================
@@ -105,6 +113,27 @@ private:
 
   Operand getTop() { return Stack.getTop(); }
 
+  // The builder may push the local itself for local.get instead of a copy
+  // when IRBuilder::DefersGetLocal is set. Such operands must be copied before
+  // the local is assigned, and before entering a block, since the assignments
+  // in the block are not executed on all paths. The top NumKept operands are
+  // about to be consumed and left as they are
+  void materializeLocalRefs(uint32_t NumKept,
+                            uint32_t LocalIdx = AllLocalRefs) {
+    if constexpr (IRBuilder::DefersGetLocal) {
+      ZEN_ASSERT(NumKept <= Stack.getSize());
+      for (uint32_t I = 0; I < Stack.getSize() - NumKept; ++I) {
+        Operand &Opnd = Stack.get(I);
+        if (Builder.isLocalRef(Opnd, LocalIdx)) {
+          Opnd = Builder.materializeLocalRef(Opnd);
+        }
+      }
+    }
+  }
+
+  // passed to IRBuilder::isLocalRef to match any local
+  static constexpr uint32_t AllLocalRefs = UINT32_MAX;
+
   bool decode() {
     const uint8_t *Ip = CurFunc->CodePtr;
     const uint8_t *IpEnd = Ip + CurFunc->CodeSize;
@@ -206,6 +235,42 @@ private:
         handleCallIndirect(U32, 0);
         break;
 
+      case Opcode::RETURN_CALL: {
+        Ip = readSafeLEBNumber(Ip, U32);
+        if (U32 == CurMod->getGasFuncIdx()) {
+          handleGasCall();
+          Ip = skipCurrentBlock(Ip, IpEnd);
+          handleReturn();
+          CurBlock.setReachable(false);
+          break;
+        }
+#ifdef ZEN_ENABLE_CHECKED_ARITHMETIC
+#define HANDLE_CHECKED_ARITHMETIC_CALL_POSTHOOK                                \
+  Ip = skipCurrentBlock(Ip, IpEnd);                                            \
+  handleReturn();                                                              \
+  CurBlock.setReachable(false);
+        HANDLE_CHECKED_ARITHMETIC_CALL(CurMod, U32)
+#undef HANDLE_CHECKED_ARITHMETIC_CALL_POSTHOOK
+#endif // ZEN_ENABLE_CHECKED_ARITHMETIC
+        runtime::CodeEntry *CalleeFunc = CurMod->getCodeEntry(U32);
+        uint32_t CalleeOffset = CalleeFunc ? CalleeFunc->CodeOffset : 0;
+        uint32_t CallSiteOffset = Ip - CurFunc->CodePtr + CurFunc->CodeOffset;
+        uint32_t CallOffset = std::abs(int32_t(CallSiteOffset - CalleeOffset));
+
+        Ip = skipCurrentBlock(Ip, IpEnd);
+        handleReturnCall(U32, CallOffset);
+        CurBlock.setReachable(false);
+        break;
+      }
+
+      case Opcode::RETURN_CALL_INDIRECT:
+        Ip = readSafeLEBNumber(Ip, U32);
+        Ip++; // Skip table index(0)
+        Ip = skipCurrentBlock(Ip, IpEnd);
+        handleReturnCallIndirect(U32, 0);
+        CurBlock.setReachable(false);
+        break;
+
       case Opcode::DROP:
       case Opcode::DROP_64:
         handleDrop();
@@ -324,6 +389,12 @@ private:
         handleMemoryGrow();
         break;
 
+#ifndef ZEN_ENABLE_SGX
+      case Opcode::ATOMIC_PREFIX:
+        Ip = handleAtomic(Ip);
+        break;
+#endif // ZEN_ENABLE_SGX
+
       case Opcode::I32_CONST:
         Ip = readSafeLEBNumber(Ip, I32);
         handleConst<WASMType::I32>(I32);
@@ -761,14 +832,17 @@ private:
   void handleUnreachable() { Builder.handleUnreachable(); }
 
   void handleBlock(WASMType BlockType) {
+    materializeLocalRefs(0);
     Builder.handleBlock(BlockType, Stack.getSize());
   }
 
   void handleLoop(WASMType BlockType) {
+    materializeLocalRefs(0);
     Builder.handleLoop(BlockType, Stack.getSize());
   }
 
   void handleIf(WASMType BlockType) {
+    materializeLocalRefs(1);
     Operand Cond = pop();
     Builder.handleIf(Cond, BlockType, Stack.getSize());
   }
@@ -918,6 +992,42 @@ private:
     }
   }
 
+  void handleReturnCall(uint32_t FuncIdx, uint32_t CallOffset) {
+    ZEN_ASSERT(FuncIdx < CurMod->getNumTotalFunctions());
+    TypeEntry *Type = CurMod->getFunctionType(FuncIdx);
+    ZEN_ASSERT(Type);
+    uintptr_t Target = 0;
+    bool IsImport = FuncIdx < CurMod->getNumImportFunctions();
+    bool FarCall = !IsImport && CallOffset > (1 << 24);
+    if (IsImport) {
+      const auto &ImportFunc = CurMod->getImportFunction(FuncIdx);
+      Target = (uintptr_t)ImportFunc.FuncPtr;
+      ZEN_ASSERT(Target != 0);
+    }
+    ArgumentInfo ArgInfo(Type);
+    std::vector<Operand> Args;
+    Args.resize(Type->NumParams);
+    collectCallParams(Type, Args);
+
+    Builder.handleReturnCall(FuncIdx, Target, IsImport, FarCall, ArgInfo,
+                             Args);
+  }
+
+  void handleReturnCallIndirect(uint32_t TypeIdx, uint32_t TableIdx) {
+    ZEN_ASSERT(CurMod->isValidType(TypeIdx));
+    ZEN_ASSERT(TableIdx < CurMod->getNumTotalTables());
+    Operand IndirectFuncIdx = pop();
+    TypeEntry *Type = CurMod->getDeclaredType(TypeIdx);
+    ZEN_ASSERT(Type);
+    ArgumentInfo ArgInfo(Type);
+    std::vector<Operand> Args;
+    Args.resize(Type->NumParams);
+    collectCallParams(Type, Args);
+    TypeIdx = Type->SmallestTypeIdx;
+    Builder.handleReturnCallIndirect(TypeIdx, IndirectFuncIdx, TableIdx,
+                                     ArgInfo, Args);
+  }
+
   // ==================== Parametric Instruction Handlers ====================
 
   void handleDrop() { pop(); }
@@ -942,11 +1052,13 @@ private:
   }
 
   void handleSetLocal(uint32_t LocalIdx) {
+    materializeLocalRefs(1, LocalIdx);
     Operand Val = pop();
     Builder.handleSetLocal(LocalIdx, Val);
   }
 
   void handleTeeLocal(uint32_t LocalIdx) {
+    materializeLocalRefs(1, LocalIdx);
     Operand Val = getTop();
     Builder.handleSetLocal(LocalIdx, Val);
   }
@@ -1000,6 +1112,57 @@ private:
     push(Result);
   }
 
+#ifndef ZEN_ENABLE_SGX
+  const uint8_t *handleAtomic(const uint8_t *Ip) {
+    using runtime::AtomicOpKind;
+    uint32_t AtomicOpcode;
+    Ip = readSafeLEBNumber(Ip, AtomicOpcode);
+    if (AtomicOpcode == common::ATOMIC_FENCE) {
+      ++Ip; // skip 0x0
+      Builder.handleAtomicFence();
+      return Ip;
+    }
+    uint32_t Align;
+    uint32_t Offset;
+    Ip = readSafeLEBNumber(Ip, Align);
+    Ip = readSafeLEBNumber(Ip, Offset);
+
+    // Arg1 is the stored value, the rmw operand, or the expected value of
+    // cmpxchg and wait, Arg2 is the replacement of cmpxchg or the timeout
+    Operand Arg1, Arg2;
+    switch (AtomicOpcode) {
+    case common::ATOMIC_NOTIFY:
+      Arg1 = pop();
+      break;
+    case common::ATOMIC_WAIT32:
+    case common::ATOMIC_WAIT64:
+    case common::I32_ATOMIC_RMW_CMPXCHG:
+    case common::I64_ATOMIC_RMW_CMPXCHG:
+    case common::I32_ATOMIC_RMW8_CMPXCHG_U:
+    case common::I32_ATOMIC_RMW16_CMPXCHG_U:
+    case common::I64_ATOMIC_RMW8_CMPXCHG_U:
+    case common::I64_ATOMIC_RMW16_CMPXCHG_U:
+    case common::I64_ATOMIC_RMW32_CMPXCHG_U:
+      Arg2 = pop();
+      Arg1 = pop();
+      break;
+    default:
+      if (runtime::getAtomicOpKind(AtomicOpcode) != AtomicOpKind::Load) {
+        Arg1 = pop();
+      }
+      break;
+    }
+    Operand Base = pop();
+    Operand Result =
+        Builder.handleAtomic(AtomicOpcode, Base, Offset, Arg1, Arg2);
+    if (AtomicOpcode < common::I32_ATOMIC_LOAD ||
+        runtime::getAtomicOpKind(AtomicOpcode) != AtomicOpKind::Store) {
+      push(Result);
+    }
+    return Ip;
+  }
+#endif // ZEN_ENABLE_SGX
+
   // ==================== Numeric Instruction Handlers ====================
 
   template <WASMType Ty> void handleConst(typename WASMTypeAttr<Ty>::Type Val) {
@@ -1009,6 +1172,11 @@ private:
 
   template <WASMType Type, CompareOperator Opr>
   const uint8_t *handleCompare(const uint8_t *Ip, const uint8_t *End) {
+    if (common::isWASMTypeInteger<Type>() && *Ip == Opcode::IF) {
+      // fused with the if below, which enters a block
+      materializeLocalRefs(Opr == CompareOperator::CO_EQZ ? 1 : 2);
+    }
+
     // pop operands
     Operand CmpRHS = (Opr != CompareOperator::CO_EQZ) ? pop() : Operand();
     Operand CmpLHS = pop();
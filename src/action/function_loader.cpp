@@ -73,6 +73,86 @@ bool FunctionLoader::checkMemoryAlign(uint8_t Opcode, uint32_t Align) {
   return Align <= Aligns[Opcode - I32_LOAD];
 }
 
+#ifndef ZEN_ENABLE_SGX
+void FunctionLoader::loadAtomicOpcode() {
+  uint32_t AtomicOpcode = readU32();
+  if (AtomicOpcode == ATOMIC_FENCE) {
+    uint8_t Flag = to_underlying(readByte());
+    if (Flag != 0x00) {
+      throw getError(ErrorCode::ZeroFlagExpected);
+    }
+    return;
+  }
+
+  int32_t NaturalAlign = -1;
+  switch (AtomicOpcode) {
+#define DEFINE_WASM_ATOMIC_OPCODE(NAME, OPCODE, TEXT, ALIGN)                   \
+  case NAME:                                                                   \
+    NaturalAlign = ALIGN;                                                      \
+    break;
+#include "common/wasm_defs/opcode_atomic.def"
+#undef DEFINE_WASM_ATOMIC_OPCODE
+  default:
+    throw getErrorWithExtraMessage(ErrorCode::UnsupportedOpcode,
+                                   "0xfe " + std::to_string(AtomicOpcode));
+  }
+  if (!hasMemory()) {
+    throw getError(ErrorCode::UnknownMemory);
+  }
+
+  uint32_t Align = readU32();
+  [[maybe_unused]] uint32_t Offset = readU32();
+  if (Align != uint32_t(NaturalAlign)) {
+    throw getError(ErrorCode::AlignMustEqualNatural);
+  }
+
+  // Operands of the 64-bit shapes are i64, the address is always i32
+  WASMType Type = WASMType::I32;
+  if (AtomicOpcode >= I32_ATOMIC_LOAD) {
+    uint32_t Shape = (AtomicOpcode - I32_ATOMIC_LOAD) % 7;
+    if (Shape == 1 || Shape >= 4) {
+      Type = WASMType::I64;
+    }
+  }
+
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+  if (AtomicOpcode < I32_ATOMIC_LOAD) {
+    markCall(); // wait and notify call into the runtime
+  }
+#endif
+
+  switch (AtomicOpcode) {
+  case ATOMIC_NOTIFY:
+    popValueType(WASMType::I32);
+    popAndPushValueType(1, WASMType::I32, WASMType::I32);
+    break;
+  case ATOMIC_WAIT32:
+  case ATOMIC_WAIT64:
+    popValueType(WASMType::I64); // timeout
+    popValueType(AtomicOpcode == ATOMIC_WAIT32 ? WASMType::I32
+                                               : WASMType::I64);
+    popAndPushValueType(1, WASMType::I32, WASMType::I32);
+    break;
+  default:
+    if (AtomicOpcode < I32_ATOMIC_STORE) {
+      popAndPushValueType(1, WASMType::I32, Type);
+    } else if (AtomicOpcode < I32_ATOMIC_RMW_ADD) {
+      popValueType(Type);
+      popValueType(WASMType::I32);
+    } else if (AtomicOpcode < I32_ATOMIC_RMW_CMPXCHG) {
+      popValueType(Type);
+      popAndPushValueType(1, WASMType::I32, Type);
+    } else {
+      popValueType(Type); // replacement
+      popValueType(Type); // expected
+      popAndPushValueType(1, WASMType::I32, Type);
+    }
+    break;
+  }
+  FuncCodeEntry.Stats |= Module::SF_memory;
+}
+#endif // ZEN_ENABLE_SGX
+
 void FunctionLoader::pushBlock(common::LabelType LabelType,
                                ControlBlockType BlockType,
                                const Byte *StartPtr) {
@@ -214,6 +294,28 @@ void FunctionLoader::checkBlockStack() {
   checkTopTypes(Block, NumReturnTypes, ReturnTypes, false);
 }
 
+void FunctionLoader::checkTailCall(const TypeEntry &CalleeType) {
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+  // Multipass has no tail call in its backend yet, a call + return there
+  // would grow the native stack on every tail call and overflow on deep tail
+  // recursion, so reject the proposal instead
+  if (Mod.getRuntime()->getConfig().Mode == RunMode::MultipassMode) {
+    throw getError(ErrorCode::UnsupportedOpcode);
+  }
+#endif
+  if (CalleeType.NumReturns != FuncTypeEntry.NumReturns) {
+    throw getError(ErrorCode::TypeMismatch);
+  }
+  for (uint32_t I = 0; I < CalleeType.NumReturns; ++I) {
+    if (CalleeType.ReturnTypes[I] != FuncTypeEntry.ReturnTypes[I]) {
+      throw getError(ErrorCode::TypeMismatch);
+    }
+  }
+  // The rest of the block is unreachable, as after `return`
+  resetStack();
+  setStackPolymorphic(true);
+}
+
 const FunctionLoader::ControlBlock &FunctionLoader::checkBranch() {
   uint32_t Depth = readU32();
   if (ControlBlocks.size() <= Depth) {
@@ -250,6 +352,13 @@ const FunctionLoader::ControlBlock &FunctionLoader::checkBranch() {
   return TargetBlock;
 }
 
+#if defined(ZEN_ENABLE_SINGLEPASS_JIT) || defined(ZEN_ENABLE_MULTIPASS_JIT)
+uint32_t FunctionLoader::getLoopWeight() const {
+  // Assume 8 iterations per loop level
+  return 1u << std::min(LoopDepth * 3, 24u);
+}
+#endif
+
 WASMType FunctionLoader::readLocal() {
   uint32_t LocalIdx = readU32();
   uint32_t NumParams = FuncTypeEntry.NumParams;
@@ -260,18 +369,95 @@ WASMType FunctionLoader::readLocal() {
   if (LocalIdx < NumParams) {
     return FuncTypeEntry.getParamTypes()[LocalIdx];
   }
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+  uint32_t Weight = getLoopWeight();
+  uint32_t &LocalWeight = LocalWeights[LocalIdx - NumParams];
+  LocalWeight = std::min<uint64_t>(uint64_t(LocalWeight) + Weight, UINT32_MAX);
+#endif
   return FuncCodeEntry.LocalTypes[LocalIdx - NumParams];
 }
 
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+void FunctionLoader::selectHotLocals() {
+  // The callee-saved registers hold the gas, memory and instance, so a hot
+  // local lives in a temporary register, which would be saved and restored
+  // around the calls of every iteration
+  if (CallInLoop) {
+    return;
+  }
+
+  // Locals used less than once per iteration of a loop are not worth
+  // a register, which has to be saved around every call
+  constexpr uint32_t MinHotLocalWeight = 8;
+  constexpr uint32_t MaxHotLocals = CodeEntry::MaxHotLocalsPerKind;
+
+  for (uint32_t I = 0; I < FuncCodeEntry.NumLocals; ++I) {
+    uint32_t Weight = LocalWeights[I];
+    if (Weight < MinHotLocalWeight) {
+      continue;
+    }
+
+    uint16_t *HotLocals;
+    uint8_t *NumHotLocals;
+    switch (FuncCodeEntry.LocalTypes[I]) {
+    case WASMType::I32:
+    case WASMType::I64:
+      HotLocals = FuncCodeEntry.HotIntLocals;
+      NumHotLocals = &FuncCodeEntry.NumHotIntLocals;
+      break;
+    case WASMType::F32:
+    case WASMType::F64:
+      HotLocals = FuncCodeEntry.HotFloatLocals;
+      NumHotLocals = &FuncCodeEntry.NumHotFloatLocals;
+      break;
+    default:
+      continue;
+    }
+
+    // Insert into the list in descending order of weights, the earlier local
+    // wins on a tie
+    uint32_t Pos = *NumHotLocals;
+    while (Pos > 0 && LocalWeights[HotLocals[Pos - 1]] < Weight) {
+      --Pos;
+    }
+    if (Pos == MaxHotLocals) {
+      continue;
+    }
+    for (uint32_t J = std::min<uint32_t>(*NumHotLocals, MaxHotLocals - 1);
+         J > Pos; --J) {
+      HotLocals[J] = HotLocals[J - 1];
+    }
+    HotLocals[Pos] = static_cast<uint16_t>(I);
+    *NumHotLocals = std::min<uint32_t>(*NumHotLocals + 1, MaxHotLocals);
+  }
+}
+#endif // ZEN_ENABLE_SINGLEPASS_JIT
+
 void FunctionLoader::load() {
   pushBlock(LABEL_FUNCTION, ControlBlockType(&FuncTypeEntry), Ptr);
 #ifdef ZEN_ENABLE_DWASM
   uint32_t NumOpcodes = 0;
 #endif
 #ifdef ZEN_ENABLE_MULTIPASS_JIT
-  std::vector<bool> CalleeIdxBitset(Mod.NumImportFunctions, true);
-  CalleeIdxBitset.resize(Mod.getNumTotalFunctions(), false);
+  // The internal callees in the order of their first calls, each weighted by
+  // the loop depths of its call sites
   std::vector<uint32_t> CalleeIdxSeq;
+  std::vector<uint32_t> CalleeWeights;
+  std::vector<uint32_t> CalleePositions(Mod.getNumTotalFunctions(),
+                                        UINT32_MAX);
+  auto AddCallee = [&](uint32_t CalleeIdx, uint32_t Weight) {
+    if (CalleeIdx < Mod.NumImportFunctions) {
+      return;
+    }
+    uint32_t &Pos = CalleePositions[CalleeIdx];
+    if (Pos == UINT32_MAX) {
+      Pos = CalleeIdxSeq.size();
+      CalleeIdxSeq.push_back(CalleeIdx);
+      CalleeWeights.push_back(0);
+    }
+    CalleeWeights[Pos] =
+        std::min<uint64_t>(uint64_t(CalleeWeights[Pos]) + Weight, UINT32_MAX);
+  };
 #endif
   while (Ptr < End) {
     uint8_t Opcode = to_underlying(readByte());
@@ -291,6 +477,11 @@ void FunctionLoader::load() {
       ControlBlockType BlockType = Type;
       auto BlockLabelTy = static_cast<LabelType>(LABEL_BLOCK + Opcode - BLOCK);
       pushBlock(BlockLabelTy, BlockType, Ptr);
+#if defined(ZEN_ENABLE_SINGLEPASS_JIT) || defined(ZEN_ENABLE_MULTIPASS_JIT)
+      if (BlockLabelTy == LABEL_LOOP) {
+        ++LoopDepth;
+      }
+#endif
 
       pushBlockParamTypes();
       break;
@@ -370,6 +561,11 @@ void FunctionLoader::load() {
         }
       } else {
         Block.EndPtr = Ptr - 1;
+#if defined(ZEN_ENABLE_SINGLEPASS_JIT) || defined(ZEN_ENABLE_MULTIPASS_JIT)
+        if (Block.LabelType == LABEL_LOOP) {
+          --LoopDepth;
+        }
+#endif
         popBlock();
         ZEN_ASSERT(!ControlBlocks.empty());
         setStackPolymorphic(false);
@@ -452,7 +648,10 @@ void FunctionLoader::load() {
 
       popAndPushValueType(1, WASMType::I32, WASMType::I32);
 
-      FuncCodeEntry.Stats |= Module::SF_memory;
+      FuncCodeEntry.Stats |= Module::SF_memory | Module::SF_memory_grow;
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+      markCall();
+#endif
 
       break;
     }
@@ -785,7 +984,8 @@ void FunctionLoader::load() {
       setStackPolymorphic(true);
       break;
     }
-    case CALL: {
+    case CALL:
+    case RETURN_CALL: {
       uint32_t CalleeIdx = readU32();
       if (!Mod.isValidFunc(CalleeIdx)) {
         throw getErrorWithExtraMessage(ErrorCode::UnknownFunction,
@@ -797,18 +997,23 @@ void FunctionLoader::load() {
         const WASMType *ParamTypes = CalleeFuncType->getParamTypes();
         popValueType(ParamTypes[I - 1]);
       }
-      for (uint32_t I = 0; I < CalleeFuncType->NumReturns; ++I) {
-        pushValueType(CalleeFuncType->ReturnTypes[I]);
+      if (Opcode == RETURN_CALL) {
+        checkTailCall(*CalleeFuncType);
+      } else {
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+        markCall();
+#endif
+        for (uint32_t I = 0; I < CalleeFuncType->NumReturns; ++I) {
+          pushValueType(CalleeFuncType->ReturnTypes[I]);
+        }
       }
 #ifdef ZEN_ENABLE_MULTIPASS_JIT
-      if (!CalleeIdxBitset[CalleeIdx]) {
-        CalleeIdxBitset[CalleeIdx] = true;
-        CalleeIdxSeq.push_back(CalleeIdx);
-      }
+      AddCallee(CalleeIdx, getLoopWeight());
 #endif
       break;
     }
-    case CALL_INDIRECT: {
+    case CALL_INDIRECT:
+    case RETURN_CALL_INDIRECT: {
       uint32_t TypeIdx = readU32();
       if (!Mod.isValidType(TypeIdx)) {
         throw getError(ErrorCode::UnknownTypeIdx);
@@ -832,21 +1037,41 @@ void FunctionLoader::load() {
         popValueType(ParamTypes[I - 1]);
       }
 
-      for (uint32_t I = 0; I < CalleeFuncType->NumReturns; ++I) {
-        pushValueType(CalleeFuncType->ReturnTypes[I]);
+      if (Opcode == RETURN_CALL_INDIRECT) {
+        checkTailCall(*CalleeFuncType);
+      } else {
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+        markCall();
+#endif
+        for (uint32_t I = 0; I < CalleeFuncType->NumReturns; ++I) {
+          pushValueType(CalleeFuncType->ReturnTypes[I]);
+        }
       }
 #ifdef ZEN_ENABLE_MULTIPASS_JIT
-      const auto &LikelyCalleeIdxs = Mod.TypedFuncRefs[TypeIdx];
-      for (uint32_t CalleeIdx : LikelyCalleeIdxs) {
-        if (!CalleeIdxBitset[CalleeIdx]) {
-          CalleeIdxBitset[CalleeIdx] = true;
-          CalleeIdxSeq.push_back(CalleeIdx);
+      // Use `find` rather than `operator[]` which inserts, the table is shared
+      // by the functions loaded concurrently
+      auto It = Mod.TypedFuncRefs.find(TypeIdx);
+      if (It != Mod.TypedFuncRefs.end()) {
+        // The weight of the call site is split among the possible callees
+        uint32_t NumCallees = It->second.size();
+        uint32_t Weight = std::max(getLoopWeight() / NumCallees, 1u);
+        for (uint32_t CalleeIdx : It->second) {
+          AddCallee(CalleeIdx, Weight);
         }
       }
 #endif
       FuncCodeEntry.Stats |= Module::SF_table;
       break;
     }
+#ifndef ZEN_ENABLE_SGX
+    case ATOMIC_PREFIX:
+      if (!Mod.getRuntime()->getConfig().EnableThreads) {
+        throw getErrorWithExtraMessage(ErrorCode::UnsupportedOpcode,
+                                       getOpcodeHexString(Opcode));
+      }
+      loadAtomicOpcode();
+      break;
+#endif // ZEN_ENABLE_SGX
     default:
       throw getErrorWithExtraMessage(ErrorCode::UnsupportedOpcode,
                                      getOpcodeHexString(Opcode));
@@ -886,7 +1111,17 @@ void FunctionLoader::load() {
   }
 
 #ifdef ZEN_ENABLE_MULTIPASS_JIT
-  Mod.CallSeqMap[FuncIdx] = std::move(CalleeIdxSeq);
+  // The entry is inserted by ModuleLoader before loading the function body
+  auto It = Mod.CallSeqMap.find(FuncIdx);
+  ZEN_ASSERT(It != Mod.CallSeqMap.end());
+  It->second = std::move(CalleeIdxSeq);
+  auto WeightIt = Mod.CallWeightMap.find(FuncIdx);
+  ZEN_ASSERT(WeightIt != Mod.CallWeightMap.end());
+  WeightIt->second = std::move(CalleeWeights);
+#endif
+
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+  selectHotLocals();
 #endif
 
   FuncCodeEntry.MaxStackSize = MaxStackSize;
@@ -53,17 +53,46 @@ class FunctionLoader final : public LoaderCommon {
   };
 
 public:
+  // Working stacks reused across the functions loaded by one thread
+  struct ScratchStacks {
+    std::vector<ControlBlock> ControlBlocks;
+    std::vector<WASMType> ValueTypes;
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+    std::vector<uint32_t> LocalWeights;
+#endif
+  };
+
   explicit FunctionLoader(runtime::Module &M, const Byte *PtrStart,
                           const Byte *PtrEnd, uint32_t FuncIdx,
-                          const runtime::TypeEntry &TE, runtime::CodeEntry &CE)
+                          const runtime::TypeEntry &TE, runtime::CodeEntry &CE,
+                          ScratchStacks &Scratch)
       : LoaderCommon(M, PtrStart, PtrEnd), FuncIdx(FuncIdx), FuncTypeEntry(TE),
-        FuncCodeEntry(CE) {}
+        FuncCodeEntry(CE), ControlBlocks(Scratch.ControlBlocks),
+        ValueTypes(Scratch.ValueTypes)
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+        ,
+        LocalWeights(Scratch.LocalWeights)
+#endif
+  {
+    ControlBlocks.clear();
+    ValueTypes.clear();
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+    LocalWeights.assign(CE.NumLocals, 0);
+#endif
+  }
 
+  /// \note only reads the module-level tables and writes the code entry of
+  /// this function, so different functions can be loaded concurrently
   void load();
 
 private:
   static bool checkMemoryAlign(uint8_t Opcode, uint32_t Align);
 
+#ifndef ZEN_ENABLE_SGX
+  /// Validate the atomic instruction following the 0xfe prefix
+  void loadAtomicOpcode();
+#endif // ZEN_ENABLE_SGX
+
   static std::string getTypeErrorMsg(WASMType ExpectedType,
                                      WASMType ActualType);
 
@@ -116,10 +145,27 @@ private:
 
   void checkBlockStack();
 
+  /// A tail call returns the callee's results directly to the caller's caller
+  void checkTailCall(const runtime::TypeEntry &CalleeType);
+
   const ControlBlock &checkBranch();
 
   WASMType readLocal();
 
+#if defined(ZEN_ENABLE_SINGLEPASS_JIT) || defined(ZEN_ENABLE_MULTIPASS_JIT)
+  // The estimated execution count of the current code relative to the
+  // function entry, by the loop depth
+  uint32_t getLoopWeight() const;
+#endif
+
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+  // Record a call emitted by singlepass JIT at the current loop depth
+  void markCall() { CallInLoop |= LoopDepth > 0; }
+
+  // Fill the hot locals of the code entry from LocalWeights
+  void selectHotLocals();
+#endif
+
   uint32_t FuncIdx;
   const runtime::TypeEntry &FuncTypeEntry;
   runtime::CodeEntry &FuncCodeEntry;
@@ -127,8 +173,17 @@ private:
   uint32_t StackSize = 0;
   uint32_t MaxStackSize = 0;
   uint32_t MaxBlockDepth = 0;
-  std::vector<ControlBlock> ControlBlocks;
-  std::vector<WASMType> ValueTypes;
+  std::vector<ControlBlock> &ControlBlocks;
+  std::vector<WASMType> &ValueTypes;
+#if defined(ZEN_ENABLE_SINGLEPASS_JIT) || defined(ZEN_ENABLE_MULTIPASS_JIT)
+  uint32_t LoopDepth = 0;
+#endif
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+  // Uses of the non-param locals, each weighted by its loop depth
+  std::vector<uint32_t> &LocalWeights;
+  // Whether the function calls inside a loop
+  bool CallInLoop = false;
+#endif
 };
 
 } // namespace zen::action
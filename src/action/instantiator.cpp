@@ -6,6 +6,7 @@
 #include "common/enums.h"
 #include "common/type.h"
 #include "runtime/instance.h"
+#include "runtime/isolation.h"
 #include "utils/math.h"
 #include <algorithm>
 
@@ -119,6 +120,8 @@ void Instantiator::instantiateFunctions(Instance &Inst) {
     } else {
       FuncInst.Kind = FunctionKind::ByteCode;
       const CodeEntry &Code = Mod.CodeTable[InternalFuncIdx];
+      // Read before the other fields, which are filled by the loading
+      FuncInst.Lazy = Code.Lazy.load(std::memory_order_acquire);
       FuncInst.NumLocals = Code.NumLocals;
       FuncInst.NumLocalCells = Code.NumLocalCells;
       FuncInst.LocalTypes = Code.LocalTypes;
@@ -250,9 +253,12 @@ void Instantiator::instantiateMemories(Instance &Inst) {
 
   for (uint32_t I = 0; I < Inst.NumTotalMemories; ++I) {
     MemoryInstance &MemInst = Inst.Memories[I];
+    MemInst.Shared = nullptr;
+    [[maybe_unused]] bool SharedMem = false;
 
     if (I < Mod.NumImportMemories) {
       const auto &ImportMem = Mod.ImportMemoryTable[I];
+      SharedMem = ImportMem.Shared;
       uint32_t CurMemPages = ImportMem.InitPages;
       uint32_t MaxMemPages = ImportMem.MaxPages;
       checkAndUpdateMemPages(VmMaxMemPages, CurMemPages, &MaxMemPages);
@@ -266,6 +272,7 @@ void Instantiator::instantiateMemories(Instance &Inst) {
     } else {
       uint32_t InternalMemIdx = I - Mod.NumImportMemories;
       const auto &Mem = Mod.InternalMemoryTable[InternalMemIdx];
+      SharedMem = Mem.Shared;
       uint32_t CurMemPages = Mem.InitSize;
 
       uint32_t MaxMemPages = 0;
@@ -290,6 +297,26 @@ void Instantiator::instantiateMemories(Instance &Inst) {
         MemInst.CurPages * uint64_t(common::DefaultBytesNumPerPage);
     ZEN_ASSERT(TotalMemSize <= UINT32_MAX);
 
+#ifndef ZEN_ENABLE_SGX
+    // Imported memories are created by the instance like the internal ones,
+    // a shared one is shared with the other instances of the module
+    if (SharedMem) {
+      bool Created = false;
+      SharedMemory *Shared = Inst.Iso->acquireSharedMemory(
+          Mod, MemInst.CurPages, MemInst.MaxPages, Created);
+      if (!Shared) {
+        ZEN_ABORT();
+      }
+      MemInst.Shared = Shared;
+      // Takes the current size, the memory may have grown since created
+      Shared->addUser(MemInst);
+      // Only the instance creating the memory applies the data segments,
+      // the others must not overwrite what has been stored since
+      Inst.DataSegsInited = !Created;
+      continue;
+    }
+#endif // ZEN_ENABLE_SGX
+
     auto *MemAllocator = Inst.getWasmMemoryAllocator();
     bool DataSegsInited = false;
 
@@ -7,7 +7,13 @@
 #include "entrypoint/entrypoint.h"
 #include "runtime/instance.h"
 #include "utils/logging.h"
+#ifndef ZEN_ENABLE_SGX
+#include "runtime/atomics.h"
+#endif // ZEN_ENABLE_SGX
 #include "utils/wasm.h"
+#ifdef ZEN_ENABLE_WASM_PROFILER
+#include "runtime/profiler.h"
+#endif
 #include <bitset>
 #include <cmath>
 #include <type_traits>
@@ -22,6 +28,9 @@ using namespace runtime;
 // local_ptr <-----> frame <-----> control stack <----> value stack
 InterpFrame *InterpreterExecContext::allocFrame(FunctionInstance *FuncInst,
                                                 uint32_t *LocalPtr) {
+  if (ZEN_UNLIKELY(FuncInst->Lazy)) {
+    getInstance()->loadLazyFunction(*FuncInst);
+  }
   InterpStack *Stack = getInterpStack();
   uint32_t LocalSize = FuncInst->NumLocalCells << 2;
   uint32_t ControlSize = FuncInst->MaxBlockDepth * sizeof(BlockInfo);
@@ -568,13 +577,26 @@ private:
       case MEMORY_GROW:
         Ptr = skipLEBNumber<uint32_t>(Ptr, End);
         break;
+      case ATOMIC_PREFIX: {
+        uint32_t AtomicOpcode = 0;
+        Ptr = readSafeLEBNumber(Ptr, AtomicOpcode);
+        if (AtomicOpcode == ATOMIC_FENCE) {
+          ++Ptr;
+        } else {
+          Ptr = skipLEBNumber<uint32_t>(Ptr, End);
+          Ptr = skipLEBNumber<uint32_t>(Ptr, End);
+        }
+        break;
+      }
       case RETURN:
         break;
-      case CALL: {
+      case CALL:
+      case RETURN_CALL: {
         Ptr = skipLEBNumber<uint32_t>(Ptr, End);
         break;
       }
-      case CALL_INDIRECT: {
+      case CALL_INDIRECT:
+      case RETURN_CALL_INDIRECT: {
         Ptr = skipLEBNumber<uint32_t>(Ptr, End);
         Ptr++;
         break;
@@ -603,6 +625,21 @@ private:
                     uint32_t *&ValStackPtr, BlockInfo *&ControlStackPtr,
                     uint32_t *&LocalPtr, FunctionInstance *&FuncInst);
 
+  /// Replace the current frame by the callee's, returns false if the callee
+  /// returned from the outermost frame (only for native callees, which can't
+  /// reuse the frame and are called normally)
+  bool tailCallFuncInst(FunctionInstance *FuncInstCallee,
+                        InterpreterExecContext &Context, const uint8_t *&Ip,
+                        const uint8_t *&IpEnd, InterpFrame *&Frame,
+                        uint32_t *&ValStackPtr, BlockInfo *&ControlStackPtr,
+                        uint32_t *&LocalPtr, FunctionInstance *&FuncInst);
+
+  /// Pop the current frame, returns false if it was the outermost frame
+  bool returnFromFunc(InterpreterExecContext &Context, const uint8_t *&Ip,
+                      const uint8_t *&IpEnd, InterpFrame *&Frame,
+                      uint32_t *&ValStackPtr, BlockInfo *&ControlStackPtr,
+                      uint32_t *&LocalPtr, FunctionInstance *&FuncInst);
+
   template <bool Sign, BinaryOperator Opr, typename SignedT, typename UnsignedT,
             typename WasmReturnType>
   WasmReturnType handleCheckedArithmeticImpl(WasmReturnType LHS,
@@ -900,6 +937,20 @@ private:
     Frame->valuePush<decltype(Ret)>(ValStackPtr, Ret);
   }
 
+  // LinearMemSize is read once per frame, another instance may have grown
+  // the shared memory since
+  static bool isOutOfBounds(const MemoryInstance &Memory, uint64_t End,
+                            uint64_t LinearMemSize) {
+    if (ZEN_LIKELY(End <= LinearMemSize)) {
+      return false;
+    }
+#ifndef ZEN_ENABLE_SGX
+    return !Memory.Shared || End > Memory.Shared->getSize();
+#else
+    return true;
+#endif // ZEN_ENABLE_SGX
+  }
+
   template <typename SrcType, typename DestType>
   void storeOp(MemoryInstance &Memory, const uint8_t *&Ip, const uint8_t *IpEnd,
                InterpFrame *Frame, uint32_t *&ValStackPtr,
@@ -909,7 +960,8 @@ private:
     Ip = readSafeLEBNumber(Ip, Offset);
     SrcType Val = Frame->valuePop<SrcType>(ValStackPtr);
     uint32_t Addr = Frame->valuePop<uint32_t>(ValStackPtr);
-    if ((uint64_t)Offset + sizeof(DestType) + Addr > LinearMemSize) {
+    if (isOutOfBounds(Memory, (uint64_t)Offset + sizeof(DestType) + Addr,
+                      LinearMemSize)) {
       throw getError(ErrorCode::OutOfBoundsMemory);
     }
     uint8_t *Start = Memory.MemBase + Offset + Addr;
@@ -928,7 +980,8 @@ private:
     Ip = readSafeLEBNumber(Ip, Align);
     Ip = readSafeLEBNumber(Ip, Offset);
     uint32_t Addr = Frame->valuePop<uint32_t>(ValStackPtr);
-    if ((uint64_t)Offset + sizeof(SrcType) + Addr > LinearMemSize) {
+    if (isOutOfBounds(Memory, (uint64_t)Offset + sizeof(SrcType) + Addr,
+                      LinearMemSize)) {
       throw getError(ErrorCode::OutOfBoundsMemory);
     }
     uint8_t *Start = Memory.MemBase + Offset + Addr;
@@ -939,6 +992,58 @@ private:
     Frame->valuePush<DestType>(ValStackPtr, *(SrcType *)Start);
   }
 
+#ifndef ZEN_ENABLE_SGX
+  void atomicOp(MemoryInstance &Memory, uint32_t Opcode, uint32_t Offset,
+                InterpFrame *Frame, uint32_t *&ValStackPtr) {
+    bool Is64 = isAtomicOp64(Opcode);
+    auto PopValue = [&]() -> uint64_t {
+      return Is64 ? Frame->valuePop<uint64_t>(ValStackPtr)
+                  : Frame->valuePop<uint32_t>(ValStackPtr);
+    };
+    uint64_t Arg1 = 0, Arg2 = 0;
+    bool HasResult = true;
+    switch (Opcode) {
+    case ATOMIC_NOTIFY:
+      Arg1 = Frame->valuePop<uint32_t>(ValStackPtr);
+      break;
+    case ATOMIC_WAIT32:
+    case ATOMIC_WAIT64:
+      Arg2 = Frame->valuePop<uint64_t>(ValStackPtr);
+      Arg1 = PopValue();
+      // The result of wait is i32 whatever the width waited on
+      Is64 = false;
+      break;
+    default:
+      switch (getAtomicOpKind(Opcode)) {
+      case AtomicOpKind::Load:
+        break;
+      case AtomicOpKind::Store:
+        Arg1 = PopValue();
+        HasResult = false;
+        break;
+      case AtomicOpKind::Cmpxchg:
+        Arg2 = PopValue();
+        Arg1 = PopValue();
+        break;
+      default:
+        Arg1 = PopValue();
+        break;
+      }
+      break;
+    }
+    uint32_t Addr = Frame->valuePop<uint32_t>(ValStackPtr);
+    uint64_t Ret = executeAtomicOp(Memory, Opcode, Addr, Offset, Arg1, Arg2);
+    if (!HasResult) {
+      return;
+    }
+    if (Is64) {
+      Frame->valuePush<uint64_t>(ValStackPtr, Ret);
+    } else {
+      Frame->valuePush<uint32_t>(ValStackPtr, static_cast<uint32_t>(Ret));
+    }
+  }
+#endif // ZEN_ENABLE_SGX
+
   template <typename TargetType, typename SrcType, bool IsSigned>
   void truncate(InterpFrame *Frame, uint32_t *&ValStackPtr) {
     static_assert(sizeof(TargetType) == 4 || sizeof(TargetType) == 8);
@@ -977,10 +1082,13 @@ void BaseInterpreterImpl::updateFrame(
   // update frame
   Ip = Frame->Ip;
   IpEnd = Frame->FuncInst->CodePtr + Frame->FuncInst->CodeSize;
-  ValStackPtr = Frame->ValueStackPtr;
   if (IsReturn) {
-    ValStackPtr -= FuncInst->NumParamCells;
-    ValStackPtr += FuncInst->NumReturnCells;
+    // The results were copied to the locals of the returning function, which
+    // started at the params pushed by the caller. Don't derive it from the
+    // params of FuncInst, tail calls may have replaced the called function
+    ValStackPtr = LocalPtr + FuncInst->NumReturnCells;
+  } else {
+    ValStackPtr = Frame->ValueStackPtr;
   }
   ControlStackPtr = Frame->CtrlStackPtr;
 
@@ -1003,6 +1111,12 @@ void BaseInterpreterImpl::callFuncInst(
     FunctionInstance *&FuncInst) {
 
   ZEN_ASSERT(Callee != nullptr);
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  if (WasmProfilerScope *ProfScope = WasmProfilerScope::current()) {
+    ProfScope->countCall(
+        static_cast<uint32_t>(Callee - Context.getInstance()->getFunctionInst(0)));
+  }
+#endif // ZEN_ENABLE_WASM_PROFILER
   if (Callee->Kind == FunctionKind::Native) {
     // Prepare slots to pass arguments
     int32_t ParamCount = Callee->NumParams;
@@ -1105,6 +1219,78 @@ void BaseInterpreterImpl::callFuncInst(
   }
 }
 
+bool BaseInterpreterImpl::tailCallFuncInst(
+    FunctionInstance *Callee, InterpreterExecContext &Context,
+    const uint8_t *&Ip, const uint8_t *&IpEnd, InterpFrame *&Frame,
+    uint32_t *&ValStackPtr, BlockInfo *&ControlStackPtr, uint32_t *&LocalPtr,
+    FunctionInstance *&FuncInst) {
+  ZEN_ASSERT(Callee != nullptr);
+  if (Callee->Kind != FunctionKind::ByteCode) {
+    callFuncInst(Callee, Context, Ip, IpEnd, Frame, ValStackPtr,
+                 ControlStackPtr, LocalPtr, FuncInst);
+    return returnFromFunc(Context, Ip, IpEnd, Frame, ValStackPtr,
+                          ControlStackPtr, LocalPtr, FuncInst);
+  }
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  if (WasmProfilerScope *ProfScope = WasmProfilerScope::current()) {
+    ProfScope->countCall(
+        static_cast<uint32_t>(Callee - Context.getInstance()->getFunctionInst(0)));
+  }
+#endif // ZEN_ENABLE_WASM_PROFILER
+
+  // Release the current frame, then move the args to the start of the current
+  // locals, which become the locals of the callee, and allocate the callee's
+  // frame in its place, so that the stack usage doesn't grow with the tail
+  // calls. The args may overwrite the released frame when the callee takes
+  // more params than the current function has params and locals.
+  InterpFrame *PrevFrame = Frame->PrevFrame;
+  Context.freeFrame(FuncInst, Frame);
+  Context.setCurFrame(PrevFrame);
+  uint32_t NumParamCells = Callee->NumParamCells;
+  ValStackPtr -= NumParamCells;
+  std::memmove(LocalPtr, ValStackPtr, NumParamCells << 2);
+
+  // The callee may take more params than the current function
+  InterpStack *Stack = Context.getInterpStack();
+  uint8_t *ParamsEnd = reinterpret_cast<uint8_t *>(LocalPtr + NumParamCells);
+  if (Stack->Top < ParamsEnd) {
+    Stack->Top = ParamsEnd;
+  }
+
+  Frame = Context.allocFrame(Callee, LocalPtr);
+  if (Frame == nullptr) {
+    throw getError(ErrorCode::CallStackExhausted);
+  }
+  updateFrame(Ip, IpEnd, Frame, ValStackPtr, ControlStackPtr, LocalPtr,
+              FuncInst, false);
+
+  std::memset(LocalPtr + FuncInst->NumParamCells, 0,
+              ((uint32_t)FuncInst->NumLocalCells) << 2);
+
+  Frame->blockPush(ControlStackPtr, IpEnd - 1, ValStackPtr,
+                   FuncInst->NumReturnCells, LABEL_FUNCTION);
+  return true;
+}
+
+bool BaseInterpreterImpl::returnFromFunc(
+    InterpreterExecContext &Context, const uint8_t *&Ip, const uint8_t *&IpEnd,
+    InterpFrame *&Frame, uint32_t *&ValStackPtr, BlockInfo *&ControlStackPtr,
+    uint32_t *&LocalPtr, FunctionInstance *&FuncInst) {
+  Context.freeFrame(FuncInst, Frame);
+  InterpFrame *PrevFrame = Frame->PrevFrame;
+  ValStackPtr -= (FuncInst->NumReturnCells);
+  std::memcpy(LocalPtr, ValStackPtr, FuncInst->NumReturnCells << 2);
+  if (PrevFrame == nullptr || !PrevFrame->Ip) {
+    return false;
+  }
+  Frame = PrevFrame;
+  Context.setCurFrame(Frame);
+  // update frame
+  updateFrame(Ip, IpEnd, Frame, ValStackPtr, ControlStackPtr, LocalPtr,
+              FuncInst, true);
+  return true;
+}
+
 void BaseInterpreterImpl::interpret() {
 #define DIRECT_DISPATCH 0
 #if !DIRECT_DISPATCH
@@ -1379,10 +1565,10 @@ void BaseInterpreterImpl::interpret() {
       }
       CASE(MEMORY_GROW) : {
         Ip = readSafeLEBNumber(Ip, LocalIdx);
-        uint32_t GrowOldPageCount = Memory->CurPages;
+        uint32_t GrowOldPageCount = 0;
         uint32_t GrowPageCount = Frame->valuePop<uint32_t>(ValStackPtr);
 
-        if (ModInst->growLinearMemory(0, GrowPageCount)) {
+        if (ModInst->growLinearMemory(0, GrowPageCount, &GrowOldPageCount)) {
           Frame->valuePush<uint32_t>(ValStackPtr, GrowOldPageCount);
         } else {
           Frame->valuePush<int32_t>(ValStackPtr, -1);
@@ -1392,6 +1578,12 @@ void BaseInterpreterImpl::interpret() {
       }
       CASE(MEMORY_SIZE) : {
         Ip = readSafeLEBNumber(Ip, LocalIdx);
+#ifndef ZEN_ENABLE_SGX
+        if (Memory->Shared) {
+          Frame->valuePush(ValStackPtr, Memory->Shared->getCurPages());
+          BREAK;
+        }
+#endif // ZEN_ENABLE_SGX
         Frame->valuePush(ValStackPtr, Memory->CurPages);
         BREAK;
       }
@@ -1993,18 +2185,10 @@ void BaseInterpreterImpl::interpret() {
         BREAK;
       }
       CASE(RETURN) : {
-        Context.freeFrame(FuncInst, Frame);
-        InterpFrame *PrevFrame = Frame->PrevFrame;
-        ValStackPtr -= (FuncInst->NumReturnCells);
-        std::memcpy(LocalPtr, ValStackPtr, FuncInst->NumReturnCells << 2);
-        if (PrevFrame == nullptr || !PrevFrame->Ip) {
+        if (!returnFromFunc(Context, Ip, IpEnd, Frame, ValStackPtr,
+                            ControlStackPtr, LocalPtr, FuncInst)) {
           return;
         }
-        Frame = PrevFrame;
-        Context.setCurFrame(Frame);
-        // update frame
-        updateFrame(Ip, IpEnd, Frame, ValStackPtr, ControlStackPtr, LocalPtr,
-                    FuncInst, true);
         BREAK;
       }
       CASE(CALL) : {
@@ -2068,6 +2252,76 @@ void BaseInterpreterImpl::interpret() {
                      ControlStackPtr, LocalPtr, FuncInst);
         BREAK;
       }
+      CASE(RETURN_CALL) : {
+        Ip = readSafeLEBNumber(Ip, FuncIdx);
+#ifdef ZEN_ENABLE_DEBUG_INTERP
+        ZEN_LOG_DEBUG("fidx: %d", FuncIdx);
+#endif
+        if (FuncIdx == Mod->getGasFuncIdx()) {
+          uint64_t Delta = Frame->valuePop<uint64_t>(ValStackPtr);
+          uint64_t GasLeft = ModInst->getGas();
+          if (GasLeft < Delta) {
+            ModInst->setGas(0);
+            throw getError(ErrorCode::GasLimitExceeded);
+          }
+          ModInst->setGas(GasLeft - Delta);
+
+          if (!returnFromFunc(Context, Ip, IpEnd, Frame, ValStackPtr,
+                              ControlStackPtr, LocalPtr, FuncInst)) {
+            return;
+          }
+          BREAK;
+        }
+#ifdef ZEN_ENABLE_CHECKED_ARITHMETIC
+        Frame->ValueStackPtr = ValStackPtr;
+#define HANDLE_CHECKED_ARITHMETIC_CALL_POSTHOOK                                \
+  ValStackPtr = Frame->ValueStackPtr;                                          \
+  if (!returnFromFunc(Context, Ip, IpEnd, Frame, ValStackPtr,                  \
+                      ControlStackPtr, LocalPtr, FuncInst)) {                  \
+    return;                                                                    \
+  }
+
+        HANDLE_CHECKED_ARITHMETIC_CALL(Mod, FuncIdx)
+#undef HANDLE_CHECKED_ARITHMETIC_CALL_POSTHOOK
+#endif // ZEN_ENABLE_CHECKED_ARITHMETIC
+
+        FunctionInstance *FuncInstCallee = ModInst->getFunctionInst(FuncIdx);
+        if (!tailCallFuncInst(FuncInstCallee, Context, Ip, IpEnd, Frame,
+                              ValStackPtr, ControlStackPtr, LocalPtr,
+                              FuncInst)) {
+          return;
+        }
+        BREAK;
+      }
+      CASE(RETURN_CALL_INDIRECT) : {
+        uint32_t TypeIdx = 0, TableIdx = 0;
+        Ip = readSafeLEBNumber(Ip, TypeIdx);
+        // Skip the fixed byte for `table 0`
+        ++Ip;
+        auto *ExpectedFuncType = Mod->getDeclaredType(TypeIdx);
+
+        int32_t IndirectFuncIdx = Frame->valuePop<int32_t>(ValStackPtr);
+        TableInstance *Table = ModInst->getTableInst(TableIdx);
+        if (IndirectFuncIdx < 0 ||
+            (uint32_t)IndirectFuncIdx >= Table->CurSize) {
+          throw getError(ErrorCode::UndefinedElement);
+        }
+        FuncIdx = Table->Elements[IndirectFuncIdx];
+        if (FuncIdx == (uint32_t)-1) {
+          throw getError(ErrorCode::UninitializedElement);
+        }
+        auto *FuncInstCallee = ModInst->getFunctionInst(FuncIdx);
+        ZEN_ASSERT(FuncInstCallee);
+        if (!TypeEntry::isEqual(FuncInstCallee->FuncType, ExpectedFuncType)) {
+          throw getError(ErrorCode::IndirectCallTypeMismatch);
+        }
+        if (!tailCallFuncInst(FuncInstCallee, Context, Ip, IpEnd, Frame,
+                              ValStackPtr, ControlStackPtr, LocalPtr,
+                              FuncInst)) {
+          return;
+        }
+        BREAK;
+      }
       CASE(END) : {
         if (ControlStackPtr > Frame->CtrlBasePtr + 1) {
           Frame->blockPop(ControlStackPtr);
@@ -2092,6 +2346,21 @@ void BaseInterpreterImpl::interpret() {
         }
         BREAK;
       }
+#ifndef ZEN_ENABLE_SGX
+      CASE(ATOMIC_PREFIX) : {
+        uint32_t AtomicOpcode, Align, Offset;
+        Ip = readSafeLEBNumber(Ip, AtomicOpcode);
+        if (AtomicOpcode == ATOMIC_FENCE) {
+          ++Ip; // skip 0x0
+          __atomic_thread_fence(__ATOMIC_SEQ_CST);
+          BREAK;
+        }
+        Ip = readSafeLEBNumber(Ip, Align);
+        Ip = readSafeLEBNumber(Ip, Offset);
+        atomicOp(*Memory, AtomicOpcode, Offset, Frame, ValStackPtr);
+        BREAK;
+      }
+#endif // ZEN_ENABLE_SGX
     DEFAULT : {
       ZEN_LOG_ERROR("munimplemented opcode: 0x%x", Opcode);
       ZEN_ASSERT_TODO();
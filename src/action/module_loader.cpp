@@ -3,6 +3,7 @@
 
 #include "action/module_loader.h"
 #include "action/function_loader.h"
+#include "runtime/runtime.h"
 #include "runtime/symbol_wrapper.h"
 #include "utils/unicode.h"
 #include "utils/wasm.h"
@@ -11,6 +12,10 @@
 #include "action/hook.h"
 #endif
 
+#ifndef ZEN_ENABLE_SGX
+#include "common/thread_pool.h"
+#endif
+
 namespace zen::action {
 
 using namespace common;
@@ -49,6 +54,7 @@ void ModuleLoader::load() {
     throw getError(ErrorCode::ModuleSizeTooLarge);
   }
 
+  waitForBytes(2 * sizeof(uint32_t));
   loadModuleHeader();
 
   loadModuleBody();
@@ -76,16 +82,28 @@ WASMSymbol ModuleLoader::readName() {
   return NameSymbol;
 }
 
-ModuleLoader::Limits ModuleLoader::readLimits() {
+ModuleLoader::Limits ModuleLoader::readLimits(bool *Shared) {
   Byte Flag = readByte();
-  if (Flag > Byte(0x01)) {
+  Byte MaxFlag = Flag;
+#ifndef ZEN_ENABLE_SGX
+  // Only memory limits may be shared(0x02/0x03), with the threads proposal
+  if (Shared && Flag <= Byte(0x03) &&
+      Mod.getRuntime()->getConfig().EnableThreads) {
+    *Shared = Flag >= Byte(0x02);
+    MaxFlag = Flag & Byte(0x01);
+    if (Flag == Byte(0x02)) {
+      throw getError(ErrorCode::SharedMemoryMustHaveMax);
+    }
+  }
+#endif // ZEN_ENABLE_SGX
+  if (MaxFlag > Byte(0x01)) {
     throw getError(ErrorCode::InvalidLimitsFlag);
   }
 
   uint32_t Min = readU32();
   common::Optional<uint32_t> Max;
   // If has maximum, read and check it
-  if (Flag == Byte(0x01)) {
+  if (MaxFlag == Byte(0x01)) {
     Max = readU32();
     if (Min > Max.value()) {
       throw getError(ErrorCode::SizeMinimumGreaterThenMaximum);
@@ -105,13 +123,14 @@ ModuleLoader::TableType ModuleLoader::readTableType() {
 }
 
 ModuleLoader::MemoryType ModuleLoader::readMemoryType() {
-  const auto &[MinMemPages, OptMaxMemPages] = readLimits();
+  bool Shared = false;
+  const auto &[MinMemPages, OptMaxMemPages] = readLimits(&Shared);
   uint32_t MaxMemPages = OptMaxMemPages.value_or(PresetMaxMemoryPages);
   if (MinMemPages > PresetMaxMemoryPages ||
       MaxMemPages > PresetMaxMemoryPages) {
     throw getError(ErrorCode::MemorySizeTooLarge);
   }
-  return {MinMemPages, MaxMemPages};
+  return {MinMemPages, MaxMemPages, Shared};
 }
 
 ModuleLoader::GlobalType ModuleLoader::readGlobalType() {
@@ -321,6 +340,11 @@ void ModuleLoader::loadModuleBody() {
     if (SecEnd > End) {
       throw getError(ErrorCode::UnexpectedEnd);
     }
+    // The code section is consumed function by function, so that validation
+    // overlaps with the arrival of the rest bodies
+    if (SecType != SectionType::SEC_CODE) {
+      waitForData(SecEnd);
+    }
 
     // Swap `SecEnd` and `End` and restore after loading current section
     std::swap(SecEnd, End);
@@ -527,9 +551,9 @@ void ModuleLoader::loadImportSection() {
         break;
       }
       case IMPORT_MEMORY: {
-        const auto [MinMemPages, MaxMemPages] = readMemoryType();
+        const auto [MinMemPages, MaxMemPages, Shared] = readMemoryType();
         ImportMemoryTable.emplace_back(ModuleName, FieldName, MinMemPages,
-                                       MaxMemPages);
+                                       MaxMemPages, Shared);
         break;
       }
       case IMPORT_GLOBAL: {
@@ -662,10 +686,11 @@ void ModuleLoader::loadMemorySection() {
 
   MemoryEntry *Entry = Mod.initMemoryTable(NumMemories);
   for (uint32_t I = 0; I < NumMemories; ++I) {
-    const auto [MinMemPages, MaxMemPages] = readMemoryType();
+    const auto [MinMemPages, MaxMemPages, Shared] = readMemoryType();
 
     Entry->InitSize = MinMemPages;
     Entry->MaxSize = MaxMemPages;
+    Entry->Shared = Shared;
 
     ++Entry;
   }
@@ -844,136 +869,321 @@ void ModuleLoader::loadElementSection() {
 
 void ModuleLoader::loadDataCountSection() { Mod.DataCount = readU32(); }
 
-void ModuleLoader::loadCodeSection() {
-  uint32_t NumCodes = readU32();
-  // Only check function number consistency, no need to check `NumCodes` range
-  if (NumCodes != Mod.NumInternalFunctions) {
-    throw getError(ErrorCode::FuncCodeInconsistent);
+#ifndef ZEN_ENABLE_SGX
+namespace {
+
+// Validate function bodies in a thread pool while the loading thread parses
+// the locals of the following functions. The error of the function with the
+// lowest index is reported, the same as loading serially.
+class ParallelFunctionLoader {
+public:
+  ParallelFunctionLoader(uint32_t NumThreads)
+      : Scratches(NumThreads), Pool(NumThreads) {
+    for (uint32_t I = 0; I < NumThreads; ++I) {
+      Pool.setThreadContext(I, &Scratches[I]);
+    }
   }
 
-  // Calculate the distance between callsite and callee in AArch64 singlepass
-  uint32_t CodeOffset = 0;
+  bool hasError() const { return FirstErrFuncIdx != NoErrFuncIdx; }
 
-  CodeEntry *Entry = Mod.initCodeTable(NumCodes);
-  uint32_t NumImportFunctions = Mod.getNumImportFunctions();
-  uint32_t NumTotalFunctions = NumImportFunctions + NumCodes;
-  for (uint32_t I = NumImportFunctions; I < NumTotalFunctions; ++I) {
-    uint32_t CodeSize = readU32();
-    if (CodeSize > PresetMaxFunctionSize) {
-      throw getError(ErrorCode::FunctionSizeTooLarge);
-    }
-
-    // Include `vec(locals) expr`
-    const Byte *CodePtrStart = Ptr;
-    uint32_t NumLocals = 0;
-    uint32_t NumLocalCells = 0;
-    uint32_t NumLocalVectors = readU32();
-    const Byte *PrevPtr = Ptr;
-
-    // First pass to get the total number and cells of locals
-    for (uint32_t J = 0; J < NumLocalVectors; ++J) {
-      // Number of same type locals
-      uint32_t NumSameLocals = readU32();
-      if (addOverflow(NumLocals, NumSameLocals, NumLocals)) {
-        throw getError(ErrorCode::TooManyLocals);
+  void pushFunction(Module &Mod, const Byte *PtrStart, const Byte *PtrEnd,
+                    uint32_t FuncIdx, const TypeEntry &FuncType,
+                    CodeEntry &Entry) {
+    Pool.pushTask([=, &Mod, &FuncType,
+                   &Entry](FunctionLoader::ScratchStacks *Scratch) {
+      // An earlier function already failed, this one can't be reported
+      if (FuncIdx > FirstErrFuncIdx) {
+        return;
       }
-
-      WASMType Type = readValType();
-      uint32_t NumCells = getWASMTypeCellNum(Type);
-
-      uint32_t NumSameLocalCells;
-      if (mulOverflow(NumSameLocals, NumCells, NumSameLocalCells) ||
-          addOverflow(NumLocalCells, NumSameLocalCells, NumLocalCells)) {
-        throw getError(ErrorCode::TooManyLocals);
+      try {
+        FunctionLoader FuncLoader(Mod, PtrStart, PtrEnd, FuncIdx, FuncType,
+                                  Entry, *Scratch);
+        FuncLoader.load();
+      } catch (const Error &Err) {
+        LockGuard<Mutex> Lock(ErrMtx);
+        if (FuncIdx < FirstErrFuncIdx) {
+          FirstErrFuncIdx = FuncIdx;
+          FirstErr = Err;
+        }
       }
+    });
+  }
+
+  // Wait for all the pushed functions, and throw the first error of the
+  // functions before `FuncIdxLimit`
+  void finish(uint32_t FuncIdxLimit = NoErrFuncIdx) {
+    Pool.setNoNewTask();
+    Pool.waitForTasks();
+    if (FirstErrFuncIdx < FuncIdxLimit) {
+      throw FirstErr;
     }
+  }
 
-    if (NumLocals > PresetMaxFunctionLocals ||
-        NumLocalCells > PresetMaxFunctionLocalCells) {
+private:
+  static constexpr uint32_t NoErrFuncIdx = UINT32_MAX;
+
+  std::vector<FunctionLoader::ScratchStacks> Scratches;
+  Mutex ErrMtx;
+  std::atomic<uint32_t> FirstErrFuncIdx{NoErrFuncIdx};
+  Error FirstErr = ErrorCode::NoError;
+  // Declared last so that the threads stop before the members above are
+  // destroyed
+  ThreadPool<FunctionLoader::ScratchStacks> Pool;
+};
+
+} // namespace
+#endif // ZEN_ENABLE_SGX
+
+const Byte *ModuleLoader::loadFunctionLocals(const TypeEntry &FuncType,
+                                             CodeEntry &Entry,
+                                             uint32_t CodeSize) {
+  // Include `vec(locals) expr`
+  const Byte *CodePtrStart = Ptr;
+  uint32_t NumLocals = 0;
+  uint32_t NumLocalCells = 0;
+  uint32_t NumLocalVectors = readU32();
+  const Byte *PrevPtr = Ptr;
+
+  // First pass to get the total number and cells of locals
+  for (uint32_t J = 0; J < NumLocalVectors; ++J) {
+    // Number of same type locals
+    uint32_t NumSameLocals = readU32();
+    if (addOverflow(NumLocals, NumSameLocals, NumLocals)) {
       throw getError(ErrorCode::TooManyLocals);
     }
 
-    WASMType *LocalTypes = Mod.initLocalTypes(NumLocals);
-    WASMType *LocalTypesPtr = LocalTypes;
-    Ptr = PrevPtr;
+    WASMType Type = readValType();
+    uint32_t NumCells = getWASMTypeCellNum(Type);
 
-    // Second pass to set the local types
-    for (uint32_t J = 0; J < NumLocalVectors; ++J) {
-      uint32_t NumSameLocals = readU32();
-      WASMType Type = readValType();
-      std::memset(LocalTypesPtr, to_underlying(Type), NumSameLocals);
-      if (addOverflow(LocalTypesPtr, NumSameLocals, LocalTypesPtr)) {
-        throw getError(ErrorCode::TooManyLocals);
-      }
+    uint32_t NumSameLocalCells;
+    if (mulOverflow(NumSameLocals, NumCells, NumSameLocalCells) ||
+        addOverflow(NumLocalCells, NumSameLocalCells, NumLocalCells)) {
+      throw getError(ErrorCode::TooManyLocals);
     }
+  }
+
+  if (NumLocals > PresetMaxFunctionLocals ||
+      NumLocalCells > PresetMaxFunctionLocalCells) {
+    throw getError(ErrorCode::TooManyLocals);
+  }
+
+  WASMType *LocalTypes = Mod.initLocalTypes(NumLocals);
+  WASMType *LocalTypesPtr = LocalTypes;
+  Ptr = PrevPtr;
 
-    TypeEntry *FuncType = Mod.getFunctionType(I);
-    ZEN_ASSERT(FuncType);
-    uint32_t NumParamsAndLocals;
-    if (addOverflow(static_cast<uint32_t>(FuncType->NumParams), NumLocals,
-                    NumParamsAndLocals)) {
+  // Second pass to set the local types
+  for (uint32_t J = 0; J < NumLocalVectors; ++J) {
+    uint32_t NumSameLocals = readU32();
+    WASMType Type = readValType();
+    std::memset(LocalTypesPtr, to_underlying(Type), NumSameLocals);
+    if (addOverflow(LocalTypesPtr, NumSameLocals, LocalTypesPtr)) {
       throw getError(ErrorCode::TooManyLocals);
     }
-    size_t TotalLocalSize = NumParamsAndLocals * sizeof(uint32_t);
-    if (TotalLocalSize > 0) {
-      Entry->LocalOffsets = Mod.initLocalOffsets(TotalLocalSize);
-
-      const WASMType *ParamTypes = FuncType->getParamTypes();
-      uint32_t LocalOffset = 0;
-
-      // Set the offsets of parameters
-      for (uint32_t J = 0; J < FuncType->NumParams; ++J) {
-        Entry->LocalOffsets[J] = LocalOffset;
-        uint32_t ParamSize = getWASMTypeCellNum(ParamTypes[J]);
-        if (addOverflow(LocalOffset, ParamSize, LocalOffset)) {
-          throw getError(ErrorCode::TooManyParams);
-        }
+  }
+
+  uint32_t NumParamsAndLocals;
+  if (addOverflow(static_cast<uint32_t>(FuncType.NumParams), NumLocals,
+                  NumParamsAndLocals)) {
+    throw getError(ErrorCode::TooManyLocals);
+  }
+  size_t TotalLocalSize = NumParamsAndLocals * sizeof(uint32_t);
+  if (TotalLocalSize > 0) {
+    Entry.LocalOffsets = Mod.initLocalOffsets(TotalLocalSize);
+
+    const WASMType *ParamTypes = FuncType.getParamTypes();
+    uint32_t LocalOffset = 0;
+
+    // Set the offsets of parameters
+    for (uint32_t J = 0; J < FuncType.NumParams; ++J) {
+      Entry.LocalOffsets[J] = LocalOffset;
+      uint32_t ParamSize = getWASMTypeCellNum(ParamTypes[J]);
+      if (addOverflow(LocalOffset, ParamSize, LocalOffset)) {
+        throw getError(ErrorCode::TooManyParams);
       }
+    }
 
-      // Set the offsets of local variables
-      for (uint32_t J = 0; J < NumLocals; ++J) {
-        Entry->LocalOffsets[FuncType->NumParams + J] = LocalOffset;
-        uint32_t LocalSize = getWASMTypeCellNum(LocalTypes[J]);
-        if (addOverflow(LocalOffset, LocalSize, LocalOffset)) {
-          throw getError(ErrorCode::TooManyLocals);
-        }
+    // Set the offsets of local variables
+    for (uint32_t J = 0; J < NumLocals; ++J) {
+      Entry.LocalOffsets[FuncType.NumParams + J] = LocalOffset;
+      uint32_t LocalSize = getWASMTypeCellNum(LocalTypes[J]);
+      if (addOverflow(LocalOffset, LocalSize, LocalOffset)) {
+        throw getError(ErrorCode::TooManyLocals);
       }
+    }
 
 #if defined(ZEN_ENABLE_DWASM) && defined(ZEN_ENABLE_JIT)
-      Entry->JITStackCost = (LocalOffset << 2) + 64;
+    Entry.JITStackCost = (LocalOffset << 2) + 64;
 #endif
-    } else {
+  } else {
 #if defined(ZEN_ENABLE_DWASM) && defined(ZEN_ENABLE_JIT)
-      Entry->JITStackCost = 64;
+    Entry.JITStackCost = 64;
 #endif
-    }
+  }
 
-    // ActualCodeSize < CodeSize < PresetMaxFunctionSize < UINT32_MAX
-    uint32_t ActualCodeSize = CodePtrStart + CodeSize - Ptr;
+  // ActualCodeSize < CodeSize < PresetMaxFunctionSize < UINT32_MAX
+  uint32_t ActualCodeSize = CodePtrStart + CodeSize - Ptr;
 
-    Entry->NumLocals = static_cast<uint16_t>(NumLocals);
-    Entry->NumLocalCells = static_cast<uint16_t>(NumLocalCells);
-    Entry->LocalTypes = LocalTypes;
-    Entry->CodePtr = reinterpret_cast<const uint8_t *>(Ptr);
-    Entry->CodeSize = ActualCodeSize;
-    Entry->CodeOffset = CodeOffset;
-    Entry->Stats = Module::SF_none;
+  Entry.NumLocals = static_cast<uint16_t>(NumLocals);
+  Entry.NumLocalCells = static_cast<uint16_t>(NumLocalCells);
+  Entry.LocalTypes = LocalTypes;
+  Entry.CodePtr = reinterpret_cast<const uint8_t *>(Ptr);
+  Entry.CodeSize = ActualCodeSize;
 
-    const Byte *CodePtrEnd;
-    if (addOverflow(Ptr, ActualCodeSize, CodePtrEnd) || CodePtrEnd > End) {
-      throw getError(ErrorCode::UnexpectedEnd);
-    }
+  const Byte *CodePtrEnd;
+  if (addOverflow(Ptr, ActualCodeSize, CodePtrEnd) || CodePtrEnd > End) {
+    throw getError(ErrorCode::UnexpectedEnd);
+  }
+  return CodePtrEnd;
+}
+
+void ModuleLoader::loadLazyFunction(Module &M, uint32_t FuncIdx) {
+  CodeEntry *Entry = M.getCodeEntry(FuncIdx);
+  TypeEntry *FuncType = M.getFunctionType(FuncIdx);
+  ZEN_ASSERT(Entry && FuncType);
+  const Byte *CodePtrStart = reinterpret_cast<const Byte *>(Entry->CodePtr);
+  ModuleLoader Loader(M, CodePtrStart, CodePtrStart + Entry->CodeSize);
+  const Byte *CodePtrEnd =
+      Loader.loadFunctionLocals(*FuncType, *Entry, Entry->CodeSize);
+
+  FunctionLoader::ScratchStacks Scratch;
+  FunctionLoader FuncLoader(M, Loader.Ptr, CodePtrEnd, FuncIdx, *FuncType,
+                            *Entry, Scratch);
+  FuncLoader.load();
+}
+
+void ModuleLoader::loadCodeSection() {
+  waitForBytes(MaxLEBU32Size);
+  uint32_t NumCodes = readU32();
+  // Only check function number consistency, no need to check `NumCodes` range
+  if (NumCodes != Mod.NumInternalFunctions) {
+    throw getError(ErrorCode::FuncCodeInconsistent);
+  }
+
+  // Calculate the distance between callsite and callee in AArch64 singlepass
+  uint32_t CodeOffset = 0;
+
+  CodeEntry *Entry = Mod.initCodeTable(NumCodes);
+  uint32_t NumImportFunctions = Mod.getNumImportFunctions();
+  uint32_t NumTotalFunctions = NumImportFunctions + NumCodes;
+
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+  // Insert the entries up front, so that the function bodies loaded
+  // concurrently only fill their own entries
+  Mod.CallSeqMap.reserve(NumCodes);
+  Mod.CallWeightMap.reserve(NumCodes);
+  for (uint32_t I = NumImportFunctions; I < NumTotalFunctions; ++I) {
+    Mod.CallSeqMap[I];
+    Mod.CallWeightMap[I];
+  }
+#endif
+
+  const RuntimeConfig &Config = Mod.getRuntime()->getConfig();
+  bool LazyLoad =
+      Config.EnableLazyFunctionLoad && Config.Mode == RunMode::InterpMode;
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+  // Lazy multipass loads each function before compiling it, see
+  // LazyJITCompiler::compileFunctionOnRequest
+  LazyLoad |= Config.EnableLazyFunctionLoad &&
+              Config.Mode == RunMode::MultipassMode &&
+              Config.EnableMultipassLazy;
+#endif
+
+  FunctionLoader::ScratchStacks Scratch;
+#ifndef ZEN_ENABLE_SGX
+  std::unique_ptr<ParallelFunctionLoader> ParallelLoader;
+  uint32_t NumThreads = Config.NumValidationThreads;
+  if (!LazyLoad && NumThreads > 1 &&
+      NumCodes >= MinNumParallelLoadFunctions) {
+    ParallelLoader = std::make_unique<ParallelFunctionLoader>(NumThreads);
+  }
+#endif // ZEN_ENABLE_SGX
+
+  uint32_t I = NumImportFunctions;
+  try {
+    for (; I < NumTotalFunctions; ++I) {
+      waitForBytes(MaxLEBU32Size);
+      uint32_t CodeSize = readU32();
+      if (CodeSize > PresetMaxFunctionSize) {
+        throw getError(ErrorCode::FunctionSizeTooLarge);
+      }
+      waitForBytes(CodeSize);
+
+      Entry->CodeOffset = CodeOffset;
+      Entry->Stats = Module::SF_none;
+
+      const Byte *CodePtrEnd;
+      if (LazyLoad) {
+        // Only locate the code, see Module::loadLazyFunction
+        if (addOverflow(Ptr, CodeSize, CodePtrEnd) || CodePtrEnd > End) {
+          throw getError(ErrorCode::UnexpectedEnd);
+        }
+        Entry->CodePtr = reinterpret_cast<const uint8_t *>(Ptr);
+        Entry->CodeSize = CodeSize;
+        Entry->Lazy.store(true, std::memory_order_relaxed);
+      } else {
+        TypeEntry *FuncType = Mod.getFunctionType(I);
+        ZEN_ASSERT(FuncType);
+        CodePtrEnd = loadFunctionLocals(*FuncType, *Entry, CodeSize);
+
+#ifndef ZEN_ENABLE_SGX
+        if (ParallelLoader) {
+          // Stop parsing, the error is thrown by `finish` below
+          if (ParallelLoader->hasError()) {
+            break;
+          }
+          ParallelLoader->pushFunction(Mod, Ptr, CodePtrEnd, I, *FuncType,
+                                       *Entry);
+        } else
+#endif // ZEN_ENABLE_SGX
+        {
+          FunctionLoader FuncLoader(Mod, Ptr, CodePtrEnd, I, *FuncType,
+                                    *Entry, Scratch);
+          FuncLoader.load();
+        }
+      }
 
-    FunctionLoader FuncLoader(Mod, Ptr, CodePtrEnd, I, *FuncType, *Entry);
-    FuncLoader.load();
+      Ptr = CodePtrEnd;
+      if (addOverflow(CodeOffset, Entry->CodeSize, CodeOffset) ||
+          CodeOffset > PresetMaxTotalFunctionSize) {
+        throw getError(ErrorCode::CodeSectionTooLarge);
+      }
 
-    Ptr = CodePtrEnd;
-    if (addOverflow(CodeOffset, ActualCodeSize, CodeOffset) ||
-        CodeOffset > PresetMaxTotalFunctionSize) {
-      throw getError(ErrorCode::CodeSectionTooLarge);
+      ++Entry;
+    }
+  } catch (const Error &) {
+#ifndef ZEN_ENABLE_SGX
+    // A function before `I` may have failed in the validation threads
+    if (ParallelLoader) {
+      ParallelLoader->finish(I);
     }
+#endif // ZEN_ENABLE_SGX
+    throw;
+  }
 
-    ++Entry;
+#ifndef ZEN_ENABLE_SGX
+  if (ParallelLoader) {
+    ParallelLoader->finish();
+  }
+#endif // ZEN_ENABLE_SGX
+
+  // An imported memory may be grown by other instances, an internal one only
+  // by memory.grow in this module and up to its max size
+  bool MayGrowInternalMemory = false;
+  for (uint32_t I = 0; I < Mod.NumInternalMemories; ++I) {
+    const MemoryEntry &Entry = Mod.InternalMemoryTable[I];
+    MayGrowInternalMemory |= Entry.MaxSize > Entry.InitSize;
+  }
+  if (Mod.NumImportMemories > 0) {
+    Mod.MemoryMayGrow = true;
+  } else if (MayGrowInternalMemory) {
+    for (uint32_t I = 0; I < NumCodes; ++I) {
+      // The lazy functions are not scanned yet
+      if (Mod.CodeTable[I].Lazy.load(std::memory_order_relaxed) ||
+          (Mod.CodeTable[I].Stats & Module::SF_memory_grow)) {
+        Mod.MemoryMayGrow = true;
+        break;
+      }
+    }
   }
 }
 
@@ -5,6 +5,7 @@
 #define ZEN_ACTION_MODULE_LOADER_H
 
 #include "action/loader_common.h"
+#include "runtime/codeholder.h"
 
 namespace zen::action {
 
@@ -26,27 +27,38 @@ class ModuleLoader final : public LoaderCommon {
 
   // {MinTableSize, MaxTableSize}
   typedef std::pair<uint32_t, uint32_t> TableType;
-  // {MinMemPages, MaxMemPages}
-  typedef std::pair<uint32_t, uint32_t> MemoryType;
+  // {MinMemPages, MaxMemPages, Shared}
+  typedef std::tuple<uint32_t, uint32_t, bool> MemoryType;
   // {Type, Mutable}
   typedef std::pair<WASMType, bool> GlobalType;
 
 public:
-  explicit ModuleLoader(runtime::Module &M, const Byte *Data, size_t Size)
+  /// \param DataStream if not null, the data arrives progressively through
+  /// this stream and the loader waits for it section by section
+  /// (function by function in the code section)
+  explicit ModuleLoader(runtime::Module &M, const Byte *Data, size_t Size,
+                        const runtime::CodeStream *DataStream = nullptr)
       // Set `End` to nullptr temporarily, and then formally set `End` when the
       // `load` method is called
       : ModuleLoader(M, Data, nullptr) {
     ModuleSize = Size;
+    Stream = DataStream;
   }
 
   void load();
 
+  /// \brief parse the locals and validate the body of a function skipped by
+  /// lazy function loading, see runtime::Module::loadLazyFunction
+  static void loadLazyFunction(runtime::Module &M, uint32_t FuncIdx);
+
 private:
   ModuleLoader(runtime::Module &M, const Byte *PtrStart, const Byte *PtrEnd)
       : LoaderCommon(M, PtrStart, PtrEnd) {}
 
   WASMSymbol readName();
-  Limits readLimits();
+  /// \param Shared if not null, the limits of a memory are being read and
+  /// the shared flag is accepted when threads are enabled
+  Limits readLimits(bool *Shared = nullptr);
   TableType readTableType();
   MemoryType readMemoryType();
   GlobalType readGlobalType();
@@ -56,7 +68,26 @@ private:
   const void *resolveImportFunction(WASMSymbol ModuleName, WASMSymbol FieldName,
                                     const runtime::TypeEntry &ExpectedFuncType);
 
+  // Block until the data before `Until` is available in streaming mode
+  void waitForData(const Byte *Until) {
+#ifndef ZEN_ENABLE_SGX
+    if (Stream && !Stream->waitForData(Until - Start)) {
+      throw getError(ErrorCode::UnexpectedEnd);
+    }
+#endif // ZEN_ENABLE_SGX
+  }
+
+  // Block until the next `Size` bytes(or the rest of the current range) are
+  // available in streaming mode
+  void waitForBytes(size_t Size) {
+    if (Stream) {
+      waitForData(static_cast<size_t>(End - Ptr) < Size ? End : Ptr + Size);
+    }
+  }
+
   std::pair<SectionType, uint32_t> loadSectionHeader() {
+    // Section id and the LEB128 encoded section size
+    waitForBytes(1 + MaxLEBU32Size);
     SectionType SecType = static_cast<SectionType>(readByte());
     uint32_t SecSize = readU32();
     return {SecType, SecSize};
@@ -76,6 +107,11 @@ private:
   void loadElementSection();
   void loadDataCountSection();
   void loadCodeSection();
+  // Parse the locals of the function at `Ptr` whose code(locals and body) is
+  // of `CodeSize` bytes, fill them and the body range into `Entry`, and return
+  // the end of the body
+  const Byte *loadFunctionLocals(const runtime::TypeEntry &FuncType,
+                                 runtime::CodeEntry &Entry, uint32_t CodeSize);
   void loadDataSection();
 
   void loadNameSection();
@@ -84,8 +120,13 @@ private:
   void patchForSpecTest();
 #endif
 
+  static constexpr size_t MaxLEBU32Size = 5;
+  // Smaller code sections are not worth starting the validation threads
+  static constexpr uint32_t MinNumParallelLoadFunctions = 64;
+
   bool HasNameSection = false;
   size_t ModuleSize = 0;
+  const runtime::CodeStream *Stream = nullptr;
 }; // class ModuleLoader
 
 } // namespace zen::action
@@ -29,9 +29,31 @@ using namespace zen::common;
 using namespace zen::runtime;
 using namespace zen::utils;
 
+#ifdef ZEN_ENABLE_WASM_PROFILER
+static std::string WasmProfileFilename;
+
+static void writeWasmProfile(Runtime *RT) {
+  WasmProfiler *Profiler = RT->getWasmProfiler();
+  if (!Profiler) {
+    return;
+  }
+  RT->stopWasmProfiler();
+  if (!Profiler->writeFoldedStacks(WasmProfileFilename)) {
+    ZEN_LOG_ERROR("failed to write wasm profile");
+  }
+  if (Profiler->isCountingCalls() &&
+      !Profiler->writeCallCounts(WasmProfileFilename + ".calls")) {
+    ZEN_LOG_ERROR("failed to write wasm call counts");
+  }
+}
+#endif // ZEN_ENABLE_WASM_PROFILER
+
 int exitMain(int ExitCode, Runtime *RT = nullptr) {
   if (RT) {
     RT->getStatistics().report();
+#ifdef ZEN_ENABLE_WASM_PROFILER
+    writeWasmProfile(RT);
+#endif
   }
 
 #ifdef ZEN_ENABLE_PROFILER
@@ -119,10 +141,43 @@ int main(int argc, char *argv[]) {
         "--enable-gdb-tracing-hook", Config.EnableGdbTracingHook,
         "Enable gdb cpu instruction tracing hook(then can trace cpu "
         "instructions when executing wasm in gdb)");
+    CLIParser->add_flag("--enable-lazy-function-load",
+                        Config.EnableLazyFunctionLoad,
+                        "Validate functions on their first call(interpreter "
+                        "and multipass lazy mode only)");
+    CLIParser->add_option("--num-validation-threads",
+                          Config.NumValidationThreads,
+                          "Number of threads to validate function bodies of "
+                          "large modules(0 or 1 to validate serially)");
+    CLIParser->add_option("--memory-pool-slots", Config.NumWasmMemoryPoolSlots,
+                          "Number of linear memory slots reserved up front(0 "
+                          "to disable the memory pool)");
+    CLIParser->add_flag("--enable-memory-image", Config.EnableWasmMemoryImage,
+                        "Map the initial linear memory copy-on-write from a "
+                        "per-module image(requires --memory-pool-slots)");
+    CLIParser->add_flag("--enable-threads", Config.EnableThreads,
+                        "Enable shared linear memory and atomic instructions");
+#ifdef ZEN_ENABLE_VIRTUAL_STACK
+    CLIParser->add_option("--retained-virtual-stacks",
+                          Config.NumRetainedVirtualStacks,
+                          "Number of free virtual stacks kept committed");
+#endif // ZEN_ENABLE_VIRTUAL_STACK
 #ifdef ZEN_ENABLE_MULTIPASS_JIT
     CLIParser->add_flag("--disable-multipass-greedyra",
                         Config.DisableMultipassGreedyRA,
                         "Disable greedy register allocation of multipass JIT");
+    CLIParser->add_flag("--enable-multipass-linear-scan-ra",
+                        Config.EnableMultipassLinearScanRA,
+                        "Use linear scan register allocation of multipass JIT "
+                        "for large functions and on request compilation");
+    CLIParser->add_option("--multipass-max-ra-func-instrs",
+                          Config.MultipassMaxRAFuncInstrs,
+                          "Use fast register allocation for functions of more "
+                          "instructions in multipass JIT(0 for unlimited)");
+    CLIParser->add_option("--multipass-func-budget-ms",
+                          Config.MultipassFuncBudgetMs,
+                          "Compile time budget of a function in multipass "
+                          "JIT in milliseconds(0 for unlimited)");
     auto *DMMOption = CLIParser->add_flag(
         "--disable-multipass-multithread", Config.DisableMultipassMultithread,
         "Disable multithread compilation of multipass JIT");
@@ -133,8 +188,31 @@ int main(int argc, char *argv[]) {
         ->excludes(DMMOption);
     CLIParser->add_flag("--enable-multipass-lazy", Config.EnableMultipassLazy,
                         "Enable multipass lazy mode(on request compile)");
+    CLIParser->add_option("--multipass-profile-dir", Config.MultipassProfileDir,
+                          "Directory of the profiles recording the called "
+                          "functions in multipass lazy mode, which are "
+                          "compiled first by the next runs");
+    CLIParser->add_flag("--enable-multipass-indirect-call-cache",
+                        Config.EnableMultipassIndirectCallCache,
+                        "Emit inline caches at call_indirect sites in "
+                        "multipass JIT");
     CLIParser->add_option("--entry-hint", EntryHint, "Entry function hint");
 #endif // ZEN_ENABLE_MULTIPASS_JIT
+#ifdef ZEN_ENABLE_WASM_PROFILER
+    auto *ProfileOption = CLIParser->add_option(
+        "--profile", WasmProfileFilename,
+        "Sample wasm functions and write folded stacks(flamegraph.pl input) "
+        "to the file");
+    CLIParser
+        ->add_option("--profile-interval", Config.WasmProfilerIntervalUs,
+                     "Sampling interval of wasm profiler in microseconds")
+        ->needs(ProfileOption);
+    CLIParser
+        ->add_flag("--profile-call-counts", Config.EnableWasmProfilerCallCounts,
+                   "Also write exact call counts of wasm functions to "
+                   "<profile>.calls(interpreter mode only)")
+        ->needs(ProfileOption);
+#endif // ZEN_ENABLE_WASM_PROFILER
 
     CLI11_PARSE(*CLIParser, argc, argv);
   } catch (const std::exception &e) {
@@ -142,6 +220,10 @@ int main(int argc, char *argv[]) {
     return exitMain(EXIT_FAILURE);
   }
 
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  Config.EnableWasmProfiler = !WasmProfileFilename.empty();
+#endif
+
   try {
     zen::setGlobalLogger(createConsoleLogger("dtvm_cli_logger", LogLevel));
   } catch (const std::exception &e) {
@@ -301,6 +383,9 @@ int main(int argc, char *argv[]) {
 #endif
 
   if (EnableBenchmark) {
+#ifdef ZEN_ENABLE_WASM_PROFILER
+    writeWasmProfile(RT.get());
+#endif
     _exit(ExitCode);
   }
 
@@ -0,0 +1,429 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+// Benchmarks the engine phases(parsing and validation, compilation,
+// instantiation, call overhead and execution) of a fixed workload corpus in
+// every run mode built in, and writes the results as JSON. Compare two result
+// files with tools/bench_compare.py.
+
+#include "runtime/codeholder.h"
+#include "utils/logging.h"
+#include "utils/statistics.h"
+#include "zetaengine.h"
+#include <CLI/CLI.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifdef ZEN_ENABLE_BUILTIN_WASI
+#include "host/wasi/wasi.h"
+#endif
+
+using namespace zen::common;
+using namespace zen::runtime;
+using namespace zen::utils;
+
+#ifndef ZEN_BENCH_CORPUS_DIR
+#define ZEN_BENCH_CORPUS_DIR "bench"
+#endif
+
+namespace {
+
+struct BenchWorkload {
+  const char *Name;
+  const char *FuncName;
+  std::vector<std::string> Args;
+  // The single i32/i64 result, checked to catch miscompilations
+  uint64_t Expected;
+  // When set, the call must trap with it instead of returning Expected, and
+  // is repeated NumTrapCalls times per sample to measure the cost of a trap
+  ErrorCode ExpectedTrap = ErrorCode::NoError;
+  // Compiled from tests/bench/<File>.wat, defaults to Name
+  const char *File = nullptr;
+
+  const char *getFile() const { return File ? File : Name; }
+};
+
+// Every module also exports "nop" to measure the call overhead
+const BenchWorkload Workloads[] = {
+    {"fib", "fib", {"24"}, 46368},
+    {"erc20", "transfers", {"20000"}, 999999984702},
+    {"keccak", "keccak", {"200"}, 0xd425ee992bbdc1ec},
+    {"abi_encode", "encode", {"200"}, 1497696},
+    {"revert", "revert", {"16"}, 0, ErrorCode::Unreachable},
+    {"out_of_gas", "out_of_gas", {"16"}, 0, ErrorCode::GasLimitExceeded},
+    {"call_indirect_mono", "dispatch", {"100000", "0"}, 100000,
+     ErrorCode::NoError, "call_indirect"},
+    {"call_indirect_mega", "dispatch", {"100000", "31"}, 1650000,
+     ErrorCode::NoError, "call_indirect"},
+    {"br_table_16", "dispatch16", {"20000"}, 169983, ErrorCode::NoError,
+     "br_table"},
+    {"br_table_64", "dispatch64", {"20000"}, 649938, ErrorCode::NoError,
+     "br_table"},
+    {"br_table_256", "dispatch256", {"20000"}, 2569752, ErrorCode::NoError,
+     "br_table"},
+};
+
+constexpr uint32_t NumNopCalls = 1000;
+constexpr uint32_t NumTrapCalls = 1000;
+// Enough for about 100 iterations of the loop in out_of_gas
+constexpr uint64_t TrapGasLimit = 100000;
+
+struct BenchMode {
+  std::string Name;
+  RuntimeConfig Config;
+};
+
+std::vector<BenchMode> getBenchModes() {
+  std::vector<BenchMode> Modes;
+  RuntimeConfig Config;
+  Config.EnableStatistics = true;
+
+  Config.Mode = RunMode::InterpMode;
+  Modes.push_back({"interp", Config});
+
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+  Config.Mode = RunMode::SinglepassMode;
+  Modes.push_back({"singlepass", Config});
+#endif // ZEN_ENABLE_SINGLEPASS_JIT
+
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+  Config.Mode = RunMode::MultipassMode;
+  // Measure the compilation cost rather than the parallelism of the machine
+  Config.DisableMultipassMultithread = true;
+  for (bool Lazy : {false, true}) {
+    Config.EnableMultipassLazy = Lazy;
+    std::string Prefix = Lazy ? "multipass-lazy" : "multipass-eager";
+
+    Config.DisableMultipassGreedyRA = false;
+    Config.EnableMultipassLinearScanRA = false;
+    Modes.push_back({Prefix + "-greedy", Config});
+
+    // Compare with -greedy to measure the inline caches of call_indirect
+    Config.EnableMultipassIndirectCallCache = true;
+    Modes.push_back({Prefix + "-greedy-icache", Config});
+    Config.EnableMultipassIndirectCallCache = false;
+
+    Config.EnableMultipassLinearScanRA = true;
+    Modes.push_back({Prefix + "-linear-scan", Config});
+
+    Config.EnableMultipassLinearScanRA = false;
+    Config.DisableMultipassGreedyRA = true;
+    Modes.push_back({Prefix + "-fast", Config});
+  }
+#endif // ZEN_ENABLE_MULTIPASS_JIT
+
+  return Modes;
+}
+
+struct BenchResult {
+  std::string Name;
+  uint64_t MedianNs;
+  uint64_t MinNs;
+  uint32_t Samples;
+};
+
+class BenchRunner {
+public:
+  BenchRunner(const std::string &CorpusDir, uint32_t Repetitions)
+      : CorpusDir(CorpusDir), Repetitions(Repetitions) {}
+
+  bool run(const BenchMode &Mode, const BenchWorkload &Workload);
+
+  const std::vector<BenchResult> &getResults() const { return Results; }
+
+private:
+  void addResult(const std::string &Name, std::vector<uint64_t> &Samples) {
+    if (Samples.empty()) {
+      return;
+    }
+    std::sort(Samples.begin(), Samples.end());
+    Results.push_back({Name, Samples[Samples.size() / 2], Samples.front(),
+                       static_cast<uint32_t>(Samples.size())});
+  }
+
+  static bool resolveCall(const Module &Mod, const BenchWorkload &Workload,
+                          uint32_t &FuncIdx, std::vector<TypedValue> &Args);
+
+  static uint64_t getPhaseNs(const StatisticsSnapshot &Snapshot,
+                             StatisticPhase Phase) {
+    return Snapshot.Phases[to_underlying(Phase)].TotalNs;
+  }
+
+  static uint64_t elapsedNs(SteadyClock::time_point Start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               SteadyClock::now() - Start)
+        .count();
+  }
+
+  std::string CorpusDir;
+  uint32_t Repetitions;
+  std::vector<BenchResult> Results;
+};
+
+bool BenchRunner::run(const BenchMode &Mode, const BenchWorkload &Workload) {
+  std::unique_ptr<Runtime> RT = Runtime::newRuntime(Mode.Config);
+  if (!RT) {
+    ZEN_LOG_ERROR("failed to create runtime of mode %s", Mode.Name.c_str());
+    return false;
+  }
+
+#ifdef ZEN_ENABLE_BUILTIN_WASI
+  RT->setWASIArgs(Workload.getFile(), {});
+  RT->setWASIEnvs({});
+  RT->setWASIDirs({});
+  if (!LOAD_HOST_MODULE(RT, zen::host, wasi_snapshot_preview1)) {
+    ZEN_LOG_ERROR("failed to load WASI module");
+    return false;
+  }
+#endif
+
+  const std::string Filename =
+      CorpusDir + "/" + Workload.getFile() + ".wasm";
+  CodeHolderUniquePtr Code;
+  try {
+    Code = CodeHolder::newFileCodeHolder(*RT, Filename);
+  } catch (const std::exception &E) {
+    ZEN_LOG_ERROR("failed to read %s: %s", Filename.c_str(), E.what());
+    return false;
+  }
+
+  const std::string Prefix =
+      std::string(Workload.Name) + "/" + Mode.Name + "/";
+  const Statistics &Stats = RT->getStatistics();
+  std::vector<uint64_t> LoadSamples, ParseSamples, CompileSamples;
+
+  // Load phase, a new name every time to bypass the module cache
+  Module *Mod = nullptr;
+  auto Before = std::make_unique<StatisticsSnapshot>();
+  auto After = std::make_unique<StatisticsSnapshot>();
+  for (uint32_t I = 0; I <= Repetitions; ++I) {
+    Stats.snapshot(*Before);
+    auto Start = SteadyClock::now();
+    MayBe<Module *> ModRet =
+        RT->loadModule(Prefix + std::to_string(I), Code->getData(),
+                       Code->getSize(), Workload.FuncName);
+    uint64_t LoadNs = elapsedNs(Start);
+    if (!ModRet) {
+      ZEN_LOG_ERROR("failed to load %s: %s", Filename.c_str(),
+                    ModRet.getError().getFormattedMessage(false).c_str());
+      return false;
+    }
+    Stats.snapshot(*After);
+    // Keep the last module for the other phases
+    if (I == Repetitions) {
+      Mod = *ModRet;
+      break;
+    }
+    LoadSamples.push_back(LoadNs);
+    // The load phase of the statistics covers the module loader, which
+    // parses and validates the module in one pass
+    ParseSamples.push_back(getPhaseNs(*After, StatisticPhase::Load) -
+                           getPhaseNs(*Before, StatisticPhase::Load));
+    uint64_t CompileNs =
+        getPhaseNs(*After, StatisticPhase::JITCompilation) -
+        getPhaseNs(*Before, StatisticPhase::JITCompilation) +
+        getPhaseNs(*After, StatisticPhase::JITLazyPrecompilation) -
+        getPhaseNs(*Before, StatisticPhase::JITLazyPrecompilation);
+    if (CompileNs > 0) {
+      CompileSamples.push_back(CompileNs);
+    }
+    RT->unloadModule(*ModRet);
+  }
+  addResult(Prefix + "load", LoadSamples);
+  addResult(Prefix + "parse_validate", ParseSamples);
+  addResult(Prefix + "compile", CompileSamples);
+
+  IsolationUniquePtr Iso = RT->createUnmanagedIsolation();
+  if (!Iso) {
+    ZEN_LOG_ERROR("failed to create isolation");
+    return false;
+  }
+
+  std::vector<uint64_t> InstantiateSamples, CallSamples, ExecuteSamples;
+  uint32_t NopFuncIdx = 0;
+  if (!Mod->getExportFunc(RT->probeSymbol("nop", 3), NopFuncIdx)) {
+    ZEN_LOG_ERROR("%s doesn't export nop", Filename.c_str());
+    return false;
+  }
+  const std::vector<TypedValue> NoArgs;
+  uint32_t FuncIdx = 0;
+  std::vector<TypedValue> Args;
+  if (!resolveCall(*Mod, Workload, FuncIdx, Args)) {
+    return false;
+  }
+  for (uint32_t I = 0; I < Repetitions; ++I) {
+    auto Start = SteadyClock::now();
+    MayBe<Instance *> InstRet = Iso->createInstance(*Mod);
+    InstantiateSamples.push_back(elapsedNs(Start));
+    if (!InstRet) {
+      ZEN_LOG_ERROR("failed to create instance: %s",
+                    InstRet.getError().getFormattedMessage(false).c_str());
+      return false;
+    }
+    Instance *Inst = *InstRet;
+
+    std::vector<TypedValue> Results;
+    Start = SteadyClock::now();
+    for (uint32_t J = 0; J < NumNopCalls; ++J) {
+      RT->callWasmFunction(*Inst, NopFuncIdx, NoArgs, Results);
+      Results.clear();
+    }
+    CallSamples.push_back(elapsedNs(Start) / NumNopCalls);
+
+    if (Workload.ExpectedTrap != ErrorCode::NoError) {
+      Start = SteadyClock::now();
+      for (uint32_t J = 0; J < NumTrapCalls; ++J) {
+        Inst->clearError();
+        Inst->setGas(TrapGasLimit);
+        if (RT->callWasmFunction(*Inst, FuncIdx, Args, Results)) {
+          ZEN_LOG_ERROR("%s didn't trap", Workload.FuncName);
+          return false;
+        }
+        if (Inst->getError().getCode() != Workload.ExpectedTrap) {
+          ZEN_LOG_ERROR("unexpected trap of %s: %s", Workload.FuncName,
+                        Inst->getError().getFormattedMessage(false).c_str());
+          return false;
+        }
+        Results.clear();
+      }
+      ExecuteSamples.push_back(elapsedNs(Start) / NumTrapCalls);
+      Iso->deleteInstance(Inst);
+      continue;
+    }
+
+    Start = SteadyClock::now();
+    bool Succeeded = RT->callWasmFunction(*Inst, FuncIdx, Args, Results);
+    ExecuteSamples.push_back(elapsedNs(Start));
+    if (!Succeeded) {
+      ZEN_LOG_ERROR("failed to call %s: %s", Workload.FuncName,
+                    Inst->getError().getFormattedMessage(false).c_str());
+      return false;
+    }
+    ZEN_ASSERT(Results.size() == 1);
+    uint64_t Result = Results[0].Type == WASMType::I64
+                          ? static_cast<uint64_t>(Results[0].Value.I64)
+                          : static_cast<uint32_t>(Results[0].Value.I32);
+    if (Result != Workload.Expected) {
+      ZEN_LOG_ERROR("unexpected result of %s: %llu", Workload.FuncName,
+                    static_cast<unsigned long long>(Result));
+      return false;
+    }
+    Iso->deleteInstance(Inst);
+  }
+  addResult(Prefix + "instantiate", InstantiateSamples);
+  addResult(Prefix + "call", CallSamples);
+  addResult(Prefix + "execute", ExecuteSamples);
+
+  RT->unloadModule(Mod);
+  return true;
+}
+
+// Looks up the workload function and converts its arguments once, so that
+// neither is part of the execution samples
+bool BenchRunner::resolveCall(const Module &Mod, const BenchWorkload &Workload,
+                              uint32_t &FuncIdx,
+                              std::vector<TypedValue> &Args) {
+  if (!Mod.getExportFunc(Workload.FuncName, FuncIdx)) {
+    ZEN_LOG_ERROR("cannot find function '%s'", Workload.FuncName);
+    return false;
+  }
+  const TypeEntry *FuncType = Mod.getFunctionType(FuncIdx);
+  if (FuncType->NumParams != Workload.Args.size()) {
+    ZEN_LOG_ERROR("unexpected number of arguments of %s", Workload.FuncName);
+    return false;
+  }
+  const WASMType *ParamTypes = FuncType->getParamTypes();
+  Args.resize(Workload.Args.size());
+  for (size_t I = 0; I < Args.size(); ++I) {
+    // The corpus only takes integer arguments
+    Args[I].Type = ParamTypes[I];
+    uint64_t Value = std::stoull(Workload.Args[I], nullptr, 0);
+    if (ParamTypes[I] == WASMType::I32) {
+      Args[I].Value.I32 = static_cast<int32_t>(Value);
+    } else if (ParamTypes[I] == WASMType::I64) {
+      Args[I].Value.I64 = static_cast<int64_t>(Value);
+    } else {
+      ZEN_LOG_ERROR("unsupported argument type of %s", Workload.FuncName);
+      return false;
+    }
+  }
+  return true;
+}
+
+void writeJSON(std::ostream &OS, const std::vector<BenchResult> &Results,
+               uint32_t Repetitions) {
+  OS << "{\n  \"version\": 1,\n  \"repetitions\": " << Repetitions
+     << ",\n  \"results\": [";
+  for (size_t I = 0; I < Results.size(); ++I) {
+    const BenchResult &R = Results[I];
+    OS << (I == 0 ? "\n" : ",\n") << "    {\"name\": \"" << R.Name
+       << "\", \"median_ns\": " << R.MedianNs << ", \"min_ns\": " << R.MinNs
+       << ", \"samples\": " << R.Samples << "}";
+  }
+  OS << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string CorpusDir = ZEN_BENCH_CORPUS_DIR;
+  std::string OutputFilename;
+  std::string Filter;
+  uint32_t Repetitions = 10;
+
+  try {
+    CLI::App CLIParser("ZetaEngine Benchmark\n", "dtvm_bench");
+    CLIParser.add_option("--corpus-dir", CorpusDir,
+                         "Directory of the compiled benchmark corpus");
+    CLIParser.add_option("-o,--output", OutputFilename,
+                         "Write the JSON results to the file instead of "
+                         "stdout");
+    CLIParser.add_option("--filter", Filter,
+                         "Only run the benchmarks whose workload/mode "
+                         "contains the string");
+    CLIParser.add_option("-r,--repetitions", Repetitions,
+                         "Number of samples of every benchmark")
+        ->check(CLI::PositiveNumber);
+    CLI11_PARSE(CLIParser, argc, argv);
+  } catch (const std::exception &E) {
+    printf("failed to parse command line arguments: %s\n", E.what());
+    return EXIT_FAILURE;
+  }
+
+  try {
+    zen::setGlobalLogger(
+        createConsoleLogger("dtvm_bench_logger", LoggerLevel::Error));
+  } catch (const std::exception &E) {
+    printf("failed to create logger: %s\n", E.what());
+    return EXIT_FAILURE;
+  }
+
+  BenchRunner Runner(CorpusDir, Repetitions);
+  for (const BenchMode &Mode : getBenchModes()) {
+    for (const BenchWorkload &Workload : Workloads) {
+      std::string Name = std::string(Workload.Name) + "/" + Mode.Name;
+      if (Name.find(Filter) == std::string::npos) {
+        continue;
+      }
+      if (!Runner.run(Mode, Workload)) {
+        ZEN_LOG_ERROR("benchmark %s failed", Name.c_str());
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  if (OutputFilename.empty()) {
+    writeJSON(std::cout, Runner.getResults(), Repetitions);
+  } else {
+    std::ofstream OS(OutputFilename);
+    if (!OS) {
+      ZEN_LOG_ERROR("failed to open %s", OutputFilename.c_str());
+      return EXIT_FAILURE;
+    }
+    writeJSON(OS, Runner.getResults(), Repetitions);
+  }
+  return EXIT_SUCCESS;
+}
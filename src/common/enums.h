@@ -46,6 +46,12 @@ enum Opcode {
 #undef DEFINE_WASM_OPCODE
 }; // Opcode
 
+enum AtomicOpcode {
+#define DEFINE_WASM_ATOMIC_OPCODE(NAME, OPCODE, TEXT, ALIGN) NAME = OPCODE,
+#include "common/wasm_defs/opcode_atomic.def"
+#undef DEFINE_WASM_ATOMIC_OPCODE
+}; // AtomicOpcode
+
 enum LabelType {
   LABEL_BLOCK,
   LABEL_LOOP,
@@ -147,7 +147,8 @@ bool initPlatformTrapHandler() {
     }
   };
 
-  // unreachable use ud2 to raise SIGILL
+  // illegal instructions in jitted code raise SIGILL, the traps raised by the
+  // runtime(unreachable, etc.) unwind without signals
   RegisterFunc(&PrevSigill, SIGILL);
   // x86 throw SIGFPE when /0
 #ifdef ZEN_BUILD_TARGET_X86_64
@@ -36,6 +36,10 @@ struct TrapState {
 
 #ifdef ZEN_ENABLE_CPU_EXCEPTION
 
+// The longjmp value of the traps raised by the runtime(unreachable, gas limit
+// exceeded, etc.), which unwind without a signal. Signal numbers are positive
+constexpr int SoftwareTrapJmpValue = -1;
+
 struct FrameCapture {
   void *PC = nullptr;        // rip, maybe empty if not provided
   void *FrameAddr = nullptr; // rbp
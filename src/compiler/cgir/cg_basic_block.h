@@ -70,6 +70,11 @@ public:
 
   uint32_t getNumber() const { return _idx; }
   void setNumber(uint32_t N) { _idx = N; }
+
+  /// Cold blocks only run on exception paths, MCLowering moves them out of
+  /// the hot code when possible
+  bool isCold() const { return Cold; }
+  void setCold() { Cold = true; }
   std::string getName() const { return std::to_string(_idx); }
 
   MCSymbol *getSymbol() const;
@@ -293,6 +298,7 @@ private:
   uint32_t _idx;
   CgFunction *_parent;
   CgInstructionListType _cg_instructions;
+  bool Cold = false;
 
   CompileVector<CgBasicBlock *> Predecessors;
   CompileVector<CgBasicBlock *> Successors;
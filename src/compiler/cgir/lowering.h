@@ -14,6 +14,7 @@
 #include "llvm/CodeGen/TargetOpcodes.h"
 #include "llvm/CodeGen/TargetRegisterInfo.h"
 #include "llvm/Support/MachineValueType.h"
+#include <algorithm>
 #include <vector>
 namespace COMPILER {
 
@@ -42,6 +43,9 @@ public:
         SELF.lowerFormalArguments();
       } else {
         setInsertBlock(getOrCreateCgBB(MIRBB));
+        if (_mir_func.isExceptionBB(MIRBB)) {
+          CurBB->setCold();
+        }
       }
 
       for (MInstruction *Instr : *MIRBB) {
@@ -56,21 +60,168 @@ public:
   }
 
 protected:
-  static bool isJumpTableSuitable(const CompileVector<int64_t> &CaseImmList) {
-    uint32_t NumCases = CaseImmList.size();
-    // Consider using jump table only if NumCases > 3
-    if (NumCases <= 3) {
+  // ==================== Switch Lowering Utilities ====================
+
+  // Consecutive case values [Low, High](unsigned) going to the same block
+  struct CaseRange {
+    uint64_t Low;
+    uint64_t High;
+    CgBasicBlock *MBB;
+  };
+
+  // Case ranges [First, Last] lowered together
+  struct CaseCluster {
+    enum ClusterKind {
+      CC_Range,     // compare and branch, First == Last
+      CC_JumpTable, // indirect jump through a table
+      CC_BitTests,  // test the case value against one bit mask per target
+    };
+    ClusterKind Kind;
+    uint32_t First;
+    uint32_t Last;
+  };
+
+  // Minimum number of case ranges to use a jump table
+  static constexpr uint32_t MinJumpTableRanges = 4;
+  // Minimum percentage of the table entries covered by case values
+  static constexpr uint64_t MinJumpTableDensity = 40;
+  // Bit tests use one machine word per target
+  static constexpr uint64_t MaxBitTestRange = 64;
+  static constexpr uint32_t MaxBitTestTargets = 3;
+
+  /// Collect the case values which don't go to the default block, sorted and
+  /// merged into ranges of consecutive values with the same target.
+  void buildCaseRanges(const SwitchInstruction &Inst,
+                       const CgBasicBlock *DefaultMBB,
+                       CompileVector<CaseRange> &Ranges) {
+    for (uint32_t I = 0, E = Inst.getNumCases(); I < E; ++I) {
+      CgBasicBlock *CaseMBB = getOrCreateCgBB(Inst.getCaseBlock(I));
+      if (CaseMBB == DefaultMBB) {
+        continue;
+      }
+      const APInt &CaseInt =
+          llvm::cast<MConstantInt>(Inst.getCaseValue(I)->getConstant())
+              .getValue();
+      uint64_t Value = CaseInt.getZExtValue();
+      Ranges.push_back({Value, Value, CaseMBB});
+    }
+    // Stable, so the first of the duplicate case values is kept below
+    std::stable_sort(Ranges.begin(), Ranges.end(),
+                     [](const CaseRange &A, const CaseRange &B) {
+                       return A.Low < B.Low;
+                     });
+
+    uint32_t NumRanges = 0;
+    for (const CaseRange &Range : Ranges) {
+      if (NumRanges > 0) {
+        CaseRange &Prev = Ranges[NumRanges - 1];
+        if (Range.Low <= Prev.High) {
+          continue; // duplicate case value, the first one wins
+        }
+        if (Range.Low == Prev.High + 1 && Range.MBB == Prev.MBB) {
+          Prev.High = Range.High;
+          continue;
+        }
+      }
+      Ranges[NumRanges++] = Range;
+    }
+    Ranges.resize(NumRanges);
+  }
+
+  /// Whether the case ranges [First, Last] are dense enough for a jump table,
+  /// NumCasesBefore[I] is the number of case values in the ranges before I.
+  static bool isJumpTableSuitable(const CompileVector<CaseRange> &Ranges,
+                                  const CompileVector<uint64_t> &NumCasesBefore,
+                                  uint32_t First, uint32_t Last) {
+    if (Last - First + 1 < MinJumpTableRanges) {
+      return false;
+    }
+    uint64_t TableSize = Ranges[Last].High - Ranges[First].Low + 1;
+    // Table entries are indexed by 32-bit values
+    if (TableSize == 0 || TableSize > UINT32_MAX) {
       return false;
     }
+    uint64_t NumCases = NumCasesBefore[Last + 1] - NumCasesBefore[First];
+    return NumCases * 100 >= TableSize * MinJumpTableDensity;
+  }
 
-    // Only use jump table when the list of case values is {n, n+1, n+2, ...}
-    for (uint32_t I = 1; I < NumCases; ++I) {
-      if (CaseImmList[I] - CaseImmList[I - 1] != 1) {
-        return false;
+  /// Partition the sorted case ranges into clusters in the same way as LLVM's
+  /// switch lowering: dense parts become jump tables(minimizing the number of
+  /// clusters), small spans with few targets become bit tests, and the others
+  /// remain single ranges searched by a balanced binary tree.
+  static void clusterCaseRanges(const CompileVector<CaseRange> &Ranges,
+                                CompileVector<CaseCluster> &Clusters,
+                                CompileMemPool &MemPool) {
+    uint32_t NumRanges = Ranges.size();
+    ZEN_ASSERT(NumRanges > 0);
+
+    CompileVector<uint64_t> NumCasesBefore(NumRanges + 1, 0, MemPool);
+    for (uint32_t I = 0; I < NumRanges; ++I) {
+      NumCasesBefore[I + 1] =
+          NumCasesBefore[I] + (Ranges[I].High - Ranges[I].Low + 1);
+    }
+
+    // LastElement[I] is the last range of the first partition of [I, N) when
+    // the number of partitions is minimal, which is MinPartitions[I]
+    CompileVector<uint32_t> MinPartitions(NumRanges + 1, 0, MemPool);
+    CompileVector<uint32_t> LastElement(NumRanges, 0, MemPool);
+    if (isJumpTableSuitable(Ranges, NumCasesBefore, 0, NumRanges - 1)) {
+      // Fast path for dense switches such as br_table
+      LastElement[0] = NumRanges - 1;
+    } else {
+      for (uint32_t I = NumRanges; I-- > 0;) {
+        MinPartitions[I] = MinPartitions[I + 1] + 1;
+        LastElement[I] = I;
+        for (uint32_t J = NumRanges - 1; J > I; --J) {
+          if (MinPartitions[J + 1] + 1 < MinPartitions[I] &&
+              isJumpTableSuitable(Ranges, NumCasesBefore, I, J)) {
+            MinPartitions[I] = MinPartitions[J + 1] + 1;
+            LastElement[I] = J;
+          }
+        }
       }
     }
 
-    return true;
+    for (uint32_t I = 0; I < NumRanges;) {
+      uint32_t Last = LastElement[I];
+      if (Last > I) {
+        Clusters.push_back({CaseCluster::CC_JumpTable, I, Last});
+        I = Last + 1;
+        continue;
+      }
+
+      // Extend bit tests over the following single ranges
+      uint32_t J = I;
+      uint32_t NumTargets = 1;
+      uint32_t NumCompares = Ranges[I].Low == Ranges[I].High ? 1 : 2;
+      while (J + 1 < NumRanges && LastElement[J + 1] == J + 1 &&
+             Ranges[J + 1].High - Ranges[I].Low < MaxBitTestRange) {
+        bool NewTarget = true;
+        for (uint32_t K = I; K <= J; ++K) {
+          if (Ranges[K].MBB == Ranges[J + 1].MBB) {
+            NewTarget = false;
+            break;
+          }
+        }
+        if (NewTarget && NumTargets == MaxBitTestTargets) {
+          break;
+        }
+        NumTargets += NewTarget;
+        NumCompares += Ranges[J + 1].Low == Ranges[J + 1].High ? 1 : 2;
+        ++J;
+      }
+      // Bit tests pay off only if they replace enough compares
+      bool UseBitTests = (NumTargets == 1 && NumCompares >= 3) ||
+                         (NumTargets == 2 && NumCompares >= 5) ||
+                         (NumTargets == 3 && NumCompares >= 6);
+      if (UseBitTests) {
+        Clusters.push_back({CaseCluster::CC_BitTests, I, J});
+        I = J + 1;
+      } else {
+        Clusters.push_back({CaseCluster::CC_Range, I, I});
+        ++I;
+      }
+    }
   }
 
   CgBasicBlock *getOrCreateCgBB(const MBasicBlock *MIRBB) {
@@ -117,6 +268,9 @@ protected:
     case MInstruction::CALL:
       SELF.lowerCall(llvm::cast<CallInstructionBase>(Inst));
       break;
+    case MInstruction::ATOMIC:
+      lowerAtomicExpr(Inst);
+      break;
     case MInstruction::RETURN:
       lowerReturnStmt(llvm::cast<ReturnInstruction>(Inst));
       break;
@@ -197,6 +351,9 @@ protected:
     case MInstruction::CALL:
       ResultReg = SELF.lowerCall(llvm::cast<CallInstructionBase>(Inst));
       break;
+    case MInstruction::ATOMIC:
+      ResultReg = lowerAtomicExpr(Inst);
+      break;
     default:
       ZEN_ASSERT_TODO();
     }
@@ -204,6 +361,14 @@ protected:
     return ResultReg;
   }
 
+  CgRegister lowerAtomicExpr(const MInstruction &Inst) {
+    if (const auto *RMW = llvm::dyn_cast<AtomicRMWInstruction>(&Inst)) {
+      return SELF.lowerAtomicRMWExpr(*RMW);
+    }
+    return SELF.lowerAtomicCmpxchgExpr(
+        llvm::cast<AtomicCmpxchgInstruction>(Inst));
+  }
+
   void lowerDassignStmt(const DassignInstruction &inst) {
     auto *opnd = inst.getOperand<0>();
     CgRegister reg_op = lowerExpr(*opnd);
@@ -350,6 +515,14 @@ protected:
     }
     llvm::MVT VT = getMVT(Type);
 
+    if (IsInteger) {
+      // Fold a load operand into the instruction if the target supports it
+      if (CgRegister ResultReg = SELF.lowerBinaryExprWithLoad(
+              *LHS, *RHS, VT, ISDOpcode, Inst.isCommutative())) {
+        return ResultReg;
+      }
+    }
+
     if (auto *ConstInst = dyn_cast<ConstantInstruction>(LHS)) {
       if (auto *IntConst = dyn_cast<MConstantInt>(&ConstInst->getConstant())) {
         if (Inst.isCommutative()) {
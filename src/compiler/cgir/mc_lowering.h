@@ -5,6 +5,7 @@
 #include "compiler/cgir/cg_function.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCExpr.h"
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCSymbol.h"
 #include "llvm/Target/TargetLoweringObjectFile.h"
@@ -51,8 +52,17 @@ protected:
     llvm::MCSymbol *FuncSym = MF->getSymbol();
     Streamer->emitSymbolAttribute(FuncSym, llvm::MCSA_ELF_TypeFunction);
     Streamer->emitLabel(FuncSym);
-    for (CgBasicBlock *BB : *MF) {
-      emitBasicBlock(BB);
+
+    llvm::SmallVector<CgBasicBlock *, 32> HotBBs;
+    llvm::SmallVector<CgBasicBlock *, 8> ColdBBs;
+    splitColdBasicBlocks(HotBBs, ColdBBs);
+    for (size_t I = 0; I < HotBBs.size(); ++I) {
+      CgBasicBlock *BB = HotBBs[I];
+      // The branch over the cold blocks moved out is no longer needed
+      CgBasicBlock *NextBB = I + 1 < HotBBs.size() ? HotBBs[I + 1] : nullptr;
+      bool SkipLastBranch = NextBB && !BB->isLayoutSuccessor(NextBB) &&
+                            !BB->empty() && isBranchTo(BB->back(), NextBB);
+      emitBasicBlock(BB, SkipLastBranch);
     }
 
 #ifdef ZEN_ENABLE_LINUX_PERF
@@ -67,15 +77,76 @@ protected:
 #endif
 
     emitJumpTableInfo();
+
+    // The cold subsection of the text section is placed after the hot code
+    // of all the functions in the object by the assembler, the branches to
+    // it are resolved without relocations since it's the same section
+    if (!ColdBBs.empty()) {
+      llvm::MCSection *TextSection = Streamer->getCurrentSectionOnly();
+      Streamer->switchSection(TextSection,
+                              llvm::MCConstantExpr::create(1, Context));
+      for (CgBasicBlock *BB : ColdBBs) {
+        emitBasicBlock(BB);
+      }
+      Streamer->switchSection(TextSection);
+    }
+  }
+
+  /// Split the blocks into the hot ones and the runs of cold ones neither
+  /// entered nor left by fallthrough, both in layout order
+  void splitColdBasicBlocks(llvm::SmallVectorImpl<CgBasicBlock *> &HotBBs,
+                            llvm::SmallVectorImpl<CgBasicBlock *> &ColdBBs) {
+#ifdef ZEN_ENABLE_DUMP_CALL_STACK
+    // The call stack dump finds the function of a code address by the start
+    // addresses of the functions, so the code is kept contiguous
+    HotBBs.append(MF->begin(), MF->end());
+    return;
+#endif
+    auto It = MF->begin();
+    auto E = MF->end();
+    while (It != E) {
+      if (It == MF->begin() || !(*It)->isCold()) {
+        HotBBs.push_back(*It++);
+        continue;
+      }
+      auto RunEnd =
+          std::find_if(It, E, [](CgBasicBlock *BB) { return !BB->isCold(); });
+      if (!canFallThrough(*std::prev(It)) &&
+          !canFallThrough(*std::prev(RunEnd))) {
+        ColdBBs.append(It, RunEnd);
+      } else {
+        HotBBs.append(It, RunEnd);
+      }
+      It = RunEnd;
+    }
   }
 
-  void emitBasicBlock(CgBasicBlock *MBB) {
+  static bool canFallThrough(const CgBasicBlock *MBB) {
+    return MBB->empty() || !MBB->back().isBarrier();
+  }
+
+  static bool isBranchTo(const CgInstruction &MI, const CgBasicBlock *MBB) {
+    if (!MI.isUnconditionalBranch()) {
+      return false;
+    }
+    for (const auto &MO : MI) {
+      if (MO.isMBB() && MO.getMBB() == MBB) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void emitBasicBlock(CgBasicBlock *MBB, bool SkipLastBranch = false) {
     // Refer to the following URL:
     // https://github.com/llvm/llvm-project/blob/release%2F15.x/llvm/lib/CodeGen/AsmPrinter/AsmPrinter.cpp#L3629-L3642
     if (!MBB->pred_empty() && (!isBlockOnlyReachableByFallthrough(MBB))) {
       Streamer->emitLabel(MBB->getSymbol());
     }
     for (CgInstruction &MI : *MBB) {
+      if (SkipLastBranch && &MI == &MBB->back()) {
+        break;
+      }
       switch (MI.getOpcode()) {
       case TargetOpcode::KILL:
       case TargetOpcode::IMPLICIT_DEF:
@@ -0,0 +1,153 @@
+// Copyright (C) 2021-2023 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#include "compiler/cgir/pass/reg_alloc_linear_scan.h"
+#include "compiler/cgir/pass/allocation_order.h"
+#include "compiler/cgir/pass/live_interval_union.h"
+
+#define DEBUG_TYPE "regalloc"
+
+using namespace COMPILER;
+
+void CgRALinearScan::enqueueImpl(const CgLiveInterval *LI) {
+  const Register Reg = LI->reg();
+  assert(Reg.isVirtual() && "Can only enqueue virtual registers");
+  // The distance from the start point to the end of the function, an empty
+  // interval is dropped as soon as it's dequeued
+  unsigned Prio = 0;
+  if (!LI->empty()) {
+    CgSlotIndexes *Indexes = LIS->getSlotIndexes();
+    Prio = LI->beginIndex().getInstrDistance(Indexes->getLastIndex());
+  }
+  Queue.push(std::make_tuple(Prio, LI->weight(), ~Reg));
+}
+
+const CgLiveInterval *CgRALinearScan::dequeue() {
+  while (!Queue.empty()) {
+    CgLiveInterval *LI = &LIS->getInterval(~std::get<2>(Queue.top()));
+    Queue.pop();
+    // Intervals emptied by the spiller while queued have nothing to allocate
+    if (LI->empty() && MRI->reg_nodbg_empty(LI->reg())) {
+      LLVM_DEBUG(dbgs() << "Dropping empty " << *LI << '\n');
+      aboutToRemoveInterval(*LI);
+      LIS->removeInterval(LI->reg());
+      continue;
+    }
+    return LI;
+  }
+  return nullptr;
+}
+
+bool CgRALinearScan::LRE_CanEraseVirtReg(Register VirtReg) {
+  CgLiveInterval &LI = LIS->getInterval(VirtReg);
+  if (VRM->hasPhys(VirtReg)) {
+    Matrix->unassign(LI);
+    aboutToRemoveInterval(LI);
+    return true;
+  }
+  // Unassigned virtreg is in the queue, CgRegAllocBase will erase it after
+  // dequeueing
+  LI.clear();
+  return false;
+}
+
+void CgRALinearScan::LRE_WillShrinkVirtReg(Register VirtReg) {
+  if (!VRM->hasPhys(VirtReg))
+    return;
+
+  // Register is assigned, put it back on the queue for reassignment
+  CgLiveInterval &LI = LIS->getInterval(VirtReg);
+  Matrix->unassign(LI);
+  enqueue(&LI);
+}
+
+CgRALinearScan::CgRALinearScan(CgFunction &MF, RegClassFilterFunc F)
+    : CgRegAllocBase(F) {
+  runOnCgFunction(MF);
+}
+
+void CgRALinearScan::releaseMemory() { SpillerInstance.reset(); }
+
+bool CgRALinearScan::spillInterferences(const CgLiveInterval &VirtReg,
+                                        MCRegister PhysReg,
+                                        SmallVectorImpl<Register> &SplitVRegs) {
+  SmallVector<const CgLiveInterval *, 8> Intfs;
+  for (MCRegUnitIterator Units(PhysReg, TRI); Units.isValid(); ++Units) {
+    CgLiveIntervalUnion::Query &Q = Matrix->query(VirtReg, *Units);
+    for (const auto *Intf : reverse(Q.interferingVRegs())) {
+      if (!Intf->isSpillable())
+        return false;
+      Intfs.push_back(Intf);
+    }
+  }
+  ZEN_ASSERT(!Intfs.empty() && "expected interference");
+
+  for (const CgLiveInterval *Spill : Intfs) {
+    // Skip duplicates
+    if (!VRM->hasPhys(Spill->reg()))
+      continue;
+    Matrix->unassign(*Spill);
+    CgLiveRangeEdit LRE(Spill, SplitVRegs, *MF, *LIS, VRM, this, &DeadRemats);
+    spiller().spill(LRE);
+  }
+  return true;
+}
+
+MCRegister CgRALinearScan::selectOrSplit(const CgLiveInterval &VirtReg,
+                                         SmallVectorImpl<Register> &SplitVRegs) {
+  // Take the first free register in the allocation order, which starts with
+  // the copy hints
+  SmallVector<MCRegister, 8> PhysRegSpillCands;
+  auto Order =
+      CgAllocationOrder::create(VirtReg.reg(), *VRM, RegClassInfo, Matrix);
+  for (MCRegister PhysReg : Order) {
+    switch (Matrix->checkInterference(VirtReg, PhysReg)) {
+    case CgLiveRegMatrix::IK_Free:
+      return PhysReg;
+    case CgLiveRegMatrix::IK_VirtReg:
+      PhysRegSpillCands.push_back(PhysReg);
+      break;
+    default:
+      // RegMask or RegUnit interference
+      break;
+    }
+  }
+
+  if (VirtReg.isSpillable()) {
+    LLVM_DEBUG(dbgs() << "spilling: " << VirtReg << '\n');
+    CgLiveRangeEdit LRE(&VirtReg, SplitVRegs, *MF, *LIS, VRM, this,
+                        &DeadRemats);
+    spiller().spill(LRE);
+    // Nothing to allocate in this round, the new intervals are queued
+    return 0;
+  }
+
+  // The interval around a single use(e.g. a reload) can't be spilled, make
+  // room for it by spilling the intervals assigned to a register instead
+  for (MCRegister PhysReg : PhysRegSpillCands) {
+    if (!spillInterferences(VirtReg, PhysReg, SplitVRegs))
+      continue;
+    ZEN_ASSERT(!Matrix->checkInterference(VirtReg, PhysReg) &&
+               "Interference after spill.");
+    return PhysReg;
+  }
+  return ~0u;
+}
+
+void CgRALinearScan::runOnCgFunction(CgFunction &mf) {
+  LLVM_DEBUG(dbgs() << "********** LINEAR SCAN REGISTER ALLOCATION **********\n"
+                    << "********** Function: " << mf.getName() << '\n');
+
+  MF = &mf;
+  CgRegAllocBase::init(*mf.VRM, *mf.LIS, *mf.Matrix);
+  CgVirtRegAuxInfo VRAI(mf, *LIS, *VRM, *mf.Loops, *mf.MBFI);
+  VRAI.calculateSpillWeightsAndHints();
+
+  SpillerInstance.reset(cgCreateInlineSpiller(*MF, *VRM, VRAI));
+
+  allocatePhysRegs();
+  postOptimization();
+
+  LLVM_DEBUG(dbgs() << "Post alloc CgVirtRegMap:\n" << *VRM << "\n");
+
+  releaseMemory();
+}
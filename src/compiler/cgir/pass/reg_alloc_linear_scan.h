@@ -0,0 +1,68 @@
+// Copyright (C) 2021-2023 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include "compiler/cgir/pass/calc_spill_weights.h"
+#include "compiler/cgir/pass/cg_block_frequency_info.h"
+#include "compiler/cgir/pass/cg_loop_info.h"
+#include "compiler/cgir/pass/cg_spiller.h"
+#include "compiler/cgir/pass/live_intervals.h"
+#include "compiler/cgir/pass/live_range_edit.h"
+#include "compiler/cgir/pass/live_reg_matrix.h"
+#include "compiler/cgir/pass/reg_alloc_base.h"
+#include "compiler/cgir/pass/virt_reg_map.h"
+#include "llvm/Support/Debug.h"
+#include <queue>
+#include <tuple>
+
+namespace COMPILER {
+
+/// CgRALinearScan assigns the live intervals in the order of their start
+/// points in the CgSlotIndexes numbering. A physical register is free for an
+/// interval if no interval assigned to it in CgLiveRegMatrix overlaps, so the
+/// lifetime holes of assigned intervals are reused.
+///
+/// Unlike CgRAGreedy there is no eviction, region splitting or spill placement:
+/// an interval without a free register is spilled everywhere by the inline
+/// spiller, and the short intervals created around its uses are allocated in
+/// turn. Only those unspillable intervals may push spillable ones out of the
+/// way, otherwise they could run out of registers.
+class CgRALinearScan : public CgRegAllocBase,
+                       private CgLiveRangeEdit::Delegate {
+  CgFunction *MF = nullptr;
+  std::unique_ptr<CgSpiller> SpillerInstance;
+  // (distance from the start point to the end, spill weight, ~reg) tuples,
+  // the earliest start point on top, ties broken by the larger spill weight.
+  // The keys are captured when queued, the spiller may change or empty the
+  // intervals while they are queued
+  using PQueue = std::priority_queue<std::tuple<unsigned, float, unsigned>>;
+  PQueue Queue;
+
+  bool LRE_CanEraseVirtReg(Register) override;
+  void LRE_WillShrinkVirtReg(Register) override;
+
+  // Spill the spillable intervals assigned to PhysReg(or an alias) which
+  // interfere with VirtReg, return false if any of them isn't spillable
+  bool spillInterferences(const CgLiveInterval &VirtReg, MCRegister PhysReg,
+                          SmallVectorImpl<Register> &SplitVRegs);
+
+public:
+  CgRALinearScan(CgFunction &MF,
+                 const RegClassFilterFunc F = allocateAllRegClasses);
+  ~CgRALinearScan() { releaseMemory(); }
+
+  void runOnCgFunction(CgFunction &MF);
+
+  void releaseMemory();
+
+  CgSpiller &spiller() override { return *SpillerInstance; }
+
+  void enqueueImpl(const CgLiveInterval *LI) override;
+
+  const CgLiveInterval *dequeue() override;
+
+  MCRegister selectOrSplit(const CgLiveInterval &VirtReg,
+                           SmallVectorImpl<Register> &SplitVRegs) override;
+};
+
+} // namespace COMPILER
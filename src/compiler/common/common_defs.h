@@ -40,6 +40,7 @@ using common::WASMType;
 using common::WASMTypeAttr;
 using common::WASMTypeKind;
 using runtime::CodeEntry;
+using runtime::IndirectCallCache;
 using runtime::Instance;
 using runtime::MemoryInstance;
 using runtime::Module;
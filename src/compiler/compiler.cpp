@@ -10,6 +10,7 @@
 #include "compiler/cgir/pass/prolog_epilog_inserter.h"
 #include "compiler/cgir/pass/reg_alloc_basic.h"
 #include "compiler/cgir/pass/reg_alloc_greedy.h"
+#include "compiler/cgir/pass/reg_alloc_linear_scan.h"
 #include "compiler/cgir/pass/register_coalescer.h"
 #include "compiler/context.h"
 #include "compiler/frontend/parser.h"
@@ -21,10 +22,17 @@
 #include "compiler/target/x86/x86_mc_lowering.h"
 #include "compiler/target/x86/x86lowering.h"
 #include "compiler/wasm_frontend/wasm_mir_compiler.h"
+#include "utils/code_layout.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/SmallVectorMemoryBuffer.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
 #include <deque>
+#include <fstream>
+#include <sstream>
+#include <tuple>
 
 #ifdef ZEN_ENABLE_MULTIPASS_JIT_LOGGING
 #include "utils/asm_dump.h"
@@ -53,15 +61,96 @@ static inline bool isFuncNeedGreedyRA(uint32_t FuncIdx) {
 }
 #endif // ZEN_ENABLE_DEBUG_GREEDY_RA
 
+// Functions of at least this many instructions are allocated by linear scan
+// in RegAllocKind::Auto unless they contain deeply nested loops, where the
+// splitting and eviction of greedy RA pay off
+static constexpr size_t LinearScanRAMinInstrs = 1000;
+static constexpr unsigned LinearScanRAMaxLoopDepth = 2;
+
+static size_t getNumCgInstructions(const CgFunction &MF) {
+  size_t NumInstrs = 0;
+  for (const CgBasicBlock *MBB : MF) {
+    NumInstrs += std::distance(MBB->begin(), MBB->end());
+  }
+  return NumInstrs;
+}
+
+static bool isLinearScanRAPreferred(const CgFunction &MF,
+                                    const CgLoopInfo &Loops,
+                                    size_t NumInstrs) {
+  if (NumInstrs < LinearScanRAMinInstrs) {
+    return false;
+  }
+  for (const CgBasicBlock *MBB : MF) {
+    if (Loops.getLoopDepth(MBB) > LinearScanRAMaxLoopDepth) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool isCompileBudgetExceeded(const CgIRCompileOptions &Options) {
+  if (Options.BudgetMs == 0) {
+    return false;
+  }
+  auto Elapsed = common::chrono::duration_cast<common::chrono::milliseconds>(
+                     common::SteadyClock::now() - Options.StartTime)
+                     .count();
+  return static_cast<uint64_t>(Elapsed) >= Options.BudgetMs;
+}
+
+static void recordRegAllocDowngrade(const CgIRCompileOptions &Options,
+                                    uint32_t FuncIdx) {
+  if (Options.Stats) {
+    Options.Stats->addCounter(utils::StatisticCounter::JITRegAllocDowngrades,
+                              1);
+  }
+  if (Options.WasmMod) {
+    Options.WasmMod->addRegAllocDowngradedFunc(
+        FuncIdx + Options.WasmMod->getNumImportFunctions());
+  }
+}
+
+namespace {
+
+// Records the time cost of a pass until stop() or the end of the scope
+class PassTimer {
+public:
+  PassTimer(utils::Statistics *Stats, utils::StatisticPhase Phase)
+      : Stats(Stats) {
+    if (Stats) {
+      Timer = Stats->startRecord(Phase);
+    }
+  }
+
+  ~PassTimer() { stop(); }
+
+  void stop() {
+    if (Stats) {
+      Stats->stopRecord(Timer);
+      Stats = nullptr;
+    }
+  }
+
+private:
+  utils::Statistics *Stats;
+  utils::Statistics::StatisticTimer Timer{};
+};
+
+} // namespace
+
 void JITCompilerBase::compileMIRToCgIR(MModule &MMod, MFunction &MFunc,
                                        CgFunction &CgFunc,
-                                       bool DisableGreedyRA) {
+                                       const CgIRCompileOptions &Options) {
 #ifdef ZEN_ENABLE_MULTIPASS_JIT_LOGGING
   llvm::DebugFlag = true;
   llvm::dbgs() << "\n########## MIR Dump ##########\n\n";
   MFunc.dump();
 #endif
 
+  utils::Statistics *Stats = Options.Stats;
+  PassTimer LoweringTimer(Stats, utils::StatisticPhase::JITPassCgIRLowering);
+
   MVerifier Verifier(MMod, MFunc, llvm::errs());
   if (!Verifier.verify()) {
     throw getError(ErrorCode::MIRVerifyingFailed);
@@ -75,33 +164,80 @@ void JITCompilerBase::compileMIRToCgIR(MModule &MMod, MFunction &MFunc,
   // TODO: refactor to pass
   X86CgLowering CgLowering(MF);
   X86CgPeephole CgPeephole(MF);
+  LoweringTimer.stop();
 
   uint32_t MFuncIdx = MFunc.getFuncIdx();
+  RegAllocKind RAKind = Options.RAKind;
+
+#ifdef ZEN_ENABLE_DEBUG_GREEDY_RA
+  if (RAKind != RegAllocKind::Fast && !isFuncNeedGreedyRA(MFuncIdx)) {
+    RAKind = RegAllocKind::Fast;
+  }
+#endif // ZEN_ENABLE_DEBUG_GREEDY_RA
 
-  if (DisableGreedyRA) {
+  // Bound the compile time of huge functions, the cost of the analyses for
+  // the global allocators grows superlinearly with the function size
+  size_t NumInstrs = 0;
+  if (RAKind != RegAllocKind::Fast) {
+    NumInstrs = getNumCgInstructions(MF);
+    const char *Reason = nullptr;
+    if (Options.MaxRAFuncInstrs != 0 && NumInstrs > Options.MaxRAFuncInstrs) {
+      Reason = "size threshold";
+    } else if (isCompileBudgetExceeded(Options)) {
+      Reason = "compile time budget";
+    }
+    if (Reason) {
+      ZEN_LOG_WARN("function %d(%zu instructions) exceeded the %s, using "
+                   "fast ra",
+                   MFuncIdx, NumInstrs, Reason);
+      recordRegAllocDowngrade(Options, MFuncIdx);
+      RAKind = RegAllocKind::Fast;
+    }
+  }
+
+  if (RAKind == RegAllocKind::Fast) {
     ZEN_LOG_DEBUG("using fast ra for function %d", MFuncIdx);
+    PassTimer RATimer(Stats, utils::StatisticPhase::JITPassRegAlloc);
     FastRA RA(MF);
   } else {
-#ifdef ZEN_ENABLE_DEBUG_GREEDY_RA
-    if (!isFuncNeedGreedyRA(MFuncIdx)) {
-      ZEN_LOG_DEBUG("using fast ra for function %d", MFuncIdx);
-      FastRA RA(MF);
+    PassTimer AnalysisTimer(Stats,
+                            utils::StatisticPhase::JITPassRegAllocAnalysis);
+    CgDeadCgInstructionElim DCE(MF);
+    CgDominatorTree DomTree(MF);
+    CgLoopInfo Loops(MF);
+    if (RAKind == RegAllocKind::Auto) {
+      RAKind = isLinearScanRAPreferred(MF, Loops, NumInstrs)
+                   ? RegAllocKind::LinearScan
+                   : RegAllocKind::Greedy;
+    }
+    CgSlotIndexes Indexes(MF);
+    CgLiveIntervals LIS(MF);
+    CgLiveStacks LSS(MF);
+    CgBlockFrequencyInfo MBFI(MF);
+    // CgRegisterCoalescer must before CgVirtRegMap
+    CgRegisterCoalescer Coalescer(MF);
+    CgVirtRegMap VRM(MF);
+    CgLiveRegMatrix Matrix(MF);
+    // RABasic ra(MF);
+    AnalysisTimer.stop();
+
+    // The analyses can't be discarded at this point, fall back to the
+    // cheaper of the allocators using them
+    if (RAKind == RegAllocKind::Greedy && isCompileBudgetExceeded(Options)) {
+      ZEN_LOG_WARN("function %d(%zu instructions) exceeded the compile time "
+                   "budget, using linear scan ra",
+                   MFuncIdx, NumInstrs);
+      recordRegAllocDowngrade(Options, MFuncIdx);
+      RAKind = RegAllocKind::LinearScan;
+    }
+
+    PassTimer RATimer(Stats, utils::StatisticPhase::JITPassRegAlloc);
+    if (RAKind == RegAllocKind::LinearScan) {
+      ZEN_LOG_DEBUG("using linear scan ra for function %d", MFuncIdx);
+      CgRALinearScan RA(MF);
+      CgVirtRegRewriter Rewriter(MF);
     } else {
-#endif // ZEN_ENABLE_DEBUG_GREEDY_RA
       ZEN_LOG_DEBUG("using greedy ra for function %d", MFuncIdx);
-      CgDeadCgInstructionElim DCE(MF);
-      CgDominatorTree DomTree(MF);
-      CgLoopInfo Loops(MF);
-      CgSlotIndexes Indexes(MF);
-      CgLiveIntervals LIS(MF);
-      CgLiveStacks LSS(MF);
-      CgBlockFrequencyInfo MBFI(MF);
-      // CgRegisterCoalescer must before CgVirtRegMap
-      CgRegisterCoalescer Coalescer(MF);
-      CgVirtRegMap VRM(MF);
-      CgLiveRegMatrix Matrix(MF);
-      // RABasic ra(MF);
-
       CgEdgeBundles EdgeBundles(MF);
       CgSpillPlacement SpillPlacer(MF);
       MF.EvictAdvisor = std::unique_ptr<CgRegAllocEvictionAdvisorAnalysis>(
@@ -109,9 +245,7 @@ void JITCompilerBase::compileMIRToCgIR(MModule &MMod, MFunction &MFunc,
       std::shared_ptr<CgRAGreedy> RA = std::make_shared<CgRAGreedy>(MF);
 
       CgVirtRegRewriter Rewriter(MF);
-#ifdef ZEN_ENABLE_DEBUG_GREEDY_RA
     }
-#endif // ZEN_ENABLE_DEBUG_GREEDY_RA
   }
 
 #ifdef ZEN_ENABLE_MULTIPASS_JIT_LOGGING
@@ -120,6 +254,7 @@ void JITCompilerBase::compileMIRToCgIR(MModule &MMod, MFunction &MFunc,
   MF.dump();
 #endif
 
+  PassTimer PostRATimer(Stats, utils::StatisticPhase::JITPassPostRA);
   PrologEpilogInserter PEInserter;
   PEInserter.runOnCgFunction(MF);
 #ifdef ZEN_ENABLE_MULTIPASS_JIT_LOGGING
@@ -326,7 +461,15 @@ void JITCompilerBase::emitObjectBuffer(CompileContext *Ctx) {
 }
 
 void WasmJITCompiler::compileWasmToMC(WasmFrontendContext &Ctx, MModule &Mod,
-                                      uint32_t FuncIdx, bool DisableGreedyRA) {
+                                      uint32_t FuncIdx, RegAllocKind RAKind) {
+  CgIRCompileOptions Options;
+  Options.RAKind = RAKind;
+  Options.MaxRAFuncInstrs = Config.MultipassMaxRAFuncInstrs;
+  Options.BudgetMs = Config.MultipassFuncBudgetMs;
+  Options.StartTime = common::SteadyClock::now();
+  Options.Stats = &Stats;
+  Options.WasmMod = WasmMod;
+
   if (Ctx.Inited) {
     // Release all memory allocated by previous function compilation
     Ctx.MemPool = CompileMemPool();
@@ -346,12 +489,48 @@ void WasmJITCompiler::compileWasmToMC(WasmFrontendContext &Ctx, MModule &Mod,
   MFunction MFunc(Ctx, FuncIdx);
   CgFunction CgFunc(Ctx, MFunc);
   MFunc.setFunctionType(Mod.getFuncType(FuncIdx));
+  PassTimer MIRTimer(&Stats, utils::StatisticPhase::JITPassMIRBuilding);
   FunctionMirBuilder MIRBuilder(Ctx, MFunc);
   MIRBuilder.compile(&Ctx); // pass the ctx argument only for compatibility
-  runtime::Runtime *RT = WasmMod->getRuntime();
-  const runtime::RuntimeConfig &Config = RT->getConfig();
-  compileMIRToCgIR(Mod, MFunc, CgFunc, DisableGreedyRA);
+  MIRTimer.stop();
+  compileMIRToCgIR(Mod, MFunc, CgFunc, Options);
+  PassTimer MCTimer(&Stats, utils::StatisticPhase::JITPassMCEmission);
   Ctx.getMCLowering().runOnCgFunction(CgFunc);
+  MCTimer.stop();
+  Stats.addCounter(utils::StatisticCounter::JITCompiledFunctions, 1);
+}
+
+RegAllocKind WasmJITCompiler::getRegAllocKind(bool OnRequest) const {
+  if (Config.DisableMultipassGreedyRA) {
+    return RegAllocKind::Fast;
+  }
+  if (Config.EnableMultipassLinearScanRA) {
+    return OnRequest ? RegAllocKind::LinearScan : RegAllocKind::Auto;
+  }
+  return OnRequest ? RegAllocKind::Fast : RegAllocKind::Greedy;
+}
+
+std::vector<std::vector<uint32_t>>
+EagerJITCompiler::buildFunctionChains(uint64_t MaxChainCodeSize) const {
+  const uint32_t NumImportFunctions = WasmMod->getNumImportFunctions();
+  const auto &CallSeqMap = WasmMod->getCallSeqMap();
+  const auto &CallWeightMap = WasmMod->getCallWeightMap();
+
+  std::vector<utils::CallEdge> Edges;
+  std::vector<uint64_t> CodeSizes(NumInternalFunctions);
+  for (uint32_t I = 0; I < NumInternalFunctions; ++I) {
+    CodeEntry *CE = WasmMod->getCodeEntry(NumImportFunctions + I);
+    ZEN_ASSERT(CE);
+    CodeSizes[I] = CE->CodeSize;
+    const auto &CallSeq = CallSeqMap.at(NumImportFunctions + I);
+    const auto &CallWeights = CallWeightMap.at(NumImportFunctions + I);
+    ZEN_ASSERT(CallSeq.size() == CallWeights.size());
+    for (size_t K = 0; K < CallSeq.size(); ++K) {
+      ZEN_ASSERT(CallSeq[K] >= NumImportFunctions);
+      Edges.push_back({I, CallSeq[K] - NumImportFunctions, CallWeights[K]});
+    }
+  }
+  return utils::buildCallChains(Edges, CodeSizes, MaxChainCodeSize);
 }
 
 void EagerJITCompiler::compile() {
@@ -392,8 +571,12 @@ void EagerJITCompiler::compile() {
   auto &CodeMPool = WasmMod->getJITCodeMemPool();
   uint8_t *JITCode = const_cast<uint8_t *>(CodeMPool.getMemStart());
   if (Config.DisableMultipassMultithread) {
-    for (uint32_t I = 0; I < NumInternalFunctions; ++I) {
-      compileWasmToMC(MainContext, Mod, I, Config.DisableMultipassGreedyRA);
+    // Emit callers and callees close to each other for better i-cache and
+    // iTLB locality
+    for (const auto &Chain : buildFunctionChains(UINT64_MAX)) {
+      for (uint32_t FuncIdx : Chain) {
+        compileWasmToMC(MainContext, Mod, FuncIdx, getRegAllocKind(false));
+      }
     }
     emitObjectBuffer(&MainContext);
     ZEN_ASSERT(MainContext.ExternRelocs.empty());
@@ -431,23 +614,40 @@ void EagerJITCompiler::compile() {
       Contexts.push_back(&AuxContexts[I]);
     }
 
-    // Sort functions by code size in descending order in order to compile
-    // larger functions first
-    CompileVector<std::pair<uint32_t, uint32_t>> FuncIdxAndSizes(MainMemPool);
-    FuncIdxAndSizes.reserve(NumInternalFunctions);
+    // Each chain of callers and callees is compiled by one task, so its
+    // functions are emitted contiguously in the object of that thread. The
+    // chains are bounded to keep the threads balanced
+    uint64_t TotalCodeSize = 0;
     for (uint32_t I = 0; I < NumInternalFunctions; ++I) {
       CodeEntry *CE = WasmMod->getCodeEntry(NumImportFunctions + I);
       ZEN_ASSERT(CE);
-      FuncIdxAndSizes.emplace_back(I, CE->CodeSize);
+      TotalCodeSize += CE->CodeSize;
+    }
+    auto Chains = buildFunctionChains(
+        std::max<uint64_t>(TotalCodeSize / (NumThreads * 4), 4096));
+
+    // Sort chains by code size in descending order in order to compile
+    // larger chains first
+    CompileVector<std::pair<uint32_t, uint64_t>> ChainIdxAndSizes(MainMemPool);
+    ChainIdxAndSizes.reserve(Chains.size());
+    for (uint32_t I = 0; I < Chains.size(); ++I) {
+      uint64_t ChainSize = 0;
+      for (uint32_t FuncIdx : Chains[I]) {
+        ChainSize += WasmMod->getCodeEntry(NumImportFunctions + FuncIdx)
+                         ->CodeSize;
+      }
+      ChainIdxAndSizes.emplace_back(I, ChainSize);
     }
-    std::sort(FuncIdxAndSizes.begin(), FuncIdxAndSizes.end(),
+    std::sort(ChainIdxAndSizes.begin(), ChainIdxAndSizes.end(),
               [](const auto &LHS, const auto &RHS) {
                 return LHS.second > RHS.second;
               });
 
-    for (const auto &[FuncIdx, FuncSize] : FuncIdxAndSizes) {
-      ThreadPool.pushTask([&, FuncIdx = FuncIdx](WasmFrontendContext *Ctx) {
-        compileWasmToMC(*Ctx, Mod, FuncIdx, Config.DisableMultipassGreedyRA);
+    for (const auto &[ChainIdx, ChainSize] : ChainIdxAndSizes) {
+      ThreadPool.pushTask([&, ChainIdx = ChainIdx](WasmFrontendContext *Ctx) {
+        for (uint32_t FuncIdx : Chains[ChainIdx]) {
+          compileWasmToMC(*Ctx, Mod, FuncIdx, getRegAllocKind(false));
+        }
       });
     }
 
@@ -529,12 +729,32 @@ LazyJITCompiler::LazyJITCompiler(Module *WasmMod)
       GreedyRACodePtrs[I] = nullptr;
     }
   }
+
+  if (!Config.MultipassProfileDir.empty()) {
+    Profiling = true;
+    uint64_t Hash = utils::hashBytes(WasmMod->getWASMBytecode(),
+                                     WasmMod->getWASMBytecodeSize());
+    char HashStr[17];
+    std::snprintf(HashStr, sizeof(HashStr), "%016" PRIx64, Hash);
+    ProfilePath = Config.MultipassProfileDir + "/" + HashStr + ".profile";
+    Called = std::make_unique<std::atomic<bool>[]>(NumInternalFunctions);
+    EntryRecorded =
+        std::make_unique<std::atomic<bool>[]>(NumInternalFunctions);
+    for (uint32_t I = 0; I < NumInternalFunctions; ++I) {
+      Called[I] = false;
+      EntryRecorded[I] = false;
+    }
+    loadProfile();
+  }
 }
 
 LazyJITCompiler::~LazyJITCompiler() {
   if (ThreadPool) {
     ThreadPool->interrupt();
   }
+  if (Profiling) {
+    saveProfile();
+  }
   MainContext->ThreadMemPool.deleteObject(Mod);
   delete MainContext;
 }
@@ -579,8 +799,12 @@ void LazyJITCompiler::dispatchCompileTasksDepthFirst(WasmFrontendContext &Ctx) {
   while (!Stack.empty()) {
     uint32_t FuncIdx = Stack.back();
     Stack.pop_back();
-    dispatchCompileTask(FuncIdx);
     Visited[FuncIdx] = true;
+    // The call sequence of a lazy function is only known after its loading
+    if (!tryLoadLazyFunction(FuncIdx)) {
+      continue;
+    }
+    dispatchCompileTask(FuncIdx);
     const auto &CallSeq = CallSeqMap.at(FuncIdx + NumImportFunctions);
     for (auto It = CallSeq.rbegin(); It != CallSeq.rend(); ++It) {
       uint32_t CalleeIdx = *It;
@@ -593,6 +817,17 @@ void LazyJITCompiler::dispatchCompileTasksDepthFirst(WasmFrontendContext &Ctx) {
   }
 }
 
+bool LazyJITCompiler::tryLoadLazyFunction(uint32_t FuncIdx) {
+  try {
+    WasmMod->loadLazyFunction(WasmMod->getNumImportFunctions() + FuncIdx);
+    return true;
+  } catch (const common::Error &Err) {
+    ZEN_LOG_DEBUG("lazy function %d failed validation: %s", FuncIdx,
+                  Err.getFormattedMessage(false).c_str());
+    return false;
+  }
+}
+
 void LazyJITCompiler::dispatchCompileTasksInOrder(WasmFrontendContext &Ctx) {
   for (uint32_t I = 0; I < NumInternalFunctions; ++I) {
     dispatchCompileTask(I);
@@ -600,6 +835,12 @@ void LazyJITCompiler::dispatchCompileTasksInOrder(WasmFrontendContext &Ctx) {
 }
 
 void LazyJITCompiler::dispatchEntryCompileTasks(WasmFrontendContext &Ctx) {
+  // The functions called by the previous runs go first in the order of their
+  // first calls, the strategies below skip them
+  for (uint32_t FuncIdx : ProfiledCallOrder) {
+    dispatchCompileTask(FuncIdx);
+  }
+
   // First strategy: dispatch compile tasks in depth-first order
   dispatchCompileTasksDepthFirst(Ctx);
 
@@ -616,6 +857,9 @@ void LazyJITCompiler::precompile() {
   for (uint32_t I = 0; I < NumInternalFunctions; ++I) {
     StubBuilder.compileFunctionToStub(I);
   }
+  if (!ProfiledEntries.empty()) {
+    compileProfiledEntries();
+  }
   if (ThreadPool) {
     ThreadPool->pushTask(
         [this](WasmFrontendContext *Ctx) { dispatchEntryCompileTasks(*Ctx); });
@@ -635,8 +879,8 @@ void LazyJITCompiler::precompile() {
 
 uint8_t *LazyJITCompiler::compileFunction(WasmFrontendContext &Ctx,
                                           uint32_t FuncIdx,
-                                          bool DisableGreedyRA) {
-  compileWasmToMC(Ctx, *Mod, FuncIdx, DisableGreedyRA);
+                                          RegAllocKind RAKind) {
+  compileWasmToMC(Ctx, *Mod, FuncIdx, RAKind);
   emitObjectBuffer(&Ctx);
   uint8_t *JITCode = const_cast<uint8_t *>(Ctx.CodeMPool->getMemStart());
   for (const auto &Reloc : Ctx.ExternRelocs) {
@@ -660,34 +904,56 @@ uint8_t *LazyJITCompiler::compileFunction(WasmFrontendContext &Ctx,
 void LazyJITCompiler::compileFunctionInBackgroud(WasmFrontendContext &Ctx,
                                                  uint32_t FuncIdx) {
   ZEN_LOG_DEBUG("compile function %d in background", FuncIdx);
+  if (!tryLoadLazyFunction(FuncIdx)) {
+    CompileStatuses[FuncIdx] = CompileStatus::Failed;
+    return;
+  }
   CompileStatuses[FuncIdx] = CompileStatus::InProgress;
   auto Timer = Stats.startRecord(utils::StatisticPhase::JITLazyBgCompilation);
   uint8_t *JITFuncCodePtr =
-      compileFunction(Ctx, FuncIdx, Config.DisableMultipassGreedyRA);
+      compileFunction(Ctx, FuncIdx, getRegAllocKind(false));
   uint8_t *FuncStubCodePtr = StubBuilder.getFuncStubCodePtr(FuncIdx);
   GreedyRACodePtrs[FuncIdx] = JITFuncCodePtr;
   CompileStatuses[FuncIdx] = CompileStatus::Done;
-  JITStubBuilder::updateStubJmpTargetPtr(FuncStubCodePtr, JITFuncCodePtr);
+  // When profiling, the stubs of the functions not called yet are kept to
+  // record their first calls, and patched by compileFunctionOnRequest then
+  if (!Profiling || Called[FuncIdx]) {
+    JITStubBuilder::updateStubJmpTargetPtr(FuncStubCodePtr, JITFuncCodePtr);
+  }
   Stats.stopRecord(Timer);
 }
 
 uint8_t *LazyJITCompiler::compileFunctionOnRequest(uint8_t *FuncStubCodePtr) {
   uint32_t FuncIdx = StubBuilder.getFuncIdxByStubCodePtr(FuncStubCodePtr);
+  if (Profiling) {
+    recordFirstCall(FuncIdx);
+  }
+  // Validate the lazy function on its first call, a failed one keeps its stub
+  // and rethrows the error on every call
+  WasmMod->loadLazyFunction(WasmMod->getNumImportFunctions() + FuncIdx);
   if (!ThreadPool) { // Single thread lazy mode
     auto Timer = Stats.startRecord(utils::StatisticPhase::JITLazyFgCompilation);
     uint8_t *JITFuncCodePtr =
-        compileFunction(*MainContext, FuncIdx, Config.DisableMultipassGreedyRA);
+        compileFunction(*MainContext, FuncIdx, getRegAllocKind(false));
     JITStubBuilder::updateStubJmpTargetPtr(FuncStubCodePtr, JITFuncCodePtr);
     Stats.stopRecord(Timer);
     return JITFuncCodePtr;
   }
   if (CompileStatuses[FuncIdx] == CompileStatus::Done) {
-    return GreedyRACodePtrs[FuncIdx];
+    uint8_t *JITFuncCodePtr = GreedyRACodePtrs[FuncIdx];
+    if (Profiling) {
+      // The background compilation may have left the stub before the call
+      // was recorded
+      JITStubBuilder::updateStubJmpTargetPtr(FuncStubCodePtr, JITFuncCodePtr);
+    }
+    return JITFuncCodePtr;
   }
   ZEN_LOG_DEBUG("compile function %d on request", FuncIdx);
   auto Timer = Stats.startRecord(utils::StatisticPhase::JITLazyFgCompilation);
-  // Compile the function with fastRA for faster compilation
-  uint8_t *JITFuncCodePtr = compileFunction(*MainContext, FuncIdx, true);
+  // Compile the function with a cheaper register allocator for faster
+  // compilation, the background compilation will replace it later
+  uint8_t *JITFuncCodePtr =
+      compileFunction(*MainContext, FuncIdx, getRegAllocKind(true));
   Stats.stopRecord(Timer);
   if (CompileStatuses[FuncIdx] == CompileStatus::Done) {
     return GreedyRACodePtrs[FuncIdx];
@@ -696,6 +962,133 @@ uint8_t *LazyJITCompiler::compileFunctionOnRequest(uint8_t *FuncStubCodePtr) {
   return JITFuncCodePtr;
 }
 
+void LazyJITCompiler::recordEntry(uint32_t FuncIdx) {
+  uint32_t NumImportFunctions = WasmMod->getNumImportFunctions();
+  if (!Profiling || FuncIdx < NumImportFunctions) {
+    return;
+  }
+  FuncIdx -= NumImportFunctions;
+  // Called on every call from the host, only the first one of a function
+  // takes the lock
+  if (EntryRecorded[FuncIdx].load(std::memory_order_relaxed) ||
+      EntryRecorded[FuncIdx].exchange(true)) {
+    return;
+  }
+  common::LockGuard<common::Mutex> Lock(ProfileMtx);
+  Entries.push_back(FuncIdx);
+}
+
+void LazyJITCompiler::recordFirstCall(uint32_t FuncIdx) {
+  if (Called[FuncIdx].exchange(true)) {
+    return;
+  }
+  common::LockGuard<common::Mutex> Lock(ProfileMtx);
+  CallOrder.push_back(FuncIdx);
+}
+
+// The profile is a text file of two lines, "entries" and "calls" followed by
+// the internal function indexes, the latter in the order of the first calls
+void LazyJITCompiler::loadProfile() {
+  std::ifstream File(ProfilePath);
+  if (!File) { // Not recorded yet
+    return;
+  }
+  std::string Line;
+  while (std::getline(File, Line)) {
+    std::istringstream LineStream(Line);
+    std::string Kind;
+    LineStream >> Kind;
+    std::vector<uint32_t> *FuncIdxs = nullptr;
+    if (Kind == "entries") {
+      FuncIdxs = &ProfiledEntries;
+    } else if (Kind == "calls") {
+      FuncIdxs = &ProfiledCallOrder;
+    } else {
+      continue;
+    }
+    uint32_t FuncIdx;
+    while (LineStream >> FuncIdx) {
+      if (FuncIdx >= NumInternalFunctions) {
+        ZEN_LOG_WARN("ignore invalid multipass profile '%s'",
+                     ProfilePath.c_str());
+        ProfiledEntries.clear();
+        ProfiledCallOrder.clear();
+        return;
+      }
+      FuncIdxs->push_back(FuncIdx);
+    }
+  }
+  ZEN_LOG_DEBUG("loaded multipass profile '%s' of %zu entries and %zu calls",
+                ProfilePath.c_str(), ProfiledEntries.size(),
+                ProfiledCallOrder.size());
+}
+
+void LazyJITCompiler::saveProfile() {
+  common::LockGuard<common::Mutex> Lock(ProfileMtx);
+  if (CallOrder.empty() && Entries.empty()) {
+    return;
+  }
+  // Keep the functions only called by the previous runs after the ones of
+  // this run, so a run taking another path doesn't lose them
+  auto Merge = [](std::vector<uint32_t> &FuncIdxs,
+                  const std::vector<uint32_t> &PrevFuncIdxs) {
+    for (uint32_t FuncIdx : PrevFuncIdxs) {
+      if (std::find(FuncIdxs.begin(), FuncIdxs.end(), FuncIdx) ==
+          FuncIdxs.end()) {
+        FuncIdxs.push_back(FuncIdx);
+      }
+    }
+  };
+  Merge(Entries, ProfiledEntries);
+  Merge(CallOrder, ProfiledCallOrder);
+
+  // Write to a temporary file first, so concurrent loads never see a partial
+  // profile
+  std::string TmpPath = ProfilePath + ".tmp";
+  std::ofstream File(TmpPath);
+  if (!File) {
+    ZEN_LOG_ERROR("failed to open multipass profile '%s'", TmpPath.c_str());
+    return;
+  }
+  File << "entries";
+  for (uint32_t FuncIdx : Entries) {
+    File << ' ' << FuncIdx;
+  }
+  File << "\ncalls";
+  for (uint32_t FuncIdx : CallOrder) {
+    File << ' ' << FuncIdx;
+  }
+  File << '\n';
+  File.close();
+  if (!File || std::rename(TmpPath.c_str(), ProfilePath.c_str()) != 0) {
+    ZEN_LOG_ERROR("failed to write multipass profile '%s'",
+                  ProfilePath.c_str());
+    std::remove(TmpPath.c_str());
+  }
+}
+
+// Compile the entries recorded by the previous runs before the first call,
+// their callees are dispatched first to the background threads
+void LazyJITCompiler::compileProfiledEntries() {
+  for (uint32_t FuncIdx : ProfiledEntries) {
+    if (Called[FuncIdx].exchange(true)) {
+      continue;
+    }
+    // Left to trap on the first call
+    if (!tryLoadLazyFunction(FuncIdx)) {
+      continue;
+    }
+    uint8_t *JITFuncCodePtr =
+        compileFunction(*MainContext, FuncIdx, getRegAllocKind(false));
+    if (ThreadPool) {
+      GreedyRACodePtrs[FuncIdx] = JITFuncCodePtr;
+      CompileStatuses[FuncIdx] = CompileStatus::Done;
+    }
+    JITStubBuilder::updateStubJmpTargetPtr(
+        StubBuilder.getFuncStubCodePtr(FuncIdx), JITFuncCodePtr);
+  }
+}
+
 std::pair<std::unique_ptr<MModule>, std::vector<void *>>
 MIRTextJITCompiler::compile(CompileContext &Context, const char *Ptr,
                             size_t Size) {
@@ -707,7 +1100,7 @@ MIRTextJITCompiler::compile(CompileContext &Context, const char *Ptr,
   for (uint32_t I = 0; I < Mod->getNumFunctions(); ++I) {
     MFunction &MFunc = *Mod->getFunction(I);
     CgFunction CgFunc(Context, MFunc);
-    compileMIRToCgIR(*Mod, MFunc, CgFunc, false);
+    compileMIRToCgIR(*Mod, MFunc, CgFunc, CgIRCompileOptions());
     Context.getMCLowering().runOnCgFunction(CgFunc);
   }
   emitObjectBuffer(&Context);
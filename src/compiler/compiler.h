@@ -15,12 +15,39 @@ class MModule;
 class MFunction;
 class CgFunction;
 
+/// Register allocator used by compileMIRToCgIR
+enum class RegAllocKind : uint8_t {
+  Fast,
+  LinearScan,
+  Greedy,
+  /// LinearScan for large functions without deeply nested loops, otherwise
+  /// Greedy
+  Auto,
+};
+
+/// Per-function options of compileMIRToCgIR
+struct CgIRCompileOptions {
+  RegAllocKind RAKind = RegAllocKind::Greedy;
+  /// Functions of more CgIR instructions are allocated by FastRA(0 for
+  /// unlimited)
+  uint32_t MaxRAFuncInstrs = 0;
+  /// Compile time budget of the function measured from StartTime, FastRA is
+  /// used once it's exceeded before register allocation(0 for unlimited)
+  uint32_t BudgetMs = 0;
+  common::SteadyClock::time_point StartTime;
+  /// Pass timers and counters are recorded if not null
+  utils::Statistics *Stats = nullptr;
+  /// The downgraded functions are recorded in it if not null
+  runtime::Module *WasmMod = nullptr;
+};
+
 class JITCompilerBase : public NonCopyable {
 protected:
   virtual ~JITCompilerBase() = default;
 
   static void compileMIRToCgIR(MModule &Mod, MFunction &MFunc,
-                               CgFunction &CgFunc, bool DisableGreedyRA);
+                               CgFunction &CgFunc,
+                               const CgIRCompileOptions &Options);
   static void emitObjectBuffer(CompileContext *Ctx);
 };
 
@@ -35,7 +62,11 @@ protected:
   ~WasmJITCompiler() override = default;
 
   void compileWasmToMC(WasmFrontendContext &Ctx, MModule &Mod, uint32_t FuncIdx,
-                       bool DisableGreedyRA);
+                       RegAllocKind RAKind);
+
+  /// Register allocator selected by the runtime config, OnRequest is true for
+  /// the foreground compilation of the multithread lazy mode
+  RegAllocKind getRegAllocKind(bool OnRequest) const;
 
   runtime::Module *WasmMod;
   const uint32_t NumInternalFunctions;
@@ -50,6 +81,14 @@ public:
   ~EagerJITCompiler() override = default;
 
   void compile();
+
+private:
+  /// \brief group the internal functions into chains of callers and callees
+  /// by the call graph weighted by the loop depths of the call sites, each
+  /// chain is emitted contiguously
+  /// \param MaxChainCodeSize chains are not merged beyond this bytecode size
+  std::vector<std::vector<uint32_t>>
+  buildFunctionChains(uint64_t MaxChainCodeSize) const;
 };
 
 class LazyJITCompiler final : public WasmJITCompiler {
@@ -69,18 +108,40 @@ public:
   void precompile();
 
   uint8_t *compileFunction(WasmFrontendContext &Ctx, uint32_t FuncIdx,
-                           bool DisableGreedyRA);
+                           RegAllocKind RAKind);
 
   void compileFunctionInBackgroud(WasmFrontendContext &Ctx, uint32_t FuncIdx);
 
+  /// \throw the validation error of a lazy function, see
+  /// RuntimeConfig::EnableLazyFunctionLoad
   uint8_t *compileFunctionOnRequest(uint8_t *FuncStubCodePtr);
 
+  /// Record a call of the function(global index) from the host into the
+  /// profile, no-op if MultipassProfileDir isn't set
+  void recordEntry(uint32_t FuncIdx);
+
 private:
+  void loadProfile();
+
+  void saveProfile();
+
+  void recordFirstCall(uint32_t FuncIdx);
+
+  void compileProfiledEntries();
+
+  /// Load the lazy function(internal index) before compiling it, see
+  /// RuntimeConfig::EnableLazyFunctionLoad
+  /// \return false if it fails the validation, its stub is kept so that its
+  /// calls trap in compileFunctionOnRequest
+  bool tryLoadLazyFunction(uint32_t FuncIdx);
+
   enum class CompileStatus : uint8_t {
     None,
     Pending,
     InProgress,
     Done,
+    // Failed the lazy validation
+    Failed,
   };
 
   JITStubBuilder StubBuilder;
@@ -93,6 +154,23 @@ private:
   std::unique_ptr<std::atomic<CompileStatus>[]> CompileStatuses;
   // must be declared before ThreadPool
   std::unique_ptr<std::atomic<uint8_t *>[]> GreedyRACodePtrs;
+
+  // These fields are only used when MultipassProfileDir is set, function
+  // indexes are internal ones
+  bool Profiling = false;
+  std::string ProfilePath;
+  // Entries and first call order recorded by the previous runs
+  std::vector<uint32_t> ProfiledEntries;
+  std::vector<uint32_t> ProfiledCallOrder;
+  // must be declared before ThreadPool
+  std::unique_ptr<std::atomic<bool>[]> Called;
+  // A function called by both the host and other functions is an entry even
+  // if it's called by the latter first, so it has its own flag
+  std::unique_ptr<std::atomic<bool>[]> EntryRecorded;
+  common::Mutex ProfileMtx;
+  std::vector<uint32_t> Entries;
+  std::vector<uint32_t> CallOrder;
+
   std::unique_ptr<common::ThreadPool<WasmFrontendContext>> ThreadPool;
 };
 
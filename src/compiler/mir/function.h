@@ -196,6 +196,19 @@ public:
 
   const auto &getExceptionSetBBs() const { return ExceptionSetBBs; }
 
+  /// Whether the block only runs when an exception is raised
+  bool isExceptionBB(const MBasicBlock *BB) const {
+    if (BB == ExceptionHandlingBB || BB == ExceptionReturnBB) {
+      return true;
+    }
+    for (const auto &[ErrCode, ExceptionSetBB] : ExceptionSetBBs) {
+      if (BB == ExceptionSetBB) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   MBasicBlock *createExceptionHandlingBB() {
     ZEN_ASSERT(!ExceptionHandlingBB);
     ExceptionHandlingBB = createBasicBlock();
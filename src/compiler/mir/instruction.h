@@ -39,7 +39,8 @@ public:
     WASM_CHECK,
 
     //===---------- Expression & Statement Instructions ----------===//
-    CALL
+    CALL,
+    ATOMIC
   };
 
   bool isStatement() const { return _parent.index() == 0; }
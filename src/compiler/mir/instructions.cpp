@@ -21,6 +21,25 @@ std::string CmpInstruction::getPredicateName() const {
   }
 }
 
+const char *AtomicRMWInstruction::getRMWOpName() const {
+  switch (Op) {
+  case XCHG:
+    return "xchg";
+  case ADD:
+    return "add";
+  case SUB:
+    return "sub";
+  case AND:
+    return "and";
+  case OR:
+    return "or";
+  case XOR:
+    return "xor";
+  default:
+    ZEN_ASSERT(false);
+  }
+}
+
 bool MInstruction::isTerminator() const {
   switch (_kind) {
   case BR:
@@ -175,6 +194,39 @@ void MInstruction::print(llvm::raw_ostream &OS) const {
     OS << ")\n";
     break;
   }
+  case ATOMIC: {
+    const MInstruction *Index = nullptr;
+    uint32_t Scale = 1;
+    int32_t Offset = 0;
+    if (auto *RMWInstr = llvm::dyn_cast<AtomicRMWInstruction>(this)) {
+      OS << getOpcodeString(_opcode) << ' ' << RMWInstr->getRMWOpName()
+         << " (value = " << RMWInstr->getValue()
+         << ", base = " << RMWInstr->getBase();
+      Index = RMWInstr->getIndex();
+      Scale = RMWInstr->getScale();
+      Offset = RMWInstr->getOffset();
+    } else {
+      auto *CmpxchgInstr = llvm::cast<AtomicCmpxchgInstruction>(this);
+      OS << getOpcodeString(_opcode)
+         << " (expected = " << CmpxchgInstr->getExpected()
+         << ", replacement = " << CmpxchgInstr->getReplacement()
+         << ", base = " << CmpxchgInstr->getBase();
+      Index = CmpxchgInstr->getIndex();
+      Scale = CmpxchgInstr->getScale();
+      Offset = CmpxchgInstr->getOffset();
+    }
+    if (Index) {
+      OS << ", scale = " << Scale << ", index = " << Index;
+    }
+    if (Offset) {
+      OS << ", offset = " << Offset;
+    }
+    OS << ')';
+    if (isStatement()) {
+      OS << '\n';
+    }
+    break;
+  }
   case CONVERSION: {
     ZEN_ASSERT(_opcode >= OP_CONV_EXPR_START && _opcode <= OP_CONV_EXPR_END);
     OS << getOpcodeString(_opcode) << " (" << getOperand<0>() << ", "
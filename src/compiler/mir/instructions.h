@@ -221,6 +221,84 @@ private:
   int32_t Offset; // Equivalent to displacement in x86 addressing mode
 };
 
+/// \brief Sequentially consistent read-modify-write of the memory at the
+/// address, the result is the value in memory before the operation
+class AtomicRMWInstruction : public BinaryInstruction {
+public:
+  enum RMWOp : uint8_t { XCHG, ADD, SUB, AND, OR, XOR };
+
+  template <typename... Arguments>
+  static AtomicRMWInstruction *create(Arguments &&...Args) {
+    return FixedOperandInstruction::create<AtomicRMWInstruction>(
+        std::forward<Arguments>(Args)...);
+  }
+
+  static bool classof(const MInstruction *Instr) {
+    return Instr->getOpcode() == OP_wasm_atomic_rmw;
+  }
+
+  RMWOp getRMWOp() const { return Op; }
+  const char *getRMWOpName() const;
+  const MInstruction *getValue() const { return getOperand<0>(); }
+  const MInstruction *getBase() const { return getOperand<1>(); }
+  uint32_t getScale() const { return Scale; }
+  const MInstruction *getIndex() const { return Index; }
+  int32_t getOffset() const { return Offset; }
+
+private:
+  friend class FixedOperandInstruction;
+  AtomicRMWInstruction(RMWOp Op, MType *Type, MInstruction *Value,
+                       MInstruction *Base, uint32_t SC, MInstruction *Index,
+                       int32_t Offset)
+      : BinaryInstruction(MInstruction::ATOMIC, OP_wasm_atomic_rmw, Type,
+                          Value, Base),
+        Op(Op), Scale(SC), Index(Index), Offset(Offset) {}
+
+  RMWOp Op;
+  uint32_t Scale; // {1,2,4,8}
+  MInstruction *Index;
+  int32_t Offset; // Equivalent to displacement in x86 addressing mode
+};
+
+/// \brief Sequentially consistent compare-and-exchange of the memory at the
+/// address, the result is the value in memory before the operation
+class AtomicCmpxchgInstruction : public FixedOperandInstruction<3> {
+public:
+  template <typename... Arguments>
+  static AtomicCmpxchgInstruction *create(Arguments &&...Args) {
+    return FixedOperandInstruction::create<AtomicCmpxchgInstruction>(
+        std::forward<Arguments>(Args)...);
+  }
+
+  static bool classof(const MInstruction *Instr) {
+    return Instr->getOpcode() == OP_wasm_atomic_cmpxchg;
+  }
+
+  const MInstruction *getExpected() const { return getOperand<0>(); }
+  const MInstruction *getReplacement() const { return getOperand<1>(); }
+  const MInstruction *getBase() const { return getOperand<2>(); }
+  uint32_t getScale() const { return Scale; }
+  const MInstruction *getIndex() const { return Index; }
+  int32_t getOffset() const { return Offset; }
+
+private:
+  friend class FixedOperandInstruction;
+  AtomicCmpxchgInstruction(MType *Type, MInstruction *Expected,
+                           MInstruction *Replacement, MInstruction *Base,
+                           uint32_t SC, MInstruction *Index, int32_t Offset)
+      : FixedOperandInstruction(MInstruction::ATOMIC, OP_wasm_atomic_cmpxchg,
+                                3, Type),
+        Scale(SC), Index(Index), Offset(Offset) {
+    setOperand<0>(Expected);
+    setOperand<1>(Replacement);
+    setOperand<2>(Base);
+  }
+
+  uint32_t Scale; // {1,2,4,8}
+  MInstruction *Index;
+  int32_t Offset; // Equivalent to displacement in x86 addressing mode
+};
+
 class ConversionInstruction : public UnaryInstruction {
 public:
   template <typename... Arguments>
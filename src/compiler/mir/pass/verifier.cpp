@@ -207,6 +207,52 @@ void MVerifier::visitStoreInstruction(StoreInstruction &I) {
   MVisitor::visitStoreInstruction(I);
 }
 
+void MVerifier::visitAtomicRMWInstruction(AtomicRMWInstruction &I) {
+  MType *ValueType = I.getValue()->getType();
+  CHECK(ValueType->isInteger(),
+        "The value of atomic rmw instruction must be integer");
+  CHECK(I.getType()->getKind() == ValueType->getKind(),
+        "The type of atomic rmw instruction must be the same as the value");
+  MType *AddrType = I.getBase()->getType();
+  CHECK(AddrType->isPointer(),
+        "The address of atomic rmw instruction must be pointer");
+  const MInstruction *Index = I.getIndex();
+  if (Index) {
+    uint32_t Scale = I.getScale();
+    CHECK(Scale == 1 || Scale == 2 || Scale == 4 || Scale == 8,
+          "The scale of atomic rmw instruction must be 1/2/4/8");
+    MType *IndexType = Index->getType();
+    CHECK(IndexType->isI32() || IndexType->isI64(),
+          "The index of atomic rmw instruction must be i32 or i64");
+    MVisitor::visitInstruction(*const_cast<MInstruction *>(Index));
+  }
+  MVisitor::visitAtomicRMWInstruction(I);
+}
+
+void MVerifier::visitAtomicCmpxchgInstruction(AtomicCmpxchgInstruction &I) {
+  MType *ExpectedType = I.getExpected()->getType();
+  CHECK(ExpectedType->isInteger(),
+        "The expected value of atomic cmpxchg instruction must be integer");
+  CHECK(I.getReplacement()->getType()->getKind() == ExpectedType->getKind() &&
+            I.getType()->getKind() == ExpectedType->getKind(),
+        "The expected value, replacement and result of atomic cmpxchg "
+        "instruction must be of the same type");
+  MType *AddrType = I.getBase()->getType();
+  CHECK(AddrType->isPointer(),
+        "The address of atomic cmpxchg instruction must be pointer");
+  const MInstruction *Index = I.getIndex();
+  if (Index) {
+    uint32_t Scale = I.getScale();
+    CHECK(Scale == 1 || Scale == 2 || Scale == 4 || Scale == 8,
+          "The scale of atomic cmpxchg instruction must be 1/2/4/8");
+    MType *IndexType = Index->getType();
+    CHECK(IndexType->isI32() || IndexType->isI64(),
+          "The index of atomic cmpxchg instruction must be i32 or i64");
+    MVisitor::visitInstruction(*const_cast<MInstruction *>(Index));
+  }
+  MVisitor::visitAtomicCmpxchgInstruction(I);
+}
+
 void MVerifier::visitConstantInstruction(ConstantInstruction &I) {
   CHECK(I.getType()->getKind() == I.getConstant().getType().getKind(),
         "The type of constant instruction result must be the same as the "
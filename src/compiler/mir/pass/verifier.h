@@ -47,6 +47,8 @@ public:
   void visitDassignInstruction(DassignInstruction &I) override;
   void visitLoadInstruction(LoadInstruction &I) override;
   void visitStoreInstruction(StoreInstruction &I) override;
+  void visitAtomicRMWInstruction(AtomicRMWInstruction &I) override;
+  void visitAtomicCmpxchgInstruction(AtomicCmpxchgInstruction &I) override;
   void visitConstantInstruction(ConstantInstruction &I) override;
   void visitBrInstruction(BrInstruction &I) override;
   void visitBrIfInstruction(BrIfInstruction &I) override;
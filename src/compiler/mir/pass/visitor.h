@@ -76,6 +76,14 @@ public:
         visitICallInstruction(static_cast<ICallInstruction &>(I));
       }
       break;
+    case MInstruction::ATOMIC:
+      if (I.getOpcode() == OP_wasm_atomic_rmw) {
+        visitAtomicRMWInstruction(static_cast<AtomicRMWInstruction &>(I));
+      } else {
+        visitAtomicCmpxchgInstruction(
+            static_cast<AtomicCmpxchgInstruction &>(I));
+      }
+      break;
     case MInstruction::RETURN:
       visitReturnInstruction(static_cast<ReturnInstruction &>(I));
       break;
@@ -128,6 +136,12 @@ public:
   }
   virtual void visitLoadInstruction(LoadInstruction &I) { VISIT_OPERAND_1 }
   virtual void visitStoreInstruction(StoreInstruction &I) { VISIT_OPERAND_2 }
+  virtual void visitAtomicRMWInstruction(AtomicRMWInstruction &I) {
+    VISIT_OPERAND_2
+  }
+  virtual void visitAtomicCmpxchgInstruction(AtomicCmpxchgInstruction &I) {
+    VISIT_OPERAND_3
+  }
   virtual void visitConstantInstruction(ConstantInstruction &I) {}
   virtual void visitBrInstruction(BrInstruction &I) {}
   virtual void visitBrIfInstruction(BrIfInstruction &I) { VISIT_OPERAND_1 }
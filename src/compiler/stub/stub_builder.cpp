@@ -27,8 +27,12 @@ void JITStubBuilder::updateStubJmpTargetPtr(uint8_t *CurStubCodePtr,
       : "memory");
 }
 
+// Re-entered instead of the function failing the lazy validation when the
+// error can't be thrown, the caller checks the exception after the call
+static uint64_t returnOnLazyLoadFailure() { return 0; }
+
 static uint64_t
-compileOnRequestTrampoline([[maybe_unused]] zen::runtime::Instance *Inst,
+compileOnRequestTrampoline(zen::runtime::Instance *Inst,
                            uint8_t *NextFuncStubCodePtr) {
   auto *LJITComiler = Inst->getModule()->getLazyJITCompiler();
   ZEN_ASSERT(LJITComiler);
@@ -38,8 +42,15 @@ compileOnRequestTrampoline([[maybe_unused]] zen::runtime::Instance *Inst,
   uint8_t *CurFuncStubCodePtr = reinterpret_cast<uint8_t *>(
       NextFuncStubCodePtr - JITStubBuilder::EachStubCodeSize);
 
-  uint8_t *FuncJITCodePtr =
-      LJITComiler->compileFunctionOnRequest(CurFuncStubCodePtr);
+  uint8_t *FuncJITCodePtr;
+  try {
+    FuncJITCodePtr = LJITComiler->compileFunctionOnRequest(CurFuncStubCodePtr);
+  } catch (const zen::common::Error &Err) {
+    // A lazy function failing the validation traps on its call
+    Inst->setExecutionError(Err, 1);
+    zen::runtime::Instance::throwInstanceExceptionOnJIT(Inst);
+    return reinterpret_cast<uint64_t>(returnOnLazyLoadFailure);
+  }
 
   // Return new jited code addr to re-entry in stub trampoline
   return reinterpret_cast<uint64_t>(FuncJITCodePtr);
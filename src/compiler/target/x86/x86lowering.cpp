@@ -9,7 +9,13 @@ using namespace llvm;
 
 X86CgLowering::X86CgLowering(CgFunction &MF)
     : CgLowering(MF), Subtarget(&MF.getSubtarget<X86Subtarget>()),
-      TRI(Subtarget->getRegisterInfo()) {
+      TRI(Subtarget->getRegisterInfo()),
+      ExprUseCounts(_mir_func.getNumInstructions(), _mpool) {
+  for (MBasicBlock *MIRBB : _mir_func) {
+    for (MInstruction *Stmt : *MIRBB) {
+      countExprUses(*Stmt);
+    }
+  }
   lower();
 #ifdef ZEN_ENABLE_MULTIPASS_JIT_LOGGING
   llvm::dbgs() << "\n########## CgIR Dump After Lowering (Instruction "
@@ -18,6 +24,52 @@ X86CgLowering::X86CgLowering(CgFunction &MF)
 #endif
 }
 
+void X86CgLowering::countExprUses(const MInstruction &Inst) {
+  auto CountUse = [this](const MInstruction *Operand) {
+    // The operands of a shared expression are only lowered once
+    if (Operand && ++ExprUseCounts[Operand] == 1) {
+      countExprUses(*Operand);
+    }
+  };
+  for (uint32_t I = 0, E = Inst.getNumOperands(); I != E; ++I) {
+    CountUse(Inst.getOperand(I));
+  }
+  if (const auto *Load = dyn_cast<LoadInstruction>(&Inst)) {
+    CountUse(Load->getIndex());
+  } else if (const auto *Store = dyn_cast<StoreInstruction>(&Inst)) {
+    CountUse(Store->getIndex());
+  } else if (const auto *RMW = dyn_cast<AtomicRMWInstruction>(&Inst)) {
+    CountUse(RMW->getIndex());
+  } else if (const auto *Cmpxchg = dyn_cast<AtomicCmpxchgInstruction>(&Inst)) {
+    CountUse(Cmpxchg->getIndex());
+  } else if (const auto *ICall = dyn_cast<ICallInstruction>(&Inst)) {
+    CountUse(ICall->getCalleeAddr());
+  } else if (const auto *CMA = dyn_cast<WasmCMAI>(&Inst)) {
+    CountUse(CMA->getBase());
+  }
+}
+
+bool X86CgLowering::hasOneUse(const MInstruction &Inst) const {
+  auto It = ExprUseCounts.find(&Inst);
+  return It != ExprUseCounts.end() && It->second == 1;
+}
+
+bool X86CgLowering::canLowerEarly(const MInstruction &Inst) const {
+  // Variables are only written by statements, so reading them early is safe
+  return Inst.getKind() == MInstruction::CONSTANT ||
+         Inst.getKind() == MInstruction::DREAD || _expr_reg_map.count(&Inst);
+}
+
+static bool getIntConstantValue(const MInstruction *Inst, int64_t &Value) {
+  const auto *ConstInst = dyn_cast<ConstantInstruction>(Inst);
+  if (!ConstInst || !ConstInst->getType()->isInteger()) {
+    return false;
+  }
+  const auto &ConstInt = cast<MConstantInt>(ConstInst->getConstant());
+  Value = ConstInt.getValue().getSExtValue();
+  return true;
+}
+
 // ==================== Unary Expressions ====================
 
 CgRegister X86CgLowering::lowerFPAbsExpr(MVT VT, CgRegister Operand) {
@@ -377,6 +429,82 @@ CgRegister X86CgLowering::lowerFPCopySignExpr(const MInstruction &LHS,
   return fastEmitInst_rr(OROpc, RC, LHSWithoutSign, RHSSign);
 }
 
+static unsigned getBinaryRMOpcode(unsigned ISDOpcode, MVT VT) {
+  // [Opcode][i32/i64]
+  static const unsigned Opcodes[][2] = {
+      {X86::ADD32rm, X86::ADD64rm}, {X86::SUB32rm, X86::SUB64rm},
+      {X86::IMUL32rm, X86::IMUL64rm}, {X86::AND32rm, X86::AND64rm},
+      {X86::OR32rm, X86::OR64rm},   {X86::XOR32rm, X86::XOR64rm},
+  };
+  unsigned Row;
+  switch (ISDOpcode) {
+  case ISD::ADD:
+    Row = 0;
+    break;
+  case ISD::SUB:
+    Row = 1;
+    break;
+  case ISD::MUL:
+    Row = 2;
+    break;
+  case ISD::AND:
+    Row = 3;
+    break;
+  case ISD::OR:
+    Row = 4;
+    break;
+  case ISD::XOR:
+    Row = 5;
+    break;
+  default:
+    return 0;
+  }
+  switch (VT.SimpleTy) {
+  case MVT::i32:
+    return Opcodes[Row][0];
+  case MVT::i64:
+    return Opcodes[Row][1];
+  default:
+    return 0;
+  }
+}
+
+/// Fold a single-use load operand into the memory form of the arithmetic
+/// instruction(e.g. ADD32rm), return 0 if the load can't be folded.
+CgRegister X86CgLowering::lowerBinaryExprWithLoad(const MInstruction &LHS,
+                                                  const MInstruction &RHS,
+                                                  llvm::MVT VT,
+                                                  unsigned ISDOpcode,
+                                                  bool IsCommutative) {
+  unsigned Opcode = getBinaryRMOpcode(ISDOpcode, VT);
+  if (!Opcode) {
+    return CgRegister();
+  }
+
+  const MInstruction *RegOperand = &LHS;
+  const LoadInstruction *Load = getFoldableLoad(RHS, VT);
+  // Folding the LHS load lowers RHS first, which must not be reordered
+  // before the load
+  if (!Load && IsCommutative && canLowerEarly(RHS)) {
+    Load = getFoldableLoad(LHS, VT);
+    RegOperand = &RHS;
+  }
+  // Immediate operands are better handled by the ri forms
+  if (!Load || isa<ConstantInstruction>(RegOperand)) {
+    return CgRegister();
+  }
+
+  CgRegister OperandReg = lowerExpr(*RegOperand);
+  CgRegister ResultReg = createReg(TLI.getRegClassFor(VT));
+  SmallVector<CgOperand, 7> Operands{
+      CgOperand::createRegOperand(ResultReg, true),
+      CgOperand::createRegOperand(OperandReg, false),
+  };
+  appendAddressOperands(Operands, lowerAddressMode(*Load));
+  MF->createCgInstruction(*CurBB, TII.get(Opcode), Operands);
+  return ResultReg;
+}
+
 // ==================== Conversion Expressions ====================
 
 CgRegister X86CgLowering::lowerIntTruncExpr(llvm::MVT VT, llvm::MVT RetVT,
@@ -812,32 +940,104 @@ unsigned X86CgLowering::X86ChooseCmpOpcode(MVT VT) {
   }
 }
 
+/// Opcode of comparing memory with an immediate, return 0 if the immediate
+/// doesn't fit.
+unsigned X86CgLowering::X86ChooseCmpMemImmediateOpcode(MVT VT, int64_t Val) {
+  switch (VT.SimpleTy) {
+  case MVT::i8:
+    return X86::CMP8mi;
+  case MVT::i16:
+    return isInt<8>(Val) ? X86::CMP16mi8 : X86::CMP16mi;
+  case MVT::i32:
+    return isInt<8>(Val) ? X86::CMP32mi8 : X86::CMP32mi;
+  case MVT::i64:
+    if (isInt<8>(Val))
+      return X86::CMP64mi8;
+    if (isInt<32>(Val))
+      return X86::CMP64mi32;
+    return 0;
+  default:
+    return 0;
+  }
+}
+
+/// Opcode of comparing memory with a register(CMPmr if the memory is the LHS,
+/// otherwise CMPrm), return 0 for floating-point comparisons.
+unsigned X86CgLowering::X86ChooseCmpMemOpcode(MVT VT, bool MemIsLHS) {
+  switch (VT.SimpleTy) {
+  case MVT::i8:
+    return MemIsLHS ? X86::CMP8mr : X86::CMP8rm;
+  case MVT::i16:
+    return MemIsLHS ? X86::CMP16mr : X86::CMP16rm;
+  case MVT::i32:
+    return MemIsLHS ? X86::CMP32mr : X86::CMP32rm;
+  case MVT::i64:
+    return MemIsLHS ? X86::CMP64mr : X86::CMP64rm;
+  default:
+    return 0;
+  }
+}
+
 void X86CgLowering::lowerFastCompareExpr(const MInstruction *LHS,
                                          const MInstruction *RHS, MVT VT) {
+  int64_t Imm = 0;
+  bool RHSIsImm = getIntConstantValue(RHS, Imm);
+
+  // Compare a single-use load of LHS in place, e.g. the gas counter or the
+  // exception flag of the instance, use CMPmi/CMPmr. Lowering RHS before the
+  // load is only allowed when it doesn't reorder memory accesses.
+  if (const LoadInstruction *Load = getFoldableLoad(*LHS, VT)) {
+    unsigned CmpMemOpc = 0;
+    CgRegister RHSReg;
+    if (RHSIsImm) {
+      CmpMemOpc = X86ChooseCmpMemImmediateOpcode(VT, Imm);
+    } else if (canLowerEarly(*RHS)) {
+      CmpMemOpc = X86ChooseCmpMemOpcode(VT, true);
+      RHSReg = lowerExpr(*RHS);
+    }
+    if (CmpMemOpc) {
+      SmallVector<CgOperand, 6> Operands;
+      appendAddressOperands(Operands, lowerAddressMode(*Load));
+      if (RHSReg) {
+        Operands.push_back(CgOperand::createRegOperand(RHSReg, false));
+      } else {
+        Operands.push_back(CgOperand::createImmOperand(Imm));
+      }
+      MF->createCgInstruction(*CurBB, TII.get(CmpMemOpc), Operands);
+      return;
+    }
+  }
+
   CgRegister LHSReg = lowerExpr(*LHS);
 
   // We have two options: compare with register or immediate. If the RHS of the
   // compare is an immediate that we can fold into this compare, use
   // CMPri/Testrr, otherwise use CMPrr.
 
-  if (const auto *ConstInst = dyn_cast<ConstantInstruction>(RHS);
-      ConstInst && ConstInst->getType()->isInteger()) {
-    const MConstant &Constant = ConstInst->getConstant();
-    const MConstantInt &ConstInt = cast<MConstantInt>(Constant);
-    const APInt &Value = ConstInt.getValue();
-    int64_t Imm = Value.getSExtValue();
+  if (RHSIsImm) {
     if (Imm == 0) {
       unsigned TestOpc =
           LHS->getType()->isI32() ? X86::TEST32rr : X86::TEST64rr;
       fastEmitNoDefInst_rr(TestOpc, LHSReg, LHSReg);
       return;
-    } else if (unsigned CmpImmOpc = X86ChooseCmpImmediateOpcode(VT, Value);
+    } else if (unsigned CmpImmOpc = X86ChooseCmpImmediateOpcode(VT, Imm);
                CmpImmOpc) {
-      fastEmitNoDefInst_ri(CmpImmOpc, LHSReg, Value.getSExtValue());
+      fastEmitNoDefInst_ri(CmpImmOpc, LHSReg, Imm);
       return;
     }
   }
 
+  // Compare with a single-use load of RHS in place, use CMPrm
+  if (const LoadInstruction *Load = getFoldableLoad(*RHS, VT)) {
+    SmallVector<CgOperand, 6> Operands{
+        CgOperand::createRegOperand(LHSReg, false),
+    };
+    appendAddressOperands(Operands, lowerAddressMode(*Load));
+    MF->createCgInstruction(*CurBB, TII.get(X86ChooseCmpMemOpcode(VT, false)),
+                            Operands);
+    return;
+  }
+
   unsigned CompareOpc = X86ChooseCmpOpcode(VT);
   CgRegister RHSReg = lowerExpr(*RHS);
   fastEmitNoDefInst_rr(CompareOpc, LHSReg, RHSReg);
@@ -1051,6 +1251,106 @@ static inline unsigned getMovRegToMemOpcode(MType::Kind TypeKind) {
   }
 }
 
+const LoadInstruction *X86CgLowering::getFoldableLoad(const MInstruction &Inst,
+                                                      MVT VT) const {
+  const auto *Load = dyn_cast<LoadInstruction>(&Inst);
+  if (!Load || !VT.isInteger() || !hasOneUse(*Load) ||
+      _expr_reg_map.count(Load)) {
+    return nullptr;
+  }
+  // Extending loads have no memory operand forms
+  if (Load->getSrcType()->getKind() != Load->getDestType()->getKind() ||
+      getMVT(*Load->getType()) != VT) {
+    return nullptr;
+  }
+  return Load;
+}
+
+const MInstruction *
+X86CgLowering::getFoldableAddressExpr(const MInstruction *Inst,
+                                      Opcode MOpc) const {
+  if (!Inst || Inst->getKind() != MInstruction::BINARY ||
+      Inst->getOpcode() != MOpc || getMVT(*Inst->getType()) != MVT::i64 ||
+      !hasOneUse(*Inst) || _expr_reg_map.count(Inst)) {
+    return nullptr;
+  }
+  return Inst;
+}
+
+/// Select base + scale * index + displacement for the address. Only 64-bit
+/// pointer arithmetic is folded, the i32 arithmetic on wasm addresses wraps
+/// around at 2^32 while the address computation doesn't.
+X86CgLowering::X86AddressMode
+X86CgLowering::lowerAddressMode(const MInstruction *Base, uint32_t Scale,
+                                const MInstruction *Index, int32_t Offset) {
+  int64_t Displacement = Offset;
+  int64_t Imm = 0;
+
+  // Pointer casts are no-ops on x86-64
+  while (Base->getKind() == MInstruction::CONVERSION &&
+         (Base->getOpcode() == OP_inttoptr ||
+          Base->getOpcode() == OP_ptrtoint) &&
+         getMVT(*Base->getOperand<0>()->getType()) == MVT::i64) {
+    Base = Base->getOperand<0>();
+  }
+
+  if (const MInstruction *Add = getFoldableAddressExpr(Base, OP_add)) {
+    const MInstruction *AddLHS = Add->getOperand<0>();
+    const MInstruction *AddRHS = Add->getOperand<1>();
+    if (getIntConstantValue(AddRHS, Imm) && isInt<32>(Imm) &&
+        isInt<32>(Displacement + Imm)) {
+      // (base + imm) + offset
+      Base = AddLHS;
+      Displacement += Imm;
+    } else if (!Index && !isa<ConstantInstruction>(AddRHS)) {
+      // base + index, or base + (index << 1/2/3)
+      Base = AddLHS;
+      Index = AddRHS;
+      Scale = 1;
+      if (const MInstruction *Shl = getFoldableAddressExpr(Index, OP_shl);
+          Shl && getIntConstantValue(Shl->getOperand<1>(), Imm) && Imm >= 0 &&
+          Imm <= 3) {
+        Index = Shl->getOperand<0>();
+        Scale = 1u << Imm;
+      }
+    }
+  }
+
+  // base + scale * (index + imm)
+  if (const MInstruction *Add = getFoldableAddressExpr(Index, OP_add);
+      Add && getIntConstantValue(Add->getOperand<1>(), Imm) && isInt<32>(Imm) &&
+      isInt<32>(Displacement + Imm * Scale)) {
+    Index = Add->getOperand<0>();
+    Displacement += Imm * Scale;
+  }
+
+  X86AddressMode AM;
+  AM.BaseReg = lowerExpr(*Base);
+  AM.Scale = Scale;
+  if (Index) {
+    AM.IndexReg = lowerExpr(*Index);
+    if (Index->getType()->isI32()) {
+      // Try enabling the zero-extends below if a memory access error occurs
+
+      // IndexReg = fastEmitInst_r(X86::MOV32rr, &X86::GR32RegClass, IndexReg);
+      AM.IndexReg = fastEmitInst_subregtoreg(&X86::GR64RegClass, AM.IndexReg,
+                                             X86::sub_32bit);
+    }
+  }
+  AM.Displacement = static_cast<int32_t>(Displacement);
+  return AM;
+}
+
+void X86CgLowering::appendAddressOperands(SmallVectorImpl<CgOperand> &Operands,
+                                          const X86AddressMode &AM) {
+  Operands.push_back(CgOperand::createRegOperand(AM.BaseReg, false));
+  Operands.push_back(CgOperand::createImmOperand(AM.Scale));
+  Operands.push_back(CgOperand::createRegOperand(AM.IndexReg, false));
+  Operands.push_back(CgOperand::createImmOperand(AM.Displacement));
+  // Segment Register
+  Operands.push_back(CgOperand::createRegOperand(X86::NoRegister, false));
+}
+
 CgRegister X86CgLowering::lowerLoadExpr(const LoadInstruction &Inst) {
   unsigned Opcode =
       getMovMemToRegOpcode(Inst.getSrcType()->getKind(),
@@ -1058,30 +1358,11 @@ CgRegister X86CgLowering::lowerLoadExpr(const LoadInstruction &Inst) {
 
   llvm::MVT VT = getMVT(*Inst.getType());
   CgRegister ResultReg = createReg(TLI.getRegClassFor(VT));
-  CgRegister BaseReg = lowerExpr(*Inst.getBase());
-  uint32_t Scale = Inst.getScale();
-  const MInstruction *IndexExpr = Inst.getIndex();
-  CgRegister IndexReg = X86::NoRegister;
-  if (IndexExpr) {
-    IndexReg = lowerExpr(*IndexExpr);
-    if (IndexExpr->getType()->isI32()) {
-      // Try enabling the zero-extends below if a memory access error occurs
-
-      // IndexReg = fastEmitInst_r(X86::MOV32rr, &X86::GR32RegClass, IndexReg);
-      IndexReg = fastEmitInst_subregtoreg(&X86::GR64RegClass, IndexReg,
-                                          X86::sub_32bit);
-    }
-  }
-  int32_t Displacement = Inst.getOffset();
 
   SmallVector<CgOperand, 6> LoadOperands{
       CgOperand::createRegOperand(ResultReg, true),
-      CgOperand::createRegOperand(BaseReg, false),
-      CgOperand::createImmOperand(Scale),
-      CgOperand::createRegOperand(IndexReg, false),
-      CgOperand::createImmOperand(Displacement),
-      CgOperand::createRegOperand(X86::NoRegister, false), // Segment Register
   };
+  appendAddressOperands(LoadOperands, lowerAddressMode(Inst));
 
   MF->createCgInstruction(*CurBB, TII.get(Opcode), LoadOperands);
   return ResultReg;
@@ -1089,37 +1370,150 @@ CgRegister X86CgLowering::lowerLoadExpr(const LoadInstruction &Inst) {
 
 void X86CgLowering::lowerStoreStmt(const StoreInstruction &Instr) {
   const MInstruction *Value = Instr.getValue();
-  const MInstruction *Base = Instr.getBase();
 
   unsigned Opcode = getMovRegToMemOpcode(Value->getType()->getKind());
 
   CgRegister ValueReg = lowerExpr(*Value);
-  CgRegister BaseReg = lowerExpr(*Base);
-  uint32_t Scale = Instr.getScale();
-  const MInstruction *IndexExpr = Instr.getIndex();
-  CgRegister IndexReg = X86::NoRegister;
-  if (IndexExpr) {
-    IndexReg = lowerExpr(*IndexExpr);
-    if (IndexExpr->getType()->isI32()) {
-      // Try enabling the zero-extends below if a memory access error occurs
 
-      // IndexReg = fastEmitInst_r(X86::MOV32rr, &X86::GR32RegClass, IndexReg);
-      IndexReg = fastEmitInst_subregtoreg(&X86::GR64RegClass, IndexReg,
-                                          X86::sub_32bit);
+  SmallVector<CgOperand, 6> StoreOperands;
+  appendAddressOperands(StoreOperands, lowerAddressMode(Instr));
+  StoreOperands.push_back(CgOperand::createRegOperand(ValueReg, false));
+
+  MF->createCgInstruction(*CurBB, TII.get(Opcode), StoreOperands);
+}
+
+// ==================== Atomic Instructions ====================
+
+// xchg with a memory operand and the locked instructions are full barriers,
+// which keeps them sequentially consistent with the plain movs of atomic loads
+
+static inline unsigned getAtomicSizeIndex(MVT VT) {
+  switch (VT.SimpleTy) {
+  case MVT::i8:
+    return 0;
+  case MVT::i16:
+    return 1;
+  case MVT::i32:
+    return 2;
+  case MVT::i64:
+    return 3;
+  default:
+    ZEN_ASSERT_TODO();
+  }
+}
+
+static constexpr unsigned CMPXCHGOpcs[4] = {X86::LCMPXCHG8, X86::LCMPXCHG16,
+                                            X86::LCMPXCHG32, X86::LCMPXCHG64};
+// The implicit operand of cmpxchg
+static constexpr unsigned CMPXCHGAccRegs[4] = {X86::AL, X86::AX, X86::EAX,
+                                               X86::RAX};
+
+CgRegister
+X86CgLowering::lowerAtomicRMWExpr(const AtomicRMWInstruction &Inst) {
+  MVT VT = getMVT(*Inst.getType());
+  const TargetRegisterClass *RC = TLI.getRegClassFor(VT);
+  unsigned SizeIdx = getAtomicSizeIndex(VT);
+
+  CgRegister ValueReg = lowerExpr(*Inst.getValue());
+  X86AddressMode AM = lowerAddressMode(Inst);
+
+  static constexpr unsigned XCHGOpcs[4] = {X86::XCHG8rm, X86::XCHG16rm,
+                                           X86::XCHG32rm, X86::XCHG64rm};
+  static constexpr unsigned XADDOpcs[4] = {X86::LXADD8, X86::LXADD16,
+                                           X86::LXADD32, X86::LXADD64};
+  static constexpr unsigned NEGOpcs[4] = {X86::NEG8r, X86::NEG16r,
+                                          X86::NEG32r, X86::NEG64r};
+
+  unsigned ISDOpcode;
+  switch (Inst.getRMWOp()) {
+  case AtomicRMWInstruction::XCHG:
+  case AtomicRMWInstruction::ADD:
+  case AtomicRMWInstruction::SUB: {
+    unsigned Opcode = XCHGOpcs[SizeIdx];
+    if (Inst.getRMWOp() != AtomicRMWInstruction::XCHG) {
+      if (Inst.getRMWOp() == AtomicRMWInstruction::SUB) {
+        // old - value == old + (-value) in two's complement
+        ValueReg = fastEmitInst_r(NEGOpcs[SizeIdx], RC, ValueReg);
+      }
+      Opcode = XADDOpcs[SizeIdx];
     }
+    // xchg/lock xadd ResultReg(ValueReg), [mem]
+    CgRegister ResultReg = createReg(RC);
+    SmallVector<CgOperand, 7> Operands{
+        CgOperand::createRegOperand(ResultReg, true),
+        CgOperand::createRegOperand(ValueReg, false),
+    };
+    appendAddressOperands(Operands, AM);
+    MF->createCgInstruction(*CurBB, TII.get(Opcode), Operands);
+    return ResultReg;
+  }
+  case AtomicRMWInstruction::AND:
+    ISDOpcode = ISD::AND;
+    break;
+  case AtomicRMWInstruction::OR:
+    ISDOpcode = ISD::OR;
+    break;
+  case AtomicRMWInstruction::XOR:
+    ISDOpcode = ISD::XOR;
+    break;
+  default:
+    ZEN_ASSERT_TODO();
   }
-  int32_t Displacement = Instr.getOffset();
 
-  SmallVector<CgOperand, 6> StoreOperands = {
-      CgOperand::createRegOperand(BaseReg, false),
-      CgOperand::createImmOperand(Scale),
-      CgOperand::createRegOperand(IndexReg, false),
-      CgOperand::createImmOperand(Displacement),
-      CgOperand::createRegOperand(X86::NoRegister, false), // Segment Register
-      CgOperand::createRegOperand(ValueReg, false),
+  // No x86 instruction returns the old value of a bitwise rmw, retry lock
+  // cmpxchg until the memory is not modified between the load and the store
+  CgRegister OldReg = createReg(RC);
+  SmallVector<CgOperand, 6> LoadOperands{
+      CgOperand::createRegOperand(OldReg, true),
   };
+  appendAddressOperands(LoadOperands, AM);
+  static constexpr unsigned MOVOpcs[4] = {X86::MOV8rm, X86::MOV16rm,
+                                          X86::MOV32rm, X86::MOV64rm};
+  MF->createCgInstruction(*CurBB, TII.get(MOVOpcs[SizeIdx]), LoadOperands);
+
+  CgBasicBlock *LoopMBB = MF->createCgBasicBlock();
+  CurBB->addSuccessorWithoutProb(LoopMBB); // fallthrough
+  setInsertBlock(LoopMBB);
+
+  CgRegister NewReg = fastEmit_rr(VT, VT, ISDOpcode, OldReg, ValueReg);
+  unsigned AccReg = CMPXCHGAccRegs[SizeIdx];
+  MF->createCgInstruction(*CurBB, TII.get(TargetOpcode::COPY), OldReg,
+                          AccReg);
+  SmallVector<CgOperand, 6> CmpxchgOperands;
+  appendAddressOperands(CmpxchgOperands, AM);
+  CmpxchgOperands.push_back(CgOperand::createRegOperand(NewReg, false));
+  MF->createCgInstruction(*CurBB, TII.get(CMPXCHGOpcs[SizeIdx]),
+                          CmpxchgOperands);
+  // On failure the accumulator holds the current value of the memory
+  MF->createCgInstruction(*CurBB, TII.get(TargetOpcode::COPY), AccReg,
+                          OldReg);
+  fastEmitCondBranch(LoopMBB, X86::CondCode::COND_NE);
+  startNewBlockAfterBranch();
+  return OldReg;
+}
 
-  MF->createCgInstruction(*CurBB, TII.get(Opcode), StoreOperands);
+CgRegister
+X86CgLowering::lowerAtomicCmpxchgExpr(const AtomicCmpxchgInstruction &Inst) {
+  MVT VT = getMVT(*Inst.getType());
+  const TargetRegisterClass *RC = TLI.getRegClassFor(VT);
+  unsigned SizeIdx = getAtomicSizeIndex(VT);
+
+  CgRegister ExpectedReg = lowerExpr(*Inst.getExpected());
+  CgRegister ReplacementReg = lowerExpr(*Inst.getReplacement());
+  X86AddressMode AM = lowerAddressMode(Inst);
+
+  unsigned AccReg = CMPXCHGAccRegs[SizeIdx];
+  MF->createCgInstruction(*CurBB, TII.get(TargetOpcode::COPY), ExpectedReg,
+                          AccReg);
+  SmallVector<CgOperand, 6> Operands;
+  appendAddressOperands(Operands, AM);
+  Operands.push_back(CgOperand::createRegOperand(ReplacementReg, false));
+  MF->createCgInstruction(*CurBB, TII.get(CMPXCHGOpcs[SizeIdx]), Operands);
+
+  CgRegister ResultReg = createReg(RC);
+  MF->createCgInstruction(*CurBB, TII.get(TargetOpcode::COPY), AccReg,
+                          ResultReg);
+  return ResultReg;
 }
 
 // ==================== Control Statements ====================
@@ -1149,18 +1543,37 @@ void X86CgLowering::lowerBrStmt(const BrInstruction &Inst) {
   fastEmitBranch(TargetMBB);
 }
 
-// TODO: optimize if the condition is comparison
 void X86CgLowering::lowerBrIfStmt(const BrIfInstruction &Inst) {
   const MInstruction *Operand = Inst.getOperand<0>();
-  CgRegister OperandReg = lowerExpr(*Operand);
+  CgBasicBlock *TrueMBB = getOrCreateCgBB(Inst.getTrueBlock());
 
-  // Perform test instruction to determine the operand is zero or not
-  unsigned TESTOpc = Operand->getType()->isI8() ? X86::TEST8rr : X86::TEST32rr;
-  fastEmitNoDefInst_rr(TESTOpc, OperandReg, OperandReg);
+  // Branch on the flags of a single-use comparison directly(cmp + jcc)
+  // instead of materializing the boolean with setcc and testing it.
+  // FCMP_OEQ and FCMP_UNE cannot be checked with a single condition code.
+  const auto *CI = dyn_cast<CmpInstruction>(Operand);
+  if (CI && hasOneUse(*CI) && !_expr_reg_map.count(CI) &&
+      CI->getPredicate() != CmpInstruction::FCMP_OEQ &&
+      CI->getPredicate() != CmpInstruction::FCMP_UNE) {
+    const auto [CC, NeedSwap] = getX86ConditionCode(CI->getPredicate());
+    ZEN_ASSERT(CC <= X86::LAST_VALID_COND && "Unexpected condition code.");
+    const MInstruction *CmpLHS = CI->getOperand<0>();
+    const MInstruction *CmpRHS = CI->getOperand<1>();
+    if (NeedSwap) {
+      std::swap(CmpLHS, CmpRHS);
+    }
+    lowerFastCompareExpr(CmpLHS, CmpRHS, getMVT(*CmpLHS->getType()));
+    fastEmitCondBranch(TrueMBB, CC);
+  } else {
+    CgRegister OperandReg = lowerExpr(*Operand);
 
-  // Jump to the true basic block if the operand is not zero
-  CgBasicBlock *TrueMBB = getOrCreateCgBB(Inst.getTrueBlock());
-  fastEmitCondBranch(TrueMBB, X86::CondCode::COND_NE);
+    // Perform test instruction to determine the operand is zero or not
+    unsigned TESTOpc =
+        Operand->getType()->isI8() ? X86::TEST8rr : X86::TEST32rr;
+    fastEmitNoDefInst_rr(TESTOpc, OperandReg, OperandReg);
+
+    // Jump to the true basic block if the operand is not zero
+    fastEmitCondBranch(TrueMBB, X86::CondCode::COND_NE);
+  }
 
   if (Inst.hasFalseBlock()) {
     // Jump to the false basic block if the operand is zero
@@ -1171,115 +1584,218 @@ void X86CgLowering::lowerBrIfStmt(const BrIfInstruction &Inst) {
   }
 }
 
-static unsigned getADDriOpcode(bool IsLP64, int64_t Imm) {
-  if (IsLP64) {
-    if (isInt<8>(Imm))
-      return X86::ADD64ri8;
-    return X86::ADD64ri32;
+// Sign-extended immediate of the case value of type VT
+static int64_t getCaseImm(MVT VT, uint64_t Value) {
+  return VT == MVT::i64 ? static_cast<int64_t>(Value)
+                        : static_cast<int64_t>(static_cast<int32_t>(Value));
+}
+
+void X86CgLowering::emitCaseCompare(CgRegister Reg, MVT VT, uint64_t Value) {
+  int64_t Imm = getCaseImm(VT, Value);
+  if (unsigned CmpImmOpc = X86ChooseCmpImmediateOpcode(VT, Imm)) {
+    fastEmitNoDefInst_ri(CmpImmOpc, Reg, Imm);
   } else {
-    if (isInt<8>(Imm))
-      return X86::ADD32ri8;
-    return X86::ADD32ri;
+    fastEmitNoDefInst_rr(X86ChooseCmpOpcode(VT), Reg,
+                         X86MaterializeInt(Value, VT));
+  }
+}
+
+CgRegister X86CgLowering::emitCaseSub(CgRegister Reg, MVT VT, uint64_t Value) {
+  if (Value == 0) {
+    return Reg;
+  }
+  const TargetRegisterClass *RC = TLI.getRegClassFor(VT);
+  int64_t Imm = getCaseImm(VT, Value);
+  if (VT == MVT::i32) {
+    return fastEmitInst_ri(isInt<8>(Imm) ? X86::SUB32ri8 : X86::SUB32ri, RC,
+                           Reg, Imm);
+  }
+  if (isInt<32>(Imm)) {
+    return fastEmitInst_ri(isInt<8>(Imm) ? X86::SUB64ri8 : X86::SUB64ri32, RC,
+                           Reg, Imm);
   }
+  return fastEmitInst_rr(X86::SUB64rr, RC, Reg, X86MaterializeInt(Value, VT));
 }
 
 void X86CgLowering::lowerSwitchStmt(const SwitchInstruction &Inst) {
-  uint32_t NumCases = Inst.getNumCases();
   const MBasicBlock *DefaultBB = Inst.getDefaultBlock();
   CgBasicBlock *DefaultMBB = getOrCreateCgBB(DefaultBB);
 
-  bool AllTargetsSame = true;
-  for (uint32_t I = 0; I < NumCases; I++) {
-    if (Inst.getCaseBlock(I) != DefaultBB) {
-      AllTargetsSame = false;
-      break;
-    }
-  }
-  if (AllTargetsSame) {
+  CompileMemPool &MemPool = MF->getContext().MemPool;
+  CompileVector<CaseRange> Ranges(MemPool);
+  buildCaseRanges(Inst, DefaultMBB, Ranges);
+  if (Ranges.empty()) {
+    // All targets are the default block
     fastEmitBranch(DefaultMBB);
     return;
   }
 
-  ZEN_ASSERT(NumCases > 0 && "NumCases should be greater than 0");
-
-  CompileVector<int64_t> CaseImmList(MF->getContext().MemPool);
-  CompileVector<CgBasicBlock *> CaseMBBList(MF->getContext().MemPool);
-  for (uint32_t I = 0; I < NumCases; I++) {
-    const ConstantInstruction *CaseValue = Inst.getCaseValue(I);
-    const APInt &CaseInt =
-        llvm::cast<MConstantInt>(CaseValue->getConstant()).getValue();
-    CaseImmList.push_back(CaseInt.getSExtValue());
-    CgBasicBlock *CaseMBB = getOrCreateCgBB(Inst.getCaseBlock(I));
-    CaseMBBList.push_back(CaseMBB);
-  }
+  CompileVector<CaseCluster> Clusters(MemPool);
+  clusterCaseRanges(Ranges, Clusters, MemPool);
 
   const MInstruction *Operand = Inst.getOperand<0>();
   MVT VT = getMVT(*Operand->getType());
-  CgRegister OperandReg = lowerExpr(*Operand);
+  ZEN_ASSERT(VT == MVT::i32 || VT == MVT::i64);
+  SwitchCases SC{lowerExpr(*Operand), VT, DefaultMBB, Ranges, Clusters};
+  uint64_t MaxValue = VT == MVT::i64 ? UINT64_MAX : UINT32_MAX;
+  lowerCaseClusters(SC, 0, Clusters.size() - 1, 0, MaxValue);
+}
 
-  if (isJumpTableSuitable(CaseImmList)) {
-    const TargetRegisterClass *RC = TLI.getRegClassFor(VT);
-    CgRegister CaseReg = OperandReg;
-    if (CaseImmList[0] != 0) {
-      unsigned ADDriOpc = getADDriOpcode(VT == MVT::i64, -CaseImmList[0]);
-      CaseReg = fastEmitInst_ri(ADDriOpc, RC, CaseReg, -CaseImmList[0]);
-    }
-    ZEN_ASSERT(NumCases >= 1);
-    fastEmitNoDefInst_ri(X86::CMP32ri, CaseReg, NumCases - 1);
-    fastEmitCondBranch(DefaultMBB, X86::CondCode::COND_A);
+/// Lower clusters [First, Last] by a balanced binary search, the case value
+/// is known to be in [LowBound, HighBound].
+void X86CgLowering::lowerCaseClusters(const SwitchCases &SC, uint32_t First,
+                                      uint32_t Last, uint64_t LowBound,
+                                      uint64_t HighBound) {
+  if (First == Last) {
+    lowerCaseCluster(SC, SC.Clusters[First], LowBound, HighBound);
+    return;
+  }
 
-    startNewBlockAfterBranch();
+  uint32_t Mid = First + (Last - First + 1) / 2;
+  uint64_t Pivot = SC.Ranges[SC.Clusters[Mid].First].Low;
+  CgBasicBlock *LeftMBB = MF->createCgBasicBlock();
+  emitCaseCompare(SC.OperandReg, SC.VT, Pivot);
+  fastEmitCondBranch(LeftMBB, X86::CondCode::COND_B);
 
-    CgRegister LEAResultReg = createReg(&X86::GR64RegClass);
-    uint32_t JTI = MF->createJumpTableIndex(CaseMBBList);
-    SmallVector<CgOperand, 6> LEAOperands{
-        CgOperand::createRegOperand(LEAResultReg, true),
-        CgOperand::createRegOperand(X86::RIP, false),        // Base Register
-        CgOperand::createImmOperand(0),                      // Scale
-        CgOperand::createRegOperand(X86::NoRegister, false), // Index Register
-        CgOperand::createJTI(JTI), // Offset(Jump Table Index)
-        CgOperand::createRegOperand(X86::NoRegister, false), // Segment Register
-    };
-    MF->createCgInstruction(*CurBB, TII.get(X86::LEA64r), LEAOperands);
+  startNewBlockAfterBranch();
+  lowerCaseClusters(SC, Mid, Last, Pivot, HighBound);
 
-    CgRegister IndexReg = CaseReg;
-    if (VT == MVT::i32) {
-      IndexReg = fastEmitInst_subregtoreg(&X86::GR64RegClass, IndexReg,
-                                          X86::sub_32bit);
+  setInsertBlock(LeftMBB);
+  lowerCaseClusters(SC, First, Mid - 1, LowBound, Pivot - 1);
+}
+
+void X86CgLowering::lowerCaseCluster(const SwitchCases &SC,
+                                     const CaseCluster &Cluster,
+                                     uint64_t LowBound, uint64_t HighBound) {
+  const CaseRange &FirstRange = SC.Ranges[Cluster.First];
+  const CaseRange &LastRange = SC.Ranges[Cluster.Last];
+  uint64_t Low = FirstRange.Low;
+  uint64_t High = LastRange.High;
+
+  if (Cluster.Kind == CaseCluster::CC_Range) {
+    CgBasicBlock *CaseMBB = FirstRange.MBB;
+    if (Low <= LowBound && High >= HighBound) {
+      fastEmitBranch(CaseMBB);
+      return;
     }
-    CgRegister LoadResultReg = createReg(&X86::GR64RegClass);
-    SmallVector<CgOperand, 6> LoadOperands{
-        CgOperand::createRegOperand(LoadResultReg, true),
-        CgOperand::createRegOperand(LEAResultReg, false),    // Base Register
-        CgOperand::createImmOperand(4),                      // Scale: Rel32
-        CgOperand::createRegOperand(IndexReg, false),        // Index Register
-        CgOperand::createImmOperand(0),                      // Offset
-        CgOperand::createRegOperand(X86::NoRegister, false), // Segment Register
-    };
-    MF->createCgInstruction(*CurBB, TII.get(X86::MOVSX64rm32), LoadOperands);
+    if (Low == High) {
+      emitCaseCompare(SC.OperandReg, SC.VT, Low);
+      fastEmitCondBranch(CaseMBB, X86::CondCode::COND_E);
+    } else if (Low <= LowBound) {
+      emitCaseCompare(SC.OperandReg, SC.VT, High);
+      fastEmitCondBranch(CaseMBB, X86::CondCode::COND_BE);
+    } else if (High >= HighBound) {
+      emitCaseCompare(SC.OperandReg, SC.VT, Low);
+      fastEmitCondBranch(CaseMBB, X86::CondCode::COND_AE);
+    } else {
+      CgRegister CaseReg = emitCaseSub(SC.OperandReg, SC.VT, Low);
+      emitCaseCompare(CaseReg, SC.VT, High - Low);
+      fastEmitCondBranch(CaseMBB, X86::CondCode::COND_BE);
+    }
+    fastEmitBranch(SC.DefaultMBB);
+    return;
+  }
 
-    CgRegister JumpTargetReg = fastEmitInst_rr(X86::ADD64rr, &X86::GR64RegClass,
-                                               LoadResultReg, LEAResultReg);
+  // Small values are tested directly to save the subtraction
+  if (Cluster.Kind == CaseCluster::CC_BitTests && High < MaxBitTestRange) {
+    Low = 0;
+  }
+  CgRegister CaseReg = emitCaseSub(SC.OperandReg, SC.VT, Low);
+  if (Low > LowBound || High < HighBound) {
+    emitCaseCompare(CaseReg, SC.VT, High - Low);
+    fastEmitCondBranch(SC.DefaultMBB, X86::CondCode::COND_A);
+    startNewBlockAfterBranch();
+  }
+  CgRegister IndexReg = CaseReg;
+  if (SC.VT == MVT::i32) {
+    IndexReg =
+        fastEmitInst_subregtoreg(&X86::GR64RegClass, IndexReg, X86::sub_32bit);
+  }
 
-    SmallVector<CgOperand, 2> JumpOperands{
-        CgOperand::createRegOperand(JumpTargetReg, false),
-    };
-    MF->createCgInstruction(*CurBB, TII.get(X86::JMP64r), JumpOperands);
-    for (CgBasicBlock *CaseMBB : CaseMBBList) {
-      CurBB->addSuccessorWithoutProb(CaseMBB);
+  if (Cluster.Kind == CaseCluster::CC_BitTests) {
+    // One "bt mask, index; jb target" per target in the order of first use
+    uint64_t CoveredMask = 0;
+    for (uint32_t I = Cluster.First; I <= Cluster.Last; ++I) {
+      CgBasicBlock *CaseMBB = SC.Ranges[I].MBB;
+      bool Seen = false;
+      for (uint32_t J = Cluster.First; J < I; ++J) {
+        Seen |= SC.Ranges[J].MBB == CaseMBB;
+      }
+      if (Seen) {
+        continue;
+      }
+      uint64_t Mask = 0;
+      for (uint32_t J = I; J <= Cluster.Last; ++J) {
+        const CaseRange &Range = SC.Ranges[J];
+        if (Range.MBB != CaseMBB) {
+          continue;
+        }
+        uint64_t NumBits = Range.High - Range.Low + 1;
+        uint64_t Bits = NumBits == 64 ? UINT64_MAX : (1ULL << NumBits) - 1;
+        Mask |= Bits << (Range.Low - Low);
+      }
+      CoveredMask |= Mask;
+      uint64_t NumValues = High - Low + 1;
+      bool CoversAll = CoveredMask == (NumValues == 64
+                                           ? UINT64_MAX
+                                           : (1ULL << NumValues) - 1);
+      if (CoversAll) {
+        // The remaining values all go to this target
+        fastEmitBranch(CaseMBB);
+        return;
+      }
+      CgRegister MaskReg = X86MaterializeInt(Mask, MVT::i64);
+      fastEmitNoDefInst_rr(X86::BT64rr, MaskReg, IndexReg);
+      fastEmitCondBranch(CaseMBB, X86::CondCode::COND_B);
+      startNewBlockAfterBranch();
     }
+    fastEmitBranch(SC.DefaultMBB);
     return;
   }
 
-  // Use naive compare and jump pattern
-  for (uint32_t I = 0; I < NumCases; ++I) {
-    fastEmitNoDefInst_ri(X86::CMP32ri, OperandReg, CaseImmList[I]);
-    fastEmitCondBranch(CaseMBBList[I], X86::CondCode::COND_E);
+  ZEN_ASSERT(Cluster.Kind == CaseCluster::CC_JumpTable);
+  CompileVector<CgBasicBlock *> TableMBBs(High - Low + 1, SC.DefaultMBB,
+                                          MF->getContext().MemPool);
+  for (uint32_t I = Cluster.First; I <= Cluster.Last; ++I) {
+    const CaseRange &Range = SC.Ranges[I];
+    for (uint64_t Value = Range.Low; Value <= Range.High; ++Value) {
+      TableMBBs[Value - Low] = Range.MBB;
+    }
+  }
+
+  CgRegister LEAResultReg = createReg(&X86::GR64RegClass);
+  uint32_t JTI = MF->createJumpTableIndex(TableMBBs);
+  SmallVector<CgOperand, 6> LEAOperands{
+      CgOperand::createRegOperand(LEAResultReg, true),
+      CgOperand::createRegOperand(X86::RIP, false),        // Base Register
+      CgOperand::createImmOperand(0),                      // Scale
+      CgOperand::createRegOperand(X86::NoRegister, false), // Index Register
+      CgOperand::createJTI(JTI), // Offset(Jump Table Index)
+      CgOperand::createRegOperand(X86::NoRegister, false), // Segment Register
+  };
+  MF->createCgInstruction(*CurBB, TII.get(X86::LEA64r), LEAOperands);
 
-    if (I == NumCases - 1) {
-      fastEmitBranch(DefaultMBB);
-    } else {
-      startNewBlockAfterBranch();
+  CgRegister LoadResultReg = createReg(&X86::GR64RegClass);
+  SmallVector<CgOperand, 6> LoadOperands{
+      CgOperand::createRegOperand(LoadResultReg, true),
+      CgOperand::createRegOperand(LEAResultReg, false),    // Base Register
+      CgOperand::createImmOperand(4),                      // Scale: Rel32
+      CgOperand::createRegOperand(IndexReg, false),        // Index Register
+      CgOperand::createImmOperand(0),                      // Offset
+      CgOperand::createRegOperand(X86::NoRegister, false), // Segment Register
+  };
+  MF->createCgInstruction(*CurBB, TII.get(X86::MOVSX64rm32), LoadOperands);
+
+  CgRegister JumpTargetReg = fastEmitInst_rr(X86::ADD64rr, &X86::GR64RegClass,
+                                             LoadResultReg, LEAResultReg);
+
+  SmallVector<CgOperand, 2> JumpOperands{
+      CgOperand::createRegOperand(JumpTargetReg, false),
+  };
+  MF->createCgInstruction(*CurBB, TII.get(X86::JMP64r), JumpOperands);
+  for (CgBasicBlock *CaseMBB : TableMBBs) {
+    if (!CurBB->isSuccessor(CaseMBB)) {
+      CurBB->addSuccessorWithoutProb(CaseMBB);
     }
   }
 }
@@ -37,6 +37,9 @@ public:
   CgRegister lowerWasmOverflowBinaryExpr(const MInstruction &LHS,
                                          const MInstruction &RHS,
                                          const MType &Type, Opcode MOpc);
+  CgRegister lowerBinaryExprWithLoad(const MInstruction &LHS,
+                                     const MInstruction &RHS, llvm::MVT VT,
+                                     unsigned ISDOpcode, bool IsCommutative);
 
   // ==================== Conversion Expressions ====================
 
@@ -73,6 +76,11 @@ public:
   CgRegister lowerLoadExpr(const LoadInstruction &Inst);
   void lowerStoreStmt(const StoreInstruction &Inst);
 
+  // ==================== Atomic Instructions ====================
+
+  CgRegister lowerAtomicRMWExpr(const AtomicRMWInstruction &Inst);
+  CgRegister lowerAtomicCmpxchgExpr(const AtomicCmpxchgInstruction &Inst);
+
   // ==================== Control Statements ====================
 
   void lowerBrStmt(const BrInstruction &Inst);
@@ -100,9 +108,44 @@ public:
 private:
   // ==================== X86CgLowering Utilities ====================
 
+  // base + scale * index + displacement
+  struct X86AddressMode {
+    CgRegister BaseReg = X86::NoRegister;
+    uint32_t Scale = 1;
+    CgRegister IndexReg = X86::NoRegister;
+    int32_t Displacement = 0;
+  };
+
+  // Count how many times each expression is referred to by the statements
+  // and expressions of the function, shared expressions are lowered once
+  void countExprUses(const MInstruction &Inst);
+  bool hasOneUse(const MInstruction &Inst) const;
+  // Whether Inst can be lowered ahead of an expression evaluated before it
+  // without reordering memory accesses or calls
+  bool canLowerEarly(const MInstruction &Inst) const;
+  // Return Inst if it is a load which can be folded as the memory operand
+  // of an instruction operating on VT, otherwise return nullptr
+  const LoadInstruction *getFoldableLoad(const MInstruction &Inst,
+                                         MVT VT) const;
+  // Return Inst if it is a 64-bit expression with the opcode MOpc whose
+  // computation can be folded into an address, otherwise return nullptr
+  const MInstruction *getFoldableAddressExpr(const MInstruction *Inst,
+                                             Opcode MOpc) const;
+
+  X86AddressMode lowerAddressMode(const MInstruction *Base, uint32_t Scale,
+                                  const MInstruction *Index, int32_t Offset);
+  template <typename T> X86AddressMode lowerAddressMode(const T &Inst) {
+    return lowerAddressMode(Inst.getBase(), Inst.getScale(), Inst.getIndex(),
+                            Inst.getOffset());
+  }
+  static void appendAddressOperands(SmallVectorImpl<CgOperand> &Operands,
+                                    const X86AddressMode &AM);
+
   static unsigned X86ChooseCmpImmediateOpcode(MVT VT, int64_t Val);
   static unsigned X86ChooseCmpImmediateOpcode(MVT VT, const APInt &Value);
   static unsigned X86ChooseCmpOpcode(MVT VT);
+  static unsigned X86ChooseCmpMemImmediateOpcode(MVT VT, int64_t Val);
+  static unsigned X86ChooseCmpMemOpcode(MVT VT, bool MemIsLHS);
 
   void lowerFastCompareExpr(const MInstruction *LHS, const MInstruction *RHS,
                             MVT VT);
@@ -112,6 +155,22 @@ private:
   CgRegister X86MaterializeFP(const MConstantFloat &FloatConstant, MVT VT);
   CgRegister fastMaterializeFloatZero(MVT VT);
 
+  // State of lowering the case clusters of a switch
+  struct SwitchCases {
+    CgRegister OperandReg;
+    MVT VT;
+    CgBasicBlock *DefaultMBB;
+    const CompileVector<CaseRange> &Ranges;
+    const CompileVector<CaseCluster> &Clusters;
+  };
+  void lowerCaseClusters(const SwitchCases &SC, uint32_t First, uint32_t Last,
+                         uint64_t LowBound, uint64_t HighBound);
+  void lowerCaseCluster(const SwitchCases &SC, const CaseCluster &Cluster,
+                        uint64_t LowBound, uint64_t HighBound);
+  // Compare Reg with the case value as unsigned integers
+  void emitCaseCompare(CgRegister Reg, MVT VT, uint64_t Value);
+  CgRegister emitCaseSub(CgRegister Reg, MVT VT, uint64_t Value);
+
   // Emit an unconditional branch to TargetBB
   void fastEmitBranch(CgBasicBlock *TargetBB);
   // Emit a conditional branch to TargetBB
@@ -119,6 +178,7 @@ private:
 
   const X86Subtarget *Subtarget;
   const TargetRegisterInfo *TRI;
+  CompileUnorderedMap<const MInstruction *, uint32_t> ExprUseCounts;
 };
 
 } // namespace COMPILER
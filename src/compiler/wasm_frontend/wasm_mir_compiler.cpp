@@ -11,11 +11,13 @@ namespace COMPILER {
 
 WasmFrontendContext::WasmFrontendContext(runtime::Module &WasmMod)
     : UseSoftMemCheck(WasmMod.checkUseSoftLinearMemoryCheck()),
+      UseIndirectCallCache(WasmMod.checkUseIndirectCallCache()),
       WasmMod(WasmMod) {}
 
 WasmFrontendContext::WasmFrontendContext(const WasmFrontendContext &OtherCtx)
     : CompileContext(OtherCtx),
       UseSoftMemCheck(OtherCtx.WasmMod.checkUseSoftLinearMemoryCheck()),
+      UseIndirectCallCache(OtherCtx.UseIndirectCallCache),
       WasmMod(OtherCtx.WasmMod) {}
 
 MType *WasmFrontendContext::getMIRTypeFromWASMType(WASMType Type) {
@@ -550,6 +552,19 @@ FunctionMirBuilder::Operand FunctionMirBuilder::handleCall(
   }
 }
 
+void FunctionMirBuilder::handleReturnCall(uint32_t FuncIdx, uintptr_t Target,
+                                          bool IsImport, bool FarCall,
+                                          const ArgumentInfo &ArgInfo,
+                                          const std::vector<Operand> &Args) {
+  ZEN_UNREACHABLE();
+}
+
+void FunctionMirBuilder::handleReturnCallIndirect(
+    uint32_t TypeIdx, Operand IndirectFuncIdx, uint32_t TblIdx,
+    const ArgumentInfo &ArgInfo, const std::vector<Operand> &Args) {
+  ZEN_UNREACHABLE();
+}
+
 FunctionMirBuilder::Operand FunctionMirBuilder::handleCallIndirect(
     uint32_t TypeIdx, Operand IndirectFuncIdxOp, uint32_t TblIdx,
     const ArgumentInfo &ArgInfo, const std::vector<Operand> &Args) {
@@ -558,6 +573,41 @@ FunctionMirBuilder::Operand FunctionMirBuilder::handleCallIndirect(
   MInstruction *ResuableIndirectFuncIdx =
       makeReusableValue(IndirectFuncIdx, &Ctx.I32Type);
 
+  // The cache is referenced by its absolute address, every access needs its
+  // own address instruction
+  IndirectCallCache *Cache = nullptr;
+  auto GetCacheFieldPtr = [&](MType *FieldType) {
+    MPointerType *FieldPtrType = MPointerType::create(Ctx, *FieldType);
+    return createInstruction<ConversionInstruction>(
+        false, OP_inttoptr, FieldPtrType,
+        createIntConstInstruction(&Ctx.I64Type, uintptr_t(Cache)));
+  };
+  MInstruction *ReusableExtIndirectFuncIdx = nullptr;
+  MBasicBlock *CacheHitBB = nullptr;
+  if (Ctx.UseIndirectCallCache) {
+    Cache = Ctx.getWasmMod().newIndirectCallCache();
+
+    /**
+     *  $ext_indirect_func_idx = uext ($indirect_func_idx)
+     *  br_if cmp ieq ($ext_indirect_func_idx, load (cache.table_idx)),
+     *        @cache_hit
+     */
+
+    ReusableExtIndirectFuncIdx = makeReusableValue(
+        createInstruction<ConversionInstruction>(
+            false, OP_uext, &Ctx.I64Type, ResuableIndirectFuncIdx),
+        &Ctx.I64Type);
+    MInstruction *CachedTableIdx = createInstruction<LoadInstruction>(
+        false, &Ctx.I64Type, GetCacheFieldPtr(&Ctx.I64Type), 1, nullptr,
+        offsetof(IndirectCallCache, TableIdx));
+    MInstruction *IsCacheHit = createInstruction<CmpInstruction>(
+        false, CmpInstruction::ICMP_EQ, &Ctx.I8Type,
+        ReusableExtIndirectFuncIdx, CachedTableIdx);
+    CacheHitBB = createBasicBlock();
+    createInstruction<BrIfInstruction>(true, Ctx, IsCacheHit, CacheHitBB);
+    addSuccessor(CacheHitBB);
+  }
+
   /**
    *  br_if cmp iuge ($indirect_func_idx, table_size), @undefined_element
    */
@@ -626,6 +676,57 @@ FunctionMirBuilder::Operand FunctionMirBuilder::handleCallIndirect(
                                      IndirectCallTypeMismatchBB);
   addUniqueSuccessor(IndirectCallTypeMismatchBB);
 
+  if (CacheHitBB) {
+    /**
+     *  $num_misses = load (cache.num_misses)
+     *  br_if cmp iuge ($num_misses, max_misses), @cache_hit
+     *  store (cache.num_misses, $num_misses + 1)
+     *  store (cache.table_idx, $ext_indirect_func_idx)
+     *  br @cache_hit
+     * @cache_hit:
+     *  $func_idx = load (
+     *    base = instance,
+     *    scale = 4,
+     *    index = $indirect_func_idx,
+     *    offset = TableElemBaseOffset
+     *  )
+     *
+     * The checked index is published with a single aligned store, racing
+     * threads only ever see indexes checked for this site, the lost updates
+     * of the miss counter don't matter
+     */
+
+    MInstruction *ReusableNumMisses = makeReusableValue(
+        createInstruction<LoadInstruction>(
+            false, &Ctx.I32Type, GetCacheFieldPtr(&Ctx.I32Type), 1, nullptr,
+            offsetof(IndirectCallCache, NumMisses)),
+        &Ctx.I32Type);
+    MInstruction *IsMegamorphic = createInstruction<CmpInstruction>(
+        false, CmpInstruction::ICMP_UGE, &Ctx.I8Type, ReusableNumMisses,
+        createIntConstInstruction(&Ctx.I32Type, IndirectCallCache::MaxMisses));
+    createInstruction<BrIfInstruction>(true, Ctx, IsMegamorphic, CacheHitBB);
+    addUniqueSuccessor(CacheHitBB);
+
+    MInstruction *NewNumMisses = createInstruction<BinaryInstruction>(
+        false, OP_add, &Ctx.I32Type, ReusableNumMisses,
+        createIntConstInstruction(&Ctx.I32Type, 1));
+    createInstruction<StoreInstruction>(
+        true, &Ctx.VoidType, NewNumMisses, GetCacheFieldPtr(&Ctx.I32Type),
+        offsetof(IndirectCallCache, NumMisses));
+    createInstruction<StoreInstruction>(
+        true, &Ctx.VoidType, ReusableExtIndirectFuncIdx,
+        GetCacheFieldPtr(&Ctx.I64Type), offsetof(IndirectCallCache, TableIdx));
+    createInstruction<BrInstruction>(true, Ctx, CacheHitBB);
+    addUniqueSuccessor(CacheHitBB);
+
+    setInsertBlock(CacheHitBB);
+    ReusableFuncIdx = makeReusableValue(
+        getInstanceElement(&Ctx.I32Type, sizeof(uint32_t),
+                           ResuableIndirectFuncIdx,
+                           Ctx.getWasmMod().getLayout().TableElemBaseOffset),
+        &Ctx.I32Type);
+  }
+
   /**
    *  $func_addr = load (
    *    base = instance,
@@ -755,6 +856,224 @@ FunctionMirBuilder::Operand FunctionMirBuilder::handleMemoryGrow(Operand Opnd) {
   return Operand(PrevNumPages, WASMType::I32);
 }
 
+#ifndef ZEN_ENABLE_SGX
+FunctionMirBuilder::Operand
+FunctionMirBuilder::handleAtomic(uint32_t AtomicOpcode, Operand Base,
+                                 uint32_t Offset, Operand Arg1, Operand Arg2) {
+  using runtime::AtomicOpKind;
+  if (AtomicOpcode < common::I32_ATOMIC_LOAD) {
+    return handleAtomicWaitNotify(AtomicOpcode, Base, Offset, Arg1, Arg2);
+  }
+
+  AtomicOpKind Kind = runtime::getAtomicOpKind(AtomicOpcode);
+  if (Kind == AtomicOpKind::Load) {
+    return handleAtomicLoad(AtomicOpcode, Base, Offset);
+  }
+
+  uint32_t Size = runtime::getAtomicAccessSize(AtomicOpcode);
+  WASMType DestType =
+      runtime::isAtomicOp64(AtomicOpcode) ? WASMType::I64 : WASMType::I32;
+  MType *DestMTy = Ctx.getMIRTypeFromWASMType(DestType);
+  MType *MemMTy = getAtomicMemoryType(Size);
+
+  // The value operands are wrapped to the accessed width
+  auto WrapArg = [&](Operand Arg) -> MInstruction * {
+    MInstruction *ArgInst = extractOperand(Arg);
+    if (MemMTy != DestMTy) {
+      ArgInst = createInstruction<ConversionInstruction>(false, OP_trunc,
+                                                         MemMTy, ArgInst);
+    }
+    return ArgInst;
+  };
+
+  MInstruction *BaseInst =
+      checkAtomicAlignment(extractOperand(Base), Offset, Size);
+  MInstruction *Arg1Inst = WrapArg(Arg1);
+  MInstruction *Arg2Inst =
+      Kind == AtomicOpKind::Cmpxchg ? WrapArg(Arg2) : nullptr;
+  const auto [MemoryBase, MemoryIndex, MemoryOffset] =
+      getMemoryLocation(BaseInst, Offset, MemMTy);
+
+  if (Kind == AtomicOpKind::Store) {
+    createInstruction<AtomicRMWInstruction>(
+        true, AtomicRMWInstruction::XCHG, MemMTy, Arg1Inst, MemoryBase, 1,
+        MemoryIndex, MemoryOffset);
+    return Operand();
+  }
+
+  MInstruction *OldValue = nullptr;
+  if (Kind == AtomicOpKind::Cmpxchg) {
+    OldValue = createInstruction<AtomicCmpxchgInstruction>(
+        false, MemMTy, Arg1Inst, Arg2Inst, MemoryBase, 1, MemoryIndex,
+        MemoryOffset);
+  } else {
+    AtomicRMWInstruction::RMWOp Op;
+    switch (Kind) {
+    case AtomicOpKind::Add:
+      Op = AtomicRMWInstruction::ADD;
+      break;
+    case AtomicOpKind::Sub:
+      Op = AtomicRMWInstruction::SUB;
+      break;
+    case AtomicOpKind::And:
+      Op = AtomicRMWInstruction::AND;
+      break;
+    case AtomicOpKind::Or:
+      Op = AtomicRMWInstruction::OR;
+      break;
+    case AtomicOpKind::Xor:
+      Op = AtomicRMWInstruction::XOR;
+      break;
+    default:
+      ZEN_ASSERT(Kind == AtomicOpKind::Xchg);
+      Op = AtomicRMWInstruction::XCHG;
+      break;
+    }
+    OldValue = createInstruction<AtomicRMWInstruction>(
+        false, Op, MemMTy, Arg1Inst, MemoryBase, 1, MemoryIndex, MemoryOffset);
+  }
+  if (MemMTy != DestMTy) {
+    OldValue = createInstruction<ConversionInstruction>(false, OP_uext,
+                                                        DestMTy, OldValue);
+  }
+
+  // Assign the old value to a variable like call results, so the access is
+  // performed here rather than where the value is used
+  Variable *ResultVar = CurFunc->createVariable(DestMTy);
+  createInstruction<DassignInstruction>(true, &(Ctx.VoidType), OldValue,
+                                        ResultVar->getVarIdx());
+  MInstruction *Result = createInstruction<DreadInstruction>(
+      false, DestMTy, ResultVar->getVarIdx());
+  return Operand(Result, DestType);
+}
+
+FunctionMirBuilder::Operand FunctionMirBuilder::handleAtomicWaitNotify(
+    uint32_t AtomicOpcode, Operand Base, uint32_t Offset, Operand Arg1,
+    Operand Arg2) {
+  // The value operands are passed as i64, zero extended from i32
+  auto ExtendArg = [&](Operand Arg) -> MInstruction * {
+    if (Arg.getType() == WASMType::VOID) {
+      return createIntConstInstruction(&Ctx.I64Type, 0);
+    }
+    if (Arg.getType() == WASMType::I32) {
+      return createInstruction<ConversionInstruction>(
+          false, OP_uext, &Ctx.I64Type, extractOperand(Arg));
+    }
+    return extractOperand(Arg);
+  };
+
+  MInstruction *BaseInst = extractOperand(Base);
+  MInstruction *Arg1Inst = ExtendArg(Arg1);
+  MInstruction *Arg2Inst = ExtendArg(Arg2);
+  CompileVector<MInstruction *> AtomicArgs{
+      {
+          InstanceAddr,
+          createIntConstInstruction(&Ctx.I32Type, AtomicOpcode),
+          BaseInst,
+          createIntConstInstruction(&Ctx.I32Type, Offset),
+          Arg1Inst,
+          Arg2Inst,
+      },
+      Ctx.MemPool,
+  };
+  MInstruction *AtomicAddr = createIntConstInstruction(
+      &Ctx.I64Type, uint64_t(Instance::atomicOnJIT));
+  MInstruction *AtomicResult = createInstruction<ICallInstruction>(
+      false, &Ctx.I64Type, AtomicAddr, AtomicArgs);
+
+  Variable *ResultVar = CurFunc->createVariable(&Ctx.I64Type);
+  createInstruction<DassignInstruction>(true, &(Ctx.VoidType), AtomicResult,
+                                        ResultVar->getVarIdx());
+  // Traps(out of bounds, unaligned, etc.) are set on the instance
+  checkCallException(true);
+
+  MInstruction *Result = createInstruction<DreadInstruction>(
+      false, &Ctx.I64Type, ResultVar->getVarIdx());
+  Result = createInstruction<ConversionInstruction>(false, OP_trunc,
+                                                    &Ctx.I32Type, Result);
+  return Operand(Result, WASMType::I32);
+}
+
+FunctionMirBuilder::Operand
+FunctionMirBuilder::handleAtomicLoad(uint32_t AtomicOpcode, Operand Base,
+                                     uint32_t Offset) {
+  uint32_t Size = runtime::getAtomicAccessSize(AtomicOpcode);
+  WASMType DestType =
+      runtime::isAtomicOp64(AtomicOpcode) ? WASMType::I64 : WASMType::I32;
+  MType *DestMTy = Ctx.getMIRTypeFromWASMType(DestType);
+  MType *SrcMTy = getAtomicMemoryType(Size);
+
+  MInstruction *BaseInst =
+      checkAtomicAlignment(extractOperand(Base), Offset, Size);
+  const auto [MemoryBase, MemoryIndex, MemoryOffset] =
+      getMemoryLocation(BaseInst, Offset, SrcMTy);
+  MInstruction *Value = createInstruction<LoadInstruction>(
+      false, DestMTy, SrcMTy, MemoryBase, 1, MemoryIndex, MemoryOffset, false);
+  return Operand(protectUnsafeValue(Value, DestMTy), DestType);
+}
+
+MType *FunctionMirBuilder::getAtomicMemoryType(uint32_t Size) {
+  switch (Size) {
+  case 1:
+    return &Ctx.I8Type;
+  case 2:
+    return &Ctx.I16Type;
+  case 4:
+    return &Ctx.I32Type;
+  default:
+    return &Ctx.I64Type;
+  }
+}
+
+MInstruction *FunctionMirBuilder::checkAtomicAlignment(MInstruction *BaseInst,
+                                                       uint32_t Offset,
+                                                       uint32_t Size) {
+  if (Size == 1) {
+    return BaseInst;
+  }
+  if (BaseInst->getKind() != MInstruction::Kind::CONSTANT) {
+    BaseInst = makeReusableValue(BaseInst, &Ctx.I32Type);
+  }
+  /**
+   *  br_if cmp ine (and (add ($base, offset % size), size - 1), 0),
+   *    @unaligned_atomic
+   */
+  MInstruction *Addr = createInstruction<BinaryInstruction>(
+      false, OP_add, &Ctx.I32Type, BaseInst,
+      createIntConstInstruction(&Ctx.I32Type, Offset & (Size - 1)));
+  MInstruction *Misalignment = createInstruction<BinaryInstruction>(
+      false, OP_and, &Ctx.I32Type, Addr,
+      createIntConstInstruction(&Ctx.I32Type, Size - 1));
+  MInstruction *IsUnaligned = createInstruction<CmpInstruction>(
+      false, CmpInstruction::ICMP_NE, &Ctx.I8Type, Misalignment,
+      createIntConstInstruction(&Ctx.I32Type, 0));
+  MBasicBlock *UnalignedAtomicBB =
+      getOrCreateExceptionSetBB(ErrorCode::UnalignedAtomic);
+  createInstruction<BrIfInstruction>(true, Ctx, IsUnaligned,
+                                     UnalignedAtomicBB);
+  addUniqueSuccessor(UnalignedAtomicBB);
+  return BaseInst;
+}
+
+void FunctionMirBuilder::handleAtomicFence() {
+  CompileVector<MInstruction *> FenceArgs{
+      {
+          InstanceAddr,
+          createIntConstInstruction(&Ctx.I32Type, common::ATOMIC_FENCE),
+          createIntConstInstruction(&Ctx.I32Type, 0),
+          createIntConstInstruction(&Ctx.I32Type, 0),
+          createIntConstInstruction(&Ctx.I64Type, 0),
+          createIntConstInstruction(&Ctx.I64Type, 0),
+      },
+      Ctx.MemPool,
+  };
+  MInstruction *AtomicAddr = createIntConstInstruction(
+      &Ctx.I64Type, uint64_t(Instance::atomicOnJIT));
+  createInstruction<ICallInstruction>(true, &Ctx.I64Type, AtomicAddr,
+                                      FenceArgs);
+}
+#endif // ZEN_ENABLE_SGX
+
 std::tuple<MInstruction *, MInstruction *, int32_t>
 FunctionMirBuilder::getMemoryLocation(MInstruction *Base, uint32_t Offset,
                                       MType *Type) {
@@ -52,6 +52,8 @@ public:
 
   const bool UseSoftMemCheck;
 
+  const bool UseIndirectCallCache;
+
 private:
   runtime::Module &WasmMod;
   uint32_t CurFuncIdx = -1; // exclude imported functions
@@ -65,6 +67,8 @@ void buildAllMIRFuncTypes(WasmFrontendContext &Context, MModule &MMod,
 class FunctionMirBuilder final {
 public:
   typedef WasmFrontendContext CompilerContext;
+  // local.get always creates a new value, see WASMByteCodeVisitor
+  static constexpr bool DefersGetLocal = false;
 
   FunctionMirBuilder(CompilerContext &Context, MFunction &MFunc);
 
@@ -203,6 +207,13 @@ public:
   Operand handleCallIndirect(uint32_t TypeIdx, Operand IndirectFuncIdx,
                              uint32_t TblIdx, const ArgumentInfo &ArgInfo,
                              const std::vector<Operand> &Args);
+  // Unreachable, the loader rejects tail calls in multipass mode
+  void handleReturnCall(uint32_t FuncIdx, uintptr_t Target, bool IsImport,
+                        bool FarCall, const ArgumentInfo &ArgInfo,
+                        const std::vector<Operand> &Args);
+  void handleReturnCallIndirect(uint32_t TypeIdx, Operand IndirectFuncIdx,
+                                uint32_t TblIdx, const ArgumentInfo &ArgInfo,
+                                const std::vector<Operand> &Args);
 
   // ==================== Parametric Instruction Handlers ====================
 
@@ -259,6 +270,23 @@ public:
 
   Operand handleMemoryGrow(Operand Opnd);
 
+#ifndef ZEN_ENABLE_SGX
+  // Loads, stores and rmw instructions access the memory inline, wait and
+  // notify block or wake threads and are calls of Instance::atomicOnJIT. Loads
+  // are plain movs, they are sequentially consistent on x86-64 since stores and
+  // rmw instructions are lowered to xchg or locked instructions
+  Operand handleAtomic(uint32_t AtomicOpcode, Operand Base, uint32_t Offset,
+                       Operand Arg1, Operand Arg2);
+
+  Operand handleAtomicWaitNotify(uint32_t AtomicOpcode, Operand Base,
+                                 uint32_t Offset, Operand Arg1, Operand Arg2);
+
+  Operand handleAtomicLoad(uint32_t AtomicOpcode, Operand Base,
+                           uint32_t Offset);
+
+  void handleAtomicFence();
+#endif // ZEN_ENABLE_SGX
+
   // ==================== Numeric Instruction Handlers ====================
 
   template <WASMType Ty>
@@ -658,7 +686,10 @@ private:
     }
 
     checkCallException(IsImportOrIndirect);
-    updateMemoryBaseAndSize();
+    // The callee can only move the memory through memory.grow
+    if (Ctx.getWasmMod().mayGrowMemory()) {
+      updateMemoryBaseAndSize();
+    }
 
     if (IsStmt) {
       return Operand();
@@ -684,6 +715,16 @@ private:
   std::tuple<MInstruction *, MInstruction *, int32_t>
   getMemoryLocation(MInstruction *Base, uint32_t Offset, MType *Type);
 
+#ifndef ZEN_ENABLE_SGX
+  // The integer type of Size bytes accessed by an atomic instruction
+  MType *getAtomicMemoryType(uint32_t Size);
+
+  // Branch to the unaligned atomic trap if base + offset isn't a multiple of
+  // Size, return the base to be used for the access
+  MInstruction *checkAtomicAlignment(MInstruction *BaseInst, uint32_t Offset,
+                                     uint32_t Size);
+#endif // ZEN_ENABLE_SGX
+
   MInstruction *getMemoryBase();
   MInstruction *getMemorySize();
 
@@ -41,7 +41,8 @@ void mprotect(void *Addr, size_t Len, int Prot) {
 }
 
 bool mapFile(FileMapInfo *Info, const char *Filename) {
-  int Fd = ::open(Filename, O_RDWR);
+  // The file itself is never written, read-only files can be loaded
+  int Fd = ::open(Filename, O_RDONLY);
   if (Fd < 0) {
     ZEN_LOG_ERROR("failed to open file '%s' due to '%s'", Filename,
                   std::strerror(errno));
@@ -63,6 +64,8 @@ bool mapFile(FileMapInfo *Info, const char *Filename) {
     return false;
   }
 
+  // The loader rewrites a few opcodes in place, the private mapping only
+  // copies the touched pages
   void *Ptr = platform::mmap(nullptr, Stat.st_size, PROT_READ | PROT_WRITE,
                              MAP_PRIVATE, Fd, 0);
   if (!Ptr) {
@@ -0,0 +1,181 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "runtime/atomics.h"
+
+#include "common/errors.h"
+#include "runtime/instance.h"
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+
+namespace zen::runtime {
+
+using common::ErrorCode;
+using common::getError;
+
+namespace {
+
+// Parking lot of the threads blocked in memory.atomic.wait, keyed by the host
+// address of the waited cell, so waiters of the same shared memory meet in the
+// same bucket whichever instance they run in
+class WaiterQueue {
+public:
+  static WaiterQueue &get() {
+    static WaiterQueue Queue;
+    return Queue;
+  }
+
+  template <typename T>
+  uint32_t wait(const T *Addr, T Expected, int64_t TimeoutNs) {
+    Bucket &B = getBucket(Addr);
+    std::unique_lock<std::mutex> Lock(B.Mutex);
+    // Read under the lock of the bucket, so a notify after the store which
+    // changes the value can't be missed
+    if (__atomic_load_n(Addr, __ATOMIC_SEQ_CST) != Expected) {
+      return 1;
+    }
+    Waiter W;
+    W.Addr = Addr;
+    auto It = B.Waiters.insert(B.Waiters.end(), &W);
+    auto Woken = [&W] { return W.Notified; };
+    if (TimeoutNs < 0) {
+      W.CV.wait(Lock, Woken);
+    } else if (!W.CV.wait_for(Lock, std::chrono::nanoseconds(TimeoutNs),
+                              Woken)) {
+      B.Waiters.erase(It);
+      return 2;
+    }
+    return 0;
+  }
+
+  uint32_t notify(const void *Addr, uint32_t Count) {
+    Bucket &B = getBucket(Addr);
+    std::lock_guard<std::mutex> Lock(B.Mutex);
+    uint32_t NumWoken = 0;
+    for (auto It = B.Waiters.begin();
+         It != B.Waiters.end() && NumWoken < Count;) {
+      Waiter *W = *It;
+      if (W->Addr != Addr) {
+        ++It;
+        continue;
+      }
+      It = B.Waiters.erase(It);
+      W->Notified = true;
+      W->CV.notify_one();
+      ++NumWoken;
+    }
+    return NumWoken;
+  }
+
+private:
+  static constexpr size_t NumBuckets = 64;
+
+  struct Waiter {
+    const void *Addr = nullptr;
+    std::condition_variable CV;
+    bool Notified = false;
+  };
+
+  struct Bucket {
+    std::mutex Mutex;
+    // In the order of waiting, notify wakes the earliest waiters first
+    std::list<Waiter *> Waiters;
+  };
+
+  Bucket &getBucket(const void *Addr) {
+    return Buckets[(reinterpret_cast<uintptr_t>(Addr) >> 2) % NumBuckets];
+  }
+
+  Bucket Buckets[NumBuckets];
+};
+
+template <typename T>
+uint64_t atomicAccess(uint8_t *Ptr, AtomicOpKind Kind, uint64_t Arg1,
+                      uint64_t Arg2) {
+  T *P = reinterpret_cast<T *>(Ptr);
+  T Val = static_cast<T>(Arg1);
+  switch (Kind) {
+  case AtomicOpKind::Load:
+    return __atomic_load_n(P, __ATOMIC_SEQ_CST);
+  case AtomicOpKind::Store:
+    __atomic_store_n(P, Val, __ATOMIC_SEQ_CST);
+    return 0;
+  case AtomicOpKind::Add:
+    return __atomic_fetch_add(P, Val, __ATOMIC_SEQ_CST);
+  case AtomicOpKind::Sub:
+    return __atomic_fetch_sub(P, Val, __ATOMIC_SEQ_CST);
+  case AtomicOpKind::And:
+    return __atomic_fetch_and(P, Val, __ATOMIC_SEQ_CST);
+  case AtomicOpKind::Or:
+    return __atomic_fetch_or(P, Val, __ATOMIC_SEQ_CST);
+  case AtomicOpKind::Xor:
+    return __atomic_fetch_xor(P, Val, __ATOMIC_SEQ_CST);
+  case AtomicOpKind::Xchg:
+    return __atomic_exchange_n(P, Val, __ATOMIC_SEQ_CST);
+  case AtomicOpKind::Cmpxchg:
+    // The expected value is wrapped to the access width like the native
+    // cmpxchg does
+    __atomic_compare_exchange_n(P, &Val, static_cast<T>(Arg2), false,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return Val;
+  default:
+    ZEN_UNREACHABLE();
+  }
+}
+
+} // namespace
+
+uint64_t executeAtomicOp(MemoryInstance &Mem, uint32_t Opcode, uint32_t Addr,
+                         uint32_t Offset, uint64_t Arg1, uint64_t Arg2) {
+  uint32_t Size = getAtomicAccessSize(Opcode);
+  uint64_t EffectiveAddr = uint64_t(Addr) + Offset;
+  // Another instance may have grown the shared memory since MemSize was
+  // updated
+  uint64_t MemSize = Mem.Shared ? Mem.Shared->getSize() : Mem.MemSize;
+  if (EffectiveAddr + Size > MemSize) {
+    throw getError(ErrorCode::OutOfBoundsMemory);
+  }
+  if (EffectiveAddr & (Size - 1)) {
+    throw getError(ErrorCode::UnalignedAtomic);
+  }
+  uint8_t *Ptr = Mem.MemBase + EffectiveAddr;
+
+  switch (Opcode) {
+  case common::ATOMIC_NOTIFY:
+    // No thread can wait on a non-shared memory
+    if (!Mem.Shared) {
+      return 0;
+    }
+    return WaiterQueue::get().notify(Ptr, static_cast<uint32_t>(Arg1));
+  case common::ATOMIC_WAIT32:
+  case common::ATOMIC_WAIT64:
+    if (!Mem.Shared) {
+      throw getError(ErrorCode::ExpectedSharedMemory);
+    }
+    if (Opcode == common::ATOMIC_WAIT32) {
+      return WaiterQueue::get().wait(reinterpret_cast<uint32_t *>(Ptr),
+                                     static_cast<uint32_t>(Arg1),
+                                     static_cast<int64_t>(Arg2));
+    }
+    return WaiterQueue::get().wait(reinterpret_cast<uint64_t *>(Ptr), Arg1,
+                                   static_cast<int64_t>(Arg2));
+  default:
+    break;
+  }
+
+  AtomicOpKind Kind = getAtomicOpKind(Opcode);
+  switch (Size) {
+  case 1:
+    return atomicAccess<uint8_t>(Ptr, Kind, Arg1, Arg2);
+  case 2:
+    return atomicAccess<uint16_t>(Ptr, Kind, Arg1, Arg2);
+  case 4:
+    return atomicAccess<uint32_t>(Ptr, Kind, Arg1, Arg2);
+  default:
+    return atomicAccess<uint64_t>(Ptr, Kind, Arg1, Arg2);
+  }
+}
+
+} // namespace zen::runtime
@@ -0,0 +1,75 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef ZEN_RUNTIME_ATOMICS_H
+#define ZEN_RUNTIME_ATOMICS_H
+
+#include "common/enums.h"
+
+namespace zen::runtime {
+
+struct MemoryInstance;
+
+/// \brief Groups of the atomic opcodes(threads proposal) following the
+/// notify/wait/fence ones, every group has 7 shapes(see opcode_atomic.def)
+enum class AtomicOpKind : uint32_t {
+  Load = 0,
+  Store,
+  Add,
+  Sub,
+  And,
+  Or,
+  Xor,
+  Xchg,
+  Cmpxchg,
+};
+
+constexpr uint32_t NumAtomicShapes = 7;
+
+inline AtomicOpKind getAtomicOpKind(uint32_t Opcode) {
+  ZEN_ASSERT(Opcode >= common::I32_ATOMIC_LOAD);
+  return AtomicOpKind((Opcode - common::I32_ATOMIC_LOAD) / NumAtomicShapes);
+}
+
+/// \return the number of bytes accessed by the atomic instruction
+inline uint32_t getAtomicAccessSize(uint32_t Opcode) {
+  switch (Opcode) {
+  case common::ATOMIC_NOTIFY:
+  case common::ATOMIC_WAIT32:
+    return 4;
+  case common::ATOMIC_WAIT64:
+    return 8;
+  default:
+    break;
+  }
+  ZEN_ASSERT(Opcode >= common::I32_ATOMIC_LOAD);
+  // i32, i64, i32 8, i32 16, i64 8, i64 16, i64 32
+  static constexpr uint8_t Sizes[NumAtomicShapes] = {4, 8, 1, 2, 1, 2, 4};
+  return Sizes[(Opcode - common::I32_ATOMIC_LOAD) % NumAtomicShapes];
+}
+
+/// \return whether the value operands and result of the atomic access are i64
+inline bool isAtomicOp64(uint32_t Opcode) {
+  if (Opcode < common::I32_ATOMIC_LOAD) {
+    return Opcode == common::ATOMIC_WAIT64;
+  }
+  uint32_t Shape = (Opcode - common::I32_ATOMIC_LOAD) % NumAtomicShapes;
+  return Shape == 1 || Shape >= 4;
+}
+
+/// \brief Execute an atomic instruction other than fence on the memory, all
+/// accesses are sequentially consistent
+/// \param Arg1 the value stored/operand of rmw/expected value of cmpxchg and
+/// wait/count of notify
+/// \param Arg2 the replacement of cmpxchg/timeout(ns, negative for infinite)
+/// of wait
+/// \return the loaded(old) value zero extended, the result of wait(0 woken, 1
+/// not equal, 2 timed out) or the number of waiters woken by notify
+/// \throw OutOfBoundsMemory/UnalignedAtomic, ExpectedSharedMemory if waiting on
+/// a non-shared memory
+uint64_t executeAtomicOp(MemoryInstance &Mem, uint32_t Opcode, uint32_t Addr,
+                         uint32_t Offset, uint64_t Arg1, uint64_t Arg2);
+
+} // namespace zen::runtime
+
+#endif // ZEN_RUNTIME_ATOMICS_H
@@ -5,6 +5,7 @@
 #include "common/errors.h"
 #include "platform/map.h"
 #include "runtime/module.h"
+#include "utils/math.h"
 
 namespace zen::runtime {
 
@@ -61,6 +62,78 @@ CodeHolder::newRawDataCodeHolder(Runtime &RT, const void *Data, size_t Size) {
   return RawData;
 }
 
+#ifndef ZEN_ENABLE_SGX
+bool CodeStream::appendData(const void *Chunk, size_t ChunkSize) {
+  {
+    LockGuard<Mutex> Lock(Mtx);
+    size_t NewSize;
+    if (Closed || utils::addOverflow(AvailableSize, ChunkSize, NewSize) ||
+        NewSize > Size) {
+      return false;
+    }
+    // The loader only reads below AvailableSize
+    std::memcpy(Data + AvailableSize, Chunk, ChunkSize);
+    AvailableSize = NewSize;
+  }
+  DataCV.notify_all();
+  return true;
+}
+
+void CodeStream::close() {
+  {
+    LockGuard<Mutex> Lock(Mtx);
+    Closed = true;
+  }
+  DataCV.notify_all();
+}
+
+bool CodeStream::waitForData(size_t Offset) const {
+  UniqueLock<Mutex> Lock(Mtx);
+  DataCV.wait(Lock,
+              [this, Offset] { return AvailableSize >= Offset || Closed; });
+  return AvailableSize >= Offset;
+}
+
+CodeHolderUniquePtr CodeHolder::newStreamCodeHolder(Runtime &RT, size_t Size) {
+  if (Size == 0) {
+    throw getError(ErrorCode::UnexpectedEnd);
+  }
+  if (Size > PresetMaxModuleSize) {
+    throw getError(ErrorCode::ModuleSizeTooLarge);
+  }
+
+  void *Buf = RT.allocate(sizeof(CodeHolder));
+  ZEN_ASSERT(Buf);
+
+  CodeHolderUniquePtr StreamData(new (Buf) CodeHolder(RT, HolderKind::kStream));
+
+  void *Data = RT.allocate(Size);
+  ZEN_ASSERT(Data);
+
+  StreamData->Data = Data;
+  StreamData->Size = Size;
+  StreamData->Stream =
+      std::make_shared<CodeStream>(static_cast<uint8_t *>(Data), Size);
+
+  return StreamData;
+}
+
+void CodeHolder::releaseStreamCodeHolder() {
+  if (Stream) {
+    // Detach the buffer before releasing it, the feeder may still hold the
+    // stream
+    {
+      LockGuard<Mutex> Lock(Stream->Mtx);
+      Stream->Closed = true;
+      Stream->Data = nullptr;
+    }
+    Stream->DataCV.notify_all();
+    Stream.reset();
+  }
+  releaseRawDataCodeHolder();
+}
+#endif // ZEN_ENABLE_SGX
+
 CodeHolder::~CodeHolder() {
   switch (Kind) {
   case HolderKind::kFile:
@@ -69,6 +142,11 @@ CodeHolder::~CodeHolder() {
   case HolderKind::kRawData:
     releaseRawDataCodeHolder();
     break;
+#ifndef ZEN_ENABLE_SGX
+  case HolderKind::kStream:
+    releaseStreamCodeHolder();
+    break;
+#endif // ZEN_ENABLE_SGX
   default:
     ZEN_UNREACHABLE();
   }
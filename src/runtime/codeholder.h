@@ -7,14 +7,53 @@
 #include "common/const_string_pool.h"
 #include "common/defines.h"
 #include "runtime/object.h"
+#include <memory>
 
 namespace zen::runtime {
 
+class CodeStream;
+
+#ifndef ZEN_ENABLE_SGX
+/// \brief Producer/consumer state of a stream code holder. It is shared with
+/// the feeder, so that feeding stays safe after the code holder is destroyed
+/// by a failed loading.
+class CodeStream final {
+  friend class CodeHolder;
+
+public:
+  CodeStream(uint8_t *Data, size_t Size) : Data(Data), Size(Size) {}
+
+  NONCOPYABLE(CodeStream);
+
+  /// \brief append a chunk to the stream and wake up the waiting loader
+  /// \return false if the chunk exceeds the declared size or the stream has
+  /// been closed
+  bool appendData(const void *Chunk, size_t ChunkSize);
+
+  /// \brief no more data will be appended, loader waiting for more data will
+  /// fail with UnexpectedEnd
+  void close();
+
+  /// \brief block until the data in [0, Offset) is available
+  /// \return false if the stream is closed before that
+  bool waitForData(size_t Offset) const;
+
+private:
+  mutable common::Mutex Mtx;
+  mutable std::condition_variable DataCV;
+  uint8_t *Data;
+  const size_t Size;
+  // Bytes in [0, AvailableSize) are ready, only grows
+  size_t AvailableSize = 0;
+  bool Closed = false;
+};
+#endif // ZEN_ENABLE_SGX
+
 class CodeHolder : public RuntimeObject<CodeHolder> {
   friend class RuntimeObjectDestroyer;
 
 public:
-  enum class HolderKind { kFile, kRawData };
+  enum class HolderKind { kFile, kRawData, kStream };
 
   static CodeHolderUniquePtr newFileCodeHolder(Runtime &RT,
                                                const std::string &Filename);
@@ -22,6 +61,15 @@ public:
   static CodeHolderUniquePtr newRawDataCodeHolder(Runtime &RT, const void *Data,
                                                   size_t Size);
 
+#ifndef ZEN_ENABLE_SGX
+  /// \brief create a code holder whose data arrives chunk by chunk through
+  /// getStream(), the total size must be known in advance because the loaded
+  /// module refers to the data in place
+  static CodeHolderUniquePtr newStreamCodeHolder(Runtime &RT, size_t Size);
+
+  const std::shared_ptr<CodeStream> &getStream() const { return Stream; }
+#endif // ZEN_ENABLE_SGX
+
   HolderKind getKind() const { return Kind; }
 
   const void *getData() const { return Data; }
@@ -38,11 +86,19 @@ private:
 
   void releaseRawDataCodeHolder();
 
+#ifndef ZEN_ENABLE_SGX
+  void releaseStreamCodeHolder();
+#endif // ZEN_ENABLE_SGX
+
   HolderKind Kind;
 
   const void *Data = nullptr;
 
   size_t Size = 0;
+
+#ifndef ZEN_ENABLE_SGX
+  std::shared_ptr<CodeStream> Stream;
+#endif // ZEN_ENABLE_SGX
 };
 
 } // namespace zen::runtime
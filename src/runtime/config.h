@@ -6,6 +6,7 @@
 
 #include "common/defines.h"
 #include "utils/logging.h"
+#include <string>
 
 namespace zen::runtime {
 
@@ -24,16 +25,69 @@ struct RuntimeConfig {
   bool EnableStatistics = false;
   // Enable cpu instruction tracer hook
   bool EnableGdbTracingHook = false;
+  // Share one loaded module among the names loaded with identical bytecode
+  bool EnableModuleCache = false;
+  // Only locate the function bodies when loading, their locals are parsed and
+  // they are validated on the first call(interpreter and multipass lazy mode
+  // only), so invalid functions never called don't fail the loading. In
+  // multipass lazy mode the background compilation validates them earlier,
+  // and the calls of an invalid function trap
+  bool EnableLazyFunctionLoad = false;
+#ifndef ZEN_ENABLE_SGX
+  // Number of threads to validate function bodies when loading large modules,
+  // 0 or 1 means validating in the loading thread
+  uint32_t NumValidationThreads = 0;
+  // Number of linear memory slots reserved up front(8GB of address space
+  // each), 0 means no memory pool
+  uint32_t NumWasmMemoryPoolSlots = 0;
+  // Map the initial linear memory of instances copy-on-write from a
+  // per-module image with the data segments applied(linux only, requires the
+  // memory pool)
+  bool EnableWasmMemoryImage = false;
+  // Accept the threads proposal(shared linear memory and atomic
+  // instructions), executions sharing memory are no longer deterministic
+  bool EnableThreads = false;
+#endif // ZEN_ENABLE_SGX
+#ifdef ZEN_ENABLE_VIRTUAL_STACK
+  // Number of free virtual stacks kept committed process-wide(including the
+  // few cached by each thread), the pages of other released stacks are
+  // returned to the OS
+  uint32_t NumRetainedVirtualStacks = 16;
+#endif // ZEN_ENABLE_VIRTUAL_STACK
 #ifdef ZEN_ENABLE_MULTIPASS_JIT
   // Disable greedy register allocation of multipass JIT
   bool DisableMultipassGreedyRA = false;
+  // Use linear scan register allocation of multipass JIT for large functions
+  // without deeply nested loops and for on request compilation in lazy mode
+  bool EnableMultipassLinearScanRA = false;
+  // Functions of more CgIR instructions are compiled with fast register
+  // allocation by multipass JIT(0 for unlimited)
+  uint32_t MultipassMaxRAFuncInstrs = 0;
+  // Compile time budget of a function in multipass JIT in milliseconds, the
+  // register allocation is downgraded once it's exceeded(0 for unlimited)
+  uint32_t MultipassFuncBudgetMs = 0;
   // Disable multithread of multipass JIT
   bool DisableMultipassMultithread = false;
   // Number of threads for multipass JIT if DisableMultipassMultithread is false
   uint32_t NumMultipassThreads = 8;
   // Enable multipass lazy mode(on request compile)
   bool EnableMultipassLazy = false;
+  // Directory of the profiles recording the functions called by each module
+  // in multipass lazy mode(one file per bytecode hash), the functions called
+  // by the previous runs are compiled first(empty to disable)
+  std::string MultipassProfileDir;
+  // Emit inline caches at call_indirect sites in multipass JIT, so calls
+  // through the same table index as the last time skip the checks
+  bool EnableMultipassIndirectCallCache = false;
 #endif // ZEN_ENABLE_MULTIPASS_JIT
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  // Enable builtin sampling profiler of wasm functions
+  bool EnableWasmProfiler = false;
+  // Sampling interval of wasm profiler in microseconds(cpu time)
+  uint32_t WasmProfilerIntervalUs = 1000;
+  // Collect exact call counts of wasm functions(interpreter mode only)
+  bool EnableWasmProfilerCallCounts = false;
+#endif // ZEN_ENABLE_WASM_PROFILER
 
   bool validate() {
     // some cli options have relations
@@ -43,8 +97,45 @@ struct RuntimeConfig {
           "multipass multithread compiling disabled in gdb tracing mode");
       DisableMultipassMultithread = true;
     }
+    if (!MultipassProfileDir.empty() &&
+        (Mode != common::RunMode::MultipassMode || !EnableMultipassLazy)) {
+      ZEN_LOG_WARN("multipass profile only used in multipass lazy mode");
+    }
+    if (EnableMultipassIndirectCallCache &&
+        Mode != common::RunMode::MultipassMode) {
+      ZEN_LOG_WARN("indirect call cache only used in multipass mode");
+    }
 #endif // ZEN_ENABLE_MULTIPASS_JIT
 
+    bool LazyLoadSupported = Mode == common::RunMode::InterpMode;
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+    LazyLoadSupported |=
+        Mode == common::RunMode::MultipassMode && EnableMultipassLazy;
+#endif
+    if (EnableLazyFunctionLoad && !LazyLoadSupported) {
+      ZEN_LOG_WARN("lazy function loading only used in interpreter mode and "
+                   "multipass lazy mode");
+    }
+
+#ifndef ZEN_ENABLE_SGX
+    if (EnableWasmMemoryImage &&
+        (NumWasmMemoryPoolSlots == 0 || DisableWasmMemoryMap)) {
+      ZEN_LOG_WARN("wasm memory image only used with the memory pool");
+    }
+#endif // ZEN_ENABLE_SGX
+
+#ifdef ZEN_ENABLE_WASM_PROFILER
+    if (EnableWasmProfiler && WasmProfilerIntervalUs == 0) {
+      ZEN_LOG_FATAL("wasm profiler enabled but sampling interval is 0");
+      return false;
+    }
+    if (EnableWasmProfilerCallCounts &&
+        Mode != common::RunMode::InterpMode) {
+      ZEN_LOG_WARN("wasm profiler call counts only collected in interpreter "
+                   "mode");
+    }
+#endif // ZEN_ENABLE_WASM_PROFILER
+
     switch (Mode) {
 #ifndef ZEN_ENABLE_SINGLEPASS_JIT
     case common::RunMode::SinglepassMode: {
@@ -0,0 +1,211 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "runtime/executor.h"
+#include "runtime/instance.h"
+#include "runtime/isolation.h"
+#include "runtime/runtime.h"
+#include "utils/logging.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef ZEN_BUILD_PLATFORM_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif // ZEN_BUILD_PLATFORM_LINUX
+
+namespace zen::runtime {
+
+using common::ConcurrencyT;
+
+ConcurrencyT BlockExecutor::determineNumWorkers(ConcurrencyT NumWorkers) {
+  if (NumWorkers > 0) {
+    return NumWorkers;
+  }
+  // Unlike the loader threads, not capped: blocks are meant to use all cores
+  ConcurrencyT HardwareCount = std::thread::hardware_concurrency();
+  return HardwareCount > 0 ? HardwareCount : 1;
+}
+
+BlockExecutor::BlockExecutor(Runtime &RT, ConcurrencyT NumWorkers,
+                             bool PinWorkers)
+    : RT(RT), PinWorkers(PinWorkers),
+      Workers(std::make_unique<Worker[]>(determineNumWorkers(NumWorkers))),
+      Pool(determineNumWorkers(NumWorkers)) {
+  for (ConcurrencyT I = 0; I < Pool.getThreadCount(); ++I) {
+    Worker &W = Workers[I];
+    W.Id = I;
+    W.Iso = RT.createUnmanagedIsolation();
+    if (!W.Iso) {
+      ZEN_ABORT();
+    }
+#ifndef ZEN_ENABLE_SGX
+    // The allocators only use the pools when the runtime pool is used
+    if (RT.getWasmMemoryPool() && !RT.getConfig().DisableWasmMemoryMap) {
+      W.MemoryPool = std::make_unique<WasmMemoryPool>(NumWorkerMemorySlots);
+      if (!W.MemoryPool->isValid()) {
+        ZEN_LOG_WARN("failed to create the memory pool of executor worker %u",
+                     I);
+        W.MemoryPool.reset();
+      }
+    }
+#endif // ZEN_ENABLE_SGX
+#ifdef ZEN_ENABLE_VIRTUAL_STACK
+    using utils::StackMemPool;
+    W.StackPool = utils::newVirtualStackPool();
+    W.StackPool->setMaxRetainedStacks(StackMemPool::MaxThreadCachedStacks);
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+    Pool.setThreadContext(I, &W);
+  }
+}
+
+static void pinCurrentThread(uint32_t WorkerId) {
+#ifdef ZEN_BUILD_PLATFORM_LINUX
+  ConcurrencyT NumCPUs = std::thread::hardware_concurrency();
+  if (NumCPUs == 0) {
+    return;
+  }
+  cpu_set_t CPUSet;
+  CPU_ZERO(&CPUSet);
+  CPU_SET(WorkerId % NumCPUs, &CPUSet);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(CPUSet), &CPUSet) != 0) {
+    ZEN_LOG_WARN("failed to pin executor worker %u", WorkerId);
+  }
+#endif // ZEN_BUILD_PLATFORM_LINUX
+}
+
+void BlockExecutor::initWorkerThread(Worker &W) {
+  if (PinWorkers) {
+    pinCurrentThread(W.Id);
+  }
+  // The worker threads live as long as the workers, so the pools are never
+  // uninstalled
+#ifndef ZEN_ENABLE_SGX
+  setThreadWasmMemoryPool(W.MemoryPool.get());
+#endif // ZEN_ENABLE_SGX
+#if defined(ZEN_ENABLE_VIRTUAL_STACK) && !defined(ZEN_ENABLE_SGX)
+  utils::setThreadVirtualStackPool(W.StackPool.get());
+#endif
+  W.Initialized = true;
+}
+
+void BlockExecutor::runJob(Worker &W, const ExecJob &Job, ExecResult &Result) {
+  ZEN_ASSERT(Job.Mod);
+  common::MayBe<Instance *> InstRet =
+      W.Iso->createInstance(*Job.Mod, Job.GasLimit);
+  if (!InstRet) {
+    Result.Err = InstRet.getError();
+    Result.GasLeft = Job.GasLimit;
+    return;
+  }
+
+  Instance *Inst = *InstRet;
+  if (!RT.callWasmFunction(*Inst, Job.FuncIdx, Job.Args, Result.Results)) {
+    Result.Err = Inst->getError();
+    Result.Results.clear();
+  }
+  Result.GasLeft = Inst->getGas();
+  W.Iso->deleteInstance(Inst);
+}
+
+std::vector<ExecResult>
+BlockExecutor::executeBlock(const std::vector<ExecJob> &Jobs) {
+  std::vector<ExecResult> Results(Jobs.size());
+  if (Jobs.empty()) {
+    return Results;
+  }
+
+  // Every worker takes the next job index until all are taken, the results
+  // are written to the slot of the job, so the order of completion doesn't
+  // matter
+  std::atomic<size_t> NextJob = 0;
+  std::mutex DoneMutex;
+  std::condition_variable DoneCV;
+  ConcurrencyT NumTasks = std::min<size_t>(Pool.getThreadCount(), Jobs.size());
+  ConcurrencyT NumDone = 0;
+
+  for (ConcurrencyT I = 0; I < NumTasks; ++I) {
+    Pool.pushTask([&](Worker *W) {
+      if (!W->Initialized) {
+        initWorkerThread(*W);
+      }
+      size_t JobIdx;
+      while ((JobIdx = NextJob.fetch_add(1)) < Jobs.size()) {
+        runJob(*W, Jobs[JobIdx], Results[JobIdx]);
+      }
+      const std::scoped_lock DoneLock(DoneMutex);
+      if (++NumDone == NumTasks) {
+        DoneCV.notify_one();
+      }
+    });
+  }
+
+  std::unique_lock<std::mutex> DoneLock(DoneMutex);
+  DoneCV.wait(DoneLock, [&] { return NumDone == NumTasks; });
+  return Results;
+}
+
+std::vector<ExecResult> executeThreadGroup(Runtime &RT,
+                                           const std::vector<ExecJob> &Jobs) {
+  std::vector<ExecResult> Results(Jobs.size());
+  if (Jobs.empty()) {
+    return Results;
+  }
+
+  IsolationUniquePtr Iso = RT.createUnmanagedIsolation();
+  if (!Iso) {
+    ZEN_ABORT();
+  }
+
+  // The isolation isn't thread-safe, so instances are created and deleted
+  // under the lock. Every thread creates and deletes its own instance to use
+  // its own memory allocator, but no instance is deleted before all are
+  // created, or a shared memory could be freed and recreated from the data
+  // segments in the middle of the group
+  std::mutex IsoMutex;
+  std::condition_variable CreatedCV;
+  size_t NumCreated = 0;
+
+  auto RunJob = [&](const ExecJob &Job, ExecResult &Result) {
+    ZEN_ASSERT(Job.Mod);
+    common::MayBe<Instance *> InstRet = nullptr;
+    {
+      std::unique_lock<std::mutex> Lock(IsoMutex);
+      InstRet = Iso->createInstance(*Job.Mod, Job.GasLimit);
+      if (++NumCreated == Jobs.size()) {
+        CreatedCV.notify_all();
+      }
+    }
+    if (!InstRet) {
+      Result.Err = InstRet.getError();
+      Result.GasLeft = Job.GasLimit;
+      return;
+    }
+
+    Instance *Inst = *InstRet;
+    if (!RT.callWasmFunction(*Inst, Job.FuncIdx, Job.Args, Result.Results)) {
+      Result.Err = Inst->getError();
+      Result.Results.clear();
+    }
+    Result.GasLeft = Inst->getGas();
+
+    std::unique_lock<std::mutex> Lock(IsoMutex);
+    CreatedCV.wait(Lock, [&] { return NumCreated == Jobs.size(); });
+    Iso->deleteInstance(Inst);
+  };
+
+  std::vector<std::thread> Threads;
+  Threads.reserve(Jobs.size());
+  for (size_t I = 0; I < Jobs.size(); ++I) {
+    Threads.emplace_back(RunJob, std::cref(Jobs[I]), std::ref(Results[I]));
+  }
+  for (std::thread &T : Threads) {
+    T.join();
+  }
+  return Results;
+}
+
+} // namespace zen::runtime
@@ -0,0 +1,109 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef ZEN_RUNTIME_EXECUTOR_H
+#define ZEN_RUNTIME_EXECUTOR_H
+
+#include "common/defines.h"
+#include "common/errors.h"
+#include "common/thread_pool.h"
+#include "common/type.h"
+#include "runtime/destroyer.h"
+#include "runtime/memory.h"
+#include "utils/virtual_stack.h"
+
+#include <memory>
+#include <vector>
+
+namespace zen::runtime {
+
+class Module;
+class Runtime;
+
+/// \brief A call to run by BlockExecutor, the module must stay loaded until
+/// the block is finished
+struct ExecJob {
+  Module *Mod = nullptr;
+  uint32_t FuncIdx = 0;
+  std::vector<common::TypedValue> Args;
+  uint64_t GasLimit = 0;
+};
+
+struct ExecResult {
+  common::Error Err = common::ErrorCode::NoError;
+  std::vector<common::TypedValue> Results;
+  // Gas left when the call returned or trapped
+  uint64_t GasLeft = 0;
+
+  bool succeeded() const { return Err.isEmpty(); }
+};
+
+/// \brief Runs the independent calls of a block on a fixed pool of worker
+/// threads. Every worker owns an isolation, and every job runs in a fresh
+/// instance created and destroyed by its worker, so no wasm state is shared
+/// between jobs and the results(including traps and gas left) are the same
+/// as running the jobs one by one. Results are returned in the job order.
+///
+/// Every worker allocates the linear memories of its instances from its own
+/// memory pool(when the runtime has one) and the virtual stacks from its own
+/// stack pool, so workers don't contend on the pools of the runtime.
+class BlockExecutor final {
+public:
+  /// \param NumWorkers 0 means the number of hardware threads
+  /// \param PinWorkers bind worker I to CPU I(modulo the CPU count), only
+  /// supported on Linux
+  BlockExecutor(Runtime &RT, common::ConcurrencyT NumWorkers = 0,
+                bool PinWorkers = false);
+
+  NONCOPYABLE(BlockExecutor);
+
+  common::ConcurrencyT getNumWorkers() const { return Pool.getThreadCount(); }
+
+  /// \brief run all jobs and wait for them to finish
+  /// \warning not thread-safe, blocks must be executed one at a time
+  std::vector<ExecResult> executeBlock(const std::vector<ExecJob> &Jobs);
+
+private:
+  // Memory slots of a worker pool, a worker runs one instance at a time, the
+  // shared pool of the runtime is used when they are all in use
+  static constexpr uint32_t NumWorkerMemorySlots = 2;
+
+  struct Worker {
+    uint32_t Id = 0;
+#ifndef ZEN_ENABLE_SGX
+    std::unique_ptr<WasmMemoryPool> MemoryPool;
+#endif // ZEN_ENABLE_SGX
+#ifdef ZEN_ENABLE_VIRTUAL_STACK
+    std::unique_ptr<utils::StackMemPool> StackPool;
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+    // Destroyed before the pools
+    IsolationUniquePtr Iso;
+    // Whether the worker thread is pinned and uses the pools
+    bool Initialized = false;
+  };
+
+  void initWorkerThread(Worker &W);
+
+  void runJob(Worker &W, const ExecJob &Job, ExecResult &Result);
+
+  static common::ConcurrencyT
+  determineNumWorkers(common::ConcurrencyT NumWorkers);
+
+  Runtime &RT;
+  bool PinWorkers;
+  std::unique_ptr<Worker[]> Workers;
+  common::ThreadPool<Worker> Pool;
+};
+
+/// \brief Runs the calls of a thread group(threads proposal) concurrently on
+/// one thread per job, so jobs may block waiting for each other. The
+/// instances are created in one isolation, the instances of a module with a
+/// shared memory share it and the data segments are applied once. Unlike
+/// BlockExecutor, the results depend on the interleaving of the threads.
+/// Results are returned in the job order.
+std::vector<ExecResult> executeThreadGroup(Runtime &RT,
+                                           const std::vector<ExecJob> &Jobs);
+
+} // namespace zen::runtime
+
+#endif // ZEN_RUNTIME_EXECUTOR_H
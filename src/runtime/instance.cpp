@@ -9,6 +9,10 @@
 #include "common/traphandler.h"
 #include "entrypoint/entrypoint.h"
 #include "runtime/config.h"
+#include "runtime/isolation.h"
+#ifndef ZEN_ENABLE_SGX
+#include "runtime/atomics.h"
+#endif // ZEN_ENABLE_SGX
 #include <algorithm>
 
 namespace zen::runtime {
@@ -64,10 +68,10 @@ void Module::InstanceLayout::compute() {
   TableElemSizeOffset =
       GlobalVarBaseOffset + GlobalVarSize + offsetof(TableInstance, CurSize);
 
-  size_t MemoryInstanceOffset = TableElemBaseOffset + TableElemsSize;
-  MemoryBaseOffset = MemoryInstanceOffset + offsetof(MemoryInstance, MemBase);
-  MemorySizeOffset = MemoryInstanceOffset + offsetof(MemoryInstance, MemSize);
-  MemoryPagesOffset = MemoryInstanceOffset + offsetof(MemoryInstance, CurPages);
+  MemoryInstancesOffset = TableElemBaseOffset + TableElemsSize;
+  MemoryBaseOffset = getMemoryBaseOffset(0);
+  MemorySizeOffset = getMemorySizeOffset(0);
+  MemoryPagesOffset = getMemoryPagesOffset(0);
 
 #ifdef ZEN_ENABLE_JIT
   FuncPtrsSize = ZEN_ALIGN(NumFunctions * sizeof(uintptr_t), Alignment);
@@ -93,6 +97,21 @@ void Module::InstanceLayout::compute() {
 #endif
 }
 
+size_t Module::InstanceLayout::getMemoryBaseOffset(uint32_t MemIdx) const {
+  return MemoryInstancesOffset + MemIdx * sizeof(MemoryInstance) +
+         offsetof(MemoryInstance, MemBase);
+}
+
+size_t Module::InstanceLayout::getMemorySizeOffset(uint32_t MemIdx) const {
+  return MemoryInstancesOffset + MemIdx * sizeof(MemoryInstance) +
+         offsetof(MemoryInstance, MemSize);
+}
+
+size_t Module::InstanceLayout::getMemoryPagesOffset(uint32_t MemIdx) const {
+  return MemoryInstancesOffset + MemIdx * sizeof(MemoryInstance) +
+         offsetof(MemoryInstance, CurPages);
+}
+
 InstanceUniquePtr Instance::newInstance(Isolation &Iso, const Module &Mod,
                                         uint64_t GasLimit) {
 #ifdef ZEN_ENABLE_CPU_EXCEPTION
@@ -144,6 +163,15 @@ InstanceUniquePtr Instance::newInstance(Isolation &Iso, const Module &Mod,
 Instance::~Instance() {
   auto *MemAllocator = getWasmMemoryAllocator();
   for (uint32_t I = 0; I < NumTotalMemories; ++I) {
+#ifndef ZEN_ENABLE_SGX
+    if (Memories[I].Shared) {
+      // Freed by the isolation with the last instance sharing it
+      Memories[I].Shared->removeUser(Memories[I]);
+      Iso->releaseSharedMemory(*Mod);
+      Memories[I].MemBase = nullptr;
+      continue;
+    }
+#endif // ZEN_ENABLE_SGX
     if (Memories[I].MemBase) {
       MemAllocator->freeWasmMemory(Memories[I].getWasmMemoryData());
       Memories[I].MemBase = nullptr;
@@ -174,6 +202,23 @@ Instance::~Instance() {
 #endif
 }
 
+// ==================== Function Methods ====================
+
+void Instance::loadLazyFunction(FunctionInstance &FuncInst) {
+  uint32_t FuncIdx = static_cast<uint32_t>(&FuncInst - Functions);
+  Mod->loadLazyFunction(FuncIdx);
+  const CodeEntry &Code = *Mod->getCodeEntry(FuncIdx);
+  FuncInst.NumLocals = Code.NumLocals;
+  FuncInst.NumLocalCells = Code.NumLocalCells;
+  FuncInst.LocalTypes = Code.LocalTypes;
+  FuncInst.LocalOffsets = Code.LocalOffsets;
+  FuncInst.MaxStackSize = Code.MaxStackSize;
+  FuncInst.MaxBlockDepth = Code.MaxBlockDepth;
+  FuncInst.CodePtr = Code.CodePtr;
+  FuncInst.CodeSize = Code.CodeSize;
+  FuncInst.Lazy = false;
+}
+
 // ==================== Memory Accessing Methods ====================
 
 WasmMemoryAllocator *Instance::getWasmMemoryAllocator() {
@@ -202,16 +247,42 @@ void Instance::protectMemory() {
 
 void Instance::protectMemoryAgain() { protectMemory(); }
 
-bool Instance::growLinearMemory(uint32_t MemIdx, uint32_t GrowPagesDelta) {
+bool Instance::growLinearMemory(uint32_t MemIdx, uint32_t GrowPagesDelta,
+                                uint32_t *OldPages) {
   if (MemIdx >= NumTotalMemories) {
     return false;
   }
 
+  MemoryInstance *Mem = &Memories[MemIdx];
+  auto &Stats = getRuntime()->getStatistics();
+
+#ifndef ZEN_ENABLE_SGX
+  // Grows in place, the other instances sharing the memory are updated too
+  if (Mem->Shared) {
+    uint32_t PrevPages = 0;
+    if (!Mem->Shared->grow(GrowPagesDelta, PrevPages)) {
+      return false;
+    }
+    if (OldPages) {
+      *OldPages = PrevPages;
+    }
+    if (GrowPagesDelta) {
+      Stats.addCounter(utils::StatisticCounter::MemoryGrows, 1);
+      Stats.addCounter(utils::StatisticCounter::MemoryGrowPages,
+                       GrowPagesDelta);
+    }
+    return true;
+  }
+#endif // ZEN_ENABLE_SGX
+
+  if (OldPages) {
+    *OldPages = Mem->CurPages;
+  }
+
   if (!GrowPagesDelta) {
     return true;
   }
 
-  MemoryInstance *Mem = &Memories[MemIdx];
   uint32_t NewMemPages = Mem->CurPages + GrowPagesDelta;
   if (NewMemPages < Mem->CurPages /* integer overflow */
       || NewMemPages > Mem->MaxPages) {
@@ -244,22 +315,28 @@ bool Instance::growLinearMemory(uint32_t MemIdx, uint32_t GrowPagesDelta) {
   Mem->MemSize = NewMemSize;
   Mem->Kind = NewMemData.Type;
 
+  Stats.addCounter(utils::StatisticCounter::MemoryGrows, 1);
+  Stats.addCounter(utils::StatisticCounter::MemoryGrowPages, GrowPagesDelta);
+
   return true;
 }
 
-void *Instance::getNativeMemoryAddr(uint32_t Offset) {
-  if (Offset >= Memories[0].MemSize) {
+void *Instance::getNativeMemoryAddr(uint32_t Offset, uint32_t MemIdx) {
+  ZEN_ASSERT(MemIdx == 0 || MemIdx < NumTotalMemories);
+  const MemoryInstance &Mem = Memories[MemIdx];
+  if (Offset >= Mem.MemSize) {
     return nullptr;
   }
-  return Memories[0].MemBase + Offset;
+  return Mem.MemBase + Offset;
 }
 
-uint32_t Instance::getMemoryOffset(void *Addr) {
-  if (Addr < Memories[0].MemBase ||
-      Addr >= Memories[0].MemBase + Memories[0].MemSize) {
+uint32_t Instance::getMemoryOffset(void *Addr, uint32_t MemIdx) {
+  ZEN_ASSERT(MemIdx == 0 || MemIdx < NumTotalMemories);
+  const MemoryInstance &Mem = Memories[MemIdx];
+  if (Addr < Mem.MemBase || Addr >= Mem.MemBase + Mem.MemSize) {
     return (uint32_t)-1;
   }
-  return (uint8_t *)Addr - Memories[0].MemBase;
+  return (uint8_t *)Addr - Mem.MemBase;
 }
 
 bool Instance::validatedAppAddr(uint32_t Offset, uint32_t Size) {
@@ -315,14 +392,31 @@ void Instance::exit(int32_t ExitCode) {
 
 int32_t Instance::growInstanceMemoryOnJIT(Instance *Inst,
                                           uint32_t GrowPagesDelta) {
-  uint32_t PrevNumPages = Inst->getDefaultMemoryInst().CurPages;
-  ZEN_ASSERT(PrevNumPages < (1U << 31));
-  if (Inst->growLinearMemory(0, GrowPagesDelta)) {
+  uint32_t PrevNumPages = 0;
+  if (Inst->growLinearMemory(0, GrowPagesDelta, &PrevNumPages)) {
+    ZEN_ASSERT(PrevNumPages < (1U << 31));
     return static_cast<int32_t>(PrevNumPages);
   }
   return -1;
 }
 
+#ifndef ZEN_ENABLE_SGX
+uint64_t Instance::atomicOnJIT(Instance *Inst, uint32_t Opcode, uint32_t Addr,
+                               uint32_t Offset, uint64_t Arg1, uint64_t Arg2) {
+  if (Opcode == common::ATOMIC_FENCE) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return 0;
+  }
+  try {
+    return executeAtomicOp(Inst->getDefaultMemoryInst(), Opcode, Addr, Offset,
+                           Arg1, Arg2);
+  } catch (const common::Error &Err) {
+    Inst->setExecutionError(Err, 1, common::traphandler::TrapState{});
+    return 0;
+  }
+}
+#endif // ZEN_ENABLE_SGX
+
 void Instance::setInstanceExceptionOnJIT(Instance *Inst,
                                          common::ErrorCode ErrCode) {
   Inst->setExecutionError(common::getError(ErrCode), 1,
@@ -331,9 +425,13 @@ void Instance::setInstanceExceptionOnJIT(Instance *Inst,
 
 void Instance::throwInstanceExceptionOnJIT(Instance *Inst) {
 #ifdef ZEN_ENABLE_CPU_EXCEPTION
-  SAVE_HOSTAPI_FRAME_POINTER_TO_TLS
-
-  utils::throwCpuIllegalInstructionTrap();
+  // The error(and the call stack if needed) has been recorded, so jump back to
+  // the entry of the wasm call directly. Raising SIGILL would cost a signal
+  // delivery and a backtrace in the trap handler for every trap, which is
+  // reserved for the faults only detected by the hardware
+  auto *TLS = common::traphandler::CallThreadState::current();
+  ZEN_ASSERT(TLS && TLS->handling());
+  TLS->jmpToMarked(common::traphandler::SoftwareTrapJmpValue);
 #endif // ZEN_ENABLE_CPU_EXCEPTION
 }
 
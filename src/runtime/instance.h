@@ -57,6 +57,8 @@ struct FunctionInstance final {
   uint8_t NumReturns : 2;
   uint8_t NumReturnCells : 4;
   WASMType ReturnTypes[2];
+  // The code entry is not loaded yet, see Instance::loadLazyFunction
+  bool Lazy;
 
   union {
     WASMType *ParamTypes;
@@ -101,6 +103,9 @@ struct MemoryInstance final {
   uint8_t *MemBase;
   uint8_t *MemEnd;
   WasmMemoryDataType Kind;
+  // Shared with the other instances of the module in the isolation(threads
+  // proposal), owned by the isolation, nullptr if not shared
+  SharedMemory *Shared;
 
   WasmMemoryData getWasmMemoryData();
 };
@@ -136,6 +141,10 @@ public:
     return Functions + FuncIdx;
   }
 
+  /// \brief load the function skipped by lazy function loading and fill its
+  /// locals and stack sizes, see Module::loadLazyFunction
+  void loadLazyFunction(FunctionInstance &FuncInst);
+
   // ==================== Table Accessing Methods ====================
 
   TableInstance *getTableInst(uint32_t TableIdx) {
@@ -157,15 +166,24 @@ public:
     return Memories[0];
   }
 
-  bool growLinearMemory(uint32_t MemIdx, uint32_t GrowPagesDelta);
+  MemoryInstance &getMemoryInst(uint32_t MemIdx) {
+    ZEN_ASSERT(MemIdx < NumTotalMemories);
+    return Memories[MemIdx];
+  }
+
+  /// \param OldPages if not null, set to the size before growing on success
+  bool growLinearMemory(uint32_t MemIdx, uint32_t GrowPagesDelta,
+                        uint32_t *OldPages = nullptr);
 
   void *reallocLinearMemory(void *Ptr, uint32_t OldSize, uint32_t NewSize) {
     return reallocate(Ptr, OldSize, NewSize);
   }
 
-  void *getNativeMemoryAddr(uint32_t Offset);
+  /// \note the memory instance 0 always exists(zero sized if the module has
+  /// no memory), so the default MemIdx is valid in any instance
+  void *getNativeMemoryAddr(uint32_t Offset, uint32_t MemIdx = 0);
 
-  uint32_t getMemoryOffset(void *Addr);
+  uint32_t getMemoryOffset(void *Addr, uint32_t MemIdx = 0);
 
   bool __attribute__((noinline))
   validatedAppAddr(uint32_t Offset, uint32_t Size);
@@ -224,6 +242,13 @@ public:
   static int32_t growInstanceMemoryOnJIT(Instance *Inst,
                                          uint32_t GrowPagesDelta);
 
+#ifndef ZEN_ENABLE_SGX
+  /// \brief execute an atomic instruction on the default memory, see
+  /// executeAtomicOp, the error is set on the instance if it traps
+  static uint64_t atomicOnJIT(Instance *Inst, uint32_t Opcode, uint32_t Addr,
+                              uint32_t Offset, uint64_t Arg1, uint64_t Arg2);
+#endif // ZEN_ENABLE_SGX
+
   void setJITStackSize(uint64_t NewStackSize) { JITStackSize = NewStackSize; }
 
   static void __attribute__((noinline))
@@ -64,6 +64,36 @@ bool Isolation::deleteInstance(Instance *Inst) noexcept {
   return InstancePool.erase(Inst) != 0;
 }
 
+#ifndef ZEN_ENABLE_SGX
+SharedMemory *Isolation::acquireSharedMemory(const Module &Mod,
+                                            uint32_t InitPages,
+                                            uint32_t MaxPages, bool &Created) {
+  auto It = SharedMemories.find(&Mod);
+  if (It != SharedMemories.end()) {
+    ++It->second.NumRefs;
+    Created = false;
+    return It->second.Memory.get();
+  }
+  auto Memory = SharedMemory::newSharedMemory(
+      getRuntime()->getWasmMemoryPool(), InitPages, MaxPages);
+  if (!Memory) {
+    return nullptr;
+  }
+  SharedMemory *RawMemory = Memory.get();
+  SharedMemories.emplace(&Mod, SharedMemoryRef{std::move(Memory), 1});
+  Created = true;
+  return RawMemory;
+}
+
+void Isolation::releaseSharedMemory(const Module &Mod) {
+  auto It = SharedMemories.find(&Mod);
+  ZEN_ASSERT(It != SharedMemories.end());
+  if (--It->second.NumRefs == 0) {
+    SharedMemories.erase(It);
+  }
+}
+#endif // ZEN_ENABLE_SGX
+
 bool Isolation::initWasi() {
   return initNativeModuleCtx(common::WASM_SYMBOL_wasi_snapshot_preview1);
 }
@@ -6,6 +6,7 @@
 
 #include "common/defines.h"
 #include "runtime/destroyer.h"
+#include "runtime/memory.h"
 #include "runtime/object.h"
 #include "runtime/wni.h"
 #include <unordered_map>
@@ -38,11 +39,34 @@ public:
   bool initWasi();
   bool initNativeModuleCtx(WASMSymbol ModName);
 
+#ifndef ZEN_ENABLE_SGX
+  /// \brief get the shared memory of the module in this isolation, allocate
+  /// it if no instance of the module holds it yet
+  /// \param Created set to true if allocated by this call, then the caller
+  /// applies the data segments
+  /// \return nullptr if the memory can't be allocated
+  SharedMemory *acquireSharedMemory(const Module &Mod, uint32_t InitPages,
+                                    uint32_t MaxPages, bool &Created);
+
+  /// \brief drop a reference to the shared memory of the module, the memory
+  /// is freed with the last reference
+  void releaseSharedMemory(const Module &Mod);
+#endif // ZEN_ENABLE_SGX
+
 private:
   explicit Isolation(Runtime &RT) : RuntimeObject<Isolation>(RT) {}
 
   WNIEnvInternal WniEnv;
 
+#ifndef ZEN_ENABLE_SGX
+  struct SharedMemoryRef {
+    std::unique_ptr<SharedMemory> Memory;
+    uint32_t NumRefs;
+  };
+  // Declared before InstancePool to outlive the instances referring to them
+  std::unordered_map<const Module *, SharedMemoryRef> SharedMemories;
+#endif // ZEN_ENABLE_SGX
+
   std::unordered_map<Instance *, InstanceUniquePtr> InstancePool;
 };
 
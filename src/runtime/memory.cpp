@@ -3,9 +3,12 @@
 
 #include "runtime/memory.h"
 #include "common/enums.h"
+#include "runtime/instance.h"
 #include "runtime/module.h"
+#include "runtime/runtime.h"
 #include "utils/logging.h"
 #include "utils/others.h"
+#include <algorithm>
 #include <cstdio>
 
 namespace zen::runtime {
@@ -14,24 +17,219 @@ using namespace zen::common;
 
 constexpr size_t MmapMemoryFileMaxSize = 32 * 1024 * 1024; // 32MB
 
-static bool verifyCanUseMmapBucketByModuleDataSegments(Module *Mod) {
-  if (Mod->getNumInternalMemories() != 1) {
-    return false;
+#ifndef ZEN_ENABLE_SGX
+WasmMemoryPool::WasmMemoryPool(uint32_t NumSlots) {
+  if (NumSlots == 0 || NumSlots > MaxNumSlots) {
+    ZEN_LOG_ERROR("invalid number of wasm memory pool slots %u(max %u)",
+                  NumSlots, MaxNumSlots);
+    return;
   }
-  const auto &Mem = Mod->getDefaultMemoryEntry();
-  size_t InitMemorySize = Mem.InitSize * DefaultBytesNumPerPage;
-  if (InitMemorySize == 0) {
+  // Only reserve the address space, pages are committed on access
+  auto *Addr = (uint8_t *)::mmap(nullptr, NumSlots * SlotSize, PROT_NONE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                                 -1, 0);
+  if (!Addr || Addr == (uint8_t *)-1) {
+    ZEN_LOG_ERROR("failed to reserve %u wasm memory pool slots due to '%s'",
+                  NumSlots, std::strerror(errno));
+    return;
+  }
+  Base = Addr;
+  this->NumSlots = NumSlots;
+  NextFree = std::make_unique<std::atomic<uint32_t>[]>(NumSlots);
+  ImageMapped = std::make_unique<bool[]>(NumSlots);
+  for (uint32_t I = 0; I < NumSlots; ++I) {
+    NextFree[I].store(I + 1 < NumSlots ? I + 2 : NoSlot,
+                      std::memory_order_relaxed);
+  }
+  FreeTop.store(1, std::memory_order_release);
+}
+
+WasmMemoryPool::~WasmMemoryPool() {
+  if (Base && 0 != ::munmap(Base, NumSlots * SlotSize)) {
+    ZEN_ABORT();
+  }
+}
+
+uint8_t *WasmMemoryPool::acquireSlot(size_t Size,
+                                     const WasmMemoryImage *Image) {
+  ZEN_ASSERT(Size <= SlotSize);
+  ZEN_ASSERT(!Image || Image->getSize() <= Size);
+  uint64_t Top = FreeTop.load(std::memory_order_acquire);
+  while (true) {
+    uint32_t SlotIdx = static_cast<uint32_t>(Top);
+    if (SlotIdx == NoSlot) {
+      return nullptr;
+    }
+    uint64_t NewTop = (((Top >> 32) + 1) << 32) |
+                      NextFree[SlotIdx - 1].load(std::memory_order_relaxed);
+    if (FreeTop.compare_exchange_weak(Top, NewTop, std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      uint8_t *Slot = Base + (SlotIdx - 1) * SlotSize;
+      size_t ImageSize = 0;
+      if (Image) {
+        ImageSize = Image->getSize();
+        if (Slot != ::mmap(Slot, ImageSize, PROT_READ | PROT_WRITE,
+                           MAP_FIXED | MAP_PRIVATE, Image->getFd(), 0)) {
+          ZEN_ABORT();
+        }
+      }
+      ImageMapped[SlotIdx - 1] = Image != nullptr;
+      growSlot(Slot, ImageSize, Size);
+      return Slot;
+    }
+  }
+}
+
+void WasmMemoryPool::growSlot(uint8_t *Slot, size_t OldSize, size_t NewSize) {
+  ZEN_ASSERT(containsSlot(Slot));
+  ZEN_ASSERT(NewSize <= SlotSize);
+  if (NewSize <= OldSize) {
+    return;
+  }
+  if (0 != ::mprotect(Slot + OldSize, NewSize - OldSize,
+                      PROT_READ | PROT_WRITE)) {
+    ZEN_ABORT();
+  }
+}
+
+void WasmMemoryPool::releaseSlot(uint8_t *Slot, size_t Size) {
+  ZEN_ASSERT(containsSlot(Slot));
+  uint32_t SlotIdx = (Slot - Base) / SlotSize + 1;
+  if (Size > 0) {
+    // Only the used range can have touched pages. MADV_DONTNEED doesn't zero
+    // the pages on Darwin, and would expose the image data again for a
+    // private file mapping, map new pages instead
+    bool Remap = ImageMapped[SlotIdx - 1];
+#ifdef ZEN_BUILD_PLATFORM_DARWIN
+    Remap = true;
+#endif // ZEN_BUILD_PLATFORM_DARWIN
+    if (Remap) {
+      if (Slot !=
+          ::mmap(Slot, Size, PROT_NONE,
+                 MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1,
+                 0)) {
+        ZEN_ABORT();
+      }
+    } else if (0 != ::madvise(Slot, Size, MADV_DONTNEED) ||
+               0 != ::mprotect(Slot, Size, PROT_NONE)) {
+      ZEN_ABORT();
+    }
+  }
+  ImageMapped[SlotIdx - 1] = false;
+
+  uint64_t Top = FreeTop.load(std::memory_order_relaxed);
+  do {
+    NextFree[SlotIdx - 1].store(static_cast<uint32_t>(Top),
+                                std::memory_order_relaxed);
+  } while (!FreeTop.compare_exchange_weak(
+      Top, (((Top >> 32) + 1) << 32) | SlotIdx, std::memory_order_release,
+      std::memory_order_relaxed));
+}
+
+static thread_local WasmMemoryPool *ThreadMemoryPool = nullptr;
+
+void setThreadWasmMemoryPool(WasmMemoryPool *Pool) { ThreadMemoryPool = Pool; }
+
+std::unique_ptr<SharedMemory>
+SharedMemory::newSharedMemory(WasmMemoryPool *Pool, uint32_t InitPages,
+                              uint32_t MaxPages) {
+  ZEN_ASSERT(InitPages <= MaxPages);
+  size_t InitSize = size_t(InitPages) * DefaultBytesNumPerPage;
+  uint8_t *Slot = Pool ? Pool->acquireSlot(InitSize) : nullptr;
+  // Not from the allocators, the pool of a thread may be uninstalled before
+  // the last instance sharing the memory is deleted
+  std::unique_ptr<WasmMemoryPool> OwnedPool;
+  if (!Slot) {
+    OwnedPool = std::make_unique<WasmMemoryPool>(1);
+    if (!OwnedPool->isValid()) {
+      return nullptr;
+    }
+    Pool = OwnedPool.get();
+    Slot = Pool->acquireSlot(InitSize);
+    ZEN_ASSERT(Slot);
+  }
+  return std::unique_ptr<SharedMemory>(new SharedMemory(
+      Pool, std::move(OwnedPool), Slot, InitPages, MaxPages));
+}
+
+SharedMemory::~SharedMemory() {
+  ZEN_ASSERT(Users.empty());
+  Pool->releaseSlot(Base, getSize());
+}
+
+void SharedMemory::updateUser(MemoryInstance &MemInst) const {
+  uint32_t Pages = CurPages.load(std::memory_order_relaxed);
+  MemInst.MemSize = uint64_t(Pages) * DefaultBytesNumPerPage;
+  MemInst.MemEnd = Base + MemInst.MemSize;
+  MemInst.CurPages = Pages;
+}
+
+void SharedMemory::addUser(MemoryInstance &MemInst) {
+  LockGuard<Mutex> Lock(Mtx);
+  MemInst.MemBase = Base;
+  MemInst.MaxPages = MaxPages;
+  MemInst.Kind = WM_MEMORY_DATA_TYPE_POOL_SLOT;
+  updateUser(MemInst);
+  Users.push_back(&MemInst);
+}
+
+void SharedMemory::removeUser(MemoryInstance &MemInst) {
+  LockGuard<Mutex> Lock(Mtx);
+  auto It = std::find(Users.begin(), Users.end(), &MemInst);
+  ZEN_ASSERT(It != Users.end());
+  Users.erase(It);
+}
+
+bool SharedMemory::grow(uint32_t DeltaPages, uint32_t &OldPages) {
+  LockGuard<Mutex> Lock(Mtx);
+  OldPages = CurPages.load(std::memory_order_relaxed);
+  uint32_t NewPages = OldPages + DeltaPages;
+  if (NewPages < OldPages /* integer overflow */ || NewPages > MaxPages) {
     return false;
   }
-  if (InitMemorySize > MmapMemoryFileMaxSize) {
+  uint64_t NewSize = uint64_t(NewPages) * DefaultBytesNumPerPage;
+  if (NewSize >= UINT32_MAX) {
     return false;
   }
-  if (WasmMemoryAllocatorMmapSize > 0 &&
-      InitMemorySize >
-          WasmMemoryAllocatorMmapSize / WasmMemoryAllocatorBucketDuplicates) {
+  // The pages are accessible before any thread can see the new size
+  Pool->growSlot(Base, uint64_t(OldPages) * DefaultBytesNumPerPage, NewSize);
+  CurPages.store(NewPages, std::memory_order_release);
+  for (MemoryInstance *MemInst : Users) {
+    updateUser(*MemInst);
+  }
+  return true;
+}
+
+uint8_t *WasmMemoryAllocator::acquirePoolSlot(size_t MemorySize,
+                                              const WasmMemoryImage *Image) {
+  ZEN_ASSERT(MemoryPool);
+  // The slots of the thread pool aren't contended by other threads
+  if (ThreadMemoryPool) {
+    if (uint8_t *Slot = ThreadMemoryPool->acquireSlot(MemorySize, Image)) {
+      return Slot;
+    }
+  }
+  return MemoryPool->acquireSlot(MemorySize, Image);
+}
+
+WasmMemoryPool *WasmMemoryAllocator::getSlotPool(const uint8_t *Slot) const {
+  if (ThreadMemoryPool && ThreadMemoryPool->containsSlot(Slot)) {
+    return ThreadMemoryPool;
+  }
+  ZEN_ASSERT(MemoryPool && MemoryPool->containsSlot(Slot));
+  return MemoryPool;
+}
+#endif // ZEN_ENABLE_SGX
+
+// Whether all the data segments can be applied to the initial memory before
+// instantiation
+static bool verifyDataSegmentsInInitMemory(const Module *Mod) {
+  if (Mod->getNumInternalMemories() != 1) {
     return false;
   }
-  if (Mod->getNumTotalMemories() != 1 || Mem.InitSize == 0) {
+  const auto &Mem = Mod->getDefaultMemoryEntry();
+  size_t InitMemorySize = Mem.InitSize * DefaultBytesNumPerPage;
+  if (Mod->getNumTotalMemories() != 1 || InitMemorySize == 0) {
     return false;
   }
   for (size_t I = 0; I < Mod->getNumDataSegments(); I++) {
@@ -40,10 +238,6 @@ static bool verifyCanUseMmapBucketByModuleDataSegments(Module *Mod) {
       return false;
     }
     int64_t BaseOffset = 0;
-    if (Seg->InitExprKind != Opcode::I32_CONST &&
-        Seg->InitExprKind != Opcode::I64_CONST) {
-      return false;
-    }
     if (Seg->InitExprKind == Opcode::I32_CONST) {
       BaseOffset = (int64_t)Seg->InitExprVal.I32;
     } else if (Seg->InitExprKind == Opcode::I64_CONST) {
@@ -58,11 +252,95 @@ static bool verifyCanUseMmapBucketByModuleDataSegments(Module *Mod) {
   return true;
 }
 
+static bool verifyCanUseMmapBucketByModuleDataSegments(Module *Mod) {
+  if (!verifyDataSegmentsInInitMemory(Mod)) {
+    return false;
+  }
+  const auto &Mem = Mod->getDefaultMemoryEntry();
+  size_t InitMemorySize = Mem.InitSize * DefaultBytesNumPerPage;
+  if (InitMemorySize > MmapMemoryFileMaxSize) {
+    return false;
+  }
+  if (WasmMemoryAllocatorMmapSize > 0 &&
+      InitMemorySize >
+          WasmMemoryAllocatorMmapSize / WasmMemoryAllocatorBucketDuplicates) {
+    return false;
+  }
+  return true;
+}
+
+#ifndef ZEN_ENABLE_SGX
+WasmMemoryImage::~WasmMemoryImage() { ::close(Fd); }
+
+std::unique_ptr<WasmMemoryImage>
+WasmMemoryImage::newImage(const Module &Mod) {
+#ifdef ZEN_BUILD_PLATFORM_LINUX
+  if (!verifyDataSegmentsInInitMemory(&Mod)) {
+    return nullptr;
+  }
+  size_t ImageSize =
+      Mod.getDefaultMemoryEntry().InitSize * DefaultBytesNumPerPage;
+  int Fd = ::memfd_create("dtvm_memory_image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (Fd < 0) {
+    ZEN_LOG_WARN("failed to create wasm memory image due to '%s'",
+                 std::strerror(errno));
+    return nullptr;
+  }
+  // Create the image object first to close the fd on failure
+  std::unique_ptr<WasmMemoryImage> Image(new WasmMemoryImage(Fd, ImageSize));
+  // The file is sparse, only the pages written by data segments take memory
+  if (0 != ::ftruncate(Fd, ImageSize)) {
+    ZEN_LOG_WARN("failed to create wasm memory image due to '%s'",
+                 std::strerror(errno));
+    return nullptr;
+  }
+  // Apply in order since the data segments may overlap
+  for (uint32_t I = 0; I < Mod.getNumDataSegments(); ++I) {
+    const auto *Seg = Mod.getDataEntry(I);
+    const uint8_t *Data = Mod.getWASMBytecode() + Seg->Offset;
+    size_t Offset = Seg->InitExprKind == Opcode::I32_CONST
+                        ? (size_t)(uint32_t)Seg->InitExprVal.I32
+                        : (size_t)Seg->InitExprVal.I64;
+    size_t Remaining = Seg->Size;
+    while (Remaining > 0) {
+      ssize_t Written = ::pwrite(Fd, Data, Remaining, Offset);
+      if (Written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (Written <= 0) {
+        ZEN_LOG_WARN("failed to write wasm memory image due to '%s'",
+                     std::strerror(errno));
+        return nullptr;
+      }
+      Data += Written;
+      Offset += Written;
+      Remaining -= Written;
+    }
+  }
+  // Seal the image so that no one can modify the pages shared by instances
+  if (0 != ::fcntl(Fd, F_ADD_SEALS,
+                   F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) {
+    ZEN_LOG_WARN("failed to seal wasm memory image due to '%s'",
+                 std::strerror(errno));
+    return nullptr;
+  }
+  return Image;
+#else
+  return nullptr;
+#endif // ZEN_BUILD_PLATFORM_LINUX
+}
+#endif // ZEN_ENABLE_SGX
+
 WasmMemoryAllocator::WasmMemoryAllocator(
     Module *Mod, const WasmMemoryAllocatorOptions *Options) {
   CurModule = Mod;
   CurRuntime = Mod->getRuntime();
   DefaultMemoryType = WM_MEMORY_DATA_TYPE_MALLOC;
+#ifndef ZEN_ENABLE_SGX
+  if (!CurRuntime->getConfig().DisableWasmMemoryMap) {
+    MemoryPool = CurRuntime->getWasmMemoryPool();
+  }
+#endif // ZEN_ENABLE_SGX
   if (Options->UseMmap) {
 #ifdef ZEN_ENABLE_CPU_EXCEPTION
     UseMmap = true;
@@ -327,6 +605,19 @@ void WasmMemoryAllocator::mprotectReadWriteWasmMemoryData(
 
 // allocate linear memory space when not use mmap-bucket
 WasmMemoryData WasmMemoryAllocator::allocateNonBucketMemory(size_t MemorySize) {
+#ifndef ZEN_ENABLE_SGX
+  if (MemoryPool) {
+    if (uint8_t *Slot = acquirePoolSlot(MemorySize, nullptr)) {
+      return WasmMemoryData{
+          .Type = WM_MEMORY_DATA_TYPE_POOL_SLOT,
+          .MemoryData = Slot,
+          .MemorySize = MemorySize,
+          .NeedMprotect = false,
+      };
+    }
+    // All slots in use, fallback to the allocation below
+  }
+#endif // ZEN_ENABLE_SGX
   if (UseMmap) {
     // when wasm memory overflow check by cpu,
     // then all linear memories should allocated by mmap
@@ -430,6 +721,23 @@ WasmMemoryData WasmMemoryAllocator::allocInitWasmMemory(
         .NeedMprotect = false,
     };
   }
+#ifndef ZEN_ENABLE_SGX
+  // The image is usable only if the memory size isn't clamped below the
+  // initial size by the runtime
+  const WasmMemoryImage *Image = CurModule->getMemoryImage();
+  if (MemoryPool && Image && Image->getSize() <= MemorySize) {
+    if (uint8_t *Slot = acquirePoolSlot(MemorySize, Image)) {
+      if (FilledInitData)
+        *FilledInitData = true;
+      return WasmMemoryData{
+          .Type = WM_MEMORY_DATA_TYPE_POOL_SLOT,
+          .MemoryData = Slot,
+          .MemorySize = MemorySize,
+          .NeedMprotect = false,
+      };
+    }
+  }
+#endif // ZEN_ENABLE_SGX
   bool InstanceUseMmap = ThisInstanceUseMmap && checkWasmMemoryCanUseMmap();
   WasmMemoryData Result;
 
@@ -470,6 +778,14 @@ WasmMemoryData WasmMemoryAllocator::allocInitWasmMemory(
 }
 
 void WasmMemoryAllocator::internalFreeWasmMemory(const WasmMemoryData &Data) {
+#ifndef ZEN_ENABLE_SGX
+  if (Data.Type == WM_MEMORY_DATA_TYPE_POOL_SLOT) {
+    // The memory may be allocated by the allocator of another thread, but the
+    // pool is shared by the runtime, or installed on the current thread
+    getSlotPool(Data.MemoryData)->releaseSlot(Data.MemoryData, Data.MemorySize);
+    return;
+  }
+#endif // ZEN_ENABLE_SGX
   if (Data.Type == WM_MEMORY_DATA_TYPE_SINGLE_MMAP) {
     if (0 != ::munmap(Data.MemoryData, Data.MemorySize)) {
       ZEN_ABORT();
@@ -514,6 +830,23 @@ void WasmMemoryAllocator::internalFreeWasmMemory(const WasmMemoryData &Data) {
 WasmMemoryData
 WasmMemoryAllocator::enlargeWasmMemory(const WasmMemoryData &OldMemoryData,
                                        size_t NewMemorySize) {
+#ifndef ZEN_ENABLE_SGX
+  if (OldMemoryData.Type == WM_MEMORY_DATA_TYPE_POOL_SLOT) {
+    // The slot covers the max memory size, grow in place without copying
+    getSlotPool(OldMemoryData.MemoryData)
+        ->growSlot(OldMemoryData.MemoryData, OldMemoryData.MemorySize,
+                   NewMemorySize);
+    return WasmMemoryData{
+        .Type = WM_MEMORY_DATA_TYPE_POOL_SLOT,
+        .MemoryData = OldMemoryData.MemoryData,
+        .MemorySize = NewMemorySize,
+        .NeedMprotect = false,
+    };
+  }
+  if (MemoryPool && !OldMemoryData.MemoryData) {
+    return allocateNonBucketMemory(NewMemorySize);
+  }
+#endif // ZEN_ENABLE_SGX
   bool NeedFreeOldMmap = false;
   if (UseMmap) {
     // when use bucket with mmap linear-memory,
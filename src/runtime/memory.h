@@ -6,6 +6,7 @@
 
 #include "common/defines.h"
 #include "platform/memory.h"
+#include <atomic>
 #include <cstdint>
 #include <list>
 #include <memory>
@@ -17,6 +18,7 @@ namespace zen::runtime {
 
 class Module;
 class Runtime;
+struct MemoryInstance;
 
 // allocated memory data type
 enum WasmMemoryDataType : uint32_t {
@@ -25,6 +27,8 @@ enum WasmMemoryDataType : uint32_t {
   WM_MEMORY_DATA_TYPE_SINGLE_MMAP = 2,
   // when the wasm memory from mmaped-bucket(1/n of one mmap instance)
   WM_MEMORY_DATA_TYPE_BUCKET_MMAP = 3,
+  // when the wasm memory from a slot of WasmMemoryPool
+  WM_MEMORY_DATA_TYPE_POOL_SLOT = 4,
 };
 
 struct WasmMemoryData {
@@ -81,6 +85,144 @@ public:
   size_t MmapSize = 0;
 };
 
+#ifndef ZEN_ENABLE_SGX
+/**
+ * Initial image of the default linear memory with all the data segments
+ * applied, kept in a sealed memfd and shared by the instances of a module.
+ * Instances map it copy-on-write, so the pages are copied on first write only.
+ */
+class WasmMemoryImage {
+public:
+  WasmMemoryImage(const WasmMemoryImage &Other) = delete;
+  WasmMemoryImage &operator=(const WasmMemoryImage &Other) = delete;
+  ~WasmMemoryImage();
+
+  /// \return nullptr if the data segments can't be applied before
+  /// instantiation(non-const offsets, imported memory, etc.) or the platform
+  /// doesn't support sealed memfds
+  static std::unique_ptr<WasmMemoryImage> newImage(const Module &Mod);
+
+  int getFd() const { return Fd; }
+  /// \return the initial memory size, a multiple of the wasm page size
+  size_t getSize() const { return Size; }
+
+private:
+  WasmMemoryImage(int Fd, size_t Size) : Fd(Fd), Size(Size) {}
+
+  int Fd;
+  size_t Size;
+};
+
+/**
+ * Pool of linear-memory slots reserved up front, shared by all the threads of
+ * a runtime. Every slot reserves WasmMemoryAllocatorMmapSize bytes, so that
+ * the memory grows in place and the access beyond the memory size hits
+ * PROT_NONE pages in the slot itself. Slots are handed out and returned
+ * through a lock-free stack, a returned slot is reset by dropping the pages
+ * of the used range.
+ */
+class WasmMemoryPool {
+public:
+  static constexpr size_t SlotSize = WasmMemoryAllocatorMmapSize;
+  // 32TB of address space at most
+  static constexpr uint32_t MaxNumSlots = 4096;
+
+  WasmMemoryPool(uint32_t NumSlots);
+  WasmMemoryPool(const WasmMemoryPool &Other) = delete;
+  WasmMemoryPool &operator=(const WasmMemoryPool &Other) = delete;
+  ~WasmMemoryPool();
+
+  // false if the slots can't be reserved
+  bool isValid() const { return Base != nullptr; }
+
+  /// \return the slot base with [0, Size) readable and writable, or nullptr if
+  /// all slots are in use
+  /// \param Image if not null, mapped copy-on-write at the slot base, its size
+  /// must not exceed Size
+  uint8_t *acquireSlot(size_t Size, const WasmMemoryImage *Image = nullptr);
+
+  /// \brief make [OldSize, NewSize) of the slot readable and writable
+  void growSlot(uint8_t *Slot, size_t OldSize, size_t NewSize);
+
+  /// \brief zero and protect [0, Size) of the slot, and return it to the pool
+  void releaseSlot(uint8_t *Slot, size_t Size);
+
+  bool containsSlot(const uint8_t *Addr) const {
+    return Addr >= Base && Addr < Base + NumSlots * SlotSize;
+  }
+
+private:
+  static constexpr uint32_t NoSlot = 0;
+
+  uint8_t *Base = nullptr;
+  uint32_t NumSlots = 0;
+  // Treiber stack of free slots, (tag << 32 | (slot index + 1)), the tag
+  // avoids ABA
+  std::atomic<uint64_t> FreeTop{0};
+  std::unique_ptr<std::atomic<uint32_t>[]> NextFree;
+  // Whether the slot has a memory image mapped, only accessed by the owner of
+  // the slot
+  std::unique_ptr<bool[]> ImageMapped;
+};
+
+/**
+ * Shared linear memory(threads proposal) of the instances of a module in an
+ * isolation. The memory is a pool slot reserving the max size, so it grows in
+ * place and the base never moves. The current size is kept here and copied to
+ * the memory instances sharing it on every grow.
+ */
+class SharedMemory {
+public:
+  /// \param Pool the pool of the runtime, a single slot pool is owned by the
+  /// memory if it's nullptr or has no free slot
+  /// \return nullptr if no slot can be reserved
+  static std::unique_ptr<SharedMemory> newSharedMemory(WasmMemoryPool *Pool,
+                                                       uint32_t InitPages,
+                                                       uint32_t MaxPages);
+
+  SharedMemory(const SharedMemory &Other) = delete;
+  SharedMemory &operator=(const SharedMemory &Other) = delete;
+  ~SharedMemory();
+
+  uint8_t *getBase() const { return Base; }
+  uint32_t getCurPages() const {
+    return CurPages.load(std::memory_order_acquire);
+  }
+  uint64_t getSize() const {
+    return uint64_t(getCurPages()) * common::DefaultBytesNumPerPage;
+  }
+
+  /// \brief the memory instance follows the size of the memory from now on,
+  /// its fields are updated here
+  void addUser(MemoryInstance &MemInst);
+  void removeUser(MemoryInstance &MemInst);
+
+  /// \param OldPages the size before growing, read under the grow lock
+  bool grow(uint32_t DeltaPages, uint32_t &OldPages);
+
+private:
+  SharedMemory(WasmMemoryPool *Pool, std::unique_ptr<WasmMemoryPool> OwnedPool,
+               uint8_t *Base, uint32_t InitPages, uint32_t MaxPages)
+      : Pool(Pool), OwnedPool(std::move(OwnedPool)), Base(Base),
+        MaxPages(MaxPages), CurPages(InitPages) {}
+
+  void updateUser(MemoryInstance &MemInst) const;
+
+  WasmMemoryPool *Pool;
+  std::unique_ptr<WasmMemoryPool> OwnedPool;
+  uint8_t *const Base;
+  const uint32_t MaxPages;
+  std::atomic<uint32_t> CurPages;
+  common::Mutex Mtx;
+  std::vector<MemoryInstance *> Users;
+};
+
+/// \brief install a pool tried before the pool of the runtime by the memory
+/// allocators on the calling thread, nullptr to uninstall. The instances with
+/// a memory from it must be deleted on this thread before it is uninstalled
+void setThreadWasmMemoryPool(WasmMemoryPool *Pool);
+#endif // ZEN_ENABLE_SGX
+
 /**
  * wasm linear-memory allocator(not thread safe)
  */
@@ -118,6 +260,11 @@ private:
   Runtime *CurRuntime;
   WasmMemoryDataType DefaultMemoryType;
 
+#ifndef ZEN_ENABLE_SGX
+  // Not null if the runtime has a memory pool and memory map not disabled
+  WasmMemoryPool *MemoryPool = nullptr;
+#endif // ZEN_ENABLE_SGX
+
   bool UseMmap = false;
   size_t MmapMemoryInitFileSize = 0;
   // the bucket contains init-size + grow-max-size(zeros)
@@ -151,6 +298,11 @@ private:
 
   void internalFreeWasmMemory(const WasmMemoryData &Data);
 
+#ifndef ZEN_ENABLE_SGX
+  uint8_t *acquirePoolSlot(size_t MemorySize, const WasmMemoryImage *Image);
+  WasmMemoryPool *getSlotPool(const uint8_t *Slot) const;
+#endif // ZEN_ENABLE_SGX
+
   WasmMemoryBucketSlice getOrCreateMmapSpace(
       const uint8_t
           *BucketAllocSand, // sand to alloc bucket. eg. MemoryInstance*
@@ -189,9 +189,13 @@ ModuleUniquePtr Module::newModule(Runtime &RT, CodeHolderUniquePtr CodeHolder,
   Mod->EntryHint = EntryHint;
 #endif
 
+  const CodeStream *Stream = nullptr;
+#ifndef ZEN_ENABLE_SGX
+  Stream = CodeHolder->getStream().get();
+#endif
   action::ModuleLoader Loader(*Mod,
                               static_cast<const Byte *>(CodeHolder->getData()),
-                              CodeHolder->getSize());
+                              CodeHolder->getSize(), Stream);
 
   auto &Stats = RT.getStatistics();
   auto Timer = Stats.startRecord(utils::StatisticPhase::Load);
@@ -208,6 +212,12 @@ ModuleUniquePtr Module::newModule(Runtime &RT, CodeHolderUniquePtr CodeHolder,
     action::performJITCompile(*Mod);
   }
 
+#ifndef ZEN_ENABLE_SGX
+  if (RT.getConfig().EnableWasmMemoryImage && RT.getWasmMemoryPool()) {
+    Mod->MemoryImage = WasmMemoryImage::newImage(*Mod);
+  }
+#endif // ZEN_ENABLE_SGX
+
   Mod->getMemoryAllocator();
 
   return Mod;
@@ -219,6 +229,43 @@ COMPILER::LazyJITCompiler *Module::newLazyJITCompiler() {
   LazyJITCompiler = std::make_unique<COMPILER::LazyJITCompiler>(this);
   return LazyJITCompiler.get();
 }
+
+void Module::recordJITEntry(uint32_t FuncIdx) const {
+  if (LazyJITCompiler) {
+    LazyJITCompiler->recordEntry(FuncIdx);
+  }
+}
+
+bool Module::checkUseIndirectCallCache() const {
+  if (!getRuntime()->getConfig().EnableMultipassIndirectCallCache) {
+    return false;
+  }
+  for (uint32_t I = 0; I < NumElementSegments; ++I) {
+    if (ElementTable[I].InitExprKind == GET_GLOBAL) {
+      return false;
+    }
+  }
+  return true;
+}
+
+IndirectCallCache *Module::newIndirectCallCache() {
+  LockGuard<Mutex> Lock(IndirectCallCachesMtx);
+  return &IndirectCallCaches.emplace_back();
+}
+
+void Module::addRegAllocDowngradedFunc(uint32_t FuncIdx) {
+  LockGuard<Mutex> Lock(RegAllocDowngradedFuncsMtx);
+  auto It = std::lower_bound(RegAllocDowngradedFuncs.begin(),
+                             RegAllocDowngradedFuncs.end(), FuncIdx);
+  if (It == RegAllocDowngradedFuncs.end() || *It != FuncIdx) {
+    RegAllocDowngradedFuncs.insert(It, FuncIdx);
+  }
+}
+
+std::vector<uint32_t> Module::getRegAllocDowngradedFuncs() const {
+  LockGuard<Mutex> Lock(RegAllocDowngradedFuncsMtx);
+  return RegAllocDowngradedFuncs;
+}
 #endif
 
 // ==================== Metadata Methods ====================
@@ -227,6 +274,8 @@ const uint8_t *Module::getWASMBytecode() const {
   return static_cast<const uint8_t *>(CodeHolder->getData());
 }
 
+size_t Module::getWASMBytecodeSize() const { return CodeHolder->getSize(); }
+
 // ==================== Segment Accessing Methods ====================
 
 uint32_t Module::getFunctionTypeIdx(uint32_t FuncIdx) const {
@@ -251,6 +300,35 @@ CodeEntry *Module::getCodeEntry(uint32_t FuncIdx) const {
   return CodeTable + InternalFuncIdx;
 }
 
+void Module::loadLazyFunction(uint32_t FuncIdx) const {
+  CodeEntry *Entry = getCodeEntry(FuncIdx);
+  ZEN_ASSERT(Entry);
+  if (!Entry->Lazy.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  LockGuard<Mutex> Lock(LazyLoadMtx);
+  if (!Entry->Lazy.load(std::memory_order_relaxed)) {
+    return;
+  }
+  // The body may be partially rewritten by the failed validation, don't load
+  // it again
+  auto It = LazyLoadErrors.find(FuncIdx);
+  if (It != LazyLoadErrors.end()) {
+    throw It->second;
+  }
+
+  try {
+    action::ModuleLoader::loadLazyFunction(const_cast<Module &>(*this),
+                                           FuncIdx);
+  } catch (const Error &Err) {
+    LazyLoadErrors.emplace(FuncIdx, Err);
+    throw;
+  }
+
+  Entry->Lazy.store(false, std::memory_order_release);
+}
+
 bool Module::getExportFunc(WASMSymbol Name, uint32_t &FuncIdx) const noexcept {
   // perhaps use a hashmap instead if there are too much export functions.
   for (uint32_t I = 0; I < NumExports; ++I) {
@@ -9,6 +9,7 @@
 #include "runtime/memory.h"
 #include "runtime/object.h"
 #include "utils/safe_map.h"
+#include <deque>
 
 #ifdef ZEN_ENABLE_MULTIPASS_JIT
 namespace COMPILER {
@@ -176,11 +177,13 @@ struct ImportTableEntry final : ImportEntryBase {
 struct ImportMemoryEntry final : ImportEntryBase {
   uint32_t InitPages;
   uint32_t MaxPages;
+  // Shared between the instances of the module(threads proposal)
+  bool Shared;
   /// \note constructor is required to initialize under C++14
   ImportMemoryEntry(WASMSymbol ModuleName, WASMSymbol FieldName,
-                    uint32_t InitPages, uint32_t MaxPages)
+                    uint32_t InitPages, uint32_t MaxPages, bool Shared)
       : ImportEntryBase{ModuleName, FieldName}, InitPages(InitPages),
-        MaxPages(MaxPages) {}
+        MaxPages(MaxPages), Shared(Shared) {}
 };
 
 struct ImportGlobalEntry final : ImportEntryBase {
@@ -208,6 +211,8 @@ struct TableEntry final {
 struct MemoryEntry final {
   uint32_t InitSize;
   uint32_t MaxSize;
+  // Shared between the instances of the module(threads proposal)
+  bool Shared = false;
 };
 
 union InitExpr final {
@@ -255,11 +260,37 @@ struct CodeEntry {
   uint32_t Stats;
   // indicate the approximate offset of current function in wasm bytecode
   uint32_t CodeOffset;
+  // Skipped by lazy function loading, `CodePtr` and `CodeSize` cover the
+  // locals and the body until Module::loadLazyFunction
+  std::atomic<bool> Lazy;
 #if defined(ZEN_ENABLE_DWASM) && defined(ZEN_ENABLE_JIT)
   uint32_t JITStackCost;
 #endif
+#ifdef ZEN_ENABLE_SINGLEPASS_JIT
+  static constexpr uint32_t MaxHotLocalsPerKind = 2;
+  // Indexes(in LocalTypes) of the most used non-param locals of each kind,
+  // weighted by loop depth and in descending order, singlepass JIT keeps
+  // them in registers
+  uint8_t NumHotIntLocals;
+  uint8_t NumHotFloatLocals;
+  uint16_t HotIntLocals[MaxHotLocalsPerKind];
+  uint16_t HotFloatLocals[MaxHotLocalsPerKind];
+#endif
 };
 
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+/// Inline cache of a call_indirect site in multipass JIT code, hits skip the
+/// bounds, null and signature checks
+struct IndirectCallCache {
+  /// Sites missing more often are megamorphic, the cache isn't refilled
+  static constexpr uint32_t MaxMisses = 16;
+  /// Zero-extended table index already checked against the signature of the
+  /// site, UINT64_MAX(never equal to an index) when empty
+  uint64_t TableIdx = UINT64_MAX;
+  uint32_t NumMisses = 0;
+};
+#endif // ZEN_ENABLE_MULTIPASS_JIT
+
 struct DataEntry {
   uint32_t MemIdx;
   uint32_t Size;
@@ -293,6 +324,9 @@ class Module final : public BaseModule<Module> {
     size_t TableElemsSize = 0;
 
     size_t MemoryInstancesSize = 0;
+    // Memory instances are stored densely from MemoryInstancesOffset, the
+    // offsets below are the ones of the default memory(index 0)
+    size_t MemoryInstancesOffset = 0;
     // Differs from TableElemBaseOffset, you must load memory base pointer
     // through MemoryBaseOffset before accessing memory data.
     size_t MemoryBaseOffset = 0;
@@ -325,6 +359,10 @@ class Module final : public BaseModule<Module> {
 
     std::pair<WASMType, size_t>
     getGlobalTypeAndOffset(uint32_t GlobalIdx) const;
+
+    size_t getMemoryBaseOffset(uint32_t MemIdx) const;
+    size_t getMemorySizeOffset(uint32_t MemIdx) const;
+    size_t getMemoryPagesOffset(uint32_t MemIdx) const;
   };
 
   friend class RuntimeObjectDestroyer;
@@ -339,6 +377,7 @@ public:
     SF_global = 1 << 0, // Access global variables
     SF_memory = 1 << 1, // Access linear memory
     SF_table = 1 << 2,  // Access table
+    SF_memory_grow = 1 << 3, // Grow linear memory
   };
 
   static ModuleUniquePtr newModule(Runtime &RT, CodeHolderUniquePtr CodeHolder,
@@ -350,6 +389,8 @@ public:
 
   const uint8_t *getWASMBytecode() const;
 
+  size_t getWASMBytecodeSize() const;
+
   // ==================== Number Methods ====================
 
   uint32_t getNumImportFunctions() const { return NumImportFunctions; }
@@ -443,6 +484,11 @@ public:
     return getInternalGlobal(InternalGlobalIdx).Type;
   }
 
+  /// \brief whether any function may grow a resizable linear memory, the
+  /// memory base and size can't change otherwise, so JIT code needn't reload
+  /// them after calls
+  bool mayGrowMemory() const { return MemoryMayGrow; }
+
   const MemoryEntry &getDefaultMemoryEntry() const {
     ZEN_ASSERT(NumInternalMemories == 1);
     return InternalMemoryTable[0];
@@ -456,6 +502,11 @@ public:
 
   CodeEntry *getCodeEntry(uint32_t FuncIdx) const;
 
+  /// \brief parse the locals and validate the body of a function skipped by
+  /// lazy function loading, no-op for loaded functions, thread-safe
+  /// \throw the validation error of the function, again on later calls
+  void loadLazyFunction(uint32_t FuncIdx) const;
+
   DataEntry *getDataEntry(uint32_t DataSegIdx) const {
     ZEN_ASSERT(DataSegIdx < NumDataSegments);
     return DataTable + DataSegIdx;
@@ -471,6 +522,11 @@ public:
 
   WasmMemoryAllocator *getMemoryAllocator();
 
+#ifndef ZEN_ENABLE_SGX
+  // Null if the memory image isn't enabled or not applicable to the module
+  const WasmMemoryImage *getMemoryImage() const { return MemoryImage.get(); }
+#endif // ZEN_ENABLE_SGX
+
   bool checkUseSoftLinearMemoryCheck() const {
 #ifdef ZEN_ENABLE_CPU_EXCEPTION
     return false;
@@ -510,6 +566,35 @@ public:
   const auto &getExportedFuncIdxs() const { return ExportedFuncIdxs; }
 
   const auto &getCallSeqMap() const { return CallSeqMap; }
+
+  const auto &getCallWeightMap() const { return CallWeightMap; }
+
+  /// \brief record the function called from the host into the multipass
+  /// profile, no-op if the module isn't compiled lazily
+  void recordJITEntry(uint32_t FuncIdx) const;
+
+  /// \brief inline caches are only sound when the tables are identical in
+  /// all instances sharing the JIT code, i.e. no element segment is placed
+  /// by a global
+  bool checkUseIndirectCallCache() const;
+
+  /// \brief allocate the inline cache of a call_indirect site, which lives
+  /// as long as the module(thread-safe)
+  IndirectCallCache *newIndirectCallCache();
+
+  /// \brief the inline caches in the order of their allocation, not locked
+  /// (for tests)
+  const std::deque<IndirectCallCache> &getIndirectCallCaches() const {
+    return IndirectCallCaches;
+  }
+
+  /// \brief record a function whose register allocation was downgraded by
+  /// the size threshold or the compile time budget(thread-safe)
+  void addRegAllocDowngradedFunc(uint32_t FuncIdx);
+
+  /// \return the functions whose register allocation was downgraded, in
+  /// ascending order(thread-safe)
+  std::vector<uint32_t> getRegAllocDowngradedFuncs() const;
 #endif // ZEN_ENABLE_MULTIPASS_JIT
 
 #endif // ZEN_ENABLE_JIT
@@ -673,9 +758,15 @@ private:
   CodeEntry *CodeTable = nullptr;
   DataEntry *DataTable = nullptr;
 
+  // Serialize Module::loadLazyFunction, and keep the errors of the functions
+  // failed to load
+  mutable common::Mutex LazyLoadMtx;
+  mutable std::unordered_map<uint32_t, common::Error> LazyLoadErrors;
+
   // ==================== Layout Members ====================
 
   uint32_t GlobalVarSize = 0;
+  bool MemoryMayGrow = false;
   InstanceLayout Layout;
 
   // ==================== Platform Feature Members ====================
@@ -689,6 +780,10 @@ private:
   typedef utils::ThreadSafeMap<int64_t, WasmMemoryAllocator *> ThreadSafeMap;
   ThreadSafeMap *ThreadLocalMemAllocatorMap = nullptr;
 
+#ifndef ZEN_ENABLE_SGX
+  std::unique_ptr<WasmMemoryImage> MemoryImage;
+#endif // ZEN_ENABLE_SGX
+
   // ==================== JIT Members ====================
 
 #ifdef ZEN_ENABLE_JIT
@@ -711,6 +806,14 @@ private:
   std::unordered_map<uint32_t, std::vector<uint32_t>> TypedFuncRefs;
   // Call Graph excluding import functions
   std::unordered_map<uint32_t, std::vector<uint32_t>> CallSeqMap;
+  // Weights of the callees in CallSeqMap by the loop depths of the call sites
+  std::unordered_map<uint32_t, std::vector<uint32_t>> CallWeightMap;
+  // Referenced by the JIT code, a deque keeps their addresses stable
+  common::Mutex IndirectCallCachesMtx;
+  std::deque<IndirectCallCache> IndirectCallCaches;
+  // Sorted, a function may be compiled again in lazy mode
+  mutable common::Mutex RegAllocDowngradedFuncsMtx;
+  std::vector<uint32_t> RegAllocDowngradedFuncs;
 #endif // ZEN_ENABLE_MULTIPASS_JIT
 
 #endif // ZEN_ENABLE_JIT
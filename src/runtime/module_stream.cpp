@@ -0,0 +1,79 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "runtime/module_stream.h"
+#include "runtime/codeholder.h"
+#include "runtime/module.h"
+#include "runtime/runtime.h"
+
+namespace zen::runtime {
+
+using namespace common;
+
+ModuleStream::ModuleStream(Runtime &RT, WASMSymbol Name,
+                           CodeHolderUniquePtr CodeHolder,
+                           const std::string &EntryHint)
+    : RT(RT), Name(Name), Stream(CodeHolder->getStream()),
+      CacheBytecode(RT.getConfig().EnableModuleCache) {
+  ZEN_ASSERT(Stream);
+  if (CacheBytecode) {
+    Bytecode.reserve(CodeHolder->getSize());
+  }
+  Worker = std::thread(
+      [this, Code = std::move(CodeHolder), EntryHint]() mutable {
+        try {
+          Mod = Module::newModule(this->RT, std::move(Code), EntryHint);
+        } catch (const Error &E) {
+          Err = E;
+        }
+      });
+}
+
+ModuleStream::~ModuleStream() {
+  if (!Finished) {
+    // Wake up the loader waiting for more data
+    Stream->close();
+    join();
+    Mod.reset();
+    RT.freeSymbol(Name);
+  }
+}
+
+bool ModuleStream::feed(const void *Chunk, size_t ChunkSize) noexcept {
+  ZEN_ASSERT(!Finished);
+  if (!Chunk || !ChunkSize) {
+    return ChunkSize == 0;
+  }
+  if (!Stream->appendData(Chunk, ChunkSize)) {
+    return false;
+  }
+  if (CacheBytecode) {
+    const auto *Bytes = static_cast<const uint8_t *>(Chunk);
+    Bytecode.insert(Bytecode.end(), Bytes, Bytes + ChunkSize);
+  }
+  return true;
+}
+
+void ModuleStream::join() {
+  if (Worker.joinable()) {
+    Worker.join();
+  }
+}
+
+MayBe<Module *> ModuleStream::finish() noexcept {
+  ZEN_ASSERT(!Finished);
+  Finished = true;
+
+  // No more data, a truncated module fails with UnexpectedEnd
+  Stream->close();
+  join();
+
+  if (!Err.isEmpty()) {
+    RT.freeSymbol(Name);
+    return Err;
+  }
+  ZEN_ASSERT(Mod);
+  return RT.registerModule(Name, std::move(Mod), std::move(Bytecode));
+}
+
+} // namespace zen::runtime
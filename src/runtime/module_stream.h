@@ -0,0 +1,70 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef ZEN_RUNTIME_MODULE_STREAM_H
+#define ZEN_RUNTIME_MODULE_STREAM_H
+
+#include "common/defines.h"
+#include "common/errors.h"
+#include "runtime/destroyer.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace zen::runtime {
+
+class CodeStream;
+class Module;
+class Runtime;
+
+/// \brief Streaming module loading. The module is parsed by a background
+/// thread while the caller feeds the chunks, and each function body is
+/// validated as soon as it has arrived, so that the I/O of large modules
+/// overlaps with validation. JIT compilation is not streamed, it needs the
+/// whole module and runs after the last chunk. Created by
+/// Runtime::startModuleStream.
+class ModuleStream final {
+  friend class Runtime;
+
+public:
+  /// \brief abort the loading if not finished
+  ~ModuleStream();
+
+  NONCOPYABLE(ModuleStream);
+
+  /// \brief feed the next chunk of the module
+  /// \return false if the chunk exceeds the declared module size or the
+  /// loading has already failed, the error is reported by finish()
+  bool feed(const void *Chunk, size_t ChunkSize) noexcept;
+
+  /// \brief wait for the loading(and the JIT compilation, which starts after
+  /// the last chunk) to complete and register the module to the runtime, the
+  /// stream can't be used afterwards
+  /// \warning not thread-safe
+  common::MayBe<Module *> finish() noexcept;
+
+private:
+  ModuleStream(Runtime &RT, WASMSymbol Name, CodeHolderUniquePtr CodeHolder,
+               const std::string &EntryHint);
+
+  void join();
+
+  Runtime &RT;
+  WASMSymbol Name;
+  std::shared_ptr<CodeStream> Stream;
+  std::thread Worker;
+  // Set by the worker thread, read after join
+  ModuleUniquePtr Mod;
+  common::Error Err = common::ErrorCode::NoError;
+  // Copy of the fed chunks for the module cache, the loader rewrites the
+  // bytecode in place
+  bool CacheBytecode = false;
+  std::vector<uint8_t> Bytecode;
+  bool Finished = false;
+};
+
+} // namespace zen::runtime
+
+#endif // ZEN_RUNTIME_MODULE_STREAM_H
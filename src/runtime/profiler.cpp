@@ -0,0 +1,445 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "runtime/profiler.h"
+
+#include "action/interpreter.h"
+#include "runtime/instance.h"
+#include "runtime/module.h"
+#include "runtime/runtime.h"
+#include "utils/logging.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <vector>
+
+namespace zen::runtime {
+
+using namespace common;
+
+namespace {
+
+std::atomic<WasmProfiler *> ActiveProfiler{nullptr};
+
+struct sigaction PrevProfAction;
+
+thread_local WasmProfilerScope *CurrentScope = nullptr;
+
+struct RegisterState {
+  uintptr_t PC;
+  uintptr_t FP;
+  uintptr_t SP;
+};
+
+RegisterState getRegisterState(void *Ctx) {
+  ucontext_t *UCtx = static_cast<ucontext_t *>(Ctx);
+#ifdef ZEN_BUILD_TARGET_X86_64
+#ifdef ZEN_BUILD_PLATFORM_DARWIN
+  return {
+      (uintptr_t)((UCtx->uc_mcontext)->__ss.__rip),
+      (uintptr_t)((UCtx->uc_mcontext)->__ss.__rbp),
+      (uintptr_t)((UCtx->uc_mcontext)->__ss.__rsp),
+  };
+#else
+  return {
+      (uintptr_t)((UCtx->uc_mcontext).gregs[REG_RIP]),
+      (uintptr_t)((UCtx->uc_mcontext).gregs[REG_RBP]),
+      (uintptr_t)((UCtx->uc_mcontext).gregs[REG_RSP]),
+  };
+#endif // ZEN_BUILD_PLATFORM_DARWIN
+#else
+#ifdef ZEN_BUILD_PLATFORM_DARWIN
+  return {
+      (uintptr_t)((UCtx->uc_mcontext)->__ss.__pc),
+      (uintptr_t)((UCtx->uc_mcontext)->__ss.__fp),
+      (uintptr_t)((UCtx->uc_mcontext)->__ss.__sp),
+  };
+#else
+  return {
+      (uintptr_t)((UCtx->uc_mcontext).pc),
+      (uintptr_t)((UCtx->uc_mcontext).regs[29]),
+      (uintptr_t)((UCtx->uc_mcontext).sp),
+  };
+#endif // ZEN_BUILD_PLATFORM_DARWIN
+#endif // ZEN_BUILD_TARGET_X86_64
+}
+
+bool isInJITCode(const Module *Mod, uintptr_t Addr) {
+#ifdef ZEN_ENABLE_JIT
+  // The code memory pool of module is reserved once and never moved, so it's
+  // safe to read the boundary in signal handler
+  auto &CodeMPool = const_cast<Module *>(Mod)->getJITCodeMemPool();
+  return Addr >= reinterpret_cast<uintptr_t>(CodeMPool.getMemStart()) &&
+         Addr < reinterpret_cast<uintptr_t>(CodeMPool.getMemPageEnd());
+#else
+  return false;
+#endif // ZEN_ENABLE_JIT
+}
+
+std::string getFuncName(const Module *Mod, uint32_t FuncIdx) {
+  uint32_t NumImportFunctions = Mod->getNumImportFunctions();
+  if (FuncIdx < NumImportFunctions) {
+    const auto &ImportFunc = Mod->getImportFunction(FuncIdx);
+    const char *ModName = Mod->getRuntime()->dumpSymbolString(ImportFunc.ModuleName);
+    const char *FieldName = Mod->getRuntime()->dumpSymbolString(ImportFunc.FieldName);
+    return std::string(ModName ? ModName : "") + "." +
+           (FieldName ? FieldName : "");
+  }
+  const FuncEntry &Func =
+      Mod->getInternalFunction(FuncIdx - NumImportFunctions);
+  if (Func.Name != WASM_SYMBOL_NULL) {
+    if (const char *FuncName = Mod->getRuntime()->dumpSymbolString(Func.Name)) {
+      return FuncName;
+    }
+  }
+  return "$f" + std::to_string(FuncIdx);
+}
+
+} // namespace
+
+WasmProfiler::WasmProfiler(uint32_t SampleIntervalUs, bool CountCalls)
+    : SampleIntervalUs(SampleIntervalUs), CountCalls(CountCalls),
+      Samples(new Sample[MaxNumSamples]) {}
+
+WasmProfiler::~WasmProfiler() { stop(); }
+
+bool WasmProfiler::start() {
+  if (Running) {
+    return true;
+  }
+
+  WasmProfiler *Expected = nullptr;
+  if (!ActiveProfiler.compare_exchange_strong(Expected, this)) {
+    ZEN_LOG_ERROR("another wasm profiler is already running");
+    return false;
+  }
+
+  struct sigaction Handler;
+  std::memset(&Handler, 0, sizeof(Handler));
+  Handler.sa_flags = SA_SIGINFO | SA_RESTART;
+#ifdef ZEN_ENABLE_VIRTUAL_STACK
+  Handler.sa_flags |= SA_ONSTACK;
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+  Handler.sa_sigaction = handleSignal;
+  sigemptyset(&Handler.sa_mask);
+  if (sigaction(SIGPROF, &Handler, &PrevProfAction) != 0) {
+    ZEN_LOG_ERROR("unable to install SIGPROF handler");
+    ActiveProfiler = nullptr;
+    return false;
+  }
+
+  struct itimerval Timer;
+  Timer.it_interval.tv_sec = SampleIntervalUs / 1000000;
+  Timer.it_interval.tv_usec = SampleIntervalUs % 1000000;
+  Timer.it_value = Timer.it_interval;
+  if (setitimer(ITIMER_PROF, &Timer, nullptr) != 0) {
+    ZEN_LOG_ERROR("unable to arm the profiling timer");
+    sigaction(SIGPROF, &PrevProfAction, nullptr);
+    ActiveProfiler = nullptr;
+    return false;
+  }
+
+  Running = true;
+  return true;
+}
+
+void WasmProfiler::stop() {
+  if (!Running) {
+    return;
+  }
+
+  struct itimerval Timer;
+  std::memset(&Timer, 0, sizeof(Timer));
+  setitimer(ITIMER_PROF, &Timer, nullptr);
+  sigaction(SIGPROF, &PrevProfAction, nullptr);
+  ActiveProfiler = nullptr;
+  Running = false;
+
+  uint64_t NumDropped = NumDroppedSamples.load(std::memory_order_relaxed);
+  if (NumDropped > 0) {
+    ZEN_LOG_WARN("wasm profiler dropped %" PRIu64 " samples, increase the "
+                 "sampling interval",
+                 NumDropped);
+  }
+}
+
+void WasmProfiler::handleSignal(int SigNum, siginfo_t *SigInfo, void *UCtx) {
+  int SavedErrno = errno;
+  WasmProfiler *Prof = ActiveProfiler.load(std::memory_order_acquire);
+  WasmProfilerScope *Scope = CurrentScope;
+  // Samples outside of wasm execution are ignored
+  if (Prof && Scope && Scope->Prof == Prof) {
+    Prof->recordSample(*Scope, UCtx);
+  }
+  errno = SavedErrno;
+}
+
+// Async-signal-safe: only touches the preallocated sample buffer and the
+// memory between the interrupted stack pointer and the entry frame
+void WasmProfiler::recordSample(const WasmProfilerScope &Scope, void *UCtx) {
+  uint32_t SampleIdx = NextSample.fetch_add(1, std::memory_order_relaxed) &
+                       (MaxNumSamples - 1);
+  Sample &S = Samples[SampleIdx];
+  // The slot is still pending or being written by another thread when all the
+  // slots are in use
+  uint32_t Expected = SS_Empty;
+  if (!S.State.compare_exchange_strong(Expected, SS_Writing,
+                                       std::memory_order_acquire)) {
+    NumDroppedSamples.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  const Instance *Inst = Scope.Inst;
+  const Module *Mod = Inst->getModule();
+  S.Mod = Mod;
+  S.Depth = 0;
+
+  if (Scope.Context) {
+    S.Kind = SampleKind::Interp;
+    Instance *MutInst = const_cast<Instance *>(Inst);
+    const FunctionInstance *FuncsBegin = MutInst->getFunctionInst(0);
+    const FunctionInstance *FuncsEnd =
+        FuncsBegin + Mod->getNumTotalFunctions();
+    const action::InterpStack *Stack = Scope.Context->getInterpStack();
+    const action::InterpFrame *Frame = Scope.Context->getCurFrame();
+    while (Frame && S.Depth < MaxSampleDepth) {
+      const uint8_t *FramePtr = reinterpret_cast<const uint8_t *>(Frame);
+      if (FramePtr < Stack->Bottom || FramePtr >= Stack->TopBoundary) {
+        break;
+      }
+      const FunctionInstance *FuncInst = Frame->FuncInst;
+      if (FuncInst < FuncsBegin || FuncInst >= FuncsEnd) {
+        break;
+      }
+      S.Frames[S.Depth++] = static_cast<uintptr_t>(FuncInst - FuncsBegin);
+      Frame = Frame->PrevFrame;
+    }
+  } else {
+    S.Kind = SampleKind::JIT;
+    RegisterState Regs = getRegisterState(UCtx);
+    // All valid frame records of this call are between the interrupted stack
+    // pointer and the entry frame, so never dereference outside this range
+    const uintptr_t Low = Regs.SP;
+    const uintptr_t High = reinterpret_cast<uintptr_t>(Scope.EntryFrameAddr);
+    if (isInJITCode(Mod, Regs.PC)) {
+      S.Frames[S.Depth++] = Regs.PC;
+    } else {
+      // Native leaf(host api or runtime helpers) called from wasm
+      S.Frames[S.Depth++] = 0;
+    }
+    uintptr_t FP = Regs.FP;
+    while (S.Depth < MaxSampleDepth && FP >= Low &&
+           FP + 2 * sizeof(uintptr_t) <= High &&
+           (FP & (sizeof(uintptr_t) - 1)) == 0) {
+      const uintptr_t *Record = reinterpret_cast<const uintptr_t *>(FP);
+      uintptr_t RetAddr = Record[1];
+      if (isInJITCode(Mod, RetAddr)) {
+        // Return address may be the start of next function
+        S.Frames[S.Depth++] = RetAddr - 1;
+      }
+      uintptr_t NextFP = Record[0];
+      if (NextFP <= FP) {
+        break;
+      }
+      FP = NextFP;
+    }
+  }
+
+  S.State.store(SS_Ready, std::memory_order_release);
+  NumPendingSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::atomic<uint64_t> *WasmProfiler::getCallCounters(const Module *Mod) {
+  LockGuard<Mutex> Lock(Mtx);
+  auto &Counters = ModuleCallCounters[Mod];
+  if (!Counters) {
+    uint32_t NumFuncs = Mod->getNumTotalFunctions();
+    Counters.reset(new std::atomic<uint64_t>[NumFuncs]);
+    for (uint32_t I = 0; I < NumFuncs; ++I) {
+      Counters[I] = 0;
+    }
+  }
+  return Counters.get();
+}
+
+void WasmProfiler::consumeSamples(const Module *Mod) {
+  // (start address, function index) of JIT functions in ascending order, of
+  // the module being symbolized
+  const Module *JITFuncsMod = nullptr;
+  std::vector<std::pair<uintptr_t, uint32_t>> JITFuncs;
+  auto ResolveJITFunc = [&](const Module *FuncMod, uintptr_t PC) -> int64_t {
+    if (JITFuncsMod != FuncMod) {
+      JITFuncsMod = FuncMod;
+      JITFuncs.clear();
+#ifdef ZEN_ENABLE_JIT
+      uint32_t NumImportFunctions = FuncMod->getNumImportFunctions();
+      for (uint32_t I = NumImportFunctions; I < FuncMod->getNumTotalFunctions();
+           ++I) {
+        const CodeEntry *CE = FuncMod->getCodeEntry(I);
+        if (CE && CE->JITCodePtr) {
+          JITFuncs.emplace_back(reinterpret_cast<uintptr_t>(CE->JITCodePtr),
+                                I);
+        }
+      }
+      std::sort(JITFuncs.begin(), JITFuncs.end());
+#endif // ZEN_ENABLE_JIT
+    }
+    auto It = std::upper_bound(
+        JITFuncs.begin(), JITFuncs.end(), PC,
+        [](uintptr_t Addr, const auto &Item) { return Addr < Item.first; });
+    if (It == JITFuncs.begin()) {
+      return -1;
+    }
+    return std::prev(It)->second;
+  };
+
+  std::vector<std::string> Names;
+  for (uint32_t I = 0; I < MaxNumSamples; ++I) {
+    Sample &S = Samples[I];
+    if (S.State.load(std::memory_order_acquire) != SS_Ready ||
+        (Mod && S.Mod != Mod)) {
+      continue;
+    }
+    const Module *SampleMod = S.Mod;
+    Names.clear();
+    for (uint32_t J = 0; J < S.Depth; ++J) {
+      uintptr_t Frame = S.Frames[J];
+      if (S.Kind == SampleKind::Interp) {
+        Names.push_back(getFuncName(SampleMod, static_cast<uint32_t>(Frame)));
+      } else if (Frame == 0) {
+        Names.emplace_back("[native]");
+      } else if (int64_t FuncIdx = ResolveJITFunc(SampleMod, Frame);
+                 FuncIdx >= 0) {
+        Names.push_back(
+            getFuncName(SampleMod, static_cast<uint32_t>(FuncIdx)));
+      } else {
+        // e.g. stubs of multipass lazy mode
+        Names.emplace_back("[jit]");
+      }
+    }
+    if (!Names.empty()) {
+      std::string Folded;
+      for (auto It = Names.rbegin(); It != Names.rend(); ++It) {
+        if (!Folded.empty()) {
+          Folded += ';';
+        }
+        Folded += *It;
+      }
+      FoldedStacks[Folded]++;
+    }
+    S.State.store(SS_Empty, std::memory_order_release);
+    NumPendingSamples.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+void WasmProfiler::drainSamples() {
+  // Symbolize the samples early so that long runs keep free slots
+  if (NumPendingSamples.load(std::memory_order_relaxed) < MaxNumSamples / 2) {
+    return;
+  }
+  LockGuard<Mutex> Lock(Mtx);
+  consumeSamples(nullptr);
+}
+
+void WasmProfiler::flushModule(const Module *Mod) {
+  ZEN_ASSERT(Mod);
+  LockGuard<Mutex> Lock(Mtx);
+
+  consumeSamples(Mod);
+
+  auto It = ModuleCallCounters.find(Mod);
+  if (It != ModuleCallCounters.end()) {
+    for (uint32_t I = 0; I < Mod->getNumTotalFunctions(); ++I) {
+      uint64_t Count = It->second[I].load(std::memory_order_relaxed);
+      if (Count > 0) {
+        CallCounts[getFuncName(Mod, I)] += Count;
+      }
+    }
+    ModuleCallCounters.erase(It);
+  }
+}
+
+bool WasmProfiler::writeFoldedStacks(const std::string &Filename) {
+  std::vector<std::pair<std::string, uint64_t>> Stacks;
+  {
+    LockGuard<Mutex> Lock(Mtx);
+    Stacks.assign(FoldedStacks.begin(), FoldedStacks.end());
+  }
+  std::sort(Stacks.begin(), Stacks.end());
+
+  std::ofstream File(Filename);
+  if (!File) {
+    ZEN_LOG_ERROR("failed to open profile file '%s'", Filename.c_str());
+    return false;
+  }
+  for (const auto &[Stack, Count] : Stacks) {
+    File << Stack << ' ' << Count << '\n';
+  }
+  return static_cast<bool>(File);
+}
+
+bool WasmProfiler::writeCallCounts(const std::string &Filename) {
+  std::vector<std::pair<std::string, uint64_t>> Counts;
+  {
+    LockGuard<Mutex> Lock(Mtx);
+    Counts.assign(CallCounts.begin(), CallCounts.end());
+  }
+  std::sort(Counts.begin(), Counts.end(), [](const auto &LHS, const auto &RHS) {
+    return LHS.second != RHS.second ? LHS.second > RHS.second
+                                    : LHS.first < RHS.first;
+  });
+
+  std::ofstream File(Filename);
+  if (!File) {
+    ZEN_LOG_ERROR("failed to open call counts file '%s'", Filename.c_str());
+    return false;
+  }
+  for (const auto &[Name, Count] : Counts) {
+    File << Name << ' ' << Count << '\n';
+  }
+  return static_cast<bool>(File);
+}
+
+WasmProfilerScope::WasmProfilerScope(WasmProfiler *Prof, Instance *Inst,
+                                     void *EntryFrameAddr)
+    : Prof(Prof), Inst(Inst), EntryFrameAddr(EntryFrameAddr) {
+  enter();
+}
+
+WasmProfilerScope::WasmProfilerScope(WasmProfiler *Prof, Instance *Inst,
+                                     action::InterpreterExecContext *Context)
+    : Prof(Prof), Inst(Inst), Context(Context) {
+  enter();
+  if (Prof && Prof->isCountingCalls()) {
+    CallCounters = Prof->getCallCounters(Inst->getModule());
+  }
+}
+
+void WasmProfilerScope::enter() {
+  if (!Prof) {
+    return;
+  }
+  Parent = CurrentScope;
+  // Publish the scope after it's fully constructed
+  std::atomic_signal_fence(std::memory_order_release);
+  CurrentScope = this;
+}
+
+WasmProfilerScope::~WasmProfilerScope() {
+  if (!Prof) {
+    return;
+  }
+  CurrentScope = Parent;
+  std::atomic_signal_fence(std::memory_order_release);
+  if (!Parent) {
+    Prof->drainSamples();
+  }
+}
+
+WasmProfilerScope *WasmProfilerScope::current() { return CurrentScope; }
+
+} // namespace zen::runtime
@@ -0,0 +1,164 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+/**
+ * Builtin sampling profiler of wasm functions
+ *
+ * A SIGPROF timer samples the threads executing wasm code. In JIT mode the
+ * sample walks the frame pointer chain of the JIT frames, in interpreter mode
+ * it walks the interpreter frames. Samples are symbolized to wasm function
+ * names lazily and reported in folded-stack format(flamegraph.pl input).
+ */
+
+#ifndef ZEN_RUNTIME_PROFILER_H
+#define ZEN_RUNTIME_PROFILER_H
+
+#include "common/defines.h"
+
+#include <atomic>
+#include <csignal>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace zen {
+
+namespace action {
+class InterpreterExecContext;
+} // namespace action
+
+namespace runtime {
+
+class Instance;
+class Module;
+class WasmProfilerScope;
+
+class WasmProfiler final {
+  friend class WasmProfilerScope;
+
+public:
+  // Max number of frames recorded in one sample
+  static constexpr uint32_t MaxSampleDepth = 32;
+  // Max number of samples pending to be symbolized, a power of 2
+  static constexpr uint32_t MaxNumSamples = 1u << 15;
+
+  WasmProfiler(uint32_t SampleIntervalUs, bool CountCalls);
+
+  ~WasmProfiler();
+
+  NONCOPYABLE(WasmProfiler);
+
+  /// \brief install the SIGPROF handler and arm the sampling timer, only one
+  /// profiler can be running in a process
+  bool start();
+
+  void stop();
+
+  bool isCountingCalls() const { return CountCalls; }
+
+  /// \brief symbolize the pending samples and call counts of the module, must
+  /// be called before the module is destroyed
+  void flushModule(const Module *Mod);
+
+  /// \brief write the aggregated stacks in folded format("a;b;c count")
+  bool writeFoldedStacks(const std::string &Filename);
+
+  /// \brief write the exact call counts("name count"), only collected in
+  /// interpreter mode
+  bool writeCallCounts(const std::string &Filename);
+
+private:
+  enum class SampleKind : uint8_t {
+    JIT,    // frames are native pc
+    Interp, // frames are function indexes
+  };
+
+  enum SampleState : uint32_t {
+    SS_Empty = 0,
+    SS_Writing,
+    SS_Ready,
+  };
+
+  struct Sample {
+    std::atomic<uint32_t> State{SS_Empty};
+    SampleKind Kind;
+    uint32_t Depth;
+    const Module *Mod;
+    // leaf first
+    uintptr_t Frames[MaxSampleDepth];
+  };
+
+  static void handleSignal(int SigNum, siginfo_t *SigInfo, void *UCtx);
+
+  void recordSample(const WasmProfilerScope &Scope, void *UCtx);
+
+  /// \brief symbolize the pending samples of the module(all modules if
+  /// nullptr) and free their slots, the caller must hold Mtx
+  void consumeSamples(const Module *Mod);
+
+  /// \brief consume all the pending samples if the buffer is half full, called
+  /// when leaving the outermost scope
+  void drainSamples();
+
+  std::atomic<uint64_t> *getCallCounters(const Module *Mod);
+
+  const uint32_t SampleIntervalUs;
+  const bool CountCalls;
+
+  bool Running = false;
+
+  // Ring buffer of samples, a slot is reused once its sample is consumed
+  std::unique_ptr<Sample[]> Samples;
+  std::atomic<uint32_t> NextSample{0};
+  std::atomic<uint32_t> NumPendingSamples{0};
+  std::atomic<uint64_t> NumDroppedSamples{0};
+
+  common::Mutex Mtx;
+  // folded stack => number of samples
+  std::unordered_map<std::string, uint64_t> FoldedStacks;
+  // function name => number of calls
+  std::unordered_map<std::string, uint64_t> CallCounts;
+  std::unordered_map<const Module *, std::unique_ptr<std::atomic<uint64_t>[]>>
+      ModuleCallCounters;
+};
+
+/// \brief register the wasm call executing on the current thread, so that the
+/// samples can be attributed to it
+class WasmProfilerScope final {
+  friend class WasmProfiler;
+
+public:
+  // JIT mode, all JIT frames of this call are below EntryFrameAddr
+  WasmProfilerScope(WasmProfiler *Prof, Instance *Inst, void *EntryFrameAddr);
+
+  // Interpreter mode
+  WasmProfilerScope(WasmProfiler *Prof, Instance *Inst,
+                    action::InterpreterExecContext *Context);
+
+  ~WasmProfilerScope();
+
+  NONCOPYABLE(WasmProfilerScope);
+
+  static WasmProfilerScope *current();
+
+  void countCall(uint32_t FuncIdx) {
+    if (CallCounters) {
+      CallCounters[FuncIdx].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  void enter();
+
+  WasmProfiler *Prof = nullptr;
+  Instance *Inst = nullptr;
+  void *EntryFrameAddr = nullptr;
+  action::InterpreterExecContext *Context = nullptr;
+  std::atomic<uint64_t> *CallCounters = nullptr;
+  WasmProfilerScope *Parent = nullptr;
+};
+
+} // namespace runtime
+} // namespace zen
+
+#endif // ZEN_RUNTIME_PROFILER_H
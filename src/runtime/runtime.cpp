@@ -18,6 +18,7 @@
 #include "runtime/module.h"
 #include "runtime/symbol_wrapper.h"
 #include "utils/logging.h"
+#include "utils/others.h"
 #include "utils/statistics.h"
 #ifdef ZEN_ENABLE_VIRTUAL_STACK
 #include "utils/virtual_stack.h"
@@ -29,12 +30,69 @@ namespace zen::runtime {
 using namespace common;
 using namespace utils;
 
+bool Runtime::initRuntime() {
+  if (!SymbolPool.initPool()) {
+    return false;
+  }
+
+#ifndef ZEN_ENABLE_SGX
+  if (Config.NumWasmMemoryPoolSlots > 0) {
+    MemoryPool =
+        std::make_unique<WasmMemoryPool>(Config.NumWasmMemoryPoolSlots);
+    if (!MemoryPool->isValid()) {
+      MemoryPool.reset();
+      return false;
+    }
+  }
+#endif // ZEN_ENABLE_SGX
+
+#ifdef ZEN_ENABLE_VIRTUAL_STACK
+  // The stack pool is shared by all runtimes in the process
+  setMaxRetainedVirtualStacks(Config.NumRetainedVirtualStacks);
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  if (Config.EnableWasmProfiler) {
+    Profiler = std::make_unique<WasmProfiler>(
+        Config.WasmProfilerIntervalUs, Config.EnableWasmProfilerCallCounts);
+    if (!Profiler->start()) {
+      Profiler.reset();
+      return false;
+    }
+  }
+#endif // ZEN_ENABLE_WASM_PROFILER
+
+  return true;
+}
+
+#ifdef ZEN_ENABLE_WASM_PROFILER
+void Runtime::stopWasmProfiler() {
+  if (!Profiler) {
+    return;
+  }
+  Profiler->stop();
+  for (const auto &[Name, Mod] : ModulePool) {
+    Profiler->flushModule(Mod.get());
+  }
+}
+#endif // ZEN_ENABLE_WASM_PROFILER
+
 void Runtime::cleanRuntime() {
 
   Isolations.clear();
 
   HostModulePool.clear();
 
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  stopWasmProfiler();
+#endif // ZEN_ENABLE_WASM_PROFILER
+
+  for (const auto &[Alias, Mod] : ModuleAliases) {
+    freeSymbol(Alias);
+  }
+  ModuleAliases.clear();
+  ModuleAliasNames.clear();
+  ModuleCache.clear();
   ModulePool.clear();
 
   SymbolPool.destroyPool();
@@ -150,12 +208,15 @@ MayBe<Module *> Runtime::loadModule(const std::string &Filename,
   }
 
   WASMSymbol Name = newSymbol(Filename.c_str(), Filename.size());
-  if (auto It = ModulePool.find(Name); It != ModulePool.end()) {
-    return It->second.get();
+  if (Module *Mod = findLoadedModule(Name)) {
+    return Mod;
   }
 
   try {
     auto Code = CodeHolder::newFileCodeHolder(*this, Filename);
+    if (Module *Mod = findCachedModule(Code->getData(), Code->getSize())) {
+      return addModuleAlias(Name, Mod);
+    }
     return loadModule(Name, std::move(Code), EntryHint);
   } catch (const Error &Err) {
     Stats.clearAllTimers();
@@ -172,8 +233,13 @@ MayBe<Module *> Runtime::loadModule(const std::string &ModName,
   }
 
   WASMSymbol Name = newSymbol(ModName.c_str(), ModName.size());
-  if (auto It = ModulePool.find(Name); It != ModulePool.end()) {
-    return It->second.get();
+  if (Module *Mod = findLoadedModule(Name)) {
+    return Mod;
+  }
+
+  // Look up before copying the data
+  if (Module *Mod = findCachedModule(Data, Size)) {
+    return addModuleAlias(Name, Mod);
   }
 
   try {
@@ -186,16 +252,57 @@ MayBe<Module *> Runtime::loadModule(const std::string &ModName,
   }
 }
 
+#ifndef ZEN_ENABLE_SGX
+std::unique_ptr<ModuleStream>
+Runtime::startModuleStream(const std::string &ModName, size_t ModSize,
+                           const std::string &EntryHint) noexcept {
+  if (ModName.empty() || !ModSize) {
+    ZEN_LOG_ERROR("invalid module stream");
+    return nullptr;
+  }
+
+  WASMSymbol Name = newSymbol(ModName.c_str(), ModName.size());
+  if (findLoadedModule(Name)) {
+    ZEN_LOG_ERROR("module '%s' already loaded", ModName.c_str());
+    freeSymbol(Name);
+    return nullptr;
+  }
+
+  try {
+    auto Code = CodeHolder::newStreamCodeHolder(*this, ModSize);
+    return std::unique_ptr<ModuleStream>(
+        new ModuleStream(*this, Name, std::move(Code), EntryHint));
+  } catch (const Error &Err) {
+    ZEN_LOG_ERROR("failed to create module stream: %s",
+                  Err.getFormattedMessage(false).c_str());
+    freeSymbol(Name);
+    return nullptr;
+  }
+}
+#endif // ZEN_ENABLE_SGX
+
 // Before executing this function, it is necessary to ensure that name is unique
 Module *Runtime::loadModule(WASMSymbol Name, CodeHolderUniquePtr CodeHolder,
                             const std::string &EntryHint) {
   ZEN_ASSERT(Name);
   ZEN_ASSERT(CodeHolder);
 
+  // Copy the bytecode before the loader rewrites it
+  std::vector<uint8_t> Bytecode;
+  if (Config.EnableModuleCache) {
+    const auto *Data = static_cast<const uint8_t *>(CodeHolder->getData());
+    Bytecode.assign(Data, Data + CodeHolder->getSize());
+  }
+
   ModuleUniquePtr Mod =
       Module::newModule(*this, std::move(CodeHolder), EntryHint);
   // All errors in Module::newModule are thrown as exceptions, so the return
   // value must be valid when the following line is executed
+  return registerModule(Name, std::move(Mod), std::move(Bytecode));
+}
+
+Module *Runtime::registerModule(WASMSymbol Name, ModuleUniquePtr Mod,
+                                std::vector<uint8_t> Bytecode) {
   ZEN_ASSERT(Mod);
   auto *ModulePtr = Mod.get();
   ModulePtr->setName(Name);
@@ -203,15 +310,78 @@ Module *Runtime::loadModule(WASMSymbol Name, CodeHolderUniquePtr CodeHolder,
   // Ignore the return value, because the name is unique(checked in above)
   auto EmplaceRet =
       ModulePool.emplace(Name, std::forward<ModuleUniquePtr>(Mod));
-  if (EmplaceRet.second) {
-    return EmplaceRet.first->second.get();
+  if (!EmplaceRet.second) {
+    return ModulePtr;
+  }
+
+  if (Config.EnableModuleCache && !Bytecode.empty()) {
+    uint64_t Hash = utils::hashBytes(Bytecode.data(), Bytecode.size());
+    ModuleCache.emplace(Hash, ModuleCacheEntry{ModulePtr, std::move(Bytecode)});
   }
 
-  return ModulePtr;
+  return EmplaceRet.first->second.get();
+}
+
+Module *Runtime::findLoadedModule(WASMSymbol Name) const {
+  if (auto It = ModulePool.find(Name); It != ModulePool.end()) {
+    return It->second.get();
+  }
+  if (auto It = ModuleAliases.find(Name); It != ModuleAliases.end()) {
+    return It->second;
+  }
+  return nullptr;
+}
+
+Module *Runtime::findCachedModule(const void *Data, size_t Size) const {
+  if (!Config.EnableModuleCache || ModuleCache.empty()) {
+    return nullptr;
+  }
+
+  uint64_t Hash = utils::hashBytes(Data, Size);
+  auto [It, End] = ModuleCache.equal_range(Hash);
+  for (; It != End; ++It) {
+    const std::vector<uint8_t> &Bytecode = It->second.Bytecode;
+    // The hash is not collision-resistant, so compare the bytecode
+    if (Bytecode.size() == Size &&
+        std::memcmp(Bytecode.data(), Data, Size) == 0) {
+      return It->second.Mod;
+    }
+  }
+  return nullptr;
+}
+
+Module *Runtime::addModuleAlias(WASMSymbol Name, Module *Mod) {
+  ModuleAliases.emplace(Name, Mod);
+  ModuleAliasNames[Mod].push_back(Name);
+  return Mod;
 }
 
 bool Runtime::unloadModule(const Module *Mod) noexcept {
+  // A shared module is destroyed when its last name is unloaded, the latest
+  // alias is released first
+  if (auto It = ModuleAliasNames.find(Mod); It != ModuleAliasNames.end()) {
+    WASMSymbol Alias = It->second.back();
+    It->second.pop_back();
+    if (It->second.empty()) {
+      ModuleAliasNames.erase(It);
+    }
+    ModuleAliases.erase(Alias);
+    freeSymbol(Alias);
+    return true;
+  }
+
   WASMSymbol Name = Mod->getName();
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  if (Profiler) {
+    Profiler->flushModule(Mod);
+  }
+#endif // ZEN_ENABLE_WASM_PROFILER
+  for (auto It = ModuleCache.begin(); It != ModuleCache.end(); ++It) {
+    if (It->second.Mod == Mod) {
+      ModuleCache.erase(It);
+      break;
+    }
+  }
   return ModulePool.erase(Name) != 0;
 }
 
@@ -439,6 +609,7 @@ bool Runtime::callWasmFunction(Instance &Inst, uint32_t FuncIdx,
   }
 
   auto Timer = Stats.startRecord(utils::StatisticPhase::Execution);
+  uint64_t GasBefore = Inst.getGas();
 
   Inst.protectMemory();
 
@@ -450,6 +621,10 @@ bool Runtime::callWasmFunction(Instance &Inst, uint32_t FuncIdx,
 #endif // !ZEN_ENABLE_VIRTUAL_STACK
 
   Stats.stopRecord(Timer);
+  uint64_t GasAfter = Inst.getGas();
+  if (GasBefore > GasAfter) {
+    Stats.addCounter(utils::StatisticCounter::GasUsed, GasBefore - GasAfter);
+  }
 
   const Error &Err = Inst.getError();
   ErrorCode ErrCode = Err.getCode();
@@ -457,6 +632,7 @@ bool Runtime::callWasmFunction(Instance &Inst, uint32_t FuncIdx,
     if (ErrCode == ErrorCode::InstanceExit) {
       Inst.clearError();
     } else {
+      Stats.addCounter(utils::StatisticCounter::Traps, 1);
 #ifdef ZEN_ENABLE_DUMP_CALL_STACK
       if (Config.Mode == RunMode::SinglepassMode ||
           Config.Mode == RunMode::MultipassMode) {
@@ -505,9 +681,23 @@ void Runtime::callWasmFunctionInInterpMode(Instance &Inst, uint32_t FuncIdx,
 
   BaseInterpreter Interpreter(Context);
   FunctionInstance *Func = Inst.getFunctionInst(FuncIdx);
+  // Report the validation error of a lazy function like other traps
+  if (Func->Lazy) {
+    try {
+      Inst.loadLazyFunction(*Func);
+    } catch (const Error &Err) {
+      Inst.setError(Err);
+      return;
+    }
+  }
   InterpFrame *Frame = Context.allocFrame(Func, (uint32_t *)Bottom);
   ZEN_ASSERT(Frame != nullptr);
 
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  WasmProfilerScope ProfScope(Profiler.get(), &Inst, &Context);
+  ProfScope.countCall(FuncIdx);
+#endif // ZEN_ENABLE_WASM_PROFILER
+
   Inst.getRuntime()->startCPUTracing();
   try {
     Interpreter.interpret();
@@ -557,6 +747,17 @@ void Runtime::callWasmFunctionInJITMode(Instance &Inst, uint32_t FuncIdx,
   auto FuncPtr =
       GenericFunctionPointer(IsImport ? Func->CodePtr : Func->JITCodePtr);
 
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+  if (!Config.MultipassProfileDir.empty()) {
+    Inst.getModule()->recordJITEntry(FuncIdx);
+  }
+#endif // ZEN_ENABLE_MULTIPASS_JIT
+
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  WasmProfilerScope ProfScope(Profiler.get(), &Inst,
+                              __builtin_frame_address(0));
+#endif // ZEN_ENABLE_WASM_PROFILER
+
 #ifdef ZEN_ENABLE_CPU_EXCEPTION
   jmp_buf JmpBuf;
   common::traphandler::CallThreadState TLS(&Inst, &JmpBuf,
@@ -634,14 +835,17 @@ void Runtime::callWasmFunctionInJITMode(Instance &Inst, uint32_t FuncIdx,
         break;
       }
       default: {
-        // SIGILL not process here. the traces set by Instance::setException
+        // SoftwareTrapJmpValue not process here. the error and traces set by
+        // Instance::setExecutionError
         break;
       }
       }
       if (Inst.getError().getCode() == ErrorCode::GasLimitExceeded) {
         Inst.setGas(0);
-      } else if (Config.Mode == RunMode::SinglepassMode) {
-        // restore gas left from register when trap in singlepass JIT mode
+      } else if (Config.Mode == RunMode::SinglepassMode &&
+                 JmpSignum != common::traphandler::SoftwareTrapJmpValue) {
+        // restore gas left from register when trap in singlepass JIT mode,
+        // the software traps have saved it to the instance
         Inst.setGas(TLS.getGasRegisterValue());
       }
       if (CapturedTapErrCode != ErrorCode::NoError) {
@@ -11,10 +11,19 @@
 #include "common/type.h"
 #include "runtime/config.h"
 #include "runtime/destroyer.h"
+#include "runtime/memory.h"
 #include "runtime/vnmi.h"
 #include "utils/logging.h"
 #include "utils/statistics.h"
 
+#ifndef ZEN_ENABLE_SGX
+#include "runtime/module_stream.h"
+#endif
+
+#ifdef ZEN_ENABLE_WASM_PROFILER
+#include "runtime/profiler.h"
+#endif
+
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -135,6 +144,18 @@ public:
   loadModule(const std::string &ModName, const void *Data, size_t DataSize,
              const std::string &EntryHint = "") noexcept;
 
+#ifndef ZEN_ENABLE_SGX
+  /// \brief start loading a module whose data is fed chunk by chunk, see
+  /// ModuleStream
+  /// \param ModSize the total size of the module
+  /// \return nullptr if the name is used or the size is invalid
+  /// \warning not thread-safe, and no other module should be loaded or
+  /// unloaded until the stream is finished
+  std::unique_ptr<ModuleStream>
+  startModuleStream(const std::string &ModName, size_t ModSize,
+                    const std::string &EntryHint = "") noexcept;
+#endif // ZEN_ENABLE_SGX
+
   /// \warning not thread-safe
   bool unloadModule(const Module *Mod) noexcept;
 
@@ -280,6 +301,20 @@ public:
 
   utils::Statistics &getStatistics() { return Stats; }
 
+#ifndef ZEN_ENABLE_SGX
+  /// \brief nullptr if Config.NumWasmMemoryPoolSlots is 0
+  WasmMemoryPool *getWasmMemoryPool() const { return MemoryPool.get(); }
+#endif // ZEN_ENABLE_SGX
+
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  /// \brief nullptr if wasm profiler not enabled
+  WasmProfiler *getWasmProfiler() const { return Profiler.get(); }
+
+  /// \brief stop sampling and symbolize the samples of all loaded modules,
+  /// called before writing the profile
+  void stopWasmProfiler();
+#endif
+
   void startCPUTracing();
 
   void endCPUTracing();
@@ -290,16 +325,31 @@ public:
 
   /* **************** [End] Runtime Tool Methods  **************** */
 private:
+  friend class ModuleStream;
+
   Runtime(const RuntimeConfig &Configuration)
       : Config(Configuration), Stats(Config.EnableStatistics) {}
 
-  bool initRuntime() { return SymbolPool.initPool(); }
+  bool initRuntime();
 
   void cleanRuntime();
 
   Module *loadModule(WASMSymbol ModName, CodeHolderUniquePtr CodeHolder,
                      const std::string &EntryHint = "");
 
+  // Bytecode is the module bytes before loading, which rewrites some opcodes
+  // in place, it's kept for the module cache
+  Module *registerModule(WASMSymbol Name, ModuleUniquePtr Mod,
+                         std::vector<uint8_t> Bytecode = {});
+
+  // Search both the module names and the alias names
+  Module *findLoadedModule(WASMSymbol Name) const;
+
+  // Find the module with the same bytecode if Config.EnableModuleCache
+  Module *findCachedModule(const void *Data, size_t Size) const;
+
+  Module *addModuleAlias(WASMSymbol Name, Module *Mod);
+
   void callWasmFunctionInInterpMode(Instance &Inst, uint32_t FuncIdx,
                                     const std::vector<TypedValue> &Args,
                                     std::vector<common::TypedValue> &Results);
@@ -320,6 +370,16 @@ private:
   std::unordered_map<WASMSymbol, HostModuleUniquePtr> HostModulePool;
   // multiple module mode
   std::unordered_map<WASMSymbol, ModuleUniquePtr> ModulePool;
+  struct ModuleCacheEntry {
+    Module *Mod;
+    std::vector<uint8_t> Bytecode;
+  };
+  // bytecode hash => module, only used if Config.EnableModuleCache
+  std::unordered_multimap<uint64_t, ModuleCacheEntry> ModuleCache;
+  // alias name => module loaded by another name with identical bytecode
+  std::unordered_map<WASMSymbol, Module *> ModuleAliases;
+  // module => alias names in loading order
+  std::unordered_map<const Module *, std::vector<WASMSymbol>> ModuleAliasNames;
 
   std::unordered_map<Isolation *, IsolationUniquePtr> Isolations;
 
@@ -347,6 +407,15 @@ private:
   RuntimeConfig Config;
 
   utils::Statistics Stats;
+
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  std::unique_ptr<WasmProfiler> Profiler;
+#endif
+
+#ifndef ZEN_ENABLE_SGX
+  // Destroyed after all the instances(in cleanRuntime)
+  std::unique_ptr<WasmMemoryPool> MemoryPool;
+#endif // ZEN_ENABLE_SGX
 };
 
 } // namespace zen::runtime
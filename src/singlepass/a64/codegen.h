@@ -216,25 +216,7 @@ private:
 
   // epilog
   void emitEpilog(Operand Op) {
-    saveGasVal();
-
-#ifdef ZEN_ENABLE_DWASM
-    // update stack cost
-    auto StackCostAddr = asmjit::a64::ptr(
-        ABI.getModuleInstReg(), Ctx->Mod->getLayout().StackCostOffset);
-    auto StackCostReg = Layout.getScopedTempReg<A64::I32, ScopedTempReg0>();
-    _ ldr(StackCostReg, StackCostAddr);
-    uint32_t StackCost = Ctx->Func->JITStackCost;
-    if (!isArithImmValid(StackCost)) {
-      auto CurFuncStackCostReg =
-          A64Reg::getRegRef<A64::I32>(ABI.getScratchRegNum());
-      _ mov(CurFuncStackCostReg, StackCost);
-      _ sub(StackCostReg, StackCostReg, CurFuncStackCostReg);
-    } else if (ZEN_LIKELY(StackCost > 0)) {
-      _ sub(StackCostReg, StackCostReg, Ctx->Func->JITStackCost);
-    }
-    _ str(StackCostReg, StackCostAddr);
-#endif
+    saveStateOnExit();
 
     if (Layout.getNumReturns() > 0) {
       ZEN_ASSERT(Layout.getNumReturns() == 1);
@@ -260,6 +242,38 @@ private:
       }
     }
 
+    releaseFrame();
+    _ ret(ABI.getLinkAddressReg());
+  } // EmitEpilog
+
+  // save the gas and release the stack cost of the current function, shared
+  // by return and tail call. Uses the scoped temp registers
+  void saveStateOnExit() {
+    saveGasVal();
+
+#ifdef ZEN_ENABLE_DWASM
+    // update stack cost
+    auto StackCostAddr = asmjit::a64::ptr(
+        ABI.getModuleInstReg(), Ctx->Mod->getLayout().StackCostOffset);
+    auto StackCostReg = Layout.getScopedTempReg<A64::I32, ScopedTempReg0>();
+    _ ldr(StackCostReg, StackCostAddr);
+    uint32_t StackCost = Ctx->Func->JITStackCost;
+    if (!isArithImmValid(StackCost)) {
+      auto CurFuncStackCostReg =
+          A64Reg::getRegRef<A64::I32>(ABI.getScratchRegNum());
+      _ mov(CurFuncStackCostReg, StackCost);
+      _ sub(StackCostReg, StackCostReg, CurFuncStackCostReg);
+    } else if (ZEN_LIKELY(StackCost > 0)) {
+      _ sub(StackCostReg, StackCostReg, Ctx->Func->JITStackCost);
+    }
+    _ str(StackCostReg, StackCostAddr);
+#endif
+  }
+
+  // restore the preserved registers, the frame base, the link register and the
+  // stack pointer to the state at entry, shared by return and tail call. The
+  // param and return registers are left untouched
+  void releaseFrame() {
     // restore preserved registers
     for (uint32_t I = 0; I < Layout.getIntPresSavedCount(); ++I) {
       const A64::GP Reg = ABI.getPresRegNum<A64::I64>(I);
@@ -271,8 +285,7 @@ private:
     // restore stack
     _ ldp(ABI.getFrameBaseReg(), ABI.getLinkAddressReg(),
           asmjit::a64::ptr_post(ABI.getStackPointerReg(), 16));
-    _ ret(ABI.getLinkAddressReg());
-  } // EmitEpilog
+  }
 
   template <uint32_t AddrRegIndex, uint32_t SizeRegIndex, uint32_t CmpRegIndex>
   void emitGetTableAddress(uint32_t TblIdx, Operand EntryIdx) {
@@ -784,9 +797,9 @@ public:
     ZEN_ASSERT(LHS.getType() == RHS.getType());
     switch (LHS.getType()) {
     case WASMType::I32:
-      return fusedCompareSelectWithIf<WASMType::I32, Opr>(LHS, RHS, Xchg);
+      return fusedCompareSelectWithCSel<WASMType::I32, Opr>(LHS, RHS, Xchg);
     case WASMType::I64:
-      return fusedCompareSelectWithIf<WASMType::I64, Opr>(LHS, RHS, Xchg);
+      return fusedCompareSelectWithCSel<WASMType::I64, Opr>(LHS, RHS, Xchg);
     case WASMType::F32:
       return fusedCompareSelectWithIf<WASMType::F32, Opr>(LHS, RHS, Xchg);
     case WASMType::F64:
@@ -985,6 +998,14 @@ public:
       return;
     }
 
+    // trailing entries going to the default label are left to the bound
+    // check
+    Bound = getBranchTableBound(LabelIdxs);
+    if (Bound == 0) {
+      branch(LabelIdxs.back());
+      return;
+    }
+
     // load index into register if necessary
     A64::RegNum IndexRegNum = toReg<A64::I32, ScopedTempReg1>(Index);
     // compare index with bound
@@ -994,32 +1015,20 @@ public:
     cmp<A64::I32, ScopedTempReg2, ScopedTempReg2>(
         IndexRegOp, Operand(WASMType::I32, Bound), Exchanged);
     // jump to default label if index >= bound
-    jmpcc<CompareOperator::CO_GE_U, true>(LabelIdxs[Bound]);
-
-    // for small tables, generate if (index == i) goto i;
-    switch (Bound) {
-    case 4:
-      cmp<A64::I32, ScopedTempReg2, ScopedTempReg2>(
-          IndexRegOp, Operand(WASMType::I32, 3), Exchanged);
-      jmpcc<CompareOperator::CO_EQ, true>(LabelIdxs[3]);
-      // fall through
-    case 3:
-      cmp<A64::I32, ScopedTempReg2, ScopedTempReg2>(
-          IndexRegOp, Operand(WASMType::I32, 2), Exchanged);
-      jmpcc<CompareOperator::CO_EQ, true>(LabelIdxs[2]);
-      // fall through
-    case 2:
-      cmp<A64::I32, ScopedTempReg2, ScopedTempReg2>(
-          IndexRegOp, Operand(WASMType::I32, 1), Exchanged);
-      jmpcc<CompareOperator::CO_EQ, true>(LabelIdxs[1]);
-      // fall through
-    case 1:
-      cmp<A64::I32, ScopedTempReg2, ScopedTempReg2>(
-          IndexRegOp, Operand(WASMType::I32, 0), Exchanged);
-      jmpcc<CompareOperator::CO_EQ, true>(LabelIdxs[0]);
+    jmpcc<CompareOperator::CO_GE_U, true>(LabelIdxs.back());
+
+    // for tables with few runs of entries going to the same label, generate
+    // if (index <= run_end) goto run_label;
+    std::vector<uint32_t> RunEnds;
+    if (getBranchTableRuns(LabelIdxs, Bound, MaxBranchTableCompareRuns,
+                           RunEnds)) {
+      for (size_t I = 0; I + 1 < RunEnds.size(); ++I) {
+        cmp<A64::I32, ScopedTempReg2, ScopedTempReg2>(
+            IndexRegOp, Operand(WASMType::I32, RunEnds[I]), Exchanged);
+        jmpcc<CompareOperator::CO_LE_U, true>(LabelIdxs[RunEnds[I]]);
+      }
+      branch(LabelIdxs[RunEnds.back()]);
       return;
-    default:
-      break;
     }
 
     // jump to entry in jump table
@@ -1030,7 +1039,8 @@ public:
                              asmjit::a64::lsl(sizeof(uintptr_t) == 4 ? 2 : 3));
     _ ldr(JmpReg, JmpAddr);
     _ br(JmpReg);
-    emitJumpTable(Table, LabelIdxs);
+    emitJumpTable(Table, std::vector<uint32_t>(LabelIdxs.begin(),
+                                               LabelIdxs.begin() + Bound));
   }
 
   // call
@@ -1173,6 +1183,103 @@ public:
         });
   }
 
+  // tail call, jump to the callee or record relocation for patching
+  void handleReturnCallImpl(uint32_t FuncIdx, bool FarCall,
+                            const ArgumentInfo &ArgInfo,
+                            const std::vector<Operand> &Args) {
+    emitTailCall(
+        ArgInfo, Args, [] {},
+        [&]() {
+          size_t Offset = _ offset();
+          _ nop();
+          if (FarCall) {
+            _ nop();
+            _ nop();
+            _ nop();
+            ZEN_ASSERT(_ offset() - Offset == 16);
+          } else {
+            ZEN_ASSERT(_ offset() - Offset == 4);
+          }
+          Patcher.addJumpEntry(Offset, _ offset() - Offset, FuncIdx);
+        });
+  }
+
+  // tail call indirect, the imported functions found in the table are called
+  // before returning as in handleReturnCall
+  void handleReturnCallIndirectImpl(uint32_t TypeIdx, Operand Callee,
+                                    uint32_t TblIdx,
+                                    const ArgumentInfo &ArgInfo,
+                                    const std::vector<Operand> &Args) {
+    uint32_t NumHostAPIs = Ctx->Mod->getNumImportFunctions();
+    uint32_t HostCallLabel = NumHostAPIs > 0 ? createLabel() : InvalidLabelId;
+    emitTailCall(
+        ArgInfo, Args,
+        // check and load Callee address into x24, which isn't restored by
+        // releaseFrame
+        [this, NumHostAPIs, HostCallLabel, TypeIdx, Callee, TblIdx]() {
+          auto FuncIdxReg = Layout.getScopedTemp<A64::I32, ScopedTempReg0>();
+          emitTableGet(TblIdx, Callee, FuncIdxReg);
+          auto FuncIdx = A64Reg::getRegRef<A64::I32>(FuncIdxReg);
+          auto InstReg = ABI.getModuleInstReg();
+          uint32_t CheckFuncType = createLabel();
+          bool Exchanged;
+          cmp<A64::I32, ScopedTempReg2, ScopedTempReg2>(
+              Operand(WASMType::I32, FuncIdxReg, Operand::FLAG_NONE),
+              Operand(WASMType::I32, -1), Exchanged);
+          jmpcc<CompareOperator::CO_NE, true>(CheckFuncType);
+          emitRuntimeError(ErrorCode::UninitializedElement);
+
+          bindLabel(CheckFuncType);
+          auto TypeIdxs = Layout.getScopedTempReg<A64::I64, ScopedTempReg2>();
+          asmjit::a64::Mem TypeIdxsAddr(InstReg, FunctionTypesOffset);
+          _ ldr(TypeIdxs, TypeIdxsAddr);
+
+          asmjit::a64::Mem TypeIdxAddr(TypeIdxs, FuncIdx, asmjit::a64::lsl(2));
+          auto ActualTypeIdx =
+              Layout.getScopedTempReg<A64::I32, ScopedTempReg2>();
+          _ ldr(ActualTypeIdx, TypeIdxAddr);
+
+          uint32_t CheckSucc = createLabel();
+          _ cmp(ActualTypeIdx, TypeIdx);
+          jmpcc<CompareOperator::CO_EQ, true>(CheckSucc);
+          emitRuntimeError(ErrorCode::IndirectCallTypeMismatch);
+          bindLabel(CheckSucc);
+
+          if (NumHostAPIs > 0) {
+            // The immediate value in the cmp instruction is 12-bit
+            if (ZEN_LIKELY(isArithImmValid(NumHostAPIs))) {
+              _ cmp(FuncIdx, NumHostAPIs);
+            } else {
+              auto NumHostAPIsReg =
+                  Layout.getScopedTempReg<A64::I32, ScopedTempReg1>();
+              _ mov(NumHostAPIsReg, NumHostAPIs);
+              _ cmp(FuncIdx, NumHostAPIsReg);
+            }
+            branchLTU(HostCallLabel);
+          }
+
+          auto FuncPtrs = Layout.getScopedTempReg<A64::I64, ScopedTempReg2>();
+          asmjit::a64::Mem FuncPtrsAddr(InstReg, FunctionPointersOffset);
+          _ ldr(FuncPtrs, FuncPtrsAddr);
+
+          auto FuncPtr = ABI.getCallTargetReg();
+          constexpr uint32_t Shift = sizeof(void *) == 4 ? 2 : 3;
+          asmjit::a64::Mem FuncPtrAddr(FuncPtrs, FuncIdx,
+                                       asmjit::a64::lsl(Shift));
+          _ ldr(FuncPtr, FuncPtrAddr);
+        },
+        [&]() { _ br(ABI.getCallTargetReg()); });
+
+    if (NumHostAPIs > 0) {
+      // nothing is changed before the branch but the scoped temp registers
+      bindLabel(HostCallLabel);
+      Operand Result =
+          handleCallIndirectImpl(TypeIdx, Callee, TblIdx, ArgInfo, Args);
+      releaseOperand(Result);
+      emitEpilog(Result);
+    }
+  }
+
   // branch to label if ZF is 0
   void je(uint32_t LabelIdx) {
     asmjit::Label L(LabelIdx);
@@ -1198,6 +1305,43 @@ public:
 
   // in alphabetical order
 
+#ifndef ZEN_ENABLE_SGX
+  // atomic instructions, wait and notify block or wake threads in the runtime,
+  // the others are lowered to acquire/release and exclusive instructions
+  Operand handleAtomicImpl(uint32_t Opcode, Operand Base, uint32_t Offset,
+                           Operand Arg1, Operand Arg2) {
+    if (Opcode < common::I32_ATOMIC_LOAD) {
+      return emitAtomicCall(Opcode, Base, Offset, Arg1, Arg2);
+    }
+    runtime::AtomicOpKind Kind = runtime::getAtomicOpKind(Opcode);
+    bool Is64 = runtime::isAtomicOp64(Opcode);
+    switch (runtime::getAtomicAccessSize(Opcode)) {
+    case 1:
+      return Is64 ? emitAtomicAccess<WASMType::I64, A64::I8>(Kind, Base, Offset,
+                                                             Arg1, Arg2)
+                  : emitAtomicAccess<WASMType::I32, A64::I8>(Kind, Base, Offset,
+                                                             Arg1, Arg2);
+    case 2:
+      return Is64 ? emitAtomicAccess<WASMType::I64, A64::I16>(
+                        Kind, Base, Offset, Arg1, Arg2)
+                  : emitAtomicAccess<WASMType::I32, A64::I16>(
+                        Kind, Base, Offset, Arg1, Arg2);
+    case 4:
+      return Is64 ? emitAtomicAccess<WASMType::I64, A64::I32>(
+                        Kind, Base, Offset, Arg1, Arg2)
+                  : emitAtomicAccess<WASMType::I32, A64::I32>(
+                        Kind, Base, Offset, Arg1, Arg2);
+    default:
+      return emitAtomicAccess<WASMType::I64, A64::I64>(Kind, Base, Offset, Arg1,
+                                                       Arg2);
+    }
+  }
+
+  // ldar/stlr and the exclusive pairs are sequentially consistent among
+  // themselves, the fence also orders plain accesses
+  void handleAtomicFenceImpl() { _ dmb(asmjit::a64::Predicate::DB::kISH); }
+#endif // ZEN_ENABLE_SGX
+
   // memory grow
   Operand handleMemoryGrowImpl(Operand Op) {
     static TypeEntry SigBuf = {
@@ -1250,9 +1394,17 @@ public:
                Cond.getType() == WASMType::I64);
     switch (LHS.getType()) {
     case WASMType::I32:
-      return selectWithIf<WASMType::I32>(Cond, LHS, RHS);
     case WASMType::I64:
-      return selectWithIf<WASMType::I64>(Cond, LHS, RHS);
+      // select by cond != 0 with csel
+      if (Cond.getType() == WASMType::I32) {
+        return handleFusedCompareSelectImpl<WASMType::I32,
+                                            CompareOperator::CO_NE>(
+            Cond, Operand(WASMType::I32, A64::XZR, Operand::FLAG_NONE), LHS,
+            RHS);
+      }
+      return handleFusedCompareSelectImpl<WASMType::I64,
+                                          CompareOperator::CO_NE>(
+          Cond, Operand(WASMType::I64, A64::XZR, Operand::FLAG_NONE), LHS, RHS);
     case WASMType::F32:
       return selectWithIf<WASMType::F32>(Cond, LHS, RHS);
     case WASMType::F64:
@@ -1535,6 +1687,34 @@ private:
     return Ret;
   }
 
+  // fused compare and select for integer, the flags are set by the compare
+  template <WASMType Type, CompareOperator Opr>
+  Operand fusedCompareSelectWithCSel(Operand LHS, Operand RHS,
+                                     bool Exchanged) {
+    constexpr auto A64Type = getA64TypeFromWASMType<Type>();
+    // loading the operands doesn't change the flags
+    auto LHSReg = toRegRef<A64Type, ScopedTempReg0>(LHS);
+    auto RHSReg = toRegRef<A64Type, ScopedTempReg1>(RHS);
+    auto RegNum = Layout.getScopedTemp<A64Type, ScopedTempReg2>();
+    auto ResReg = A64Reg::getRegRef<A64Type>(RegNum);
+
+    if (Exchanged) {
+      constexpr auto ExchangedOpr = getExchangedCompareOperator<Opr>();
+      constexpr auto SelccOpr = getSelccOperator<ExchangedOpr>();
+      SelccOperatorImpl<A64Type, SelccOpr, true>::emit(ASM, ResReg, LHSReg,
+                                                       RHSReg);
+    } else {
+      constexpr auto SelccOpr = getSelccOperator<Opr>();
+      SelccOperatorImpl<A64Type, SelccOpr, true>::emit(ASM, ResReg, LHSReg,
+                                                       RHSReg);
+    }
+
+    auto Ret = getTempOperand(Type);
+    ZEN_ASSERT(!Ret.isImm());
+    mov<A64Type>(Ret, RegNum);
+    return Ret;
+  }
+
   template <WASMType Type, CompareOperator Opr>
   Operand fusedCompareSelectWithIf(Operand LHS, Operand RHS, bool Exchanged) {
     constexpr auto A64Type = getA64TypeFromWASMType<Type>();
@@ -1636,6 +1816,161 @@ private:
     }
   }
 
+#ifndef ZEN_ENABLE_SGX
+  // atomic access of MemType at base + offset, values in ValType. x0 holds
+  // the absolute address, x1 and x2 the operands, the exclusive loops keep
+  // the old value in x24 and the store status in w23, which are only used
+  // within a single instruction elsewhere
+  template <WASMType ValType, A64::Type MemType>
+  Operand emitAtomicAccess(runtime::AtomicOpKind Kind, Operand Base,
+                           uint32_t Offset, Operand Arg1, Operand Arg2) {
+    using runtime::AtomicOpKind;
+    constexpr A64::Type A64ValType = getA64TypeFromWASMType<ValType>();
+    // narrow accesses operate on w registers, which zero extend the results
+    constexpr A64::Type OpType = MemType == A64::I64 ? A64::I64 : A64::I32;
+    constexpr uint32_t Size = A64TypeAttr<MemType>::Size;
+    ZEN_ASSERT(Base.getType() == A64OnePassABI::WASMAddrType);
+
+    auto AddrRegNum = Layout.getScopedTemp<A64::I64, ScopedTempReg0>();
+    auto ValRegNum = Layout.getScopedTemp<A64::I64, ScopedTempReg1>();
+    auto NewRegNum = Layout.getScopedTemp<A64::I64, ScopedTempReg2>();
+    auto AddrReg = A64Reg::getRegRef<A64::I64>(AddrRegNum);
+    auto ValReg = A64Reg::getRegRef<OpType>(ValRegNum);
+    auto NewReg = A64Reg::getRegRef<OpType>(NewRegNum);
+    auto OldReg = A64Reg::getRegRef<OpType>(ABI.getCallTarget());
+    auto StatusReg = A64Reg::getRegRef<A64::I32>(ABI.getScratchRegNum());
+
+    // the 32-bit mov zero extends base to 64 bits, so base + offset can't
+    // wrap around
+    mov<A64::I32>(AddrRegNum, Base);
+    if (!isArithImmValid(Offset)) {
+      _ mov(A64Reg::getRegRef<A64::I64>(NewRegNum), Offset);
+      _ add(AddrReg, AddrReg, A64Reg::getRegRef<A64::I64>(NewRegNum));
+    } else if (Offset > 0) {
+      _ add(AddrReg, AddrReg, Offset);
+    }
+    if (Ctx->UseSoftMemCheck) {
+      auto Bound = A64Reg::getRegRef<A64::I64>(NewRegNum);
+      _ add(Bound, AddrReg, Size);
+      auto InBounds = createLabel();
+      _ cmp(Bound, ABI.getMemorySizeReg());
+      _ b_ls(asmjit::Label(InBounds));
+      emitRuntimeError(ErrorCode::OutOfBoundsMemory);
+      bindLabel(InBounds);
+    }
+    if (Size > 1) {
+      auto Aligned = createLabel();
+      _ tst(AddrReg, Size - 1);
+      _ b_eq(asmjit::Label(Aligned));
+      emitRuntimeError(ErrorCode::UnalignedAtomic);
+      bindLabel(Aligned);
+    }
+    // the exclusive and acquire/release instructions take no offset
+    _ add(AddrReg, AddrReg, ABI.getMemoryBaseReg());
+    auto Addr = asmjit::a64::ptr(AddrReg);
+
+    auto LoadAcquire = [&](const A64RegType<OpType> &Reg) {
+      if constexpr (Size == 1) {
+        _ ldarb(Reg, Addr);
+      } else if constexpr (Size == 2) {
+        _ ldarh(Reg, Addr);
+      } else {
+        _ ldar(Reg, Addr);
+      }
+    };
+    auto LoadExclusive = [&](const A64RegType<OpType> &Reg) {
+      if constexpr (Size == 1) {
+        _ ldaxrb(Reg, Addr);
+      } else if constexpr (Size == 2) {
+        _ ldaxrh(Reg, Addr);
+      } else {
+        _ ldaxr(Reg, Addr);
+      }
+    };
+    auto StoreExclusive = [&](const A64RegType<OpType> &Reg) {
+      if constexpr (Size == 1) {
+        _ stlxrb(StatusReg, Reg, Addr);
+      } else if constexpr (Size == 2) {
+        _ stlxrh(StatusReg, Reg, Addr);
+      } else {
+        _ stlxr(StatusReg, Reg, Addr);
+      }
+    };
+
+    if (Kind == AtomicOpKind::Load) {
+      LoadAcquire(ValReg);
+      auto Ret = getTempOperand(ValType);
+      mov<A64ValType>(Ret, ValRegNum);
+      return Ret;
+    }
+
+    mov<A64ValType>(ValRegNum, Arg1);
+    if (Kind == AtomicOpKind::Store) {
+      if constexpr (Size == 1) {
+        _ stlrb(ValReg, Addr);
+      } else if constexpr (Size == 2) {
+        _ stlrh(ValReg, Addr);
+      } else {
+        _ stlr(ValReg, Addr);
+      }
+      return Operand();
+    }
+
+    asmjit::Label Retry = _ newLabel();
+    if (Kind == AtomicOpKind::Cmpxchg) {
+      // the expected value is wrapped to the accessed width like the loaded
+      if constexpr (Size == 1) {
+        _ uxtb(ValReg, ValReg);
+      } else if constexpr (Size == 2) {
+        _ uxth(ValReg, ValReg);
+      }
+      mov<A64ValType>(NewRegNum, Arg2);
+      asmjit::Label Fail = _ newLabel();
+      asmjit::Label Done = _ newLabel();
+      _ bind(Retry);
+      LoadExclusive(OldReg);
+      _ cmp(OldReg, ValReg);
+      _ b_ne(Fail);
+      StoreExclusive(NewReg);
+      _ cbnz(StatusReg, Retry);
+      _ b(Done);
+      _ bind(Fail);
+      _ clrex();
+      _ bind(Done);
+    } else {
+      _ bind(Retry);
+      LoadExclusive(OldReg);
+      switch (Kind) {
+      case AtomicOpKind::Add:
+        _ add(NewReg, OldReg, ValReg);
+        break;
+      case AtomicOpKind::Sub:
+        _ sub(NewReg, OldReg, ValReg);
+        break;
+      case AtomicOpKind::And:
+        _ and_(NewReg, OldReg, ValReg);
+        break;
+      case AtomicOpKind::Or:
+        _ orr(NewReg, OldReg, ValReg);
+        break;
+      case AtomicOpKind::Xor:
+        _ eor(NewReg, OldReg, ValReg);
+        break;
+      case AtomicOpKind::Xchg:
+        break;
+      default:
+        ZEN_ABORT();
+      }
+      StoreExclusive(Kind == AtomicOpKind::Xchg ? ValReg : NewReg);
+      _ cbnz(StatusReg, Retry);
+    }
+
+    auto Ret = getTempOperand(ValType);
+    mov<A64ValType>(Ret, ABI.getCallTarget());
+    return Ret;
+  }
+#endif // ZEN_ENABLE_SGX
+
   // compare and branch on zero or non-zero
   template <A64::Type Ty, bool Zero, uint32_t TempRegIndex>
   void compareBranch(Operand Op, uint32_t LabelIdx) {
@@ -19,12 +19,13 @@
 namespace zen::singlepass {
 // ============================================================================
 // PatchInfo
-// manage info to patch call instructions
+// manage info to patch call and tail call instructions
 // ============================================================================
 class PatchInfo {
 public:
   enum PatchKind {
     PK_CALL = 0, // patch direct call
+    PK_JUMP = 1, // patch direct tail call
   };
 
 private:
@@ -58,6 +59,10 @@ public:
     Entries.push_back(PatchEntry(PK_CALL, Offset, Size, Callee));
   }
 
+  void addJumpEntry(uint32_t Offset, uint32_t Size, uint32_t Callee) {
+    Entries.push_back(PatchEntry(PK_JUMP, Offset, Size, Callee));
+  }
+
   uintptr_t getFunctionAddress() const { return (uintptr_t)Func->JITCodePtr; }
 
 public:
@@ -195,6 +200,12 @@ public:
                                    Callee - Mod->getNumImportFunctions());
   }
 
+  void addJumpEntry(uint32_t Offset, uint32_t Size, uint32_t Callee) {
+    ZEN_ASSERT(PatchInfos.size() > 0);
+    PatchInfos.back().addJumpEntry(Offset, Size,
+                                   Callee - Mod->getNumImportFunctions());
+  }
+
   void finalizeModule() {
     for (auto It = PatchInfos.begin(), E = PatchInfos.end(); It != E; ++It) {
       uint8_t *Base = (uint8_t *)It->getFunctionAddress();
@@ -202,14 +213,15 @@ public:
       for (auto P = It->begin(), EE = It->end(); P != EE; ++P) {
         ZEN_ASSERT(P->getSize() == 4 || P->getSize() == 16);
         ZEN_ASSERT(P->getArg() < PatchInfos.size());
-        ZEN_ASSERT(P->getKind() == PatchInfo::PK_CALL);
+        bool IsCall = P->getKind() == PatchInfo::PK_CALL;
+        ZEN_ASSERT(IsCall || P->getKind() == PatchInfo::PK_JUMP);
         uint8_t *Target = (uint8_t *)getFunctionAddress(P->getArg());
         int64_t Diff = (int64_t)Target - (int64_t)(Base + P->getOffset());
         uint32_t *Patch = (uint32_t *)(Base + P->getOffset());
         ZEN_ASSERT((Diff & 0x3) == 0);             // 4 byte aligned
         ZEN_ASSERT(((uintptr_t)Patch & 0x3) == 0); // 4 byte aligned
 
-        // BL instruction encoding
+        // BL/B instruction encoding, bit 31 is 0 for B
         // +---+---+---+---+---+---+-------------+
         // | 31| 30| 29| 28| 27| 26| 25 ... ... 0|
         // +---+---+---+---+---+---+-------------+
@@ -218,8 +230,8 @@ public:
         namespace EncodingData = asmjit::a64::InstDB::EncodingData;
         if (-(1 << 27) <= Diff && Diff <= (1 << 27)) {
           uint32_t Imm26 =
-              (Diff >> 2) & ((1 << 26) - 1); // imm26 to be encoded to BL
-          *Patch = EncodingData::baseBranchRel[1].opcode | Imm26;
+              (Diff >> 2) & ((1 << 26) - 1); // imm26 to be encoded to BL/B
+          *Patch = EncodingData::baseBranchRel[IsCall ? 1 : 0].opcode | Imm26;
         } else {
           ZEN_ASSERT(P->getSize() == 16);
           auto RegId = A64OnePassABI::getCallTargetReg().id();
@@ -231,9 +243,10 @@ public:
           for (uint32_t I = 0; I < MovOpCount; I++) {
             Patch[I] = MovOpData[I];
           }
-          auto BlrOpData = EncodingData::baseBranchReg[0].opcode;
-          BlrOpData |= ((RegId & 31u) << 5);
-          Patch[4] = BlrOpData;
+          // BLR for call and BR for tail call in the last slot
+          auto BrOpData = EncodingData::baseBranchReg[IsCall ? 0 : 1].opcode;
+          BrOpData |= ((RegId & 31u) << 5);
+          Patch[3] = BrOpData;
         }
       }
     }
@@ -140,6 +140,7 @@ public:
     // set StackUsed and _stack_budget
     StackUsed = ((StackTop + 15) / 16) * 16;
     StackBudget = StackUsed + StackIncrement;
+    clearTempStackSlots();
     // set param in register
     if (FuncType->NumParams) {
       ParamInRegister = true;
@@ -230,14 +231,13 @@ public:
   A64InstOperand getTempStackOperand(WASMType Type, uint32_t Size) {
     ZEN_ASSERT(getWASMTypeSize(Type) == Size);
     ZEN_ASSERT((Size & (Size - 1)) == 0);
-    StackUsed = ZEN_ALIGN(StackUsed, Size);
-    StackUsed += Size;
+    int32_t Offset = allocTempStackSlot(Size);
     // check if need to grow the stack
     if (StackUsed > StackBudget) {
       StackBudget += StackIncrement;
     }
     return A64InstOperand(Type, A64OnePassABI::getFrameBase(),
-                          -(int32_t)StackUsed, A64InstOperand::FLAG_TEMP_MEM);
+                          -Offset, A64InstOperand::FLAG_TEMP_MEM);
   }
 
   A64MachineState getVMState() const { return VmState; }
@@ -267,10 +267,9 @@ public:
       ZEN_ASSERT(Opnd.isMem());
       ZEN_ASSERT(Opnd.getOffset() < 0 && (-Opnd.getOffset() <= StackUsed));
       ZEN_ASSERT(-Opnd.getOffset() <= StackUsed);
-      StackUsed = (-Opnd.getOffset() -
-                   getWASMTypeSize(Opnd.getType())); // if stack aligned when
-                                                     // getTempStackOperand,
-                                                     // some stack space lost;
+      // the copy of a deferred local.get may be allocated above temporaries
+      // which are released before it
+      releaseTempStackSlot(-Opnd.getOffset());
     }
   }
 };
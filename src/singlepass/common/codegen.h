@@ -12,6 +12,9 @@
 // ============================================================================
 
 #include "singlepass/common/definitions.h"
+#ifndef ZEN_ENABLE_SGX
+#include "runtime/atomics.h"
+#endif // ZEN_ENABLE_SGX
 
 namespace zen::singlepass {
 
@@ -182,6 +185,9 @@ public:
   static constexpr DataType F64 = ConcreteCodeGenAttrs::F64;
   static constexpr DataType V128 = ConcreteCodeGenAttrs::V128;
 
+  // local.get may push the local itself, see handleGetLocal
+  static constexpr bool DefersGetLocal = true;
+
   static constexpr uint32_t GlobalBaseOffset =
       offsetof(Instance, GlobalVarData);
   static constexpr uint32_t MemoriesOffset = offsetof(Instance, Memories);
@@ -312,6 +318,9 @@ public:
 
     if (GotExcept != InvalidLabelId) {
       bindLabel(GotExcept);
+      // The trap unwinds without returning to the jitted code, so the gas
+      // left must be in the instance before
+      self().saveGasVal();
       mov<I64>(ABI.template getParamRegNum<I64, 0>(), ABI.getModuleInst());
       self().callAbsolute(uintptr_t(Instance::triggerInstanceExceptionOnJIT));
 
@@ -326,6 +335,7 @@ public:
 
       self().setException();
 #ifdef ZEN_ENABLE_CPU_EXCEPTION
+      self().saveGasVal();
       mov<I64>(ABI.template getParamRegNum<I64, 0>(), ABI.getModuleInst());
       self().callAbsolute(uintptr_t(Instance::throwInstanceExceptionOnJIT));
 #else
@@ -463,17 +473,28 @@ public:
 
   void handleBranchTable(Operand Index, Operand StackTop,
                          const std::vector<uint32_t> &Levels) {
+    // entries branching to the same level share one label, so that runs of
+    // them can be checked by range and only one jump is emitted per level
+    std::vector<uint32_t> LevelLabels(Stack.size(), InvalidLabelId);
     std::vector<uint32_t> Labels;
     Labels.reserve(Levels.size());
-    std::generate_n(std::back_inserter(Labels), Levels.size(),
-                    [this] { return createLabel(); });
+    for (uint32_t Level : Levels) {
+      uint32_t &Label = LevelLabels.at(Level);
+      if (Label == InvalidLabelId) {
+        Label = createLabel();
+      }
+      Labels.push_back(Label);
+    }
 
     self().handleBranchTableImpl(Index, Labels);
 
     // TODO: no need to emit extra jumps if there's no result value
-    for (size_t I = 0; I < Levels.size(); ++I) {
-      bindLabel(Labels[I]);
-      const auto &Info = Stack.at(Stack.size() - Levels[I] - 1);
+    for (size_t Level = 0; Level < LevelLabels.size(); ++Level) {
+      if (LevelLabels[Level] == InvalidLabelId) {
+        continue;
+      }
+      bindLabel(LevelLabels[Level]);
+      const auto &Info = Stack.at(Stack.size() - Level - 1);
       if (Info.getType() != WASMType::VOID &&
           Info.getKind() != CtrlBlockKind::LOOP) {
         makeAssignment<ScopedTempReg0>(Info.getType(), Info.getResult(),
@@ -498,6 +519,34 @@ public:
     return self().handleCallIndirectImpl(TypeIdx, Callee, TblIdx, ArgInfo, Arg);
   }
 
+  // The frame of the current function is reused when the callee receives all
+  // the arguments in registers, otherwise it's called before returning.
+  // Imported functions are always called, their exception must be checked
+  void handleReturnCall(uint32_t FuncIdx, uintptr_t Target, bool IsImport,
+                        bool FarCall, const ArgumentInfo &ArgInfo,
+                        const std::vector<Operand> &Arg) {
+    if (IsImport || ArgInfo.getStackSize() != 0) {
+      Operand Result = handleCall(FuncIdx, Target, IsImport, FarCall, ArgInfo,
+                                  Arg);
+      releaseOperand(Result);
+      handleReturn(Result);
+      return;
+    }
+    self().handleReturnCallImpl(FuncIdx, FarCall, ArgInfo, Arg);
+  }
+
+  void handleReturnCallIndirect(uint32_t TypeIdx, Operand Callee,
+                                uint32_t TblIdx, const ArgumentInfo &ArgInfo,
+                                const std::vector<Operand> &Arg) {
+    if (ArgInfo.getStackSize() != 0) {
+      Operand Result = handleCallIndirect(TypeIdx, Callee, TblIdx, ArgInfo, Arg);
+      releaseOperand(Result);
+      handleReturn(Result);
+      return;
+    }
+    self().handleReturnCallIndirectImpl(TypeIdx, Callee, TblIdx, ArgInfo, Arg);
+  }
+
   // ==================== Parametric Instruction Handlers ====================
 
   Operand handleSelect(Operand Cond, Operand LHS, Operand RHS) {
@@ -508,11 +557,38 @@ public:
 
   Operand handleGetLocal(uint32_t LocalIdx) {
     auto Val = Layout.getLocal(LocalIdx);
+    // A local on stack is pushed itself and read by its consumer, which saves
+    // a copy in most cases. Locals in registers are still copied, since many
+    // instructions compute in place of a register operand
+    if (Val.isMem() && Val.getType() != WASMType::V128) {
+      return Val;
+    }
     auto Ret = getTempOperand(Val.getType());
     makeAssignment<ScopedTempReg0>(Val.getType(), Ret, Val);
     return Ret;
   }
 
+  // whether Opnd is pushed by handleGetLocal for local LocalIdx(or any local
+  // if LocalIdx is UINT32_MAX) and not copied yet
+  bool isLocalRef(Operand Opnd, uint32_t LocalIdx) {
+    // the other operands in memory on the stack are all temporary
+    if (!Opnd.isMem() || Opnd.isTempMem()) {
+      return false;
+    }
+    if (LocalIdx == UINT32_MAX) {
+      return true;
+    }
+    auto Local = Layout.getLocal(LocalIdx);
+    return Local.isMem() && Local.getBase() == Opnd.getBase() &&
+           Local.getOffset() == Opnd.getOffset();
+  }
+
+  Operand materializeLocalRef(Operand Opnd) {
+    auto Ret = getTempOperand(Opnd.getType());
+    makeAssignment<ScopedTempReg0>(Opnd.getType(), Ret, Opnd);
+    return Ret;
+  }
+
   void handleSetLocal(uint32_t LocalIdx, Operand Val) {
     auto Local = Layout.getLocal(LocalIdx);
     ZEN_ASSERT(Local.getType() == Val.getType());
@@ -554,6 +630,70 @@ public:
     return self().handleMemoryGrowImpl(Op);
   }
 
+#ifndef ZEN_ENABLE_SGX
+  Operand handleAtomic(uint32_t Opcode, Operand Base, uint32_t Offset,
+                       Operand Arg1, Operand Arg2) {
+    return self().handleAtomicImpl(Opcode, Base, Offset, Arg1, Arg2);
+  }
+
+  void handleAtomicFence() { self().handleAtomicFenceImpl(); }
+
+  // Call Instance::atomicOnJIT for the atomic instructions not lowered to
+  // native code, the absent operands are passed as 0
+  Operand emitAtomicCall(uint32_t Opcode, Operand Base, uint32_t Offset,
+                         Operand Arg1, Operand Arg2) {
+    if (Arg1.getType() == WASMType::VOID) {
+      Arg1 = Operand(WASMType::I32, 0);
+    }
+    if (Arg2.getType() == WASMType::VOID) {
+      Arg2 = Operand(WASMType::I32, 0);
+    }
+    WASMType RetType = WASMType::I32;
+    if (Opcode == common::ATOMIC_FENCE) {
+      RetType = WASMType::VOID;
+    } else if (Opcode >= common::I32_ATOMIC_LOAD) {
+      if (runtime::getAtomicOpKind(Opcode) == runtime::AtomicOpKind::Store) {
+        RetType = WASMType::VOID;
+      } else if (runtime::isAtomicOp64(Opcode)) {
+        RetType = WASMType::I64;
+      }
+    }
+    auto NumCells = [](WASMType Type) -> uint16_t {
+      return Type == WASMType::I64 ? 2 : 1;
+    };
+
+    TypeEntry Sig = {
+        .NumParams = 5,
+        .NumParamCells =
+            uint16_t(3 + NumCells(Arg1.getType()) + NumCells(Arg2.getType())),
+        .NumReturns = uint8_t(RetType == WASMType::VOID ? 0 : 1),
+        .NumReturnCells =
+            uint8_t(RetType == WASMType::VOID ? 0 : NumCells(RetType)),
+        .ReturnTypes = {RetType},
+        {
+            .ParamTypesVec = {WASMType::I32, WASMType::I32, WASMType::I32,
+                              Arg1.getType(), Arg2.getType()},
+        },
+        .SmallestTypeIdx = uint32_t(-1),
+    };
+    ArgumentInfo ArgInfo(&Sig);
+    std::vector<Operand> Args({
+        Operand(WASMType::I32, static_cast<int32_t>(Opcode)),
+        Base,
+        Operand(WASMType::I32, static_cast<int32_t>(Offset)),
+        Arg1,
+        Arg2,
+    });
+    return emitCall(
+        ArgInfo, Args, [this] { self().saveGasVal(); },
+        [this] { self().callAbsolute(uintptr_t(Instance::atomicOnJIT)); },
+        [this] {
+          // Out of bounds or unaligned accesses are set on the instance
+          self().checkCallException(true);
+        });
+  }
+#endif // ZEN_ENABLE_SGX
+
   // ==================== Numeric Instruction Handlers ====================
 
   template <WASMType Ty>
@@ -846,6 +986,38 @@ protected:
 
   void embedLabel(uint32_t Id) { _ embedLabel(asmjit::Label(Id)); }
 
+  // max number of label runs in a branch table checked by compare and branch
+  // instead of an indirect jump through the jump table
+  static constexpr uint32_t MaxBranchTableCompareRuns = 4;
+
+  // get the number of leading entries in a branch table to dispatch, the
+  // trailing ones going to the default label(the last item) are left to the
+  // bound check
+  static uint32_t getBranchTableBound(const std::vector<uint32_t> &Labels) {
+    uint32_t Bound = Labels.size() - 1;
+    while (Bound > 0 && Labels[Bound - 1] == Labels.back()) {
+      --Bound;
+    }
+    return Bound;
+  }
+
+  // split entries [0, Bound) of a branch table into runs of consecutive
+  // entries with the same label and collect the last entry of each run,
+  // return false if there are more than MaxRuns runs
+  static bool getBranchTableRuns(const std::vector<uint32_t> &Labels,
+                                 uint32_t Bound, uint32_t MaxRuns,
+                                 std::vector<uint32_t> &RunEnds) {
+    for (uint32_t I = 0; I < Bound; ++I) {
+      if (I + 1 == Bound || Labels[I + 1] != Labels[I]) {
+        if (RunEnds.size() == MaxRuns) {
+          return false;
+        }
+        RunEnds.push_back(I);
+      }
+    }
+    return true;
+  }
+
   void emitJumpTable(uint32_t Table, const std::vector<uint32_t> &Targets) {
     // align code to pointer boundary
     _ align(asmjit::AlignMode::kCode, sizeof(uintptr_t));
@@ -900,47 +1072,7 @@ protected:
     // prepare call
     PreCall();
 
-    // layout argument
-    ZEN_ASSERT(ArgInfo.size() == Arg.size() + 1);
-
-    std::vector<uint32_t> NeedSortedMovs;
-    uint32_t GpRegUsed = 0;
-    uint32_t FpRegUsed = 0;
-    for (uint32_t I = 1; I < ArgInfo.size(); ++I) {
-      const auto &Info = ArgInfo.at(I);
-      if (Info.inReg()) {
-        NeedSortedMovs.push_back(I);
-        continue;
-      }
-
-      Operand Op = Arg[I - 1];
-      ZEN_ASSERT(Op.getType() == Info.getType());
-      copyParam(Info, Op, GpRegUsed, FpRegUsed, StackOffset);
-    }
-
-    // sort movs
-    for (uint32_t I = 0; I < NeedSortedMovs.size(); ++I) {
-      for (uint32_t J = I + 1; J < NeedSortedMovs.size(); ++J) {
-        // should not take this sentence out, because need_sorted_movs
-        // may change
-        const auto &Info = ArgInfo.at(NeedSortedMovs[I]);
-        Operand Op = Arg[NeedSortedMovs[J] - 1];
-        if (Op.isReg() && Op.getReg() == Info.getRegNum()) {
-          std::swap(NeedSortedMovs[I], NeedSortedMovs[J]);
-        }
-      }
-    }
-
-    // copy sorted movs
-    for (uint32_t I : NeedSortedMovs) {
-      const auto &Info = ArgInfo.at(I);
-      Operand Op = Arg[I - 1];
-      ZEN_ASSERT(Op.getType() == Info.getType());
-      copyParam(Info, Op, GpRegUsed, FpRegUsed, StackOffset);
-    }
-
-    // place instance
-    mov<I64>(ABI.template getParamRegNum<I64, 0>(), ABI.getModuleInst());
+    layoutCallArgs(ArgInfo, Arg, StackOffset);
 
     // generare call
     GenCall();
@@ -978,6 +1110,22 @@ protected:
     return RetVal;
   }
 
+  // Jump to the callee after releasing the frame of the current function, the
+  // callee returns to our caller. The temp registers aren't saved since the
+  // control doesn't come back. The exit state is saved before the arguments
+  // are placed, when the scoped temp registers are still free
+  template <typename PrepareCallFn, typename GenerateJumpFn>
+  void emitTailCall(const ArgumentInfo &ArgInfo,
+                    const std::vector<Operand> &Arg, PrepareCallFn PreCall,
+                    GenerateJumpFn GenJump) {
+    ZEN_ASSERT(ArgInfo.getStackSize() == 0);
+    PreCall();
+    self().saveStateOnExit();
+    layoutCallArgs(ArgInfo, Arg, 0);
+    self().releaseFrame();
+    GenJump();
+  }
+
   // Use vector because branch may refer random parent block
   typedef std::vector<BlockInfo> BlockStack;
   BlockStack Stack; // manage nested block
@@ -991,6 +1139,52 @@ protected:
 private:
   ConcreteCodeGen &self() { return static_cast<ConcreteCodeGen &>(*this); }
 
+  // move arguments to the registers and the stack slots of the callee, and the
+  // instance to the first param register
+  void layoutCallArgs(const ArgumentInfo &ArgInfo,
+                      const std::vector<Operand> &Arg, uint32_t StackOffset) {
+    ZEN_ASSERT(ArgInfo.size() == Arg.size() + 1);
+
+    std::vector<uint32_t> NeedSortedMovs;
+    uint32_t GpRegUsed = 0;
+    uint32_t FpRegUsed = 0;
+    for (uint32_t I = 1; I < ArgInfo.size(); ++I) {
+      const auto &Info = ArgInfo.at(I);
+      if (Info.inReg()) {
+        NeedSortedMovs.push_back(I);
+        continue;
+      }
+
+      Operand Op = Arg[I - 1];
+      ZEN_ASSERT(Op.getType() == Info.getType());
+      copyParam(Info, Op, GpRegUsed, FpRegUsed, StackOffset);
+    }
+
+    // sort movs
+    for (uint32_t I = 0; I < NeedSortedMovs.size(); ++I) {
+      for (uint32_t J = I + 1; J < NeedSortedMovs.size(); ++J) {
+        // should not take this sentence out, because need_sorted_movs
+        // may change
+        const auto &Info = ArgInfo.at(NeedSortedMovs[I]);
+        Operand Op = Arg[NeedSortedMovs[J] - 1];
+        if (Op.isReg() && Op.getReg() == Info.getRegNum()) {
+          std::swap(NeedSortedMovs[I], NeedSortedMovs[J]);
+        }
+      }
+    }
+
+    // copy sorted movs
+    for (uint32_t I : NeedSortedMovs) {
+      const auto &Info = ArgInfo.at(I);
+      Operand Op = Arg[I - 1];
+      ZEN_ASSERT(Op.getType() == Info.getType());
+      copyParam(Info, Op, GpRegUsed, FpRegUsed, StackOffset);
+    }
+
+    // place instance
+    mov<I64>(ABI.template getParamRegNum<I64, 0>(), ABI.getModuleInst());
+  }
+
   // save parameters in register to stack
   void saveParamReg(uint32_t ParamCnt) {
     uint32_t GpAvailMask = 0;
@@ -13,6 +13,7 @@
 // ============================================================================
 
 #include "singlepass/common/definitions.h"
+#include <algorithm>
 #include <vector>
 
 // ============================================================================
@@ -148,6 +149,15 @@ protected:
                                  //   for eval stack
   int32_t StackBudget;           // total stack allocated
   bool ParamInRegister;          // is param still in register
+  // temp stack slots in allocation order, which is also the order of their
+  // offsets, and whether each of them is freed. A slot freed below the
+  // topmost live one is given back when all the slots above it are freed
+  struct TempStackSlot {
+    int32_t Begin; // StackUsed before the slot, including alignment padding
+    int32_t End;   // StackUsed after the slot
+  };
+  std::vector<TempStackSlot> TempStackSlots;
+  std::vector<bool> FreedTempStackSlots;
 
 public:
   OnePassDataLayout(ABI &Abi)
@@ -187,6 +197,42 @@ public:
 
   uint32_t getStackBudget() const { return StackBudget; }
 
+  // allocate a temp stack slot at the top, return the end offset of the slot
+  int32_t allocTempStackSlot(uint32_t Size) {
+    ZEN_ASSERT((Size & (Size - 1)) == 0);
+    int32_t Begin = StackUsed;
+    StackUsed = ZEN_ALIGN(StackUsed, Size);
+    StackUsed += Size;
+    TempStackSlots.push_back({Begin, StackUsed});
+    FreedTempStackSlots.push_back(false);
+    return StackUsed;
+  }
+
+  // free the temp stack slot ending at Offset, and pop the freed slots at the
+  // top to shrink the used stack
+  void releaseTempStackSlot(int32_t Offset) {
+    auto It = std::lower_bound(
+        TempStackSlots.begin(), TempStackSlots.end(), Offset,
+        [](const TempStackSlot &Slot, int32_t End) { return Slot.End < End; });
+    ZEN_ASSERT(It != TempStackSlots.end() && It->End == Offset);
+    if (It == TempStackSlots.end() || It->End != Offset) {
+      return;
+    }
+    size_t Index = It - TempStackSlots.begin();
+    ZEN_ASSERT(!FreedTempStackSlots[Index]);
+    FreedTempStackSlots[Index] = true;
+    while (!TempStackSlots.empty() && FreedTempStackSlots.back()) {
+      StackUsed = TempStackSlots.back().Begin;
+      TempStackSlots.pop_back();
+      FreedTempStackSlots.pop_back();
+    }
+  }
+
+  void clearTempStackSlots() {
+    TempStackSlots.clear();
+    FreedTempStackSlots.clear();
+  }
+
   LocalInfo getLocalInfo(uint32_t LocalIdx) {
     ZEN_ASSERT(LocalIdx < Locals.size());
     return Locals[LocalIdx];
@@ -187,15 +187,7 @@ private:
 
   // epilog
   void emitEpilog(Operand Op) {
-    saveGasVal();
-
-#ifdef ZEN_ENABLE_DWASM
-    // update stack cost
-    auto StackCostAddr = asmjit::x86::ptr(ABI.getModuleInstReg(),
-                                          Ctx->Mod->getLayout().StackCostOffset,
-                                          sizeof(uint32_t));
-    _ sub(StackCostAddr, Ctx->Func->JITStackCost);
-#endif
+    saveStateOnExit();
 
     if (Layout.getNumReturns() > 0) {
       ZEN_ASSERT(Layout.getNumReturns() == 1);
@@ -221,6 +213,28 @@ private:
         ZEN_ASSERT(false);
       }
     }
+    releaseFrame();
+    _ ret();
+  } // EmitEpilog
+
+  // save the gas and release the stack cost of the current function, shared
+  // by return and tail call
+  void saveStateOnExit() {
+    saveGasVal();
+
+#ifdef ZEN_ENABLE_DWASM
+    // update stack cost
+    auto StackCostAddr = asmjit::x86::ptr(ABI.getModuleInstReg(),
+                                          Ctx->Mod->getLayout().StackCostOffset,
+                                          sizeof(uint32_t));
+    _ sub(StackCostAddr, Ctx->Func->JITStackCost);
+#endif
+  }
+
+  // restore the preserved registers and the stack pointer to the state at
+  // entry, shared by return and tail call. The param and return registers are
+  // left untouched
+  void releaseFrame() {
     for (uint32_t I = 0; I < Layout.getIntPresSavedCount(); ++I) {
       const X64::GP Reg = ABI.getPresRegNum<X64::I64>(I);
       _ mov(X64Reg::getRegRef<X64::I64>(Reg),
@@ -228,8 +242,7 @@ private:
     }
     _ mov(ABI.getStackPointerReg(), ABI.getFrameBaseReg());
     _ pop(ABI.getFrameBaseReg());
-    _ ret();
-  } // EmitEpilog
+  }
 
   template <uint32_t SizeRegIndex>
   void emitTableSize(uint32_t TblIdx, Operand EntryIdx) {
@@ -244,7 +257,6 @@ private:
       ZEN_ASSERT(EntryIdx.isTempReg());
       _ cmp(SizeAddr, EntryIdx.getRegRef<X64::I32>());
     } else if (EntryIdx.isMem()) {
-      ZEN_ASSERT(EntryIdx.isTempMem());
       auto SizeReg = Layout.getScopedTempReg<X64::I32, SizeRegIndex>();
       _ mov(SizeReg, SizeAddr);
       _ cmp(SizeReg, EntryIdx.getMem<X64::I32>());
@@ -355,6 +367,117 @@ public:
     }
   }
 
+#ifndef ZEN_ENABLE_SGX
+  // atomic access of MemType at base + offset, values in ValType, rcx holds
+  // the 64-bit effective address, rax the value and rdx the new value of
+  // cmpxchg and the rmw loop
+  template <WASMType ValType, X64::Type MemType>
+  Operand emitAtomicAccess(runtime::AtomicOpKind Kind, Operand Base,
+                           uint32_t Offset, Operand Arg1, Operand Arg2) {
+    using runtime::AtomicOpKind;
+    constexpr X64::Type X64ValType = getX64TypeFromWASMType<ValType>();
+    constexpr X64::Type LoadType = X64TypeAttr<MemType>::WidenType;
+    constexpr uint32_t Size = X64TypeAttr<MemType>::Size;
+    ZEN_ASSERT(Base.getType() == X64OnePassABI::WASMAddrType);
+
+    auto AddrRegNum = Layout.getScopedTemp<X64::I64, ScopedTempReg1>();
+    auto ValRegNum = Layout.getScopedTemp<X64ValType, ScopedTempReg0>();
+    auto NewRegNum = Layout.getScopedTemp<X64ValType, ScopedTempReg2>();
+    const auto &AddrReg = X64Reg::getRegRef<X64::I64>(AddrRegNum);
+    const auto &NewReg64 = X64Reg::getRegRef<X64::I64>(NewRegNum);
+
+    // the 32-bit mov zero extends base to 64 bits, so base + offset can't
+    // wrap around
+    mov<X64::I32>(AddrRegNum, Base);
+    if (Offset > INT32_MAX) {
+      _ mov(X64Reg::getRegRef<X64::I32>(NewRegNum), Offset);
+      _ add(AddrReg, NewReg64);
+    } else if (Offset > 0) {
+      _ add(AddrReg, Offset);
+    }
+    // without the soft check, base + offset + size < 8GB falls in the guard
+    // region
+    if (Ctx->UseSoftMemCheck) {
+      _ lea(NewReg64, asmjit::x86::ptr(AddrReg, Size));
+      _ cmp(NewReg64, ABI.getMemorySizeReg());
+      _ ja(getExceptLabel(ErrorCode::OutOfBoundsMemory));
+    }
+    if (Size > 1) {
+      _ test(X64Reg::getRegRef<X64::I32>(AddrRegNum), Size - 1);
+      _ jnz(getExceptLabel(ErrorCode::UnalignedAtomic));
+    }
+    asmjit::x86::Mem Addr(ABI.getMemoryBaseReg(), AddrReg, 0, 0, Size);
+
+    const auto &ValReg = X64Reg::getRegRef<MemType>(ValRegNum);
+    const auto &NewReg = X64Reg::getRegRef<MemType>(NewRegNum);
+    switch (Kind) {
+    case AtomicOpKind::Load:
+      LoadOperatorImpl<LoadType, MemType, false>::emit(
+          ASM, X64Reg::getRegRef<LoadType>(ValRegNum), Addr);
+      break;
+    case AtomicOpKind::Store:
+      // xchg with memory is always locked
+      mov<X64ValType>(ValRegNum, Arg1);
+      _ xchg(Addr, ValReg);
+      return Operand();
+    case AtomicOpKind::Add:
+    case AtomicOpKind::Sub:
+      mov<X64ValType>(ValRegNum, Arg1);
+      if (Kind == AtomicOpKind::Sub) {
+        _ neg(X64Reg::getRegRef<X64ValType>(ValRegNum));
+      }
+      _ lock().xadd(Addr, ValReg);
+      break;
+    case AtomicOpKind::Xchg:
+      mov<X64ValType>(ValRegNum, Arg1);
+      _ xchg(Addr, ValReg);
+      break;
+    case AtomicOpKind::Cmpxchg:
+      mov<X64ValType>(NewRegNum, Arg2);
+      mov<X64ValType>(ValRegNum, Arg1);
+      _ lock().cmpxchg(Addr, NewReg, ValReg);
+      break;
+    case AtomicOpKind::And:
+    case AtomicOpKind::Or:
+    case AtomicOpKind::Xor: {
+      // cmpxchg loop, on failure rax is reloaded with the current value
+      asmjit::Label Retry = _ newLabel();
+      LoadOperatorImpl<LoadType, MemType, false>::emit(
+          ASM, X64Reg::getRegRef<LoadType>(ValRegNum), Addr);
+      _ bind(Retry);
+      _ mov(NewReg64, X64Reg::getRegRef<X64::I64>(ValRegNum));
+      const auto &NewValReg = X64Reg::getRegRef<X64ValType>(NewRegNum);
+      if (Kind == AtomicOpKind::And) {
+        BinaryOperatorImpl<X64ValType, BinaryOperator::BO_AND>::emit(
+            ASM, NewValReg, Arg1);
+      } else if (Kind == AtomicOpKind::Or) {
+        BinaryOperatorImpl<X64ValType, BinaryOperator::BO_OR>::emit(
+            ASM, NewValReg, Arg1);
+      } else {
+        BinaryOperatorImpl<X64ValType, BinaryOperator::BO_XOR>::emit(
+            ASM, NewValReg, Arg1);
+      }
+      _ lock().cmpxchg(Addr, NewReg, ValReg);
+      _ jne(Retry);
+      break;
+    }
+    default:
+      ZEN_ABORT();
+    }
+
+    // the old value is in the low bits of rax, zero extend it
+    if constexpr (MemType == X64::I8 || MemType == X64::I16) {
+      _ movzx(X64Reg::getRegRef<X64::I32>(ValRegNum), ValReg);
+    } else if constexpr (MemType == X64::I32 && X64ValType == X64::I64) {
+      _ mov(X64Reg::getRegRef<X64::I32>(ValRegNum),
+            X64Reg::getRegRef<X64::I32>(ValRegNum));
+    }
+    Operand Ret = getTempOperand(ValType);
+    mov<X64ValType>(Ret, ValRegNum);
+    return Ret;
+  }
+#endif // ZEN_ENABLE_SGX
+
 public:
   //
   // templated method to handle operations
@@ -861,11 +984,12 @@ public:
 
     ZEN_ASSERT(LHS.getType() == RHS.getType());
     switch (LHS.getType()) {
-    // TODO: use cmov for integer type
     case WASMType::I32:
-      return fusedCompareSelectWithIf<WASMType::I32, Opr>(LHS, RHS, Exchanged);
+      return fusedCompareSelectWithCMov<WASMType::I32, Opr>(LHS, RHS,
+                                                            Exchanged);
     case WASMType::I64:
-      return fusedCompareSelectWithIf<WASMType::I64, Opr>(LHS, RHS, Exchanged);
+      return fusedCompareSelectWithCMov<WASMType::I64, Opr>(LHS, RHS,
+                                                            Exchanged);
     case WASMType::F32:
       return fusedCompareSelectWithIf<WASMType::F32, Opr>(LHS, RHS, Exchanged);
     case WASMType::F64:
@@ -1113,6 +1237,14 @@ public:
       return;
     }
 
+    // trailing entries going to the default label are left to the bound
+    // check
+    Bound = getBranchTableBound(LabelIdxs);
+    if (Bound == 0) {
+      _ jmp(asmjit::Label(LabelIdxs.back()));
+      return;
+    }
+
     // load index into register if necessary
     auto IndexReg = Index.isReg()
                         ? Index.getRegRef<X64::I32>()
@@ -1123,28 +1255,19 @@ public:
     // compare index with bound
     _ cmp(IndexReg, Bound);
     // jump to default label if index >= bound
-    _ jae(asmjit::Label(LabelIdxs[Bound]));
-
-    // for small tables, generate if (index == i) goto i;
-    switch (Bound) {
-    case 4:
-      _ cmp(IndexReg, 3);
-      _ je(asmjit::Label(LabelIdxs[3]));
-      // fall through
-    case 3:
-      _ cmp(IndexReg, 2);
-      _ je(asmjit::Label(LabelIdxs[2]));
-      // fall through
-    case 2:
-      _ cmp(IndexReg, 1);
-      _ je(asmjit::Label(LabelIdxs[1]));
-      // fall through
-    case 1:
-      _ cmp(IndexReg, 0);
-      _ je(asmjit::Label(LabelIdxs[0]));
+    _ jae(asmjit::Label(LabelIdxs.back()));
+
+    // for tables with few runs of entries going to the same label, generate
+    // if (index <= run_end) goto run_label;
+    std::vector<uint32_t> RunEnds;
+    if (getBranchTableRuns(LabelIdxs, Bound, MaxBranchTableCompareRuns,
+                           RunEnds)) {
+      for (size_t I = 0; I + 1 < RunEnds.size(); ++I) {
+        _ cmp(IndexReg, RunEnds[I]);
+        _ jbe(asmjit::Label(LabelIdxs[RunEnds[I]]));
+      }
+      _ jmp(asmjit::Label(LabelIdxs[RunEnds.back()]));
       return;
-    default:
-      break;
     }
 
     // jump to entry in jump table
@@ -1153,7 +1276,8 @@ public:
     _ lea(JmpReg, asmjit::x86::ptr(asmjit::Label(Table)));
     _ jmp(
         asmjit::x86::Mem(JmpReg, IndexReg, sizeof(uintptr_t) == 4 ? 2 : 3, 0));
-    emitJumpTable(Table, LabelIdxs);
+    emitJumpTable(Table, std::vector<uint32_t>(LabelIdxs.begin(),
+                                               LabelIdxs.begin() + Bound));
   }
 
   // call
@@ -1274,6 +1398,77 @@ public:
         });
   }
 
+  // tail call, jump to the callee or record relocation for patching
+  void handleReturnCallImpl(uint32_t FuncIdx, bool FarCall,
+                            const ArgumentInfo &ArgInfo,
+                            const std::vector<Operand> &Args) {
+    emitTailCall(
+        ArgInfo, Args, [] {},
+        [&]() {
+          size_t Offset = _ offset();
+          _ dw(0);
+          _ dd(0); // reserve 6 bytes
+          ZEN_ASSERT(_ offset() - Offset == 6);
+          Patcher.addJumpEntry(Offset, _ offset() - Offset, FuncIdx);
+        });
+  }
+
+  // tail call indirect, the imported functions found in the table are called
+  // before returning as in handleReturnCall
+  void handleReturnCallIndirectImpl(uint32_t TypeIdx, Operand Callee,
+                                    uint32_t TblIdx,
+                                    const ArgumentInfo &ArgInfo,
+                                    const std::vector<Operand> &Args) {
+    uint32_t NumHostAPIs = Ctx->Mod->getNumImportFunctions();
+    uint32_t HostCallLabel = NumHostAPIs > 0 ? createLabel() : InvalidLabelId;
+    emitTailCall(
+        ArgInfo, Args,
+        // check and load callee address into %rax
+        [this, NumHostAPIs, HostCallLabel, TypeIdx, Callee, TblIdx]() {
+          auto FuncIdxReg = Layout.getScopedTemp<X64::I32, ScopedTempReg0>();
+          auto FuncIdx = X64Reg::getRegRef<X64::I32>(FuncIdxReg);
+
+          emitTableGet(TblIdx, Callee, FuncIdxReg);
+
+          auto InstReg = ABI.getModuleInstReg();
+
+          _ cmp(FuncIdx, -1);
+          _ je(getExceptLabel(ErrorCode::UninitializedElement));
+
+          constexpr uint32_t Shift0 = 2;
+          auto IndexesBaseOffset =
+              Ctx->Mod->getLayout().FuncTypeIndexesBaseOffset;
+          asmjit::x86::Mem TypeIdxAddr(InstReg, FuncIdx, Shift0,
+                                       IndexesBaseOffset, sizeof(TypeIdx));
+
+          _ cmp(TypeIdxAddr, TypeIdx);
+          _ jne(getExceptLabel(ErrorCode::IndirectCallTypeMismatch));
+
+          if (NumHostAPIs > 0) {
+            _ cmp(FuncIdx, NumHostAPIs);
+            branchLTU(HostCallLabel);
+          }
+
+          auto FuncPtr = ABI.getCallTargetReg();
+          constexpr uint32_t Shift = sizeof(void *) == 4 ? 2 : 3;
+          asmjit::x86::Mem FuncPtrAddr(
+              InstReg, FuncIdx, Shift,
+              Ctx->Mod->getLayout().FuncPtrsBaseOffset);
+
+          _ mov(FuncPtr, FuncPtrAddr);
+        },
+        [&]() { _ jmp(ABI.getCallTargetReg()); });
+
+    if (NumHostAPIs > 0) {
+      // nothing is changed before the branch but the scoped temp registers
+      bindLabel(HostCallLabel);
+      Operand Result =
+          handleCallIndirectImpl(TypeIdx, Callee, TblIdx, ArgInfo, Args);
+      releaseOperand(Result);
+      emitEpilog(Result);
+    }
+  }
+
   // branch to label if ZF is set
   void je(uint32_t LabelIdx) {
     asmjit::Label L(LabelIdx);
@@ -1301,6 +1496,43 @@ public:
 
   // in alphabetical order
 
+#ifndef ZEN_ENABLE_SGX
+  // atomic instructions, wait and notify block or wake threads in the runtime,
+  // the others are lowered to lock-prefixed instructions
+  Operand handleAtomicImpl(uint32_t Opcode, Operand Base, uint32_t Offset,
+                           Operand Arg1, Operand Arg2) {
+    if (Opcode < common::I32_ATOMIC_LOAD) {
+      return emitAtomicCall(Opcode, Base, Offset, Arg1, Arg2);
+    }
+    runtime::AtomicOpKind Kind = runtime::getAtomicOpKind(Opcode);
+    bool Is64 = runtime::isAtomicOp64(Opcode);
+    switch (runtime::getAtomicAccessSize(Opcode)) {
+    case 1:
+      return Is64 ? emitAtomicAccess<WASMType::I64, X64::I8>(Kind, Base, Offset,
+                                                             Arg1, Arg2)
+                  : emitAtomicAccess<WASMType::I32, X64::I8>(Kind, Base, Offset,
+                                                             Arg1, Arg2);
+    case 2:
+      return Is64 ? emitAtomicAccess<WASMType::I64, X64::I16>(Kind, Base,
+                                                              Offset, Arg1, Arg2)
+                  : emitAtomicAccess<WASMType::I32, X64::I16>(
+                        Kind, Base, Offset, Arg1, Arg2);
+    case 4:
+      return Is64 ? emitAtomicAccess<WASMType::I64, X64::I32>(Kind, Base,
+                                                              Offset, Arg1, Arg2)
+                  : emitAtomicAccess<WASMType::I32, X64::I32>(
+                        Kind, Base, Offset, Arg1, Arg2);
+    default:
+      return emitAtomicAccess<WASMType::I64, X64::I64>(Kind, Base, Offset, Arg1,
+                                                       Arg2);
+    }
+  }
+
+  // x86 loads and stores are ordered except store-load, so only the store
+  // needs the barrier, which xchg implies
+  void handleAtomicFenceImpl() { _ mfence(); }
+#endif // ZEN_ENABLE_SGX
+
   // memory grow
   Operand handleMemoryGrowImpl(Operand Op) {
     static TypeEntry SigBuf = {
@@ -1454,6 +1686,31 @@ private:
     return Ret;
   }
 
+  // fused compare and select for integer, the flags are set by the compare
+  // mov    rhs, res
+  // cmovcc lhs, res
+  template <WASMType Type, CompareOperator Opr>
+  Operand fusedCompareSelectWithCMov(Operand LHS, Operand RHS,
+                                     bool Exchanged) {
+    constexpr auto X64Type = getX64TypeFromWASMType<Type>();
+    auto RegNum = Layout.getScopedTemp<X64Type, ScopedTempReg0>();
+
+    // mov doesn't change the flags
+    mov<X64Type>(RegNum, RHS);
+    if (Exchanged) {
+      constexpr auto ExchangedOpr = getExchangedCompareOperator<Opr>();
+      cmovcc<ExchangedOpr, X64Type, ScopedTempReg1>(RegNum, LHS);
+    } else {
+      cmovcc<Opr, X64Type, ScopedTempReg1>(RegNum, LHS);
+    }
+
+    auto Ret = getTempOperand(Type);
+    ZEN_ASSERT(!Ret.isImm());
+    mov<X64Type, ScopedTempReg1>(Ret,
+                                 Operand(Type, RegNum, Operand::FLAG_NONE));
+    return Ret;
+  }
+
   template <WASMType Type, CompareOperator Opr>
   Operand fusedCompareSelectWithIf(Operand LHS, Operand RHS, bool Exchanged) {
     auto Ret = getTempOperand(Type);
@@ -1520,6 +1777,26 @@ private:
     }
   }
 
+  // move value from rhs(reg, mem, imm) to lhs(reg only) if the flags satisfy
+  // the compare operator
+  template <CompareOperator Opr, X64::Type Ty, uint32_t TempRegIndex>
+  void cmovcc(X64::RegNum LHS, Operand RHS) {
+    constexpr CmovccOperator CmovccOpr = getCmovccOperator<Opr>();
+    typedef CmovccOperatorImpl<CmovccOpr, true> CmovccImpl;
+    const auto &LHSReg = X64Reg::getRegRef<Ty>(LHS);
+    if (RHS.isReg()) {
+      CmovccImpl::emit(ASM, LHSReg, RHS.getRegRef<Ty>());
+    } else if (RHS.isMem()) {
+      CmovccImpl::emit(ASM, LHSReg, RHS.getMem<Ty>());
+    } else if (RHS.isImm()) {
+      auto Tmp = Layout.getScopedTempReg<Ty, TempRegIndex>();
+      ASM.mov<Ty>(Tmp, RHS.getImm());
+      CmovccImpl::emit(ASM, LHSReg, Tmp);
+    } else {
+      ZEN_ABORT();
+    }
+  }
+
   // get an operand in register, using a scoped temp if necessary
   template <X64::Type Ty, uint32_t Temp> X64::RegNum toReg(Operand Op) {
     if (Op.isReg()) {
@@ -1840,6 +2117,7 @@ private:
     return Ret;
   }
 
+public:
   // load gas value from 'module_inst' to register
   void loadGasVal() {
     auto InstReg = ABI.getModuleInstReg();
@@ -1854,7 +2132,6 @@ private:
     _ mov(GasAddr, ABI.getGasReg());
   }
 
-public:
   void subGasVal(Operand Delta) {
     Operand GasReg(WASMType::I64, ABI.getGasRegNum(), Operand::FLAG_NONE);
     BinaryOperatorImpl<X64::I64, BinaryOperator::BO_SUB>::emit(ASM, GasReg,
@@ -17,12 +17,13 @@ namespace zen::singlepass {
 
 // ============================================================================
 // PatchInfo
-// manage info to patch call instructions
+// manage info to patch call and tail call instructions
 // ============================================================================
 class PatchInfo {
 public:
   enum PatchKind {
     PKCall = 0, // patch direct call
+    PKJump = 1, // patch direct tail call
   };
 
 private:
@@ -56,6 +57,10 @@ public:
     Entries.push_back(PatchEntry(PKCall, Offset, Size, Callee));
   }
 
+  void addJumpEntry(uint32_t Offset, uint32_t Size, uint32_t Callee) {
+    Entries.push_back(PatchEntry(PKJump, Offset, Size, Callee));
+  }
+
   uintptr_t getFunctionAddress() const { return (uintptr_t)Func->JITCodePtr; }
 
 public:
@@ -99,6 +104,12 @@ public:
                                    Callee - Mod->getNumImportFunctions());
   }
 
+  void addJumpEntry(uint32_t Offset, uint32_t Size, uint32_t Callee) {
+    ZEN_ASSERT(PatchInfos.size() > 0);
+    PatchInfos.back().addJumpEntry(Offset, Size,
+                                   Callee - Mod->getNumImportFunctions());
+  }
+
   void finalizeModule() {
     for (auto It = PatchInfos.begin(), E = PatchInfos.end(); It != E; ++It) {
       uint8_t *Base = (uint8_t *)It->getFunctionAddress();
@@ -106,14 +117,18 @@ public:
       for (auto P = It->begin(), EE = It->end(); P != EE; ++P) {
         ZEN_ASSERT(P->getSize() == 6);
         ZEN_ASSERT(P->getArg() < PatchInfos.size());
-        ZEN_ASSERT(P->getKind() == PatchInfo::PKCall);
         uint8_t *Target = (uint8_t *)getFunctionAddress(P->getArg());
         int64_t Diff =
             (int64_t)Target - (int64_t)(Base + P->getOffset() + P->getSize());
         ZEN_ASSERT(INT_MIN <= Diff && Diff <= INT_MAX);
         uint8_t *Patch = Base + P->getOffset();
         Patch[0] = 0x40; // rex
-        Patch[1] = 0xe8; // call rel32
+        if (P->getKind() == PatchInfo::PKCall) {
+          Patch[1] = 0xe8; // call rel32
+        } else {
+          ZEN_ASSERT(P->getKind() == PatchInfo::PKJump);
+          Patch[1] = 0xe9; // jmp rel32
+        }
         Patch[2] = (Diff & 0xff);
         Patch[3] = ((Diff >> 8) & 0xff);
         Patch[4] = ((Diff >> 16) & 0xff);
@@ -35,6 +35,10 @@ protected:
   // each time stack increase 32-byte
   constexpr static uint32_t StackIncrement = 32;
 
+  // r10/r11 and xmm9/xmm10 at most, the other temporary registers are left
+  // to the evaluation stack
+  constexpr static uint32_t NumHotLocalRegs = 2;
+
 public:
   X64OnePassDataLayout(X64OnePassABI &ABI)
       : OnePassDataLayout<X64OnePassABI>(ABI) {}
@@ -68,8 +72,16 @@ private:
     }
   }
 
-  template <WASMType Type> void layoutLocal(uint32_t &StkSize) {
+  template <WASMType Type> void layoutLocal(uint32_t &StkSize, uint32_t Reg) {
     constexpr X64::Type X64Type = getX64TypeFromWASMType<Type>();
+    if (Reg != X64OnePassABI::InvalidParamReg) {
+      // Pinned for the whole function, emitCall saves it around calls like
+      // other temporary registers in use
+      VmState.clearAvailReg<X64Type>(
+          static_cast<typename X64TypeAttr<X64Type>::RegNum>(Reg));
+      Locals.push_back(LocalInfo(Type, Reg, 0));
+      return;
+    }
     constexpr uint32_t Align = X64TypeAttr<X64Type>::Size;
     ZEN_STATIC_ASSERT((Align & (Align - 1)) == 0);
     StkSize = ZEN_ALIGN(StkSize, Align);
@@ -114,23 +126,39 @@ public:
       }
     } // for (...)
 
+    // Keep the hot locals found by the function loader in the last temporary
+    // registers, which are never used to pass parameters, so they can be
+    // initialized before the parameters are saved. They are caller-saved, the
+    // function loader finds no hot locals in functions calling inside loops
+    std::vector<uint32_t> LocalRegs(Func->NumLocals,
+                                    X64OnePassABI::InvalidParamReg);
+    ZEN_STATIC_ASSERT(CodeEntry::MaxHotLocalsPerKind <= NumHotLocalRegs);
+    for (uint32_t I = 0; I < Func->NumHotIntLocals; ++I) {
+      LocalRegs[Func->HotIntLocals[I]] = X64OnePassABI::getTempIntRegNum(
+          X64OnePassABI::NumTempGpRegs - 1 - I);
+    }
+    for (uint32_t I = 0; I < Func->NumHotFloatLocals; ++I) {
+      LocalRegs[Func->HotFloatLocals[I]] = X64OnePassABI::getTempFloatRegNum(
+          X64OnePassABI::NumTempFpRegs - 1 - I);
+    }
+
     // layout rest locals
     for (uint32_t I = 0; I < Func->NumLocals; ++I) {
       switch (Func->LocalTypes[I]) {
       case WASMType::I32:
-        layoutLocal<WASMType::I32>(StackTop);
+        layoutLocal<WASMType::I32>(StackTop, LocalRegs[I]);
         break;
       case WASMType::I64:
-        layoutLocal<WASMType::I64>(StackTop);
+        layoutLocal<WASMType::I64>(StackTop, LocalRegs[I]);
         break;
       case WASMType::F32:
-        layoutLocal<WASMType::F32>(StackTop);
+        layoutLocal<WASMType::F32>(StackTop, LocalRegs[I]);
         break;
       case WASMType::F64:
-        layoutLocal<WASMType::F64>(StackTop);
+        layoutLocal<WASMType::F64>(StackTop, LocalRegs[I]);
         break;
       case WASMType::V128:
-        layoutLocal<WASMType::V128>(StackTop);
+        layoutLocal<WASMType::V128>(StackTop, LocalRegs[I]);
         break;
       default:
         ZEN_ABORT();
@@ -140,6 +168,7 @@ public:
     // set _stack_used and _stack_budget
     StackUsed = ((StackTop + 15) / 16) * 16;
     StackBudget = StackUsed + StackIncrement;
+    clearTempStackSlots();
     // set param in register
     if (FuncType->NumParams) {
       ParamInRegister = true;
@@ -230,14 +259,13 @@ public:
   X64InstOperand getTempStackOperand(WASMType Type, uint32_t Size) {
     ZEN_ASSERT(getWASMTypeSize(Type) == Size);
     ZEN_ASSERT((Size & (Size - 1)) == 0);
-    StackUsed = ZEN_ALIGN(StackUsed, Size);
-    StackUsed += Size;
+    int32_t Offset = allocTempStackSlot(Size);
     // check if need to grow the stack
     if (StackUsed > StackBudget) {
       StackBudget += StackIncrement;
     }
     return X64InstOperand(Type, X64OnePassABI::getFrameBase(),
-                          -(int32_t)StackUsed, X64InstOperand::FLAG_TEMP_MEM);
+                          -Offset, X64InstOperand::FLAG_TEMP_MEM);
   }
 
   X64MachineState getVMState() const { return VmState; }
@@ -265,10 +293,9 @@ public:
       ZEN_ASSERT(Op.isMem());
       ZEN_ASSERT(Op.getOffset() < 0 && (-Op.getOffset() <= StackUsed));
       ZEN_ASSERT(-Op.getOffset() <= StackUsed);
-      StackUsed = (-Op.getOffset() -
-                   getWASMTypeSize(Op.getType())); // if stack aligned when
-                                                   // getTempStackOperand,
-                                                   // some stack space lost;
+      // the copy of a deferred local.get may be allocated above temporaries
+      // which are released before it
+      releaseTempStackSlot(-Op.getOffset());
     }
   }
 };
@@ -159,29 +159,33 @@ public:
 template <CmovccOperator Opr, bool Cond>
 class CmovccOperatorImpl : public ConditionalOperatorBase {
 public:
+  typedef asmjit::x86::Gp Gp; // 32/64-bit general purpose register
+
   // emit cmovcc instruction
-  static void emit(X64Assembler &_, const Reg &Res, const Reg &Opnd);
-  static void emit(X64Assembler &_, const Reg &Res, const Mem &Opnd);
+  static void emit(X64Assembler &_, const Gp &Res, const Gp &Opnd);
+  static void emit(X64Assembler &_, const Gp &Res, const Mem &Opnd);
 };
 
 #define DECL_CMOVCC_IMPL(Opr, TrueOp, FalseOp)                                 \
   template <>                                                                  \
   class CmovccOperatorImpl<CM_##Opr, true> : public ConditionalOperatorBase {  \
   public:                                                                      \
-    static void emit(X64Assembler &_, const Reg &Res, const Reg &Opnd) {       \
+    typedef asmjit::x86::Gp Gp;                                                \
+    static void emit(X64Assembler &_, const Gp &Res, const Gp &Opnd) {         \
       _.Assembler().TrueOp(Res, Opnd);                                         \
     }                                                                          \
-    static void emit(X64Assembler &_, const Reg &Res, const Mem &Opnd) {       \
+    static void emit(X64Assembler &_, const Gp &Res, const Mem &Opnd) {        \
       _.Assembler().TrueOp(Res, Opnd);                                         \
     }                                                                          \
   };                                                                           \
   template <>                                                                  \
   class CmovccOperatorImpl<CM_##Opr, false> : public ConditionalOperatorBase { \
   public:                                                                      \
-    static void emit(X64Assembler &_, const Reg &Res, const Reg &Opnd) {       \
+    typedef asmjit::x86::Gp Gp;                                                \
+    static void emit(X64Assembler &_, const Gp &Res, const Gp &Opnd) {         \
       _.Assembler().FalseOp(Res, Opnd);                                        \
     }                                                                          \
-    static void emit(X64Assembler &_, const Reg &Res, const Mem &Opnd) {       \
+    static void emit(X64Assembler &_, const Gp &Res, const Mem &Opnd) {        \
       _.Assembler().FalseOp(Res, Opnd);                                        \
     }                                                                          \
   }
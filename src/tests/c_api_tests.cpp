@@ -1,16 +1,32 @@
 // Copyright (C) 2021-2023 the DTVM authors. All Rights Reserved.
 // SPDX-License-Identifier: Apache-2.0
 
+#include "utils/others.h"
 #include "zetaengine-c.h"
 #include "zetaengine.h"
 
+#include <algorithm>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <gtest/gtest.h>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace zen::test {
 
 using namespace zen;
 using namespace common;
 
+// Callers create the config by value, the options added later are only set on
+// the configs created by ZenCreateRuntimeConfig
+static_assert(sizeof(ZenRuntimeConfig) == sizeof(ZenRunMode) + 4 * sizeof(bool),
+              "the layout of ZenRuntimeConfig is part of the ABI");
+
 static ZenRuntimeConfig RuntimeConfig = {
 #ifdef ZEN_ENABLE_SINGLEPASS_JIT
     .Mode = ZenModeSinglepass,
@@ -163,6 +179,807 @@ TEST(C_API, Trap) {
   ZenDeleteRuntime(Runtime);
 }
 
+TEST(C_API, Statistics) {
+  ZenEnableLogging();
+  ZenRuntimeConfig StatsRuntimeConfig = RuntimeConfig;
+  StatsRuntimeConfig.EnableStatistics = true;
+  ZenRuntimeRef Runtime = ZenCreateRuntime(&StatsRuntimeConfig);
+  EXPECT_NE(Runtime, nullptr);
+
+  // Same module as C_API.Trap
+  static uint8_t WASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x04, 0x01, 0x60,
+      0x00, 0x00, 0x03, 0x03, 0x02, 0x00, 0x00, 0x05, 0x03, 0x01, 0x00, 0x01,
+      0x07, 0x09, 0x01, 0x05, 0x65, 0x6e, 0x74, 0x72, 0x79, 0x00, 0x00, 0x0a,
+      0x0b, 0x02, 0x04, 0x00, 0x10, 0x01, 0x0b, 0x04, 0x00, 0x10, 0x01, 0x0b,
+  };
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "test", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+
+  ZenIsolationRef Isolation = ZenCreateIsolation(Runtime);
+  EXPECT_NE(Isolation, nullptr);
+
+  ZenInstanceRef Instance =
+      ZenCreateInstance(Isolation, Module, ErrBuf, ErrBufSize);
+  EXPECT_NE(Instance, nullptr);
+
+  ZenValue Results[1];
+  uint32_t NumOutResults;
+  for (int I = 0; I < 2; ++I) {
+    EXPECT_FALSE(ZenCallWasmFuncByName(Runtime, Instance, "entry", nullptr, 0,
+                                       Results, &NumOutResults));
+    ZenClearInstanceError(Instance);
+  }
+
+  ZenStatisticsSnapshot Snapshot;
+  EXPECT_TRUE(ZenGetRuntimeStatistics(Runtime, &Snapshot));
+  EXPECT_EQ(Snapshot.Phases[ZenStatPhaseLoad].Count, 1);
+  EXPECT_EQ(Snapshot.Phases[ZenStatPhaseInstantiation].Count, 1);
+  const ZenPhaseStatistics &Exec = Snapshot.Phases[ZenStatPhaseExecution];
+  EXPECT_EQ(Exec.Count, 2);
+  EXPECT_GT(Exec.TotalNs, 0);
+  EXPECT_LE(Exec.P50Ns, Exec.P99Ns);
+  EXPECT_LE(Exec.P99Ns, Exec.MaxNs);
+  EXPECT_EQ(Snapshot.Counters[ZenStatCounterTraps], 2);
+
+  ZenPhaseStatistics Phase;
+  EXPECT_TRUE(
+      ZenGetRuntimePhaseStatistics(Runtime, ZenStatPhaseExecution, &Phase));
+  EXPECT_EQ(Phase.Count, 2);
+  EXPECT_TRUE(ZenGetRuntimePhaseStatistics(
+      Runtime, ZenStatPhaseJITPassMCEmission, &Phase));
+  if (RuntimeConfig.Mode == ZenModeInterp) {
+    EXPECT_EQ(Phase.Count, 0);
+  }
+  EXPECT_FALSE(ZenGetRuntimePhaseStatistics(
+      Runtime, static_cast<ZenStatPhase>(ZenStatPhaseJITPassMCEmission + 1),
+      &Phase));
+  uint64_t CounterValue = 0;
+  EXPECT_TRUE(
+      ZenGetRuntimeStatCounter(Runtime, ZenStatCounterTraps, &CounterValue));
+  EXPECT_EQ(CounterValue, 2);
+  EXPECT_TRUE(ZenGetRuntimeStatCounter(
+      Runtime, ZenStatCounterJITRegAllocDowngrades, &CounterValue));
+  EXPECT_EQ(CounterValue, 0);
+  EXPECT_EQ(ZenGetRegAllocDowngradedFuncs(Module, nullptr, 0), 0);
+
+  uint32_t TextSize = ZenDumpRuntimeStatistics(Runtime, nullptr, 0);
+  EXPECT_GT(TextSize, 0);
+  std::string Text(TextSize, '\0');
+  EXPECT_EQ(ZenDumpRuntimeStatistics(Runtime, Text.data(), TextSize + 1),
+            TextSize);
+  EXPECT_NE(Text.find("dtvm_phase_duration_seconds_count{phase=\"execution\"} "
+                      "2\n"),
+            std::string::npos);
+  EXPECT_NE(Text.find("dtvm_traps_total 2\n"), std::string::npos);
+
+  EXPECT_TRUE(ZenDeleteInstance(Isolation, Instance));
+
+  EXPECT_TRUE(ZenDeleteIsolation(Runtime, Isolation));
+
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+
+  ZenDeleteRuntime(Runtime);
+}
+
+TEST(C_API, MemoryAccess) {
+  ZenEnableLogging();
+  ZenRuntimeConfigRef Config = ZenCreateRuntimeConfig(RuntimeConfig.Mode);
+  ZenRuntimeConfigSetWASI(Config, false);
+  ZenRuntimeConfigSetStatistics(Config, true);
+  ZenRuntimeConfigSetNumMultipassThreads(Config, 2);
+  ZenRuntimeRef Runtime = ZenCreateRuntime(Config);
+  ZenDeleteRuntimeConfig(Config);
+  EXPECT_NE(Runtime, nullptr);
+
+  // Same module as C_API.Trap, one page of memory
+  static uint8_t WASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x04, 0x01, 0x60,
+      0x00, 0x00, 0x03, 0x03, 0x02, 0x00, 0x00, 0x05, 0x03, 0x01, 0x00, 0x01,
+      0x07, 0x09, 0x01, 0x05, 0x65, 0x6e, 0x74, 0x72, 0x79, 0x00, 0x00, 0x0a,
+      0x0b, 0x02, 0x04, 0x00, 0x10, 0x01, 0x0b, 0x04, 0x00, 0x10, 0x01, 0x0b,
+  };
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "test", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+
+  ZenIsolationRef Isolation = ZenCreateIsolation(Runtime);
+  EXPECT_NE(Isolation, nullptr);
+
+  ZenInstanceRef Instance =
+      ZenCreateInstance(Isolation, Module, ErrBuf, ErrBufSize);
+  EXPECT_NE(Instance, nullptr);
+
+  char Hello[] = "hello";
+  char World[] = "world";
+  ZenMemAccess Writes[] = {
+      {.Offset = 16, .Size = 5, .Data = Hello},
+      {.Offset = 65531, .Size = 5, .Data = World},
+  };
+  EXPECT_TRUE(ZenWriteAppMem(Instance, Writes, 2));
+
+  char *Slice = static_cast<char *>(ZenGetAppMemSlice(Instance, 16, 5));
+  ASSERT_NE(Slice, nullptr);
+  EXPECT_EQ(std::string(Slice, 5), "hello");
+  EXPECT_EQ(Slice, ZenGetHostMemAddr(Instance, 16));
+
+  char Buf1[5], Buf2[5];
+  ZenMemAccess Reads[] = {
+      {.Offset = 65531, .Size = 5, .Data = Buf1},
+      {.Offset = 16, .Size = 5, .Data = Buf2},
+  };
+  EXPECT_TRUE(ZenReadAppMem(Instance, Reads, 2));
+  EXPECT_EQ(std::string(Buf1, 5), "world");
+  EXPECT_EQ(std::string(Buf2, 5), "hello");
+  EXPECT_FALSE(ZenGetInstanceError(Instance, ErrBuf, ErrBufSize));
+
+  // Nothing is written if any range is out of bounds
+  ZenMemAccess BadWrites[] = {
+      {.Offset = 16, .Size = 5, .Data = World},
+      {.Offset = 65532, .Size = 5, .Data = Hello},
+  };
+  EXPECT_FALSE(ZenWriteAppMem(Instance, BadWrites, 2));
+  EXPECT_TRUE(ZenGetInstanceError(Instance, ErrBuf, ErrBufSize));
+  EXPECT_STREQ(ErrBuf, "execution error: out of bounds memory access");
+  ZenClearInstanceError(Instance);
+  EXPECT_EQ(std::string(Slice, 5), "hello");
+  EXPECT_EQ(ZenGetAppMemSlice(Instance, 65536, 0), nullptr);
+  ZenClearInstanceError(Instance);
+
+  EXPECT_TRUE(ZenDeleteInstance(Isolation, Instance));
+
+  EXPECT_TRUE(ZenDeleteIsolation(Runtime, Isolation));
+
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+
+  ZenDeleteRuntime(Runtime);
+}
+
+// Runs the module of a valid and an invalid function with lazy function
+// loading, the config is deleted
+static void expectLazyFunctionLoad(ZenRuntimeConfigRef Config) {
+  ZenRuntimeConfigSetWASI(Config, false);
+  ZenRuntimeConfigSetLazyFunctionLoad(Config, true);
+  ZenRuntimeRef Runtime = ZenCreateRuntime(Config);
+  ZenDeleteRuntimeConfig(Config);
+  ASSERT_NE(Runtime, nullptr);
+
+  // (func (export "ok") (result i32) i32.const 42)
+  // (func (export "bad") (result i32) i64.const 1)
+  static uint8_t WASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x05, 0x01,
+      0x60, 0x00, 0x01, 0x7f, 0x03, 0x03, 0x02, 0x00, 0x00, 0x07, 0x0c,
+      0x02, 0x02, 0x6f, 0x6b, 0x00, 0x00, 0x03, 0x62, 0x61, 0x64, 0x00,
+      0x01, 0x0a, 0x0b, 0x02, 0x04, 0x00, 0x41, 0x2a, 0x0b, 0x04, 0x00,
+      0x42, 0x01, 0x0b,
+  };
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  // The invalid function is not validated when loading
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "test", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+
+  ZenIsolationRef Isolation = ZenCreateIsolation(Runtime);
+  EXPECT_NE(Isolation, nullptr);
+
+  ZenInstanceRef Instance =
+      ZenCreateInstance(Isolation, Module, ErrBuf, ErrBufSize);
+  EXPECT_NE(Instance, nullptr);
+
+  ZenValue Results[1];
+  uint32_t NumOutResults;
+  EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, "ok", nullptr, 0,
+                                    Results, &NumOutResults));
+  EXPECT_EQ(NumOutResults, 1);
+  EXPECT_EQ(Results[0].Value.I32, 42);
+
+  // Fails on every call
+  for (int I = 0; I < 2; ++I) {
+    EXPECT_FALSE(ZenCallWasmFuncByName(Runtime, Instance, "bad", nullptr, 0,
+                                       Results, &NumOutResults));
+    EXPECT_TRUE(ZenGetInstanceError(Instance, ErrBuf, ErrBufSize));
+    EXPECT_STREQ(ErrBuf, "load error: type mismatch: stack size does not "
+                         "match block type");
+    ZenClearInstanceError(Instance);
+  }
+
+  EXPECT_TRUE(ZenDeleteInstance(Isolation, Instance));
+
+  EXPECT_TRUE(ZenDeleteIsolation(Runtime, Isolation));
+
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+
+  ZenDeleteRuntime(Runtime);
+}
+
+TEST(C_API, LazyFunctionLoad) {
+  ZenEnableLogging();
+  expectLazyFunctionLoad(ZenCreateRuntimeConfig(ZenModeInterp));
+}
+
+TEST(C_API, LazyFunctionLoadMultipass) {
+#ifndef ZEN_ENABLE_MULTIPASS_JIT
+  GTEST_SKIP() << "multipass JIT not enabled";
+#endif
+  ZenEnableLogging();
+  // Validated by the stub resolver, and by the background compilation with
+  // multiple threads
+  for (uint32_t NumThreads : {0, 2}) {
+    SCOPED_TRACE(NumThreads);
+    ZenRuntimeConfigRef Config = ZenCreateRuntimeConfig(ZenModeMultipass);
+    ZenRuntimeConfigSetMultipassLazy(Config, true);
+    ZenRuntimeConfigSetNumMultipassThreads(Config, NumThreads);
+    expectLazyFunctionLoad(Config);
+  }
+}
+
+TEST(C_API, TailCall) {
+  ZenEnableLogging();
+  ZenRuntimeRef Runtime = ZenCreateRuntime(&RuntimeConfig);
+  EXPECT_NE(Runtime, nullptr);
+
+  // (type $sum_t (func (param i32 ... i32) (result i32))) ;; 20 params
+  // (type $num_t (func (param i32) (result i32)))
+  // (table 3 funcref)
+  // (elem (i32.const 0) $even $odd $sum)
+  // (func (export "entry") (result i32)
+  //   (return_call $sum (i32.const 1) ... (i32.const 20)))
+  // (func $sum (type $sum_t) local.get 0 ... local.get 19 i32.add)
+  // (func $even (export "even") (type $num_t)
+  //   (if (result i32) (i32.eqz (local.get 0)) (then (i32.const 1))
+  //     (else (return_call $odd (i32.sub (local.get 0) (i32.const 1))))))
+  // (func $odd (type $num_t)
+  //   (if (result i32) (i32.eqz (local.get 0)) (then (i32.const 0))
+  //     (else (return_call $even (i32.sub (local.get 0) (i32.const 1))))))
+  // (func (export "dispatch") (type $num_t)
+  //   (return_call_indirect (type $num_t) (i32.const 1000001) (local.get 0)))
+  // (func (export "indirect_sum") (result i32)
+  //   (return_call_indirect (type $sum_t) (i32.const 1) ... (i32.const 20)
+  //     (i32.const 2)))
+  static uint8_t WASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x22, 0x03, 0x60,
+      0x00, 0x01, 0x7f, 0x60, 0x14, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f,
+      0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f, 0x7f,
+      0x7f, 0x01, 0x7f, 0x60, 0x01, 0x7f, 0x01, 0x7f, 0x03, 0x07, 0x06, 0x00,
+      0x01, 0x02, 0x02, 0x02, 0x00, 0x04, 0x04, 0x01, 0x70, 0x00, 0x03, 0x07,
+      0x2a, 0x04, 0x05, 0x65, 0x6e, 0x74, 0x72, 0x79, 0x00, 0x00, 0x04, 0x65,
+      0x76, 0x65, 0x6e, 0x00, 0x02, 0x08, 0x64, 0x69, 0x73, 0x70, 0x61, 0x74,
+      0x63, 0x68, 0x00, 0x04, 0x0c, 0x69, 0x6e, 0x64, 0x69, 0x72, 0x65, 0x63,
+      0x74, 0x5f, 0x73, 0x75, 0x6d, 0x00, 0x05, 0x09, 0x09, 0x01, 0x00, 0x41,
+      0x00, 0x0b, 0x03, 0x02, 0x03, 0x01, 0x0a, 0xce, 0x01, 0x06, 0x2c, 0x00,
+      0x41, 0x01, 0x41, 0x02, 0x41, 0x03, 0x41, 0x04, 0x41, 0x05, 0x41, 0x06,
+      0x41, 0x07, 0x41, 0x08, 0x41, 0x09, 0x41, 0x0a, 0x41, 0x0b, 0x41, 0x0c,
+      0x41, 0x0d, 0x41, 0x0e, 0x41, 0x0f, 0x41, 0x10, 0x41, 0x11, 0x41, 0x12,
+      0x41, 0x13, 0x41, 0x14, 0x12, 0x01, 0x0b, 0x3d, 0x00, 0x20, 0x00, 0x20,
+      0x01, 0x6a, 0x20, 0x02, 0x6a, 0x20, 0x03, 0x6a, 0x20, 0x04, 0x6a, 0x20,
+      0x05, 0x6a, 0x20, 0x06, 0x6a, 0x20, 0x07, 0x6a, 0x20, 0x08, 0x6a, 0x20,
+      0x09, 0x6a, 0x20, 0x0a, 0x6a, 0x20, 0x0b, 0x6a, 0x20, 0x0c, 0x6a, 0x20,
+      0x0d, 0x6a, 0x20, 0x0e, 0x6a, 0x20, 0x0f, 0x6a, 0x20, 0x10, 0x6a, 0x20,
+      0x11, 0x6a, 0x20, 0x12, 0x6a, 0x20, 0x13, 0x6a, 0x0b, 0x12, 0x00, 0x20,
+      0x00, 0x45, 0x04, 0x7f, 0x41, 0x01, 0x05, 0x20, 0x00, 0x41, 0x01, 0x6b,
+      0x12, 0x03, 0x0b, 0x0b, 0x12, 0x00, 0x20, 0x00, 0x45, 0x04, 0x7f, 0x41,
+      0x00, 0x05, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x12, 0x02, 0x0b, 0x0b, 0x0b,
+      0x00, 0x41, 0xc1, 0x84, 0x3d, 0x20, 0x00, 0x13, 0x02, 0x00, 0x0b, 0x2f,
+      0x00, 0x41, 0x01, 0x41, 0x02, 0x41, 0x03, 0x41, 0x04, 0x41, 0x05, 0x41,
+      0x06, 0x41, 0x07, 0x41, 0x08, 0x41, 0x09, 0x41, 0x0a, 0x41, 0x0b, 0x41,
+      0x0c, 0x41, 0x0d, 0x41, 0x0e, 0x41, 0x0f, 0x41, 0x10, 0x41, 0x11, 0x41,
+      0x12, 0x41, 0x13, 0x41, 0x14, 0x41, 0x02, 0x13, 0x01, 0x00, 0x0b,
+  };
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "test", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+
+  ZenIsolationRef Isolation = ZenCreateIsolation(Runtime);
+  EXPECT_NE(Isolation, nullptr);
+
+  ZenInstanceRef Instance =
+      ZenCreateInstance(Isolation, Module, ErrBuf, ErrBufSize);
+  EXPECT_NE(Instance, nullptr);
+
+  ZenValue Results[1];
+  uint32_t NumOutResults;
+  // The callee takes more params than the caller's params and locals
+  EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, "entry", nullptr, 0,
+                                    Results, &NumOutResults));
+  EXPECT_EQ(NumOutResults, 1);
+  EXPECT_EQ(Results[0].Value.I32, 210);
+
+  EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, "indirect_sum",
+                                    nullptr, 0, Results, &NumOutResults));
+  EXPECT_EQ(NumOutResults, 1);
+  EXPECT_EQ(Results[0].Value.I32, 210);
+
+  // Far deeper than the call stack allows without reusing the frames
+  const char *EvenArgs[] = {"1000000"};
+  EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, "even", EvenArgs, 1,
+                                    Results, &NumOutResults));
+  EXPECT_EQ(NumOutResults, 1);
+  EXPECT_EQ(Results[0].Value.I32, 1);
+
+  const char *DispatchArgs[] = {"1"};
+  EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, "dispatch",
+                                    DispatchArgs, 1, Results, &NumOutResults));
+  EXPECT_EQ(NumOutResults, 1);
+  EXPECT_EQ(Results[0].Value.I32, 1);
+
+  // The signature doesn't match the table entry
+  DispatchArgs[0] = "2";
+  EXPECT_FALSE(ZenCallWasmFuncByName(Runtime, Instance, "dispatch",
+                                     DispatchArgs, 1, Results, &NumOutResults));
+  EXPECT_TRUE(ZenGetInstanceError(Instance, ErrBuf, ErrBufSize));
+  EXPECT_STREQ(ErrBuf, "execution error: indirect call type mismatch");
+  ZenClearInstanceError(Instance);
+
+  EXPECT_TRUE(ZenDeleteInstance(Isolation, Instance));
+
+  EXPECT_TRUE(ZenDeleteIsolation(Runtime, Isolation));
+
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+
+  // (func (export "entry") (result i64) (return_call 1))
+  // (func (result i32) (i32.const 0))
+  static uint8_t BadWASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x09, 0x02, 0x60,
+      0x00, 0x01, 0x7f, 0x60, 0x00, 0x01, 0x7e, 0x03, 0x03, 0x02, 0x01, 0x00,
+      0x07, 0x09, 0x01, 0x05, 0x65, 0x6e, 0x74, 0x72, 0x79, 0x00, 0x00, 0x0a,
+      0x0b, 0x02, 0x04, 0x00, 0x12, 0x01, 0x0b, 0x04, 0x00, 0x41, 0x00, 0x0b,
+  };
+  Module = ZenLoadModuleFromBuffer(Runtime, "bad", BadWASMBuffer,
+                                   sizeof(BadWASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_EQ(Module, nullptr);
+  EXPECT_STREQ(ErrBuf, "load error: type mismatch");
+
+  ZenDeleteRuntime(Runtime);
+}
+
+TEST(C_API, ModuleCache) {
+  ZenEnableLogging();
+  ZenRuntimeConfigRef Config = ZenCreateRuntimeConfig(ZenModeInterp);
+  ZenRuntimeConfigSetWASI(Config, false);
+  ZenRuntimeConfigSetModuleCache(Config, true);
+  ZenRuntimeRef Runtime = ZenCreateRuntime(Config);
+  ZenDeleteRuntimeConfig(Config);
+  EXPECT_NE(Runtime, nullptr);
+
+  // The loader rewrites the i64 drop and select in place
+  // (func (export "f") (param i64 i64 i32) (result i64)
+  //   (drop (i64.const 1))
+  //   (select (local.get 0) (local.get 1) (local.get 2)))
+  static uint8_t WASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x08, 0x01, 0x60,
+      0x03, 0x7e, 0x7e, 0x7f, 0x01, 0x7e, 0x03, 0x02, 0x01, 0x00, 0x07, 0x05,
+      0x01, 0x01, 0x66, 0x00, 0x00, 0x0a, 0x0e, 0x01, 0x0c, 0x00, 0x20, 0x00,
+      0x20, 0x01, 0x20, 0x02, 0x1b, 0x42, 0x01, 0x1a, 0x0b,
+  };
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "a", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+  ZenModuleRef SharedModule = ZenLoadModuleFromBuffer(
+      Runtime, "b", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_EQ(SharedModule, Module);
+
+  // Different bytecode isn't shared
+  uint8_t OtherWASMBuffer[sizeof(WASMBuffer)];
+  std::memcpy(OtherWASMBuffer, WASMBuffer, sizeof(WASMBuffer));
+  OtherWASMBuffer[sizeof(WASMBuffer) - 3] = 0x02; // i64.const 2
+  ZenModuleRef OtherModule =
+      ZenLoadModuleFromBuffer(Runtime, "c", OtherWASMBuffer,
+                              sizeof(OtherWASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(OtherModule, nullptr);
+  EXPECT_NE(OtherModule, Module);
+
+  ZenIsolationRef Isolation = ZenCreateIsolation(Runtime);
+  EXPECT_NE(Isolation, nullptr);
+
+  ZenInstanceRef Instance =
+      ZenCreateInstance(Isolation, SharedModule, ErrBuf, ErrBufSize);
+  EXPECT_NE(Instance, nullptr);
+
+  ZenValue Results[1];
+  uint32_t NumOutResults;
+  const char *Args[] = {"7", "8", "0"};
+  EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, "f", Args, 3, Results,
+                                    &NumOutResults));
+  EXPECT_EQ(NumOutResults, 1);
+  EXPECT_EQ(Results[0].Value.I64, 8);
+
+  EXPECT_TRUE(ZenDeleteInstance(Isolation, Instance));
+
+  EXPECT_TRUE(ZenDeleteIsolation(Runtime, Isolation));
+
+  // The shared module lives until both names are unloaded
+  EXPECT_TRUE(ZenDeleteModule(Runtime, SharedModule));
+  ZenModuleRef CachedModule = ZenLoadModuleFromBuffer(
+      Runtime, "d", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_EQ(CachedModule, Module);
+  EXPECT_TRUE(ZenDeleteModule(Runtime, CachedModule));
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+  EXPECT_TRUE(ZenDeleteModule(Runtime, OtherModule));
+
+  ZenDeleteRuntime(Runtime);
+}
+
+TEST(C_API, BlockExecutor) {
+  ZenEnableLogging();
+  ZenRuntimeRef Runtime = ZenCreateRuntime(&RuntimeConfig);
+  EXPECT_NE(Runtime, nullptr);
+
+  // (memory 1)
+  // (func $use_gas (export "__instrumented_use_gas") (param i64))
+  // (func (export "work") (param $n i32) (result i32)
+  //   (local $i i32) (local $acc i32)
+  //   (if (i32.eq (local.get $n) (i32.const 13)) (then unreachable))
+  //   (block
+  //     (loop
+  //       (br_if 1 (i32.ge_u (local.get $i) (local.get $n)))
+  //       (call $use_gas (i64.const 10))
+  //       (local.set $acc (i32.add (local.get $acc) (local.get $i)))
+  //       (local.set $i (i32.add (local.get $i) (i32.const 1)))
+  //       (br 0)))
+  //   (i32.store (i32.const 0)
+  //              (i32.add (i32.load (i32.const 0)) (local.get $n)))
+  //   (i32.add (local.get $acc) (i32.load (i32.const 0))))
+  static uint8_t WASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x0a, 0x02, 0x60,
+      0x01, 0x7e, 0x00, 0x60, 0x01, 0x7f, 0x01, 0x7f, 0x03, 0x03, 0x02, 0x00,
+      0x01, 0x05, 0x03, 0x01, 0x00, 0x01, 0x07, 0x21, 0x02, 0x16, 0x5f, 0x5f,
+      0x69, 0x6e, 0x73, 0x74, 0x72, 0x75, 0x6d, 0x65, 0x6e, 0x74, 0x65, 0x64,
+      0x5f, 0x75, 0x73, 0x65, 0x5f, 0x67, 0x61, 0x73, 0x00, 0x00, 0x04, 0x77,
+      0x6f, 0x72, 0x6b, 0x00, 0x01, 0x0a, 0x48, 0x02, 0x02, 0x00, 0x0b, 0x43,
+      0x01, 0x02, 0x7f, 0x20, 0x00, 0x41, 0x0d, 0x46, 0x04, 0x40, 0x00, 0x0b,
+      0x02, 0x40, 0x03, 0x40, 0x20, 0x01, 0x20, 0x00, 0x4f, 0x0d, 0x01, 0x42,
+      0x0a, 0x10, 0x00, 0x20, 0x02, 0x20, 0x01, 0x6a, 0x21, 0x02, 0x20, 0x01,
+      0x41, 0x01, 0x6a, 0x21, 0x01, 0x0c, 0x00, 0x0b, 0x0b, 0x41, 0x00, 0x41,
+      0x00, 0x28, 0x02, 0x00, 0x20, 0x00, 0x6a, 0x36, 0x02, 0x00, 0x20, 0x02,
+      0x41, 0x00, 0x28, 0x02, 0x00, 0x6a, 0x0b,
+  };
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "gas", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+  uint32_t FuncIdx;
+  EXPECT_TRUE(ZenGetExportFunc(Module, "work", &FuncIdx));
+
+  ZenBlockExecutorRef Executor = ZenCreateBlockExecutor(Runtime, 2, false);
+  EXPECT_NE(Executor, nullptr);
+  EXPECT_EQ(ZenGetBlockExecutorNumWorkers(Executor), 2);
+
+  ZenValue Args[3];
+  ZenValue Results[3][1];
+  char ErrBufs[3][128] = {{0}};
+  ZenExecJob Jobs[3];
+  ZenExecResult ExecResults[3];
+  const int32_t Ns[] = {5, 13, 30};
+  for (uint32_t I = 0; I < 3; ++I) {
+    Args[I].Type = ZenTypeI32;
+    Args[I].Value.I32 = Ns[I];
+    Jobs[I] = {
+        .Module = Module,
+        .FuncIdx = FuncIdx,
+        .Args = &Args[I],
+        .NumArgs = 1,
+        .GasLimit = 100,
+    };
+    ExecResults[I] = {
+        .Succeeded = false,
+        .Results = Results[I],
+        .NumResults = 0,
+        .GasLeft = 0,
+        .ErrBuf = ErrBufs[I],
+        .ErrBufSize = sizeof(ErrBufs[I]),
+    };
+  }
+  ZenExecuteBlock(Executor, Jobs, ExecResults, 3);
+
+  EXPECT_TRUE(ExecResults[0].Succeeded);
+  EXPECT_EQ(ExecResults[0].NumResults, 1);
+  EXPECT_EQ(Results[0][0].Value.I32, 15);
+  EXPECT_EQ(ExecResults[0].GasLeft, 50);
+
+  EXPECT_FALSE(ExecResults[1].Succeeded);
+  EXPECT_EQ(ExecResults[1].NumResults, 0);
+  EXPECT_EQ(ExecResults[1].GasLeft, 100);
+  EXPECT_STREQ(ErrBufs[1], "execution error: unreachable");
+
+  EXPECT_FALSE(ExecResults[2].Succeeded);
+  EXPECT_EQ(ExecResults[2].NumResults, 0);
+  EXPECT_EQ(ExecResults[2].GasLeft, 0);
+  EXPECT_STREQ(ErrBufs[2], "execution error: out of gas");
+
+  ZenDeleteBlockExecutor(Executor);
+
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+
+  ZenDeleteRuntime(Runtime);
+}
+
+TEST(C_API, WasmProfile) {
+#ifndef ZEN_ENABLE_WASM_PROFILER
+  GTEST_SKIP() << "wasm profiler not enabled";
+#endif
+  ZenEnableLogging();
+  ZenRuntimeConfigRef Config = ZenCreateRuntimeConfig(ZenModeInterp);
+  ZenRuntimeConfigSetWASI(Config, false);
+  ZenRuntimeConfigSetWasmProfiler(Config, true, 100);
+  ZenRuntimeConfigSetWasmProfilerCallCounts(Config, true);
+  ZenRuntimeRef Runtime = ZenCreateRuntime(Config);
+  ZenDeleteRuntimeConfig(Config);
+  EXPECT_NE(Runtime, nullptr);
+
+  // (func $f (export "f") (param i32) (result i32)
+  //   (if (result i32) (i32.eqz (local.get 0)) (then (i32.const 0))
+  //     (else (call $f (i32.sub (local.get 0) (i32.const 1))))))
+  static uint8_t WASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x06, 0x01, 0x60,
+      0x01, 0x7f, 0x01, 0x7f, 0x03, 0x02, 0x01, 0x00, 0x07, 0x05, 0x01, 0x01,
+      0x66, 0x00, 0x00, 0x0a, 0x14, 0x01, 0x12, 0x00, 0x20, 0x00, 0x45, 0x04,
+      0x7f, 0x41, 0x00, 0x05, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x10, 0x00, 0x0b,
+      0x0b,
+  };
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "test", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+
+  ZenIsolationRef Isolation = ZenCreateIsolation(Runtime);
+  EXPECT_NE(Isolation, nullptr);
+
+  ZenInstanceRef Instance =
+      ZenCreateInstance(Isolation, Module, ErrBuf, ErrBufSize);
+  EXPECT_NE(Instance, nullptr);
+
+  ZenValue Results[1];
+  uint32_t NumOutResults;
+  const char *Args[] = {"9"};
+  EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, "f", Args, 1, Results,
+                                    &NumOutResults));
+
+  EXPECT_TRUE(ZenDeleteInstance(Isolation, Instance));
+
+  EXPECT_TRUE(ZenDeleteIsolation(Runtime, Isolation));
+
+  const std::string Filename = testing::TempDir() + "c_api_wasm_profile";
+  EXPECT_TRUE(ZenWriteWasmProfile(Runtime, Filename.c_str()));
+  std::ifstream CallsFile(Filename + ".calls");
+  std::string Calls((std::istreambuf_iterator<char>(CallsFile)),
+                    std::istreambuf_iterator<char>());
+  EXPECT_EQ(Calls, "$f0 10\n");
+  std::remove(Filename.c_str());
+  std::remove((Filename + ".calls").c_str());
+
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+
+  ZenDeleteRuntime(Runtime);
+}
+
+static void envSample(ZenInstanceRef Instance) { raise(SIGPROF); }
+
+TEST(C_API, WasmProfileManySamples) {
+#ifndef ZEN_ENABLE_WASM_PROFILER
+  GTEST_SKIP() << "wasm profiler not enabled";
+#endif
+  ZenEnableLogging();
+  ZenRuntimeConfigRef Config = ZenCreateRuntimeConfig(ZenModeInterp);
+  ZenRuntimeConfigSetWASI(Config, false);
+  // Samples are taken by env.sample only, the timer never fires in the test
+  ZenRuntimeConfigSetWasmProfiler(Config, true, 1000000000);
+  ZenRuntimeRef Runtime = ZenCreateRuntime(Config);
+  ZenDeleteRuntimeConfig(Config);
+  EXPECT_NE(Runtime, nullptr);
+
+  ZenHostFuncDesc HostFuncDescs[] = {
+      {
+          .Name = "sample",
+          .NumArgs = 0,
+          .ArgTypes = NULL,
+          .NumReturns = 0,
+          .RetTypes = NULL,
+          .Ptr = (void *)envSample,
+      },
+  };
+  ZenHostModuleDescRef HostModuleDesc =
+      ZenCreateHostModuleDesc(Runtime, "env", HostFuncDescs, 1);
+  EXPECT_NE(HostModuleDesc, nullptr);
+  ZenHostModuleRef HostModule = ZenLoadHostModule(Runtime, HostModuleDesc);
+  EXPECT_NE(HostModule, nullptr);
+
+  // (import "env" "sample" (func $sample))
+  // (func (export "sample_loop") (param i32)
+  //   (loop (call $sample)
+  //     (br_if 0 (local.tee 0 (i32.sub (local.get 0) (i32.const 1))))))
+  static uint8_t WASMBuffer[] = {
+      0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x08, 0x02, 0x60,
+      0x00, 0x00, 0x60, 0x01, 0x7f, 0x00, 0x02, 0x0e, 0x01, 0x03, 0x65, 0x6e,
+      0x76, 0x06, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x00, 0x00, 0x03, 0x02,
+      0x01, 0x01, 0x07, 0x0f, 0x01, 0x0b, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+      0x5f, 0x6c, 0x6f, 0x6f, 0x70, 0x00, 0x01, 0x0a, 0x12, 0x01, 0x10, 0x00,
+      0x03, 0x40, 0x10, 0x00, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x22, 0x00, 0x0d,
+      0x00, 0x0b, 0x0b,
+  };
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "test", WASMBuffer, sizeof(WASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+
+  ZenIsolationRef Isolation = ZenCreateIsolation(Runtime);
+  EXPECT_NE(Isolation, nullptr);
+
+  ZenInstanceRef Instance =
+      ZenCreateInstance(Isolation, Module, ErrBuf, ErrBufSize);
+  EXPECT_NE(Instance, nullptr);
+
+  // 60000 samples in total, more than the sample buffer holds, none of them
+  // must be dropped
+  ZenValue Results[1];
+  uint32_t NumOutResults;
+  const char *Args[] = {"20000"};
+  for (int I = 0; I < 3; ++I) {
+    EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, "sample_loop", Args,
+                                      1, Results, &NumOutResults));
+  }
+
+  EXPECT_TRUE(ZenDeleteInstance(Isolation, Instance));
+
+  EXPECT_TRUE(ZenDeleteIsolation(Runtime, Isolation));
+
+  const std::string Filename =
+      testing::TempDir() + "c_api_wasm_profile_many_samples";
+  EXPECT_TRUE(ZenWriteWasmProfile(Runtime, Filename.c_str()));
+  std::ifstream StacksFile(Filename);
+  std::string Stacks((std::istreambuf_iterator<char>(StacksFile)),
+                     std::istreambuf_iterator<char>());
+  EXPECT_EQ(Stacks, "$f1 60000\n");
+  std::remove(Filename.c_str());
+
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+
+  EXPECT_TRUE(ZenDeleteHostModule(Runtime, HostModule));
+
+  ZenDeleteHostModuleDesc(Runtime, HostModuleDesc);
+  ZenDeleteRuntime(Runtime);
+}
+
+// (func (export "a") (call 2))
+// (func (export "b") (call 3))
+// (func)
+// (func)
+static uint8_t MultipassProfileWASMBuffer[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x04, 0x01, 0x60,
+    0x00, 0x00, 0x03, 0x05, 0x04, 0x00, 0x00, 0x00, 0x00, 0x07, 0x09, 0x02,
+    0x01, 0x61, 0x00, 0x00, 0x01, 0x62, 0x00, 0x01, 0x0a, 0x11, 0x04, 0x04,
+    0x00, 0x10, 0x02, 0x0b, 0x04, 0x00, 0x10, 0x03, 0x0b, 0x02, 0x00, 0x0b,
+    0x02, 0x00, 0x0b,
+};
+
+// Loads the module in multipass lazy mode, calls FuncName and unloads it, the
+// profile is saved when the module is deleted
+static void runWithMultipassProfile(const std::string &Dir,
+                                    const char *FuncName) {
+  ZenRuntimeConfigRef Config = ZenCreateRuntimeConfig(ZenModeMultipass);
+  ZenRuntimeConfigSetWASI(Config, false);
+  ZenRuntimeConfigSetMultipassLazy(Config, true);
+  ZenRuntimeConfigSetMultipassProfileDir(Config, Dir.c_str());
+  ZenRuntimeRef Runtime = ZenCreateRuntime(Config);
+  ZenDeleteRuntimeConfig(Config);
+  ASSERT_NE(Runtime, nullptr);
+
+  char ErrBuf[128] = {0};
+  const uint32_t ErrBufSize = sizeof(ErrBuf);
+  ZenModuleRef Module = ZenLoadModuleFromBuffer(
+      Runtime, "test", MultipassProfileWASMBuffer,
+      sizeof(MultipassProfileWASMBuffer), ErrBuf, ErrBufSize);
+  EXPECT_NE(Module, nullptr);
+
+  ZenIsolationRef Isolation = ZenCreateIsolation(Runtime);
+  EXPECT_NE(Isolation, nullptr);
+
+  ZenInstanceRef Instance =
+      ZenCreateInstance(Isolation, Module, ErrBuf, ErrBufSize);
+  EXPECT_NE(Instance, nullptr);
+
+  ZenValue Results[1];
+  uint32_t NumOutResults;
+  // Called twice, the entry is recorded once
+  for (int I = 0; I < 2; ++I) {
+    EXPECT_TRUE(ZenCallWasmFuncByName(Runtime, Instance, FuncName, nullptr, 0,
+                                      Results, &NumOutResults));
+  }
+
+  EXPECT_TRUE(ZenDeleteInstance(Isolation, Instance));
+
+  EXPECT_TRUE(ZenDeleteIsolation(Runtime, Isolation));
+
+  EXPECT_TRUE(ZenDeleteModule(Runtime, Module));
+
+  ZenDeleteRuntime(Runtime);
+}
+
+static std::map<std::string, std::vector<uint32_t>>
+readMultipassProfile(const std::string &Filename) {
+  std::map<std::string, std::vector<uint32_t>> Profile;
+  std::ifstream File(Filename);
+  std::string Line;
+  while (std::getline(File, Line)) {
+    std::istringstream LineStream(Line);
+    std::string Kind;
+    LineStream >> Kind;
+    std::vector<uint32_t> &FuncIdxs = Profile[Kind];
+    uint32_t FuncIdx;
+    while (LineStream >> FuncIdx) {
+      FuncIdxs.push_back(FuncIdx);
+    }
+  }
+  return Profile;
+}
+
+TEST(C_API, MultipassProfile) {
+#ifndef ZEN_ENABLE_MULTIPASS_JIT
+  GTEST_SKIP() << "multipass JIT not enabled";
+#endif
+  ZenEnableLogging();
+  const std::string Dir = testing::TempDir() + "c_api_multipass_profile";
+  ::mkdir(Dir.c_str(), 0755);
+  char HashStr[17];
+  std::snprintf(HashStr, sizeof(HashStr), "%016" PRIx64,
+                utils::hashBytes(MultipassProfileWASMBuffer,
+                                 sizeof(MultipassProfileWASMBuffer)));
+  const std::string Filename = Dir + "/" + HashStr + ".profile";
+  std::remove(Filename.c_str());
+
+  auto IndexOf = [](const std::vector<uint32_t> &FuncIdxs, uint32_t FuncIdx) {
+    return static_cast<size_t>(
+        std::find(FuncIdxs.begin(), FuncIdxs.end(), FuncIdx) -
+        FuncIdxs.begin());
+  };
+
+  // Save: the internal function indexes of the entry and of the called
+  // functions
+  runWithMultipassProfile(Dir, "a");
+  auto Profile = readMultipassProfile(Filename);
+  EXPECT_EQ(Profile["entries"], std::vector<uint32_t>({0}));
+  std::vector<uint32_t> Calls = Profile["calls"];
+  EXPECT_LT(IndexOf(Calls, 2), Calls.size());
+  EXPECT_EQ(IndexOf(Calls, 1), Calls.size());
+  EXPECT_EQ(IndexOf(Calls, 3), Calls.size());
+
+  // Load and merge: the functions of this run come first, followed by the
+  // ones only recorded by the previous run
+  runWithMultipassProfile(Dir, "b");
+  Profile = readMultipassProfile(Filename);
+  EXPECT_EQ(Profile["entries"], std::vector<uint32_t>({1, 0}));
+  Calls = Profile["calls"];
+  EXPECT_LT(IndexOf(Calls, 3), IndexOf(Calls, 2));
+  EXPECT_LT(IndexOf(Calls, 2), Calls.size());
+
+  // An invalid profile is ignored and replaced
+  {
+    std::ofstream File(Filename);
+    File << "entries 99\ncalls 1 3\n";
+  }
+  runWithMultipassProfile(Dir, "a");
+  Profile = readMultipassProfile(Filename);
+  EXPECT_EQ(Profile["entries"], std::vector<uint32_t>({0}));
+  Calls = Profile["calls"];
+  EXPECT_LT(IndexOf(Calls, 2), Calls.size());
+  EXPECT_EQ(IndexOf(Calls, 3), Calls.size());
+
+  std::remove(Filename.c_str());
+  ::rmdir(Dir.c_str());
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
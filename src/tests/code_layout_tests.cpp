@@ -0,0 +1,68 @@
+// Copyright (C) 2021-2023 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "utils/code_layout.h"
+
+#include <gtest/gtest.h>
+
+namespace zen::test {
+
+using namespace zen;
+using namespace utils;
+
+using Chains = std::vector<std::vector<uint32_t>>;
+
+TEST(CodeLayout, NoEdges) {
+  EXPECT_EQ(buildCallChains({}, {10, 10, 10}, UINT64_MAX),
+            (Chains{{0}, {1}, {2}}));
+  // Self calls and zero weights don't link anything
+  EXPECT_EQ(buildCallChains({{1, 1, 100}, {0, 2, 0}}, {10, 10, 10},
+                            UINT64_MAX),
+            (Chains{{0}, {1}, {2}}));
+}
+
+TEST(CodeLayout, HeaviestEdgesFirst) {
+  // 1-2 is merged first, then 2-3 extends the chain at its back and 0-1 at its
+  // front, every call edge ends up between adjacent functions
+  EXPECT_EQ(buildCallChains({{0, 1, 1}, {1, 2, 10}, {2, 3, 5}},
+                            {10, 10, 10, 10}, UINT64_MAX),
+            (Chains{{0, 1, 2, 3}}));
+  // A callee in a loop outweighs the straight-line callees and is placed
+  // next to the caller
+  EXPECT_EQ(buildCallChains({{0, 1, 1}, {0, 2, 1}, {0, 3, 8}},
+                            {10, 10, 10, 10}, UINT64_MAX),
+            (Chains{{3, 0, 1, 2}}));
+}
+
+TEST(CodeLayout, SumDuplicateEdges) {
+  // 0 and 2 call each other, 4 in total outweighs 1-2
+  EXPECT_EQ(buildCallChains({{0, 2, 2}, {2, 0, 2}, {1, 2, 3}}, {10, 10, 10},
+                            UINT64_MAX),
+            (Chains{{1, 2, 0}}));
+  EXPECT_EQ(buildCallChains({{0, 2, 1}, {2, 0, 1}, {1, 2, 3}}, {10, 10, 10},
+                            UINT64_MAX),
+            (Chains{{0, 2, 1}}));
+  // Saturated instead of wrapping around
+  EXPECT_EQ(buildCallChains({{0, 2, UINT64_MAX}, {2, 0, 1}, {1, 2, 2}},
+                            {10, 10, 10}, UINT64_MAX),
+            (Chains{{1, 2, 0}}));
+}
+
+TEST(CodeLayout, MaxChainCodeSize) {
+  EXPECT_EQ(buildCallChains({{0, 1, 5}, {1, 2, 4}}, {10, 10, 10}, 25),
+            (Chains{{0, 1}, {2}}));
+  // The skipped merge doesn't block the lighter ones
+  EXPECT_EQ(buildCallChains({{0, 1, 5}, {1, 2, 4}, {2, 3, 3}},
+                            {10, 10, 10, 10}, 25),
+            (Chains{{0, 1}, {2, 3}}));
+}
+
+TEST(CodeLayout, ChainOrder) {
+  // Ordered by the smallest function indexes, ties between equal weights are
+  // broken by the indexes
+  EXPECT_EQ(buildCallChains({{3, 1, 1}, {2, 0, 1}}, {10, 10, 10, 10},
+                            UINT64_MAX),
+            (Chains{{0, 2}, {1, 3}}));
+}
+
+} // namespace zen::test
@@ -0,0 +1,337 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "runtime/executor.h"
+#include "runtime/instance.h"
+#include "runtime/isolation.h"
+#include "runtime/module.h"
+#include "runtime/runtime.h"
+
+#include <gtest/gtest.h>
+
+namespace zen::test {
+
+using namespace zen;
+using namespace common;
+using namespace runtime;
+
+namespace {
+
+// (memory 1 1 shared)
+// (data (i32.const 8) "\2a")
+// (func (export "waiter") (result i32)
+//   (i32.add
+//     (i32.mul (memory.atomic.wait32 (i32.const 0) (i32.const 0)
+//                                    (i64.const -1))
+//              (i32.const 100))
+//     (i32.atomic.load (i32.const 4))))
+// (func (export "notifier") (result i32)
+//   (i32.atomic.store (i32.const 4) (i32.atomic.load (i32.const 8)))
+//   (loop
+//     (br_if 0 (i32.eqz (memory.atomic.notify (i32.const 0) (i32.const 1)))))
+//   (i32.const 1))
+// (func (export "counter") (result i32) (local i32)
+//   (loop
+//     (drop (i32.atomic.rmw.add (i32.const 16) (i32.const 1)))
+//     (br_if 0 (i32.lt_u (local.tee 0 (i32.add (local.get 0) (i32.const 1)))
+//                        (i32.const 1000))))
+//   (loop (br_if 0 (i32.lt_u (i32.atomic.load (i32.const 16))
+//                            (i32.const 4000))))
+//   (i32.atomic.load (i32.const 16)))
+const uint8_t ThreadsWasm[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x05, 0x01, 0x60,
+    0x00, 0x01, 0x7f, 0x03, 0x04, 0x03, 0x00, 0x00, 0x00, 0x05, 0x04, 0x01,
+    0x03, 0x01, 0x01, 0x07, 0x1f, 0x03, 0x06, 0x77, 0x61, 0x69, 0x74, 0x65,
+    0x72, 0x00, 0x00, 0x08, 0x6e, 0x6f, 0x74, 0x69, 0x66, 0x69, 0x65, 0x72,
+    0x00, 0x01, 0x07, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x65, 0x72, 0x00, 0x02,
+    0x0a, 0x6b, 0x03, 0x17, 0x00, 0x41, 0x00, 0x41, 0x00, 0x42, 0x7f, 0xfe,
+    0x01, 0x02, 0x00, 0x41, 0xe4, 0x00, 0x6c, 0x41, 0x04, 0xfe, 0x10, 0x02,
+    0x00, 0x6a, 0x0b, 0x1e, 0x00, 0x41, 0x04, 0x41, 0x08, 0xfe, 0x10, 0x02,
+    0x00, 0xfe, 0x17, 0x02, 0x00, 0x03, 0x40, 0x41, 0x00, 0x41, 0x01, 0xfe,
+    0x00, 0x02, 0x00, 0x45, 0x0d, 0x00, 0x0b, 0x41, 0x01, 0x0b, 0x32, 0x01,
+    0x01, 0x7f, 0x03, 0x40, 0x41, 0x10, 0x41, 0x01, 0xfe, 0x1e, 0x02, 0x00,
+    0x1a, 0x20, 0x00, 0x41, 0x01, 0x6a, 0x22, 0x00, 0x41, 0xe8, 0x07, 0x49,
+    0x0d, 0x00, 0x0b, 0x03, 0x40, 0x41, 0x10, 0xfe, 0x10, 0x02, 0x00, 0x41,
+    0xa0, 0x1f, 0x49, 0x0d, 0x00, 0x0b, 0x41, 0x10, 0xfe, 0x10, 0x02, 0x00,
+    0x0b, 0x0b, 0x07, 0x01, 0x00, 0x41, 0x08, 0x0b, 0x01, 0x2a,
+};
+
+// (memory 1 2 shared)
+// (func (export "grower") (result i32)
+//   (i32.atomic.store (i32.const 4) (memory.grow (i32.const 1)))
+//   (loop
+//     (br_if 0 (i32.eqz (memory.atomic.notify (i32.const 0) (i32.const 1)))))
+//   (memory.grow (i32.const 1)))
+// (func (export "user") (result i32)
+//   (drop (memory.atomic.wait32 (i32.const 0) (i32.const 0) (i64.const -1)))
+//   (i32.store (i32.const 65536) (i32.const 7))
+//   (i32.add (i32.add (i32.mul (memory.size) (i32.const 100))
+//                     (i32.load (i32.const 65536)))
+//            (i32.mul (i32.atomic.load (i32.const 4)) (i32.const 10))))
+const uint8_t SharedGrowWasm[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x05, 0x01, 0x60,
+    0x00, 0x01, 0x7f, 0x03, 0x03, 0x02, 0x00, 0x00, 0x05, 0x04, 0x01, 0x03,
+    0x01, 0x02, 0x07, 0x11, 0x02, 0x06, 0x67, 0x72, 0x6f, 0x77, 0x65, 0x72,
+    0x00, 0x00, 0x04, 0x75, 0x73, 0x65, 0x72, 0x00, 0x01, 0x0a, 0x4f, 0x02,
+    0x1e, 0x00, 0x41, 0x04, 0x41, 0x01, 0x40, 0x00, 0xfe, 0x17, 0x02, 0x00,
+    0x03, 0x40, 0x41, 0x00, 0x41, 0x01, 0xfe, 0x00, 0x02, 0x00, 0x45, 0x0d,
+    0x00, 0x0b, 0x41, 0x01, 0x40, 0x00, 0x0b, 0x2e, 0x00, 0x41, 0x00, 0x41,
+    0x00, 0x42, 0x7f, 0xfe, 0x01, 0x02, 0x00, 0x1a, 0x41, 0x80, 0x80, 0x04,
+    0x41, 0x07, 0x36, 0x02, 0x00, 0x3f, 0x00, 0x41, 0xe4, 0x00, 0x6c, 0x41,
+    0x80, 0x80, 0x04, 0x28, 0x02, 0x00, 0x6a, 0x41, 0x04, 0xfe, 0x10, 0x02,
+    0x00, 0x41, 0x0a, 0x6c, 0x6a, 0x0b,
+};
+
+// (memory 1)
+// (func $use_gas (export "__instrumented_use_gas") (param i64))
+// (func (export "work") (param $n i32) (result i32)
+//   (local $i i32) (local $acc i32)
+//   (if (i32.eq (local.get $n) (i32.const 13)) (then unreachable))
+//   (block
+//     (loop
+//       (br_if 1 (i32.ge_u (local.get $i) (local.get $n)))
+//       (call $use_gas (i64.const 10))
+//       (local.set $acc (i32.add (local.get $acc) (local.get $i)))
+//       (local.set $i (i32.add (local.get $i) (i32.const 1)))
+//       (br 0)))
+//   (i32.store (i32.const 0) (i32.add (i32.load (i32.const 0)) (local.get $n)))
+//   (i32.add (local.get $acc) (i32.load (i32.const 0))))
+const uint8_t GasWasm[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x0a, 0x02, 0x60,
+    0x01, 0x7e, 0x00, 0x60, 0x01, 0x7f, 0x01, 0x7f, 0x03, 0x03, 0x02, 0x00,
+    0x01, 0x05, 0x03, 0x01, 0x00, 0x01, 0x07, 0x21, 0x02, 0x16, 0x5f, 0x5f,
+    0x69, 0x6e, 0x73, 0x74, 0x72, 0x75, 0x6d, 0x65, 0x6e, 0x74, 0x65, 0x64,
+    0x5f, 0x75, 0x73, 0x65, 0x5f, 0x67, 0x61, 0x73, 0x00, 0x00, 0x04, 0x77,
+    0x6f, 0x72, 0x6b, 0x00, 0x01, 0x0a, 0x48, 0x02, 0x02, 0x00, 0x0b, 0x43,
+    0x01, 0x02, 0x7f, 0x20, 0x00, 0x41, 0x0d, 0x46, 0x04, 0x40, 0x00, 0x0b,
+    0x02, 0x40, 0x03, 0x40, 0x20, 0x01, 0x20, 0x00, 0x4f, 0x0d, 0x01, 0x42,
+    0x0a, 0x10, 0x00, 0x20, 0x02, 0x20, 0x01, 0x6a, 0x21, 0x02, 0x20, 0x01,
+    0x41, 0x01, 0x6a, 0x21, 0x01, 0x0c, 0x00, 0x0b, 0x0b, 0x41, 0x00, 0x41,
+    0x00, 0x28, 0x02, 0x00, 0x20, 0x00, 0x6a, 0x36, 0x02, 0x00, 0x20, 0x02,
+    0x41, 0x00, 0x28, 0x02, 0x00, 0x6a, 0x0b,
+};
+
+std::unique_ptr<Runtime>
+newThreadsRuntime(uint32_t NumWasmMemoryPoolSlots = 0) {
+  RuntimeConfig Config;
+  Config.Mode = RunMode::InterpMode;
+  Config.EnableThreads = true;
+  Config.NumWasmMemoryPoolSlots = NumWasmMemoryPoolSlots;
+#ifdef ZEN_ENABLE_BUILTIN_WASI
+  Config.DisableWASI = true;
+#endif
+  return Runtime::newRuntime(Config);
+}
+
+std::unique_ptr<Runtime> newBlockRuntime(uint32_t NumWasmMemoryPoolSlots) {
+  RuntimeConfig Config;
+  Config.Mode = RunMode::InterpMode;
+  Config.NumWasmMemoryPoolSlots = NumWasmMemoryPoolSlots;
+#ifdef ZEN_ENABLE_BUILTIN_WASI
+  Config.DisableWASI = true;
+#endif
+  return Runtime::newRuntime(Config);
+}
+
+// The jobs of "work" with a mix of results, unreachable traps(N = 13) and
+// out-of-gas traps
+std::vector<ExecJob> makeGasJobs(Module *Mod, size_t NumJobs) {
+  uint32_t FuncIdx;
+  EXPECT_TRUE(Mod->getExportFunc("work", FuncIdx));
+  std::vector<ExecJob> Jobs(NumJobs);
+  for (size_t I = 0; I < NumJobs; ++I) {
+    ExecJob &Job = Jobs[I];
+    Job.Mod = Mod;
+    Job.FuncIdx = FuncIdx;
+    TypedValue Arg;
+    Arg.Type = WASMType::I32;
+    Arg.Value.I32 = static_cast<int32_t>(I * 7 % 40);
+    Job.Args.push_back(Arg);
+    Job.GasLimit = 100 + I * 5;
+  }
+  return Jobs;
+}
+
+// The reference results, every job runs in a fresh instance on this thread
+std::vector<ExecResult> runSerially(Runtime &RT,
+                                    const std::vector<ExecJob> &Jobs) {
+  std::vector<ExecResult> Results(Jobs.size());
+  IsolationUniquePtr Iso = RT.createUnmanagedIsolation();
+  EXPECT_NE(Iso, nullptr);
+  for (size_t I = 0; I < Jobs.size(); ++I) {
+    const ExecJob &Job = Jobs[I];
+    ExecResult &Result = Results[I];
+    auto InstRet = Iso->createInstance(*Job.Mod, Job.GasLimit);
+    EXPECT_TRUE(InstRet);
+    Instance *Inst = *InstRet;
+    if (!RT.callWasmFunction(*Inst, Job.FuncIdx, Job.Args, Result.Results)) {
+      Result.Err = Inst->getError();
+      Result.Results.clear();
+    }
+    Result.GasLeft = Inst->getGas();
+    Iso->deleteInstance(Inst);
+  }
+  return Results;
+}
+
+void expectSameResults(const std::vector<ExecResult> &Results,
+                       const std::vector<ExecResult> &Expected) {
+  ASSERT_EQ(Results.size(), Expected.size());
+  for (size_t I = 0; I < Results.size(); ++I) {
+    SCOPED_TRACE(I);
+    EXPECT_EQ(Results[I].Err.getCode(), Expected[I].Err.getCode());
+    EXPECT_EQ(Results[I].GasLeft, Expected[I].GasLeft);
+    ASSERT_EQ(Results[I].Results.size(), Expected[I].Results.size());
+    for (size_t J = 0; J < Results[I].Results.size(); ++J) {
+      EXPECT_EQ(Results[I].Results[J].Type, Expected[I].Results[J].Type);
+      EXPECT_EQ(Results[I].Results[J].Value.I64,
+                Expected[I].Results[J].Value.I64);
+    }
+  }
+}
+
+ExecJob makeJob(Module *Mod, const char *FuncName) {
+  ExecJob Job;
+  Job.Mod = Mod;
+  EXPECT_TRUE(Mod->getExportFunc(FuncName, Job.FuncIdx));
+  Job.GasLimit = UINT64_MAX;
+  return Job;
+}
+
+} // namespace
+
+TEST(Executor, BlockDeterministicOrder) {
+  auto RT = newBlockRuntime(0);
+  ASSERT_NE(RT, nullptr);
+  auto ModRet = RT->loadModule("gas", GasWasm, sizeof(GasWasm));
+  ASSERT_TRUE(ModRet);
+  std::vector<ExecJob> Jobs = makeGasJobs(*ModRet, 64);
+
+  BlockExecutor Executor(*RT, 4);
+  ASSERT_EQ(Executor.getNumWorkers(), 4u);
+  std::vector<ExecResult> Results = Executor.executeBlock(Jobs);
+  ASSERT_EQ(Results.size(), Jobs.size());
+
+  // Results are in the job order whichever worker ran the job, and the memory
+  // of a job isn't seen by the later jobs of the same worker
+  size_t NumSucceeded = 0;
+  for (size_t I = 0; I < Jobs.size(); ++I) {
+    SCOPED_TRACE(I);
+    const ExecResult &Result = Results[I];
+    int32_t N = Jobs[I].Args[0].Value.I32;
+    uint64_t GasUsed = 10 * N;
+    if (N == 13) {
+      EXPECT_EQ(Result.Err.getCode(), ErrorCode::Unreachable);
+      EXPECT_EQ(Result.GasLeft, Jobs[I].GasLimit);
+    } else if (GasUsed > Jobs[I].GasLimit) {
+      EXPECT_EQ(Result.Err.getCode(), ErrorCode::GasLimitExceeded);
+      EXPECT_EQ(Result.GasLeft, 0u);
+    } else {
+      ASSERT_TRUE(Result.succeeded());
+      ASSERT_EQ(Result.Results.size(), 1u);
+      EXPECT_EQ(Result.Results[0].Value.I32, N * (N - 1) / 2 + N);
+      EXPECT_EQ(Result.GasLeft, Jobs[I].GasLimit - GasUsed);
+      ++NumSucceeded;
+    }
+  }
+  EXPECT_GT(NumSucceeded, 0u);
+  EXPECT_LT(NumSucceeded, Jobs.size());
+
+  // Running the block again gives the same results
+  expectSameResults(Executor.executeBlock(Jobs), Results);
+}
+
+TEST(Executor, BlockGasParity) {
+  // Also with the worker memory pools, which are only used along with the
+  // pool of the runtime
+  for (uint32_t NumSlots : {0u, 2u}) {
+    SCOPED_TRACE(NumSlots);
+    auto RT = newBlockRuntime(NumSlots);
+    ASSERT_NE(RT, nullptr);
+    auto ModRet = RT->loadModule("gas", GasWasm, sizeof(GasWasm));
+    ASSERT_TRUE(ModRet);
+    std::vector<ExecJob> Jobs = makeGasJobs(*ModRet, 64);
+
+    std::vector<ExecResult> Expected = runSerially(*RT, Jobs);
+    for (ConcurrencyT NumWorkers : {1u, 3u, 8u}) {
+      SCOPED_TRACE(NumWorkers);
+      BlockExecutor Executor(*RT, NumWorkers);
+      expectSameResults(Executor.executeBlock(Jobs), Expected);
+    }
+  }
+}
+
+TEST(Executor, ThreadGroupWaitNotify) {
+  auto RT = newThreadsRuntime();
+  ASSERT_NE(RT, nullptr);
+  auto ModRet = RT->loadModule("threads", ThreadsWasm, sizeof(ThreadsWasm));
+  ASSERT_TRUE(ModRet);
+  Module *Mod = *ModRet;
+
+  // The waiter blocks until the notifier wakes it, so both jobs must run
+  // concurrently, and it sees the value stored before the notification
+  std::vector<ExecJob> Jobs = {makeJob(Mod, "waiter"),
+                               makeJob(Mod, "notifier")};
+  std::vector<ExecResult> Results = executeThreadGroup(*RT, Jobs);
+  ASSERT_EQ(Results.size(), 2u);
+  for (const ExecResult &Result : Results) {
+    ASSERT_TRUE(Result.succeeded());
+    ASSERT_EQ(Result.Results.size(), 1u);
+  }
+  EXPECT_EQ(Results[0].Results[0].Value.I32, 42);
+  EXPECT_EQ(Results[1].Results[0].Value.I32, 1);
+}
+
+TEST(Executor, ThreadGroupSharedMemory) {
+  auto RT = newThreadsRuntime();
+  ASSERT_NE(RT, nullptr);
+  auto ModRet = RT->loadModule("threads", ThreadsWasm, sizeof(ThreadsWasm));
+  ASSERT_TRUE(ModRet);
+  Module *Mod = *ModRet;
+
+  // Every job adds 1000 to the shared counter and waits for the others
+  std::vector<ExecJob> Jobs(4, makeJob(Mod, "counter"));
+  std::vector<ExecResult> Results = executeThreadGroup(*RT, Jobs);
+  ASSERT_EQ(Results.size(), Jobs.size());
+  for (const ExecResult &Result : Results) {
+    ASSERT_TRUE(Result.succeeded());
+    ASSERT_EQ(Result.Results.size(), 1u);
+    EXPECT_EQ(Result.Results[0].Value.I32, 4000);
+  }
+
+  // A new group gets new instances, so the counter starts from 0 again
+  Results = executeThreadGroup(*RT, Jobs);
+  ASSERT_EQ(Results.size(), Jobs.size());
+  for (const ExecResult &Result : Results) {
+    ASSERT_TRUE(Result.succeeded());
+    EXPECT_EQ(Result.Results[0].Value.I32, 4000);
+  }
+}
+
+TEST(Executor, ThreadGroupSharedMemoryGrow) {
+  // Without pool slots the shared memory reserves its own slot
+  for (uint32_t NumSlots : {0u, 2u}) {
+    auto RT = newThreadsRuntime(NumSlots);
+    ASSERT_NE(RT, nullptr);
+    auto ModRet =
+        RT->loadModule("grow", SharedGrowWasm, sizeof(SharedGrowWasm));
+    ASSERT_TRUE(ModRet);
+    Module *Mod = *ModRet;
+
+    // The user waits until the grower has grown the memory to the max, then
+    // stores to the new page and sees the new size, the grower can't grow
+    // beyond the max
+    std::vector<ExecJob> Jobs = {makeJob(Mod, "grower"),
+                                 makeJob(Mod, "user")};
+    std::vector<ExecResult> Results = executeThreadGroup(*RT, Jobs);
+    ASSERT_EQ(Results.size(), 2u);
+    for (const ExecResult &Result : Results) {
+      ASSERT_TRUE(Result.succeeded());
+      ASSERT_EQ(Result.Results.size(), 1u);
+    }
+    EXPECT_EQ(Results[0].Results[0].Value.I32, -1);
+    EXPECT_EQ(Results[1].Results[0].Value.I32, 2 * 100 + 7 + 1 * 10);
+  }
+}
+
+} // namespace zen::test
@@ -2,8 +2,17 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "common/mem_pool.h"
+#include "runtime/memory.h"
+#include "utils/virtual_stack.h"
 
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <future>
 #include <gtest/gtest.h>
+#include <set>
+#include <sys/mman.h>
+#include <thread>
 
 namespace zen::test {
 
@@ -38,6 +47,257 @@ TEST(Mempool, CodeMemPool) {
   EXPECT_DEATH(Pool.allocate(CodeMemPool::MaxCodeSize), "");
 }
 
+#ifdef ZEN_ENABLE_VIRTUAL_STACK
+namespace {
+
+using utils::StackMemPool;
+
+constexpr size_t TestStackSize = 16 * StackMemPool::PageSize;
+
+// Whether the first whole page of the stack is resident
+bool isStackResident(void *Ptr) {
+  uintptr_t Page =
+      ZEN_ALIGN(reinterpret_cast<uintptr_t>(Ptr), StackMemPool::PageSize);
+  unsigned char Vec = 0;
+  EXPECT_EQ(::mincore(reinterpret_cast<void *>(Page), StackMemPool::PageSize,
+                      &Vec),
+            0);
+  return Vec & 1;
+}
+
+} // namespace
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+
+TEST(Mempool, StackMemPoolReuse) {
+#ifndef ZEN_ENABLE_VIRTUAL_STACK
+  GTEST_SKIP() << "virtual stack not enabled";
+#else
+  StackMemPool Pool(TestStackSize);
+  // Far more stacks than a single chunk used to hold are in use at once
+  std::vector<void *> Stacks;
+  for (int I = 0; I < 200; ++I) {
+    void *Ptr = Pool.allocate(true);
+    ASSERT_NE(Ptr, nullptr);
+    std::memset(Ptr, 0, TestStackSize);
+    Stacks.push_back(Ptr);
+  }
+  EXPECT_EQ(std::set<void *>(Stacks.begin(), Stacks.end()).size(),
+            Stacks.size());
+
+  // Released stacks are reused last in first out
+  Pool.deallocate(Stacks[5]);
+  Pool.deallocate(Stacks[7]);
+  EXPECT_EQ(Pool.getNumRetainedStacks(), 2u);
+  EXPECT_EQ(Pool.allocate(true), Stacks[7]);
+  EXPECT_EQ(Pool.allocate(true), Stacks[5]);
+  EXPECT_EQ(Pool.getNumRetainedStacks(), 0u);
+
+  // Only the high-water mark of free stacks is kept committed, in the thread
+  // cache and the global list together
+  for (void *Ptr : Stacks) {
+    Pool.deallocate(Ptr);
+  }
+  EXPECT_EQ(Pool.getNumRetainedStacks(),
+            StackMemPool::DefaultMaxRetainedStacks);
+  for (size_t I = 0; I < Stacks.size(); ++I) {
+    EXPECT_EQ(isStackResident(Stacks[I]),
+              I < StackMemPool::DefaultMaxRetainedStacks);
+  }
+  Pool.setMaxRetainedStacks(2);
+  EXPECT_EQ(Pool.getNumRetainedStacks(), StackMemPool::MaxThreadCachedStacks);
+  // All stacks are handed out again, the decommitted ones are zero-filled
+  std::set<void *> Reused;
+  for (size_t I = 0; I < Stacks.size(); ++I) {
+    Reused.insert(Pool.allocate(true));
+  }
+  EXPECT_EQ(Reused, std::set<void *>(Stacks.begin(), Stacks.end()));
+  EXPECT_EQ(Pool.getNumRetainedStacks(), 0u);
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+}
+
+TEST(Mempool, StackMemPoolDecommit) {
+#ifndef ZEN_ENABLE_VIRTUAL_STACK
+  GTEST_SKIP() << "virtual stack not enabled";
+#else
+  StackMemPool Pool(TestStackSize);
+  Pool.setMaxRetainedStacks(1);
+  void *A = Pool.allocate(true);
+  void *B = Pool.allocate(true);
+  std::memset(A, 1, TestStackSize);
+  std::memset(B, 1, TestStackSize);
+  EXPECT_TRUE(isStackResident(A));
+  EXPECT_TRUE(isStackResident(B));
+
+  // A is cached by the thread, B is above the high-water mark
+  Pool.deallocate(A);
+  Pool.deallocate(B);
+  EXPECT_EQ(Pool.getNumRetainedStacks(), 1u);
+  EXPECT_TRUE(isStackResident(A));
+  EXPECT_FALSE(isStackResident(B));
+
+  // The thread-cached stacks count towards the high-water mark too
+  Pool.setMaxRetainedStacks(0);
+  EXPECT_EQ(Pool.allocate(true), A);
+  EXPECT_EQ(Pool.getNumRetainedStacks(), 0u);
+  Pool.deallocate(A);
+  EXPECT_EQ(Pool.getNumRetainedStacks(), 0u);
+  EXPECT_FALSE(isStackResident(A));
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+}
+
+TEST(Mempool, StackMemPoolThreadCacheOutlivesPool) {
+#ifndef ZEN_ENABLE_VIRTUAL_STACK
+  GTEST_SKIP() << "virtual stack not enabled";
+#else
+  auto Pool = std::make_unique<StackMemPool>(TestStackSize);
+  std::promise<void> Cached;
+  std::promise<void> Destroyed;
+  std::future<void> DestroyedFuture = Destroyed.get_future();
+  std::thread Thread([&] {
+    Pool->deallocate(Pool->allocate(true));
+    Cached.set_value();
+    DestroyedFuture.wait();
+
+    // The stale cache is neither handed out nor returned to the dead pool,
+    // and the cache of this pool is dropped when the thread exits after the
+    // pool is destroyed
+    StackMemPool Other(TestStackSize);
+    void *Ptr = Other.allocate(true);
+    Other.deallocate(Ptr);
+    EXPECT_EQ(Other.allocate(true), Ptr);
+    Other.deallocate(Ptr);
+    EXPECT_EQ(Other.getNumRetainedStacks(), 1u);
+  });
+  Cached.get_future().wait();
+  Pool.reset();
+  Destroyed.set_value();
+  Thread.join();
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+}
+
+#ifndef ZEN_ENABLE_SGX
+using runtime::WasmMemoryPool;
+
+constexpr size_t WasmPageSize = 64 * 1024;
+
+TEST(Mempool, WasmMemoryPoolInvalid) {
+  EXPECT_FALSE(WasmMemoryPool(0).isValid());
+  EXPECT_FALSE(WasmMemoryPool(WasmMemoryPool::MaxNumSlots + 1).isValid());
+}
+
+TEST(Mempool, WasmMemoryPoolAcquireRelease) {
+  WasmMemoryPool Pool(2);
+  ASSERT_TRUE(Pool.isValid());
+
+  uint8_t *A = Pool.acquireSlot(WasmPageSize);
+  uint8_t *B = Pool.acquireSlot(2 * WasmPageSize);
+  ASSERT_NE(A, nullptr);
+  ASSERT_NE(B, nullptr);
+  EXPECT_TRUE(Pool.containsSlot(A));
+  EXPECT_TRUE(Pool.containsSlot(B));
+  EXPECT_FALSE(Pool.containsSlot(A + 2 * WasmMemoryPool::SlotSize));
+  EXPECT_EQ(std::abs(A - B), std::ptrdiff_t(WasmMemoryPool::SlotSize));
+
+  // All slots in use
+  EXPECT_EQ(Pool.acquireSlot(WasmPageSize), nullptr);
+
+  // The whole size is accessible and zeroed, the rest of the slot isn't
+  // accessible
+  EXPECT_EQ(A[0], 0);
+  EXPECT_EQ(B[2 * WasmPageSize - 1], 0);
+  std::memset(A, 0xab, WasmPageSize);
+  EXPECT_DEATH(*reinterpret_cast<volatile uint8_t *>(A + WasmPageSize) = 1,
+               "");
+
+  // The released slot is handed out again zeroed, and protected beyond the
+  // new size
+  Pool.releaseSlot(A, WasmPageSize);
+  uint8_t *C = Pool.acquireSlot(WasmPageSize / 2);
+  EXPECT_EQ(C, A);
+  EXPECT_EQ(C[0], 0);
+  EXPECT_EQ(C[WasmPageSize / 2 - 1], 0);
+  EXPECT_DEATH(*reinterpret_cast<volatile uint8_t *>(C + WasmPageSize / 2) = 1,
+               "");
+
+  Pool.releaseSlot(B, 2 * WasmPageSize);
+  Pool.releaseSlot(C, WasmPageSize / 2);
+}
+
+TEST(Mempool, WasmMemoryPoolGrow) {
+  WasmMemoryPool Pool(1);
+  ASSERT_TRUE(Pool.isValid());
+  uint8_t *Slot = Pool.acquireSlot(WasmPageSize);
+  ASSERT_NE(Slot, nullptr);
+  Slot[WasmPageSize - 1] = 0x5a;
+
+  // In place, the data is kept and the new pages are zeroed
+  Pool.growSlot(Slot, WasmPageSize, 3 * WasmPageSize);
+  EXPECT_EQ(Slot[WasmPageSize - 1], 0x5a);
+  EXPECT_EQ(Slot[WasmPageSize], 0);
+  Slot[3 * WasmPageSize - 1] = 0x5b;
+  EXPECT_DEATH(
+      *reinterpret_cast<volatile uint8_t *>(Slot + 3 * WasmPageSize) = 1, "");
+
+  // Shrinking is a no-op
+  Pool.growSlot(Slot, 3 * WasmPageSize, WasmPageSize);
+  EXPECT_EQ(Slot[3 * WasmPageSize - 1], 0x5b);
+
+  Pool.releaseSlot(Slot, 3 * WasmPageSize);
+  Slot = Pool.acquireSlot(3 * WasmPageSize);
+  ASSERT_NE(Slot, nullptr);
+  EXPECT_EQ(Slot[WasmPageSize - 1], 0);
+  EXPECT_EQ(Slot[3 * WasmPageSize - 1], 0);
+  Pool.releaseSlot(Slot, 3 * WasmPageSize);
+}
+
+TEST(Mempool, WasmMemoryPoolConcurrent) {
+  constexpr uint32_t NumSlots = 2;
+  constexpr uint32_t NumThreads = 4;
+  WasmMemoryPool Pool(NumSlots);
+  ASSERT_TRUE(Pool.isValid());
+
+  // A slot is never owned by two threads at once, every owner finds it
+  // zeroed and leaves its mark in it
+  std::atomic<uint32_t> NumAcquired = 0;
+  std::vector<std::thread> Threads;
+  for (uint32_t I = 0; I < NumThreads; ++I) {
+    Threads.emplace_back([&Pool, &NumAcquired, Mark = uint8_t(I + 1)] {
+      for (uint32_t J = 0; J < 1000; ++J) {
+        uint8_t *Slot = Pool.acquireSlot(WasmPageSize);
+        if (!Slot) {
+          std::this_thread::yield();
+          continue;
+        }
+        ++NumAcquired;
+        EXPECT_TRUE(Pool.containsSlot(Slot));
+        EXPECT_EQ(Slot[0], 0);
+        Slot[0] = Mark;
+        std::this_thread::yield();
+        EXPECT_EQ(Slot[0], Mark);
+        Pool.releaseSlot(Slot, WasmPageSize);
+      }
+    });
+  }
+  for (std::thread &Thread : Threads) {
+    Thread.join();
+  }
+  EXPECT_GT(NumAcquired.load(), 0u);
+
+  // All slots are back
+  std::set<uint8_t *> Slots;
+  for (uint32_t I = 0; I < NumSlots; ++I) {
+    uint8_t *Slot = Pool.acquireSlot(WasmPageSize);
+    ASSERT_NE(Slot, nullptr);
+    Slots.insert(Slot);
+  }
+  EXPECT_EQ(Slots.size(), NumSlots);
+  EXPECT_EQ(Pool.acquireSlot(WasmPageSize), nullptr);
+  for (uint8_t *Slot : Slots) {
+    Pool.releaseSlot(Slot, WasmPageSize);
+  }
+}
+#endif // ZEN_ENABLE_SGX
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,443 @@
+// Copyright (C) 2021-2025 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "runtime/instance.h"
+#include "runtime/isolation.h"
+#include "runtime/module.h"
+#include "runtime/module_stream.h"
+#include "runtime/runtime.h"
+
+#include <chrono>
+#include <gtest/gtest.h>
+#include <map>
+#include <thread>
+
+namespace zen::test {
+
+using namespace zen;
+using namespace common;
+using namespace runtime;
+
+namespace {
+
+// (type $i32_i32 (func (param i32) (result i32)))
+// (table 21 funcref)
+// (elem (i32.const 0) $add0 $add1 ... $add19 $const7)
+// (func $addK (type $i32_i32) (i32.add (local.get 0) (i32.const K)))
+// (func $const7 (result i32) (i32.const 7))
+// (func (export "call") (param i32 i32) (result i32)
+//   (call_indirect (type $i32_i32) (local.get 0) (local.get 1)))
+const uint8_t CallIndirectWasm[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x10, 0x03, 0x60,
+    0x01, 0x7f, 0x01, 0x7f, 0x60, 0x00, 0x01, 0x7f, 0x60, 0x02, 0x7f, 0x7f,
+    0x01, 0x7f, 0x03, 0x17, 0x16, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x04, 0x04, 0x01, 0x70, 0x00, 0x15, 0x07, 0x08, 0x01,
+    0x04, 0x63, 0x61, 0x6c, 0x6c, 0x00, 0x15, 0x09, 0x1b, 0x01, 0x00, 0x41,
+    0x00, 0x0b, 0x15, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+    0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+    0x0a, 0xb0, 0x01, 0x16, 0x07, 0x00, 0x20, 0x00, 0x41, 0x00, 0x6a, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x41, 0x01, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00,
+    0x41, 0x02, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x41, 0x03, 0x6a, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x41, 0x04, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00,
+    0x41, 0x05, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x41, 0x06, 0x6a, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x41, 0x07, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00,
+    0x41, 0x08, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x41, 0x09, 0x6a, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x41, 0x0a, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00,
+    0x41, 0x0b, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x41, 0x0c, 0x6a, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x41, 0x0d, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00,
+    0x41, 0x0e, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x41, 0x0f, 0x6a, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x41, 0x10, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00,
+    0x41, 0x11, 0x6a, 0x0b, 0x07, 0x00, 0x20, 0x00, 0x41, 0x12, 0x6a, 0x0b,
+    0x07, 0x00, 0x20, 0x00, 0x41, 0x13, 0x6a, 0x0b, 0x04, 0x00, 0x41, 0x07,
+    0x0b, 0x09, 0x00, 0x20, 0x00, 0x20, 0x01, 0x11, 0x00, 0x00, 0x0b,
+};
+
+// Calls call(X, TableIdx), returns false if it traps
+bool callIndirect(Runtime &RT, Instance &Inst, int32_t X, int32_t TableIdx,
+                  int32_t &Result) {
+  uint32_t FuncIdx = 0;
+  EXPECT_TRUE(Inst.getModule()->getExportFunc("call", FuncIdx));
+  std::vector<TypedValue> Args = {{X, WASMType::I32},
+                                 {TableIdx, WASMType::I32}};
+  std::vector<TypedValue> Results;
+  Inst.clearError();
+  if (!RT.callWasmFunction(Inst, FuncIdx, Args, Results)) {
+    return false;
+  }
+  EXPECT_EQ(Results.size(), 1u);
+  Result = Results[0].Value.I32;
+  return true;
+}
+
+std::unique_ptr<Runtime> newInterpRuntime() {
+  RuntimeConfig Config;
+  Config.Mode = RunMode::InterpMode;
+#ifdef ZEN_ENABLE_BUILTIN_WASI
+  Config.DisableWASI = true;
+#endif
+  return Runtime::newRuntime(Config);
+}
+
+// Instantiates the module loaded from CallIndirectWasm and calls through the
+// table
+void expectCallIndirectWorks(Runtime &RT, Module &Mod) {
+  IsolationUniquePtr Iso = RT.createUnmanagedIsolation();
+  ASSERT_NE(Iso, nullptr);
+  auto InstRet = Iso->createInstance(Mod);
+  ASSERT_TRUE(InstRet);
+  Instance *Inst = *InstRet;
+  int32_t Result = 0;
+  ASSERT_TRUE(callIndirect(RT, *Inst, 100, 19, Result));
+  EXPECT_EQ(Result, 119);
+  Iso->deleteInstance(Inst);
+}
+
+void appendU32(std::vector<uint8_t> &Out, uint32_t Value) {
+  do {
+    uint8_t Byte = Value & 0x7f;
+    Value >>= 7;
+    Out.push_back(Value ? Byte | 0x80 : Byte);
+  } while (Value);
+}
+
+void appendS32(std::vector<uint8_t> &Out, int32_t Value) {
+  while (true) {
+    uint8_t Byte = Value & 0x7f;
+    Value >>= 7;
+    if ((Value == 0 && !(Byte & 0x40)) || (Value == -1 && (Byte & 0x40))) {
+      Out.push_back(Byte);
+      return;
+    }
+    Out.push_back(Byte | 0x80);
+  }
+}
+
+void appendSection(std::vector<uint8_t> &Out, uint8_t Id,
+                   const std::vector<uint8_t> &Body) {
+  Out.push_back(Id);
+  appendU32(Out, Body.size());
+  Out.insert(Out.end(), Body.begin(), Body.end());
+}
+
+enum class BadFunc {
+  // Failures found by validating the body
+  TypeMismatch,
+  UnknownFunction,
+  UnknownLocal,
+  // Found by the loading thread when parsing the locals
+  InvalidLocalType,
+};
+
+// NumFuncs functions (func (param i32) (result i32)) adding their index to
+// the param, the last one exported as "last", and the functions in BadFuncs
+// broken in the given way
+std::vector<uint8_t>
+buildManyFuncsWasm(uint32_t NumFuncs,
+                   const std::map<uint32_t, BadFunc> &BadFuncs) {
+  std::vector<uint8_t> Wasm = {0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00};
+  appendSection(Wasm, 1, {0x01, 0x60, 0x01, 0x7f, 0x01, 0x7f});
+
+  std::vector<uint8_t> Funcs;
+  appendU32(Funcs, NumFuncs);
+  Funcs.insert(Funcs.end(), NumFuncs, 0x00);
+  appendSection(Wasm, 3, Funcs);
+
+  std::vector<uint8_t> Exports = {0x01, 0x04, 'l', 'a', 's', 't', 0x00};
+  appendU32(Exports, NumFuncs - 1);
+  appendSection(Wasm, 7, Exports);
+
+  std::vector<uint8_t> Codes;
+  appendU32(Codes, NumFuncs);
+  for (uint32_t I = 0; I < NumFuncs; ++I) {
+    std::vector<uint8_t> Body = {0x00, 0x20, 0x00, 0x41};
+    appendS32(Body, I);
+    Body.insert(Body.end(), {0x6a, 0x0b});
+    auto It = BadFuncs.find(I);
+    if (It != BadFuncs.end()) {
+      switch (It->second) {
+      case BadFunc::TypeMismatch:
+        Body = {0x00, 0x42, 0x00, 0x0b};
+        break;
+      case BadFunc::UnknownFunction:
+        Body = {0x00, 0x20, 0x00, 0x10, 0xc0, 0x84, 0x3d, 0x0b};
+        break;
+      case BadFunc::UnknownLocal:
+        Body = {0x00, 0x20, 0x05, 0x0b};
+        break;
+      case BadFunc::InvalidLocalType:
+        Body = {0x01, 0x01, 0x40, 0x20, 0x00, 0x0b};
+        break;
+      }
+    }
+    appendU32(Codes, Body.size());
+    Codes.insert(Codes.end(), Body.begin(), Body.end());
+  }
+  appendSection(Wasm, 10, Codes);
+  return Wasm;
+}
+
+} // namespace
+
+TEST(Runtime, ParallelValidation) {
+  constexpr uint32_t NumFuncs = 200;
+  struct {
+    std::map<uint32_t, BadFunc> BadFuncs;
+    ErrorCode ExpectedErr;
+  } Cases[] = {
+      {{}, ErrorCode::NoError},
+      // The error of the lowest function index, whichever thread finds first
+      {{{90, BadFunc::UnknownLocal}, {150, BadFunc::TypeMismatch}},
+       ErrorCode::UnknownLocal},
+      {{{150, BadFunc::UnknownLocal}, {90, BadFunc::UnknownFunction}},
+       ErrorCode::UnknownFunction},
+      {{{198, BadFunc::UnknownLocal}, {199, BadFunc::UnknownFunction}},
+       ErrorCode::UnknownLocal},
+      // Errors of the validation threads and the loading thread
+      {{{30, BadFunc::UnknownLocal}, {60, BadFunc::InvalidLocalType}},
+       ErrorCode::UnknownLocal},
+      {{{30, BadFunc::InvalidLocalType}, {60, BadFunc::UnknownLocal}},
+       ErrorCode::InvalidType},
+  };
+
+  for (const auto &Case : Cases) {
+    std::vector<uint8_t> Wasm = buildManyFuncsWasm(NumFuncs, Case.BadFuncs);
+    // 0 validates in the loading thread
+    std::string SerialErrMsg;
+    for (uint32_t NumThreads : {0u, 2u, 4u, 8u}) {
+      SCOPED_TRACE(testing::Message()
+                   << "error " << uint32_t(Case.ExpectedErr) << ", "
+                   << NumThreads << " threads");
+      RuntimeConfig Config;
+      Config.Mode = RunMode::InterpMode;
+      Config.NumValidationThreads = NumThreads;
+#ifdef ZEN_ENABLE_BUILTIN_WASI
+      Config.DisableWASI = true;
+#endif
+      auto RT = Runtime::newRuntime(Config);
+      ASSERT_NE(RT, nullptr);
+      auto ModRet = RT->loadModule("many", Wasm.data(), Wasm.size());
+      if (Case.ExpectedErr == ErrorCode::NoError) {
+        ASSERT_TRUE(ModRet);
+        IsolationUniquePtr Iso = RT->createUnmanagedIsolation();
+        ASSERT_NE(Iso, nullptr);
+        auto InstRet = Iso->createInstance(**ModRet);
+        ASSERT_TRUE(InstRet);
+        std::vector<TypedValue> Results;
+        ASSERT_TRUE(RT->callWasmFunction(**InstRet, "last", {"5"}, Results));
+        ASSERT_EQ(Results.size(), 1u);
+        EXPECT_EQ(Results[0].Value.I32, int32_t(5 + NumFuncs - 1));
+        Iso->deleteInstance(*InstRet);
+        continue;
+      }
+      ASSERT_FALSE(ModRet);
+      const Error &Err = ModRet.getError();
+      EXPECT_EQ(Err.getCode(), Case.ExpectedErr);
+      if (NumThreads == 0) {
+        SerialErrMsg = Err.getFormattedMessage();
+      } else {
+        EXPECT_EQ(Err.getFormattedMessage(), SerialErrMsg);
+      }
+    }
+  }
+}
+
+#ifndef ZEN_ENABLE_SGX
+TEST(Runtime, ModuleStreamChunks) {
+  auto RT = newInterpRuntime();
+  ASSERT_NE(RT, nullptr);
+
+  // Chunks splitting the sections and the function bodies anywhere, and a
+  // single chunk
+  const size_t ChunkSizes[] = {1, 7, 64, sizeof(CallIndirectWasm)};
+  for (size_t ChunkSize : ChunkSizes) {
+    SCOPED_TRACE(ChunkSize);
+    auto Stream = RT->startModuleStream("stream", sizeof(CallIndirectWasm));
+    ASSERT_NE(Stream, nullptr);
+    for (size_t Offset = 0; Offset < sizeof(CallIndirectWasm);
+         Offset += ChunkSize) {
+      size_t Size = std::min(ChunkSize, sizeof(CallIndirectWasm) - Offset);
+      ASSERT_TRUE(Stream->feed(CallIndirectWasm + Offset, Size));
+    }
+    auto ModRet = Stream->finish();
+    ASSERT_TRUE(ModRet);
+    expectCallIndirectWorks(*RT, **ModRet);
+    EXPECT_TRUE(RT->unloadModule(*ModRet));
+  }
+}
+
+TEST(Runtime, ModuleStreamInvalid) {
+  auto RT = newInterpRuntime();
+  ASSERT_NE(RT, nullptr);
+  EXPECT_EQ(RT->startModuleStream("stream", 0), nullptr);
+  EXPECT_EQ(RT->startModuleStream("", sizeof(CallIndirectWasm)), nullptr);
+
+  auto ModRet = RT->loadModule("loaded", CallIndirectWasm,
+                               sizeof(CallIndirectWasm));
+  ASSERT_TRUE(ModRet);
+  EXPECT_EQ(RT->startModuleStream("loaded", sizeof(CallIndirectWasm)),
+            nullptr);
+
+  // Data beyond the declared size is rejected
+  auto Stream =
+      RT->startModuleStream("stream", sizeof(CallIndirectWasm) - 1);
+  ASSERT_NE(Stream, nullptr);
+  EXPECT_FALSE(Stream->feed(CallIndirectWasm, sizeof(CallIndirectWasm)));
+  EXPECT_TRUE(Stream->feed(CallIndirectWasm, 8));
+
+  // A truncated module fails when the stream is finished
+  Stream = RT->startModuleStream("stream", sizeof(CallIndirectWasm));
+  ASSERT_NE(Stream, nullptr);
+  ASSERT_TRUE(Stream->feed(CallIndirectWasm, sizeof(CallIndirectWasm) - 1));
+  auto StreamRet = Stream->finish();
+  ASSERT_FALSE(StreamRet);
+  EXPECT_EQ(StreamRet.getError().getCode(), ErrorCode::UnexpectedEnd);
+  Stream.reset();
+
+  // The name of the failed stream can be used again
+  ModRet = RT->loadModule("stream", CallIndirectWasm, sizeof(CallIndirectWasm));
+  ASSERT_TRUE(ModRet);
+  EXPECT_TRUE(RT->unloadModule(*ModRet));
+}
+
+TEST(Runtime, ModuleStreamFailsEarly) {
+  auto RT = newInterpRuntime();
+  ASSERT_NE(RT, nullptr);
+
+  // The loader rejects the bad header while the rest is being fed, so the
+  // feeding stops before the end
+  std::vector<uint8_t> Bytecode(CallIndirectWasm,
+                                CallIndirectWasm + sizeof(CallIndirectWasm));
+  Bytecode[0] = 0xff;
+  auto Stream = RT->startModuleStream("stream", Bytecode.size());
+  ASSERT_NE(Stream, nullptr);
+  size_t Offset = 0;
+  while (Offset < Bytecode.size() && Stream->feed(&Bytecode[Offset], 1)) {
+    ++Offset;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_LT(Offset, Bytecode.size());
+  auto ModRet = Stream->finish();
+  ASSERT_FALSE(ModRet);
+  EXPECT_EQ(ModRet.getError().getCode(), ErrorCode::MagicNotDetected);
+}
+
+TEST(Runtime, ModuleStreamValidatesFunctionsOnArrival) {
+  auto RT = newInterpRuntime();
+  ASSERT_NE(RT, nullptr);
+
+  // $add0 becomes (i32.add (nop) (nop) (i32.const 0)). It is rejected as soon
+  // as its body has arrived, so the feeding stops before the rest of the code
+  // section
+  std::vector<uint8_t> Bytecode(CallIndirectWasm,
+                                CallIndirectWasm + sizeof(CallIndirectWasm));
+  const size_t Add0LocalGet = 102;
+  ASSERT_EQ(Bytecode[Add0LocalGet], 0x20);
+  Bytecode[Add0LocalGet] = 0x01;
+  Bytecode[Add0LocalGet + 1] = 0x01;
+  auto Stream = RT->startModuleStream("stream", Bytecode.size());
+  ASSERT_NE(Stream, nullptr);
+  size_t Offset = 0;
+  while (Offset < Bytecode.size() && Stream->feed(&Bytecode[Offset], 1)) {
+    ++Offset;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_GT(Offset, Add0LocalGet);
+  EXPECT_LT(Offset, Bytecode.size());
+  auto ModRet = Stream->finish();
+  ASSERT_FALSE(ModRet);
+  EXPECT_EQ(ModRet.getError().getCode(), ErrorCode::TypeMismatchStackSize);
+}
+
+TEST(Runtime, ModuleStreamAbort) {
+  auto RT = newInterpRuntime();
+  ASSERT_NE(RT, nullptr);
+
+  // Destroying an unfinished stream wakes up the loader waiting for data and
+  // frees the name
+  auto Stream = RT->startModuleStream("stream", sizeof(CallIndirectWasm));
+  ASSERT_NE(Stream, nullptr);
+  ASSERT_TRUE(Stream->feed(CallIndirectWasm, sizeof(CallIndirectWasm) / 2));
+  Stream.reset();
+
+  auto ModRet =
+      RT->loadModule("stream", CallIndirectWasm, sizeof(CallIndirectWasm));
+  ASSERT_TRUE(ModRet);
+  expectCallIndirectWorks(*RT, **ModRet);
+}
+#endif // ZEN_ENABLE_SGX
+
+TEST(Runtime, IndirectCallCache) {
+#ifndef ZEN_ENABLE_MULTIPASS_JIT
+  GTEST_SKIP() << "multipass JIT not enabled";
+#else
+  RuntimeConfig Config;
+  Config.Mode = RunMode::MultipassMode;
+  Config.EnableMultipassIndirectCallCache = true;
+#ifdef ZEN_ENABLE_BUILTIN_WASI
+  Config.DisableWASI = true;
+#endif
+  auto RT = Runtime::newRuntime(Config);
+  ASSERT_NE(RT, nullptr);
+  auto ModRet = RT->loadModule("call_indirect", CallIndirectWasm,
+                               sizeof(CallIndirectWasm));
+  ASSERT_TRUE(ModRet);
+  Module *Mod = *ModRet;
+  IsolationUniquePtr Iso = RT->createUnmanagedIsolation();
+  ASSERT_NE(Iso, nullptr);
+  auto InstRet = Iso->createInstance(*Mod);
+  ASSERT_TRUE(InstRet);
+  Instance *Inst = *InstRet;
+
+  // The only call_indirect site, the last cache if it was compiled again
+  ASSERT_FALSE(Mod->getIndirectCallCaches().empty());
+  const IndirectCallCache &Cache = Mod->getIndirectCallCaches().back();
+  EXPECT_EQ(Cache.TableIdx, UINT64_MAX);
+  EXPECT_EQ(Cache.NumMisses, 0u);
+
+  // The first call misses and fills the cache, the next one hits
+  int32_t Result = 0;
+  ASSERT_TRUE(callIndirect(*RT, *Inst, 100, 3, Result));
+  EXPECT_EQ(Result, 103);
+  EXPECT_EQ(Cache.TableIdx, 3u);
+  EXPECT_EQ(Cache.NumMisses, 1u);
+  ASSERT_TRUE(callIndirect(*RT, *Inst, 200, 3, Result));
+  EXPECT_EQ(Result, 203);
+  EXPECT_EQ(Cache.TableIdx, 3u);
+  EXPECT_EQ(Cache.NumMisses, 1u);
+
+  // Another index misses and replaces the cached one
+  ASSERT_TRUE(callIndirect(*RT, *Inst, 100, 5, Result));
+  EXPECT_EQ(Result, 105);
+  EXPECT_EQ(Cache.TableIdx, 5u);
+  EXPECT_EQ(Cache.NumMisses, 2u);
+
+  // The misses failing the checks still trap and leave the cache alone
+  EXPECT_FALSE(callIndirect(*RT, *Inst, 100, 21, Result));
+  EXPECT_EQ(Inst->getError().getCode(), ErrorCode::UndefinedElement);
+  EXPECT_FALSE(callIndirect(*RT, *Inst, 100, 20, Result));
+  EXPECT_EQ(Inst->getError().getCode(), ErrorCode::IndirectCallTypeMismatch);
+  EXPECT_EQ(Cache.TableIdx, 5u);
+  EXPECT_EQ(Cache.NumMisses, 2u);
+
+  // Every call misses until the site turns megamorphic, then the cache keeps
+  // the index of the last miss counted
+  for (int32_t I = 0; I < 20; ++I) {
+    ASSERT_TRUE(callIndirect(*RT, *Inst, 100, I, Result));
+    EXPECT_EQ(Result, 100 + I);
+  }
+  const uint32_t LastCountedIdx = IndirectCallCache::MaxMisses - 2 - 1;
+  EXPECT_EQ(Cache.NumMisses, IndirectCallCache::MaxMisses);
+  EXPECT_EQ(Cache.TableIdx, LastCountedIdx);
+  ASSERT_TRUE(callIndirect(*RT, *Inst, 100, 19, Result));
+  EXPECT_EQ(Result, 119);
+  ASSERT_TRUE(callIndirect(*RT, *Inst, 100, LastCountedIdx, Result));
+  EXPECT_EQ(Result, 100 + LastCountedIdx);
+  EXPECT_EQ(Cache.NumMisses, IndirectCallCache::MaxMisses);
+  EXPECT_EQ(Cache.TableIdx, LastCountedIdx);
+
+  Iso->deleteInstance(Inst);
+#endif // ZEN_ENABLE_MULTIPASS_JIT
+}
+
+} // namespace zen::test
@@ -0,0 +1,97 @@
+// Copyright (C) 2021-2023 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "utils/code_layout.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace zen::utils {
+
+std::vector<std::vector<uint32_t>>
+buildCallChains(const std::vector<CallEdge> &Edges,
+                const std::vector<uint64_t> &CodeSizes,
+                uint64_t MaxChainCodeSize) {
+  const uint32_t NumFuncs = CodeSizes.size();
+
+  // Normalize the edges to (min, max) and sum up the duplicates
+  std::vector<CallEdge> Merged;
+  Merged.reserve(Edges.size());
+  for (const CallEdge &E : Edges) {
+    if (E.From != E.To && E.Weight != 0) {
+      Merged.push_back(
+          {std::min(E.From, E.To), std::max(E.From, E.To), E.Weight});
+    }
+  }
+  std::sort(Merged.begin(), Merged.end(),
+            [](const CallEdge &LHS, const CallEdge &RHS) {
+              return std::tie(LHS.From, LHS.To) < std::tie(RHS.From, RHS.To);
+            });
+  size_t NumMerged = 0;
+  for (const CallEdge &E : Merged) {
+    if (NumMerged > 0 && Merged[NumMerged - 1].From == E.From &&
+        Merged[NumMerged - 1].To == E.To) {
+      uint64_t &Weight = Merged[NumMerged - 1].Weight;
+      Weight = E.Weight > UINT64_MAX - Weight ? UINT64_MAX : Weight + E.Weight;
+    } else {
+      Merged[NumMerged++] = E;
+    }
+  }
+  Merged.resize(NumMerged);
+  // Heaviest first, ties broken by indexes for a deterministic layout
+  std::stable_sort(Merged.begin(), Merged.end(),
+                   [](const CallEdge &LHS, const CallEdge &RHS) {
+                     return LHS.Weight > RHS.Weight;
+                   });
+
+  // Every function starts as a chain of its own, the chain of a function is
+  // found through Leaders(union-find)
+  std::vector<uint32_t> Leaders(NumFuncs);
+  std::vector<std::vector<uint32_t>> Chains(NumFuncs);
+  std::vector<uint64_t> ChainCodeSizes(CodeSizes);
+  for (uint32_t I = 0; I < NumFuncs; ++I) {
+    Leaders[I] = I;
+    Chains[I].push_back(I);
+  }
+  auto FindLeader = [&Leaders](uint32_t I) {
+    while (Leaders[I] != I) {
+      Leaders[I] = Leaders[Leaders[I]];
+      I = Leaders[I];
+    }
+    return I;
+  };
+
+  for (const CallEdge &E : Merged) {
+    uint32_t LeaderA = FindLeader(E.From);
+    uint32_t LeaderB = FindLeader(E.To);
+    if (LeaderA == LeaderB ||
+        ChainCodeSizes[LeaderA] + ChainCodeSizes[LeaderB] > MaxChainCodeSize) {
+      continue;
+    }
+    // Orient the chains to place the two functions of the edge side by side
+    // when they are at the ends of their chains
+    auto &ChainA = Chains[LeaderA];
+    auto &ChainB = Chains[LeaderB];
+    if (ChainA.front() == E.From) {
+      std::reverse(ChainA.begin(), ChainA.end());
+    }
+    if (ChainB.back() == E.To) {
+      std::reverse(ChainB.begin(), ChainB.end());
+    }
+    ChainA.insert(ChainA.end(), ChainB.begin(), ChainB.end());
+    ChainB.clear();
+    ChainCodeSizes[LeaderA] += ChainCodeSizes[LeaderB];
+    Leaders[LeaderB] = LeaderA;
+  }
+
+  std::vector<std::vector<uint32_t>> Result;
+  for (uint32_t I = 0; I < NumFuncs; ++I) {
+    auto &Chain = Chains[FindLeader(I)];
+    if (!Chain.empty()) {
+      Result.push_back(std::move(Chain));
+    }
+  }
+  return Result;
+}
+
+} // namespace zen::utils
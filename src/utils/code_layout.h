@@ -0,0 +1,34 @@
+// Copyright (C) 2021-2023 the DTVM authors. All Rights Reserved.
+// SPDX-License-Identifier: Apache-2.0
+
+#ifndef ZEN_UTILS_CODE_LAYOUT_H
+#define ZEN_UTILS_CODE_LAYOUT_H
+
+#include <cstdint>
+#include <vector>
+
+namespace zen::utils {
+
+/// A weighted call graph edge, the direction doesn't matter for the layout
+struct CallEdge {
+  uint32_t From;
+  uint32_t To;
+  uint64_t Weight;
+};
+
+/// \brief group the functions into chains of callers and callees(Pettis-Hansen
+/// style), the heaviest edges are merged first and each chain is meant to be
+/// emitted contiguously
+/// \param Edges the edges between the same two functions are summed up, self
+/// edges and zero weights are ignored
+/// \param CodeSizes the size of every function
+/// \param MaxChainCodeSize chains are not merged beyond this size
+/// \return the chains in the order of their smallest function indexes
+std::vector<std::vector<uint32_t>>
+buildCallChains(const std::vector<CallEdge> &Edges,
+                const std::vector<uint64_t> &CodeSizes,
+                uint64_t MaxChainCodeSize);
+
+} // namespace zen::utils
+
+#endif // ZEN_UTILS_CODE_LAYOUT_H
@@ -5,6 +5,7 @@
 
 #include <cinttypes>
 #include <cstdio>
+#include <cstring>
 #ifdef ZEN_BUILD_PLATFORM_DARWIN
 #include <dirent.h>
 #endif
@@ -104,4 +105,28 @@ std::string toHex(const uint8_t *Bytes, size_t BytesCount) {
   return HexStr;
 }
 
+uint64_t hashBytes(const void *Data, size_t Size) {
+  constexpr uint64_t Prime = 0x9E3779B97F4A7C15ULL;
+  const uint8_t *Ptr = static_cast<const uint8_t *>(Data);
+  uint64_t Hash = Size * Prime;
+  // Mix 8 bytes per step
+  for (; Size >= sizeof(uint64_t); Size -= sizeof(uint64_t)) {
+    uint64_t Word;
+    std::memcpy(&Word, Ptr, sizeof(uint64_t));
+    Hash = ((Hash ^ Word) * Prime);
+    Hash ^= Hash >> 29;
+    Ptr += sizeof(uint64_t);
+  }
+  for (; Size > 0; --Size) {
+    Hash = (Hash ^ *Ptr++) * Prime;
+  }
+  // Final avalanche of splitmix64
+  Hash ^= Hash >> 30;
+  Hash *= 0xBF58476D1CE4E5B9ULL;
+  Hash ^= Hash >> 27;
+  Hash *= 0x94D049BB133111EBULL;
+  Hash ^= Hash >> 31;
+  return Hash;
+}
+
 } // namespace zen::utils
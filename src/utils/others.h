@@ -42,6 +42,9 @@ bool readBinaryFile(const std::string &Path, std::vector<uint8_t> &Data);
 
 std::string toHex(const uint8_t *Bytes, size_t BytesCount);
 
+// Fast non-cryptographic 64-bit hash, equal hashes don't imply equal bytes
+uint64_t hashBytes(const void *Data, size_t Size);
+
 } // namespace zen::utils
 
 #endif // ZEN_UTILS_OTHERS_H
@@ -3,55 +3,201 @@
 
 #include "utils/statistics.h"
 #include "utils/logging.h"
+#include <algorithm>
+#include <cinttypes>
 #include <cstdio>
+#include <iterator>
 #include <ratio>
 
 namespace zen::utils {
 
-Statistics::StatisticTimer Statistics::startRecord(StatisticPhase Phase) {
-  if (!Enabled) {
-    return -1u;
+namespace {
+
+std::atomic<uint64_t> StatisticsIdCounter{0};
+
+// Only written by the owner thread, so plain load/store is enough
+inline void addRelaxed(std::atomic<uint64_t> &Slot, uint64_t Delta) {
+  Slot.store(Slot.load(std::memory_order_relaxed) + Delta,
+             std::memory_order_relaxed);
+}
+
+constexpr const char *PhaseMetricNames[] = {
+    "load",
+    "jit_compilation",
+    "jit_lazy_precompilation",
+    "jit_lazy_fg_compilation",
+    "jit_lazy_bg_compilation",
+    "jit_lazy_release_delay",
+    "memory_bucket_map",
+    "instantiation",
+    "execution",
+    "jit_pass_mir_building",
+    "jit_pass_cgir_lowering",
+    "jit_pass_regalloc_analysis",
+    "jit_pass_regalloc",
+    "jit_pass_post_ra",
+    "jit_pass_mc_emission",
+};
+
+constexpr const char *CounterMetricNames[] = {
+    "dtvm_gas_used_total",
+    "dtvm_traps_total",
+    "dtvm_memory_grows_total",
+    "dtvm_memory_grow_pages_total",
+    "dtvm_jit_compiled_functions_total",
+    "dtvm_jit_regalloc_downgrades_total",
+};
+
+} // namespace
+
+uint64_t StatisticHistogram::getBucketUpperBound(uint32_t Index) {
+  if (Index < NumSubBuckets) {
+    return Index;
+  }
+  uint32_t Shift = (Index - NumSubBuckets) / NumSubBuckets;
+  uint64_t Sub = (Index - NumSubBuckets) % NumSubBuckets;
+  uint64_t Lower = (NumSubBuckets + Sub) << Shift;
+  return Lower + ((uint64_t(1) << Shift) - 1);
+}
+
+uint64_t StatisticHistogram::getQuantile(double Quantile) const {
+  if (Count == 0) {
+    return 0;
+  }
+  uint64_t Rank = static_cast<uint64_t>(Quantile * Count + 0.5);
+  Rank = std::max<uint64_t>(Rank, 1);
+  uint64_t Accumulated = 0;
+  for (uint32_t I = 0; I < NumBuckets; ++I) {
+    Accumulated += Buckets[I];
+    if (Accumulated >= Rank) {
+      return std::min(getBucketUpperBound(I), MaxNs);
+    }
   }
+  return MaxNs;
+}
+
+Statistics::Statistics(bool Enabled)
+    : Enabled(Enabled), Id(StatisticsIdCounter.fetch_add(1) + 1) {}
 
+Statistics::~Statistics() = default;
+
+Statistics::ThreadShard::~ThreadShard() {
+  for (auto &Phase : Phases) {
+    delete Phase.load(std::memory_order_relaxed);
+  }
+}
+
+Statistics::ThreadShard *Statistics::registerThreadShard() {
+  thread_local char ThreadKey;
   common::LockGuard<common::Mutex> Lock(Mtx);
-  auto Timer = TimerCounter++;
-  Timers[Timer] = {Phase, common::SteadyClock::now()};
-  return Timer;
+  for (auto &[Key, Shard] : Shards) {
+    if (Key == &ThreadKey) {
+      return Shard.get();
+    }
+  }
+  Shards.emplace_back(&ThreadKey, std::make_unique<ThreadShard>());
+  return Shards.back().second.get();
 }
 
-void Statistics::stopRecord(StatisticTimer Timer) {
+void Statistics::stopRecord(const StatisticTimer &Timer) {
   if (!Enabled) {
     return;
   }
 
-  ZEN_ASSERT(Timers.find(Timer) != Timers.end());
-  common::LockGuard<common::Mutex> Lock(Mtx);
   auto End = common::SteadyClock::now();
-  auto Start = Timers[Timer].second;
-  float TimeCost =
-      common::chrono::duration<float, std::milli>(End - Start).count();
-  auto Phase = Timers[Timer].first;
-  Records.emplace_back(Phase, TimeCost);
-  Timers.erase(Timer);
+  uint64_t TimeCost = common::chrono::duration_cast<common::chrono::nanoseconds>(
+                          End - Timer.Start)
+                          .count();
+  PhaseShard &Shard = getPhaseShard(Timer.Phase);
+  addRelaxed(Shard.Count, 1);
+  addRelaxed(Shard.TotalNs, TimeCost);
+  if (TimeCost > Shard.MaxNs.load(std::memory_order_relaxed)) {
+    Shard.MaxNs.store(TimeCost, std::memory_order_relaxed);
+  }
+  addRelaxed(Shard.Buckets[StatisticHistogram::getBucketIndex(TimeCost)], 1);
 }
 
-void Statistics::revertRecord(StatisticTimer Timer) {
+void Statistics::snapshot(StatisticsSnapshot &Snapshot) const {
+  Snapshot = StatisticsSnapshot();
   if (!Enabled) {
     return;
   }
 
-  ZEN_ASSERT(Timers.find(Timer) != Timers.end());
   common::LockGuard<common::Mutex> Lock(Mtx);
-  Timers.erase(Timer);
+  for (const auto &[Key, Shard] : Shards) {
+    for (uint32_t I = 0; I < NumPhases; ++I) {
+      const PhaseShard *Src = Shard->Phases[I].load(std::memory_order_acquire);
+      if (!Src || Src->Count.load(std::memory_order_relaxed) == 0) {
+        continue;
+      }
+      StatisticHistogram &Dst = Snapshot.Phases[I];
+      Dst.Count += Src->Count.load(std::memory_order_relaxed);
+      Dst.TotalNs += Src->TotalNs.load(std::memory_order_relaxed);
+      Dst.MaxNs =
+          std::max(Dst.MaxNs, Src->MaxNs.load(std::memory_order_relaxed));
+      for (uint32_t J = 0; J < StatisticHistogram::NumBuckets; ++J) {
+        Dst.Buckets[J] += Src->Buckets[J].load(std::memory_order_relaxed);
+      }
+    }
+    for (uint32_t I = 0; I < NumCounters; ++I) {
+      Snapshot.Counters[I] +=
+          Shard->Counters[I].load(std::memory_order_relaxed);
+    }
+  }
 }
 
-void Statistics::clearAllTimers() {
-  if (!Enabled) {
-    return;
+std::string Statistics::dumpPrometheus() const {
+  static_assert(std::size(PhaseMetricNames) == NumPhases);
+  static_assert(std::size(CounterMetricNames) == NumCounters);
+
+  auto Snapshot = std::make_unique<StatisticsSnapshot>();
+  snapshot(*Snapshot);
+
+  std::string Out;
+  char Buf[256];
+  auto Append = [&](const char *Format, auto... Args) {
+    int Len = std::snprintf(Buf, sizeof(Buf), Format, Args...);
+    ZEN_ASSERT(Len > 0 && static_cast<size_t>(Len) < sizeof(Buf));
+    Out.append(Buf, Len);
+  };
+
+  // Coarse bucket bounds in nanoseconds(1us ~ 10s)
+  static constexpr uint64_t BoundsNs[] = {
+      1000,        10000,        100000,        1000000,
+      10000000,    100000000,    1000000000,    10000000000,
+  };
+
+  Out += "# HELP dtvm_phase_duration_seconds Time cost of runtime phases\n";
+  Out += "# TYPE dtvm_phase_duration_seconds histogram\n";
+  for (uint32_t I = 0; I < NumPhases; ++I) {
+    const StatisticHistogram &Hist = Snapshot->Phases[I];
+    const char *Phase = PhaseMetricNames[I];
+    uint64_t Accumulated = 0;
+    uint32_t BucketIdx = 0;
+    for (uint64_t Bound : BoundsNs) {
+      while (BucketIdx < StatisticHistogram::NumBuckets &&
+             StatisticHistogram::getBucketUpperBound(BucketIdx) <= Bound) {
+        Accumulated += Hist.Buckets[BucketIdx++];
+      }
+      Append("dtvm_phase_duration_seconds_bucket{phase=\"%s\",le=\"%g\"} "
+             "%" PRIu64 "\n",
+             Phase, Bound / 1e9, Accumulated);
+    }
+    Append("dtvm_phase_duration_seconds_bucket{phase=\"%s\",le=\"+Inf\"} "
+           "%" PRIu64 "\n",
+           Phase, Hist.Count);
+    Append("dtvm_phase_duration_seconds_sum{phase=\"%s\"} %.9f\n", Phase,
+           Hist.TotalNs / 1e9);
+    Append("dtvm_phase_duration_seconds_count{phase=\"%s\"} %" PRIu64 "\n",
+           Phase, Hist.Count);
   }
 
-  common::LockGuard<common::Mutex> Lock(Mtx);
-  Timers.clear();
+  for (uint32_t I = 0; I < NumCounters; ++I) {
+    Append("# TYPE %s counter\n", CounterMetricNames[I]);
+    Append("%s %" PRIu64 "\n", CounterMetricNames[I], Snapshot->Counters[I]);
+  }
+
+  return Out;
 }
 
 void Statistics::report() const {
@@ -66,25 +212,37 @@ void Statistics::report() const {
   constexpr auto JITLazyBgPhaseVal =
       common::to_underlying(StatisticPhase::JITLazyBgCompilation);
   constexpr auto ExePhaseVal = common::to_underlying(StatisticPhase::Execution);
+  constexpr auto FirstJITPassPhaseVal =
+      common::to_underlying(StatisticPhase::JITPassMIRBuilding);
   constexpr auto NumStatPhases =
       common::to_underlying(StatisticPhase::NumStatisticPhases);
 
-  uint32_t NumPhaseRecords[NumStatPhases] = {0};
+  auto Snapshot = std::make_unique<StatisticsSnapshot>();
+  snapshot(*Snapshot);
+
+  uint64_t NumPhaseRecords[NumStatPhases] = {0};
   float TimePhaseCosts[NumStatPhases] = {0};
+  float P99PhaseTimeCosts[NumStatPhases] = {0};
 
-  for (const auto &[Phase, TimeCost] : Records) {
-    auto PhaseVal = to_underlying(Phase);
-    ZEN_ASSERT(PhaseVal < NumStatPhases);
-    NumPhaseRecords[PhaseVal]++;
-    TimePhaseCosts[PhaseVal] += TimeCost;
+  for (uint32_t I = 0; I < NumStatPhases; ++I) {
+    const StatisticHistogram &Hist = Snapshot->Phases[I];
+    NumPhaseRecords[I] = Hist.Count;
+    TimePhaseCosts[I] = Hist.TotalNs / 1e6f;
+    P99PhaseTimeCosts[I] = Hist.getQuantile(0.99) / 1e6f;
   }
 
   TimePhaseCosts[ExePhaseVal] -= TimePhaseCosts[JITLazyFgPhaseVal];
 
   float TotalTimeCost = 0;
   bool HasPhaseTimeCost = false;
+  // The background compilation overlaps with other phases, and the passes
+  // are nested in the compilation phases
+  auto IsNestedPhase = [&](uint32_t I) {
+    return I == JITLazyBgPhaseVal || I >= FirstJITPassPhaseVal;
+  };
+
   for (uint32_t I = 0; I < NumStatPhases; ++I) {
-    if (I == JITLazyBgPhaseVal) {
+    if (IsNestedPhase(I)) {
       continue;
     }
     TotalTimeCost += TimePhaseCosts[I];
@@ -112,25 +270,50 @@ void Statistics::report() const {
       "Memory Bucket Map:\t",
       "Instantiation:\t\t",
       "Execution:\t\t",
+      "JIT Pass MIR Building:\t",
+      "JIT Pass CgIR Lowering:\t",
+      "JIT Pass RA Analysis:\t",
+      "JIT Pass RA:\t\t",
+      "JIT Pass Post RA:\t",
+      "JIT Pass MC Emission:\t",
   };
 
   for (uint32_t I = 0; I < NumStatPhases; ++I) {
     if (NumPhaseRecords[I] > 0) {
       float AvgPhaseTimeCost = TimePhaseCosts[I] / NumPhaseRecords[I];
-      if (I == JITLazyBgPhaseVal) {
-        ZEN_LOG_INFO("%s%u times, avg %.3fms, total %.3fms", StatLogPrefixs[I],
-                     NumPhaseRecords[I], AvgPhaseTimeCost, TimePhaseCosts[I]);
+      if (IsNestedPhase(I)) {
+        ZEN_LOG_INFO("%s%" PRIu64 " times, avg %.3fms, p99 %.3fms, "
+                     "total %.3fms",
+                     StatLogPrefixs[I], NumPhaseRecords[I], AvgPhaseTimeCost,
+                     P99PhaseTimeCosts[I], TimePhaseCosts[I]);
       } else {
         float PhaseTimeCostPercent = TimePhaseCosts[I] / TotalTimeCost * 100;
-        ZEN_LOG_INFO("%s%u times, avg %.3fms, total %.3fms, %.2f%%",
+        ZEN_LOG_INFO("%s%" PRIu64 " times, avg %.3fms, p99 %.3fms, "
+                     "total %.3fms, %.2f%%",
                      StatLogPrefixs[I], NumPhaseRecords[I], AvgPhaseTimeCost,
-                     TimePhaseCosts[I], PhaseTimeCostPercent);
+                     P99PhaseTimeCosts[I], TimePhaseCosts[I],
+                     PhaseTimeCostPercent);
       }
     }
   }
 
   ZEN_LOG_INFO("Total:\t\t%.3fms", TotalTimeCost);
 
+  static constexpr const char *CounterLogPrefixs[] = {
+      "Gas Used:\t\t",
+      "Traps:\t\t\t",
+      "Memory Grows:\t\t",
+      "Memory Grow Pages:\t",
+      "JIT Compiled Functions:\t",
+      "JIT RA Downgrades:\t",
+  };
+
+  for (uint32_t I = 0; I < NumCounters; ++I) {
+    if (Snapshot->Counters[I] > 0) {
+      ZEN_LOG_INFO("%s%" PRIu64, CounterLogPrefixs[I], Snapshot->Counters[I]);
+    }
+  }
+
   ZEN_LOG_INFO(
       "=================  [End] ZetaEngine Statistics =================");
 }
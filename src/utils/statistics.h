@@ -6,8 +6,10 @@
 
 #include "common/defines.h"
 
+#include <atomic>
 #include <chrono>
-#include <unordered_map>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace zen::utils {
@@ -22,38 +24,165 @@ enum class StatisticPhase : uint32_t {
   MemoryBucketMap = 6,
   Instantiation = 7,
   Execution = 8,
+  // Passes of multipass JIT per function, nested in the compilation phases
+  JITPassMIRBuilding = 9,
+  JITPassCgIRLowering = 10,
+  JITPassRegAllocAnalysis = 11,
+  JITPassRegAlloc = 12,
+  JITPassPostRA = 13,
+  JITPassMCEmission = 14,
   NumStatisticPhases
 };
 
+enum class StatisticCounter : uint32_t {
+  GasUsed = 0,
+  Traps = 1,
+  MemoryGrows = 2,
+  MemoryGrowPages = 3,
+  JITCompiledFunctions = 4,  // only for multipass JIT
+  JITRegAllocDowngrades = 5, // only for multipass JIT(size/time budget hit)
+  NumStatisticCounters
+};
+
+/// \brief log-linear(HDR-style) latency histogram in nanoseconds, values below
+/// 2^SubBucketBits are exact, others have relative error below 2^-SubBucketBits
+struct StatisticHistogram {
+  static constexpr uint32_t SubBucketBits = 3;
+  static constexpr uint32_t NumSubBuckets = 1u << SubBucketBits;
+  static constexpr uint32_t NumBuckets =
+      NumSubBuckets + (64 - SubBucketBits) * NumSubBuckets;
+
+  static uint32_t getBucketIndex(uint64_t Value) {
+    if (Value < NumSubBuckets) {
+      return static_cast<uint32_t>(Value);
+    }
+    uint32_t Exp = 63 - __builtin_clzll(Value);
+    uint32_t Sub = (Value >> (Exp - SubBucketBits)) & (NumSubBuckets - 1);
+    return NumSubBuckets + (Exp - SubBucketBits) * NumSubBuckets + Sub;
+  }
+
+  /// \brief the largest value that falls into the bucket
+  static uint64_t getBucketUpperBound(uint32_t Index);
+
+  uint64_t Count = 0;
+  uint64_t TotalNs = 0;
+  uint64_t MaxNs = 0;
+  uint64_t Buckets[NumBuckets] = {0};
+
+  /// \param Quantile in [0, 1]
+  uint64_t getQuantile(double Quantile) const;
+};
+
+struct StatisticsSnapshot {
+  StatisticHistogram Phases[common::to_underlying(
+      StatisticPhase::NumStatisticPhases)];
+  uint64_t Counters[common::to_underlying(
+      StatisticCounter::NumStatisticCounters)] = {0};
+};
+
+/// \brief Recording is lock-free: every thread writes its own shard with
+/// relaxed atomics, shards are only aggregated in snapshot()
 class Statistics final {
   typedef common::SteadyClock::time_point TimePoint;
-  typedef uint32_t StatisticTimer;
-  typedef std::pair<StatisticPhase, float> StatisticRecord;
 
 public:
-  Statistics(bool Enabled) : Enabled(Enabled) {}
+  struct StatisticTimer {
+    StatisticPhase Phase;
+    TimePoint Start;
+  };
 
-  ~Statistics() { ZEN_ASSERT(Timers.empty()); }
+  Statistics(bool Enabled);
+
+  ~Statistics();
 
   NONCOPYABLE(Statistics);
 
-  StatisticTimer startRecord(StatisticPhase Phase);
+  bool isEnabled() const { return Enabled; }
+
+  StatisticTimer startRecord(StatisticPhase Phase) {
+    if (!Enabled) {
+      return {Phase, TimePoint()};
+    }
+    return {Phase, common::SteadyClock::now()};
+  }
+
+  void stopRecord(const StatisticTimer &Timer);
 
-  void stopRecord(StatisticTimer Timer);
+  /// \brief discard the timer, timers hold no resources so nothing to do
+  void revertRecord(const StatisticTimer &Timer) {}
 
-  void revertRecord(StatisticTimer Timer);
+  /// \brief kept for the error paths, timers hold no resources
+  void clearAllTimers() {}
 
-  void clearAllTimers();
+  void addCounter(StatisticCounter Counter, uint64_t Delta) {
+    if (!Enabled) {
+      return;
+    }
+    auto &Slot = getThreadShard().Counters[common::to_underlying(Counter)];
+    Slot.store(Slot.load(std::memory_order_relaxed) + Delta,
+               std::memory_order_relaxed);
+  }
+
+  /// \brief aggregate all thread shards, can be called concurrently with
+  /// recording
+  void snapshot(StatisticsSnapshot &Snapshot) const;
+
+  /// \brief dump the snapshot in Prometheus text exposition format
+  std::string dumpPrometheus() const;
 
   void report() const;
 
 private:
+  static constexpr uint32_t NumPhases =
+      common::to_underlying(StatisticPhase::NumStatisticPhases);
+  static constexpr uint32_t NumCounters =
+      common::to_underlying(StatisticCounter::NumStatisticCounters);
+
+  struct PhaseShard {
+    std::atomic<uint64_t> Count{0};
+    std::atomic<uint64_t> TotalNs{0};
+    std::atomic<uint64_t> MaxNs{0};
+    std::atomic<uint64_t> Buckets[StatisticHistogram::NumBuckets] = {};
+  };
+
+  // Written by only one thread, phase shards are allocated on the first
+  // record of the phase, so a thread only pays for the phases it hits
+  struct ThreadShard {
+    std::atomic<PhaseShard *> Phases[NumPhases] = {};
+    std::atomic<uint64_t> Counters[NumCounters] = {};
+
+    ~ThreadShard();
+  };
+
+  ThreadShard &getThreadShard() {
+    // Cache the shard of the last used Statistics, Id never repeats so a
+    // destroyed Statistics can't be hit
+    thread_local uint64_t CachedId = 0;
+    thread_local ThreadShard *CachedShard = nullptr;
+    if (CachedId != Id) {
+      CachedShard = registerThreadShard();
+      CachedId = Id;
+    }
+    return *CachedShard;
+  }
+
+  ThreadShard *registerThreadShard();
+
+  PhaseShard &getPhaseShard(StatisticPhase Phase) {
+    auto &Slot = getThreadShard().Phases[common::to_underlying(Phase)];
+    PhaseShard *Shard = Slot.load(std::memory_order_relaxed);
+    if (ZEN_UNLIKELY(!Shard)) {
+      Shard = new PhaseShard();
+      Slot.store(Shard, std::memory_order_release);
+    }
+    return *Shard;
+  }
+
   const bool Enabled;
-  common::Mutex Mtx;
-  StatisticTimer TimerCounter = 0;
-  typedef std::pair<StatisticPhase, TimePoint> TimerPair;
-  std::unordered_map<StatisticTimer, TimerPair> Timers;
-  std::vector<StatisticRecord> Records;
+  const uint64_t Id;
+  mutable common::Mutex Mtx;
+  // (thread key, shard), shards are never released before the Statistics
+  std::vector<std::pair<const void *, std::unique_ptr<ThreadShard>>> Shards;
 };
 
 } // namespace zen::utils
@@ -4,45 +4,183 @@
 #include "common/mem_pool.h"
 #include "runtime/instance.h"
 
+#include <unordered_map>
+
 namespace zen::utils {
 
 constexpr size_t StackMemorySize = 9 * 1024 * 1024; // 9MB > dwasm 8MB
 
-StackMemPool::StackMemPool(size_t ItemSize)
-    : EachStackSize(ItemSize), AvailableCount(MAX_STACK_ITEM_NUM) {
+#ifndef ZEN_ENABLE_SGX
+namespace {
+
+// Live pools by their ids, looked up by the thread caches which may outlive
+// their pools. Never destroyed, since threads may exit after the static
+// destructors have run
+struct StackMemPoolRegistry {
+  common::Mutex Mutex;
+  uint64_t NextId = 1;
+  std::unordered_map<uint64_t, StackMemPool *> Pools;
+};
+
+StackMemPoolRegistry &getStackMemPoolRegistry() {
+  static auto *Registry = new StackMemPoolRegistry;
+  return *Registry;
+}
+
+} // namespace
+
+// Free stacks of the current thread from a single pool, returned to the
+// global list of the pool when the thread exits or caches the stacks of
+// another pool, and dropped if the pool is already destroyed
+struct StackMemPool::ThreadCache {
+  uint64_t PoolId = 0;
+  std::vector<void *> Stacks;
+
+  ~ThreadCache() { flush(); }
+
+  void flush() {
+    if (Stacks.empty()) {
+      return;
+    }
+    // Hold the registry lock, so that the pool can't be destroyed meanwhile
+    auto &Registry = getStackMemPoolRegistry();
+    common::LockGuard<common::Mutex> Lock(Registry.Mutex);
+    auto It = Registry.Pools.find(PoolId);
+    if (It != Registry.Pools.end()) {
+      for (void *Ptr : Stacks) {
+        It->second->deallocateToGlobal(Ptr, true);
+      }
+    }
+    Stacks.clear();
+  }
+};
+
+StackMemPool::ThreadCache &StackMemPool::getThreadCache() {
+  static thread_local ThreadCache Cache;
+  return Cache;
+}
+#endif // ZEN_ENABLE_SGX
+
+StackMemPool::StackMemPool(size_t ItemSize) : EachStackSize(ItemSize) {
+  ZEN_ASSERT(EachStackSize <= MaxCodeSize);
+  MemStart = reserveChunk();
+  MemEnd = MemStart;
+  MemPageEnd = MemStart;
+#ifndef ZEN_ENABLE_SGX
+  auto &Registry = getStackMemPoolRegistry();
+  common::LockGuard<common::Mutex> Lock(Registry.Mutex);
+  Id = Registry.NextId++;
+  Registry.Pools.emplace(Id, this);
+#endif // ZEN_ENABLE_SGX
+}
+
+StackMemPool::~StackMemPool() {
+#ifndef ZEN_ENABLE_SGX
+  // The thread caches(including the one of the current thread, which may
+  // already be destroyed at exit) find the pool gone when they flush, and
+  // never hand out their stacks since the id isn't reused
+  auto &Registry = getStackMemPoolRegistry();
+  common::LockGuard<common::Mutex> Lock(Registry.Mutex);
+  Registry.Pools.erase(Id);
+#endif // ZEN_ENABLE_SGX
+  for (uint8_t *Chunk : Chunks) {
+    platform::munmap(Chunk, MaxCodeSize);
+  }
+}
+
+uint8_t *StackMemPool::reserveChunk() {
 #ifdef ZEN_ENABLE_CPU_EXCEPTION
   int DefaultProtMode = PROT_NONE;
 #else
   int DefaultProtMode = PROT_READ | PROT_WRITE;
 #endif // ZEN_ENABLE_CPU_EXCEPTION
 
-  MemStart = reinterpret_cast<uint8_t *>(platform::mmap(
+  // Only reserve the address space, pages are committed on first touch
+  auto *Chunk = reinterpret_cast<uint8_t *>(platform::mmap(
       NULL, MaxCodeSize, DefaultProtMode, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+  Chunks.push_back(Chunk);
+  return Chunk;
+}
 
-  MemEnd = MemStart;
-  MemPageEnd = MemStart;
+void StackMemPool::setMaxRetainedStacks(size_t Num) {
+  common::LockGuard<common::Mutex> Lock(Mutex);
+  MaxRetainedStacks = Num;
+  while (NumRetainedStacks > Num && !CommittedFreeObjects.empty()) {
+    void *Ptr = CommittedFreeObjects.back();
+    CommittedFreeObjects.pop_back();
+    --NumRetainedStacks;
+    decommit(Ptr);
+    DecommittedFreeObjects.push_back(Ptr);
+  }
+}
+
+bool StackMemPool::tryRetainStack() {
+  size_t Num = NumRetainedStacks.load(std::memory_order_relaxed);
+  do {
+    if (Num >= MaxRetainedStacks.load(std::memory_order_relaxed)) {
+      return false;
+    }
+  } while (!NumRetainedStacks.compare_exchange_weak(
+      Num, Num + 1, std::memory_order_relaxed));
+  return true;
 }
-StackMemPool::~StackMemPool() { platform::munmap(MemStart, MaxCodeSize); }
 
 void *StackMemPool::allocate(bool AllowReadWrite) {
-  common::UniqueLock<common::Mutex> Lock(Mutex);
 #ifndef ZEN_ENABLE_SGX
-  AvailableCountCV.wait(Lock, [this]() { return AvailableCount > 0; });
+  ThreadCache &Cache = getThreadCache();
+  if (Cache.PoolId == Id && !Cache.Stacks.empty()) {
+    void *Result = Cache.Stacks.back();
+    Cache.Stacks.pop_back();
+    NumRetainedStacks.fetch_sub(1, std::memory_order_relaxed);
+    return Result;
+  }
+#endif // ZEN_ENABLE_SGX
+  return allocateFromGlobal(AllowReadWrite);
+}
+
+void StackMemPool::deallocate(void *Ptr) {
+  if (!Ptr) {
+    return;
+  }
+#ifndef ZEN_ENABLE_SGX
+  ThreadCache &Cache = getThreadCache();
+  if (Cache.PoolId != Id) {
+    Cache.flush();
+    Cache.PoolId = Id;
+  }
+  if (Cache.Stacks.size() < MaxThreadCachedStacks && tryRetainStack()) {
+    Cache.Stacks.push_back(Ptr);
+    return;
+  }
 #endif // ZEN_ENABLE_SGX
-  --AvailableCount;
+  deallocateToGlobal(Ptr, false);
+}
 
-  if (!FreeObjects.empty()) {
-    auto *Result = FreeObjects.front();
-    FreeObjects.pop();
+void *StackMemPool::allocateFromGlobal(bool AllowReadWrite) {
+  common::LockGuard<common::Mutex> Lock(Mutex);
+  if (!CommittedFreeObjects.empty()) {
+    void *Result = CommittedFreeObjects.back();
+    CommittedFreeObjects.pop_back();
+    --NumRetainedStacks;
+    return Result;
+  }
+  if (!DecommittedFreeObjects.empty()) {
+    void *Result = DecommittedFreeObjects.back();
+    DecommittedFreeObjects.pop_back();
     return Result;
   }
+
   constexpr size_t Align = 16;
   uint8_t *Ptr = reinterpret_cast<uint8_t *>(
       ZEN_ALIGN(reinterpret_cast<uintptr_t>(MemEnd), Align));
   size_t NewSize = reinterpret_cast<uintptr_t>(Ptr) + EachStackSize -
                    reinterpret_cast<uintptr_t>(MemStart);
   if (NewSize > MaxCodeSize) {
-    ZEN_ABORT(); // not supported, exit
+    // The current chunk is used up, continue in a new one
+    MemStart = reserveChunk();
+    MemPageEnd = MemStart;
+    Ptr = MemStart;
+    NewSize = EachStackSize;
   }
   MemEnd = MemStart + NewSize;
   if (MemEnd > MemPageEnd) {
@@ -60,34 +198,71 @@ void *StackMemPool::allocate(bool AllowReadWrite) {
   return Ptr;
 }
 
-void StackMemPool::deallocate(void *Ptr) {
-  if (!Ptr) {
+void StackMemPool::deallocateToGlobal(void *Ptr, bool Retained) {
+  common::LockGuard<common::Mutex> Lock(Mutex);
+  if (Retained || tryRetainStack()) {
+    CommittedFreeObjects.push_back(Ptr);
     return;
   }
+  decommit(Ptr);
+  DecommittedFreeObjects.push_back(Ptr);
+}
+
+void StackMemPool::decommit(void *Ptr) {
 #ifndef ZEN_ENABLE_SGX
-  common::UniqueLock<common::Mutex> Lock(Mutex);
+  // Keep the mapping and the protection, only drop the touched pages. The
+  // stack start is only 16-byte aligned, so keep its first partial page
+  uintptr_t Start =
+      ZEN_ALIGN(reinterpret_cast<uintptr_t>(Ptr), (uintptr_t)PageSize);
+  uintptr_t End = (reinterpret_cast<uintptr_t>(Ptr) + EachStackSize) &
+                  ~((uintptr_t)PageSize - 1);
+  if (End > Start) {
+    ::madvise(reinterpret_cast<void *>(Start), End - Start, MADV_DONTNEED);
+  }
 #endif // ZEN_ENABLE_SGX
-  ZEN_ASSERT(AvailableCount < MAX_STACK_ITEM_NUM);
+}
 
-  ++AvailableCount;
+// stack allocate 2 * needed size, the first part used as stack, the second
+// part used to protect read/write by cpu
+// can't be less, even not enable cpu exception
+constexpr size_t StackItemSize = StackMemorySize * 2;
 
-  FreeObjects.push(Ptr);
+#ifndef ZEN_ENABLE_SGX
+static thread_local StackMemPool *ThreadStackPool = nullptr;
+#endif // ZEN_ENABLE_SGX
+
+static StackMemPool *getProcessVirtualStackPool() {
+  static StackMemPool StackPool(StackItemSize);
+  return &StackPool;
 }
 
 static StackMemPool *getVirtualStackPool() {
-  // stack allocate 2 * needed size, the first part used as stack, the second
-  // part used to protect read/write by cpu
-  // can't be less, even not enable cpu exception
-  static StackMemPool StackPool(StackMemorySize * 2);
-  return &StackPool;
+#ifndef ZEN_ENABLE_SGX
+  if (ThreadStackPool) {
+    return ThreadStackPool;
+  }
+#endif // ZEN_ENABLE_SGX
+  return getProcessVirtualStackPool();
+}
+
+std::unique_ptr<StackMemPool> newVirtualStackPool() {
+  return std::make_unique<StackMemPool>(StackItemSize);
+}
+
+#ifndef ZEN_ENABLE_SGX
+void setThreadVirtualStackPool(StackMemPool *Pool) { ThreadStackPool = Pool; }
+#endif // ZEN_ENABLE_SGX
+
+void setMaxRetainedVirtualStacks(size_t Num) {
+  getProcessVirtualStackPool()->setMaxRetainedStacks(Num);
 }
 
 void VirtualStackInfo::allocate() {
   if (AllInfo) {
     return;
   }
-  auto *MemPool = getVirtualStackPool();
-  AllocatedMem = (uint8_t *)MemPool->allocate(true);
+  Pool = getVirtualStackPool();
+  AllocatedMem = (uint8_t *)Pool->allocate(true);
   AllInfo = AllocatedMem + StackMemorySize;
   // [AllocatedMem, AllInfo) is disabled visiting
   // [AllInfo, StackMemoryTop) is available stack memory
@@ -107,9 +282,10 @@ void VirtualStackInfo::allocate() {
 
 void VirtualStackInfo::deallocate() {
   if (AllocatedMem) {
-    getVirtualStackPool()->deallocate(AllocatedMem);
+    Pool->deallocate(AllocatedMem);
     AllInfo = nullptr;
     AllocatedMem = nullptr;
+    Pool = nullptr;
   }
 }
 
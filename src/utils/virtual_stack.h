@@ -6,7 +6,9 @@
 
 #include "common/type.h"
 #include "platform/platform.h"
+#include <atomic>
 #include <csetjmp>
+#include <memory>
 #include <queue>
 #include <vector>
 
@@ -17,12 +19,23 @@ namespace zen::utils {
 using namespace common;
 using namespace runtime;
 
+/**
+ * Pool of virtual stacks, free stacks are cached per thread first, and the
+ * overflow goes to a global list. Address space is reserved in chunks on
+ * demand, so there is no limit of the stacks used simultaneously. The pages of
+ * a stack are committed on first touch, and returned to the OS when the stack
+ * is released while enough free stacks are already retained(in the thread
+ * caches or the global list)
+ */
 class StackMemPool {
 public:
-  // The maximum number of VStackItem that can be used simultaneously.
-  static constexpr size_t MAX_STACK_ITEM_NUM = 100;
+  // Number of free stacks cached by each thread without locking
+  static constexpr size_t MaxThreadCachedStacks = 4;
+  // Default number of free stacks kept committed
+  static constexpr size_t DefaultMaxRetainedStacks = 16;
 
 #ifndef ZEN_ENABLE_OCCLUM
+  // Address space reserved in each chunk
   static constexpr size_t MaxCodeSize = INT32_MAX;
 #else
   // for occlum, we need to limit the code size to avoid mmap failure
@@ -36,18 +49,59 @@ public:
   void *allocate(bool AllowReadWrite);
   void deallocate(void *Ptr);
 
+  /// \brief set the high-water mark of free stacks kept committed, the pages
+  /// of the free stacks above it in the global list are returned to the OS
+  /// right away, the ones in thread caches when they are used again
+  void setMaxRetainedStacks(size_t Num);
+
+  /// \brief number of free stacks kept committed, in the thread caches or the
+  /// global list
+  size_t getNumRetainedStacks() const { return NumRetainedStacks; }
+
 private:
+  struct ThreadCache;
+#ifndef ZEN_ENABLE_SGX
+  static ThreadCache &getThreadCache();
+#endif // ZEN_ENABLE_SGX
+
+  void *allocateFromGlobal(bool AllowReadWrite);
+  // Retained stacks are already counted in NumRetainedStacks
+  void deallocateToGlobal(void *Ptr, bool Retained);
+  // Count one more retained stack unless the high-water mark is reached
+  bool tryRetainStack();
+  void decommit(void *Ptr);
+  uint8_t *reserveChunk();
+
+  // Unique in the process, the thread caches outliving the pool compare it
+  // rather than the address which may be reused by another pool
+  uint64_t Id = 0;
   size_t EachStackSize;
-  uint8_t *MemStart;
-  uint8_t *MemEnd;
-  uint8_t *MemPageEnd;
-  std::queue<void *> FreeObjects;
+  // All reserved chunks, the last one is used to allocate new stacks
+  std::vector<uint8_t *> Chunks;
+  uint8_t *MemStart = nullptr;
+  uint8_t *MemEnd = nullptr;
+  uint8_t *MemPageEnd = nullptr;
+  // Free stacks with committed pages(LIFO to reuse the hot ones first)
+  std::vector<void *> CommittedFreeObjects;
+  // Free stacks whose pages have been returned to the OS
+  std::vector<void *> DecommittedFreeObjects;
+  std::atomic<size_t> MaxRetainedStacks{DefaultMaxRetainedStacks};
+  std::atomic<size_t> NumRetainedStacks{0};
   common::Mutex Mutex;
+};
+
+/// \brief set the high-water mark of the process-wide virtual stack pool
+void setMaxRetainedVirtualStacks(size_t Num);
+
+/// \brief a pool of virtual stacks separate from the process-wide one
+std::unique_ptr<StackMemPool> newVirtualStackPool();
+
 #ifndef ZEN_ENABLE_SGX
-  std::condition_variable AvailableCountCV;
+/// \brief allocate the virtual stacks of the calling thread from Pool rather
+/// than the process-wide pool, nullptr to restore. The stacks are returned to
+/// the pool they are allocated from, so it must outlive them
+void setThreadVirtualStackPool(StackMemPool *Pool);
 #endif // ZEN_ENABLE_SGX
-  size_t AvailableCount;
-};
 
 struct VirtualStackInfo;
 
@@ -63,6 +117,8 @@ struct VirtualStackInfo {
   // all stack infos put into bytes pointed by AllInfo
   uint8_t *AllInfo = nullptr;
   uint8_t *AllocatedMem = nullptr;
+  // the pool AllocatedMem is from
+  StackMemPool *Pool = nullptr;
   uint8_t *StackMemoryTop = nullptr;
   // pointed to the offset in AllInfo[0:8)
   uint64_t *NewRspPtr = nullptr;
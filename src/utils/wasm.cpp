@@ -70,10 +70,12 @@ const uint8_t *skipCurrentBlock(const uint8_t *Ip, const uint8_t *End) {
       break;
 
     case CALL:
+    case RETURN_CALL:
       Ip = skipLEBNumber<uint32_t>(Ip, End); // skip func_idx
       break;
 
     case CALL_INDIRECT:
+    case RETURN_CALL_INDIRECT:
       Ip = skipLEBNumber<uint32_t>(Ip, End); // skip type_idx
       ++Ip;                                  // skip tbl_idx
       break;
@@ -127,6 +129,18 @@ const uint8_t *skipCurrentBlock(const uint8_t *Ip, const uint8_t *End) {
       Ip = skipLEBNumber<uint32_t>(Ip, End); // 0x0
       break;
 
+    case ATOMIC_PREFIX: {
+      uint32_t AtomicOpcode;
+      Ip = readLEBNumber(Ip, End, AtomicOpcode);
+      if (AtomicOpcode == ATOMIC_FENCE) {
+        ++Ip; // skip 0x0
+      } else {
+        Ip = skipLEBNumber<uint32_t>(Ip, End); // align
+        Ip = skipLEBNumber<uint32_t>(Ip, End); // offset
+      }
+      break;
+    }
+
     case I32_CONST:
       Ip = skipLEBNumber<uint32_t>(Ip, End); // i32 val
       break;
@@ -2,8 +2,11 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "zetaengine-c.h"
+#include "runtime/executor.h"
 #include "zetaengine.h"
 
+#include <unordered_set>
+
 static inline zen::common::WASMType getWASMType(ZenType Type) {
   using WASMType = zen::common::WASMType;
   switch (Type) {
@@ -115,22 +118,81 @@ DEFINE_CONVERSION_FUNCTIONS(zen::runtime::HostModule, ZenHostModuleRef)
 DEFINE_CONVERSION_FUNCTIONS(BuiltinModuleDesc, ZenHostModuleDescRef)
 DEFINE_CONVERSION_FUNCTIONS(zen::runtime::Isolation, ZenIsolationRef)
 DEFINE_CONVERSION_FUNCTIONS(zen::runtime::Instance, ZenInstanceRef)
+DEFINE_CONVERSION_FUNCTIONS(zen::runtime::BlockExecutor, ZenBlockExecutorRef)
 
 // ==================== Runtime ====================
 
+// The configs created by ZenCreateRuntimeConfig, followed by the options not
+// in the public ZenRuntimeConfig. Zero keeps the defaults of the runtime
+struct ZenRuntimeConfigEx {
+  ZenRuntimeConfig Base;
+  bool EnableModuleCache;
+  bool EnableMultipassLazy;
+  bool DisableMultipassGreedyRA;
+  bool EnableMultipassLinearScanRA;
+  bool DisableMultipassMultithread;
+  uint32_t NumMultipassThreads;
+  uint32_t NumValidationThreads;
+  uint32_t NumWasmMemoryPoolSlots;
+  bool EnableWasmMemoryImage;
+  bool EnableThreads;
+  bool EnableLazyFunctionLoad;
+  const char *MultipassProfileDir;
+  bool EnableMultipassIndirectCallCache;
+  // UINT32_MAX keeps none
+  uint32_t NumRetainedVirtualStacks;
+  uint32_t MultipassMaxRAFuncInstrs;
+  uint32_t MultipassFuncBudgetMs;
+  bool EnableWasmProfiler;
+  uint32_t WasmProfilerIntervalUs;
+  bool EnableWasmProfilerCallCounts;
+};
+
+// ZenCreateRuntime can't tell the configs created by the caller from the
+// created ones by the pointer, so the latter are recorded here
+static zen::common::Mutex &getCreatedConfigsMutex() {
+  static zen::common::Mutex Mtx;
+  return Mtx;
+}
+
+static std::unordered_set<const ZenRuntimeConfig *> &getCreatedConfigs() {
+  static std::unordered_set<const ZenRuntimeConfig *> Configs;
+  return Configs;
+}
+
+static const ZenRuntimeConfigEx *findConfigEx(const ZenRuntimeConfig *Config) {
+  zen::common::LockGuard<zen::common::Mutex> Lock(getCreatedConfigsMutex());
+  if (getCreatedConfigs().count(Config) == 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<const ZenRuntimeConfigEx *>(Config);
+}
+
+static ZenRuntimeConfigEx *unwrapConfigEx(ZenRuntimeConfigRef Config) {
+  ZEN_ASSERT(findConfigEx(Config));
+  return reinterpret_cast<ZenRuntimeConfigEx *>(Config);
+}
+
 ZenRuntimeConfigRef ZenCreateRuntimeConfig(ZenRunMode Mode) {
-  auto *Config = reinterpret_cast<ZenRuntimeConfigRef>(
-      std::malloc(sizeof(ZenRuntimeConfig)));
-  if (!Config) {
+  auto *ConfigEx = reinterpret_cast<ZenRuntimeConfigEx *>(
+      std::malloc(sizeof(ZenRuntimeConfigEx)));
+  if (!ConfigEx) {
     ZEN_ABORT();
   }
-  std::memset(Config, 0x0, sizeof(ZenRuntimeConfig));
+  std::memset(ConfigEx, 0x0, sizeof(ZenRuntimeConfigEx));
+  ZenRuntimeConfigRef Config = &ConfigEx->Base;
   Config->Mode = Mode;
+  zen::common::LockGuard<zen::common::Mutex> Lock(getCreatedConfigsMutex());
+  getCreatedConfigs().insert(Config);
   return Config;
 }
 
 void ZenDeleteRuntimeConfig(ZenRuntimeConfigRef Config) {
   ZEN_ASSERT(Config);
+  {
+    zen::common::LockGuard<zen::common::Mutex> Lock(getCreatedConfigsMutex());
+    getCreatedConfigs().erase(Config);
+  }
   std::free(Config);
 }
 
@@ -140,6 +202,153 @@ void ZenRuntimeConfigSetWasmMemoryMap(ZenRuntimeConfigRef Config,
   Config->DisableWasmMemoryMap = !Enabled;
 }
 
+void ZenRuntimeConfigSetWASI(ZenRuntimeConfigRef Config, bool Enabled) {
+  ZEN_ASSERT(Config);
+  Config->DisableWASI = !Enabled;
+}
+
+void ZenRuntimeConfigSetStatistics(ZenRuntimeConfigRef Config, bool Enabled) {
+  ZEN_ASSERT(Config);
+  Config->EnableStatistics = Enabled;
+}
+
+void ZenRuntimeConfigSetGdbTracingHook(ZenRuntimeConfigRef Config,
+                                       bool Enabled) {
+  ZEN_ASSERT(Config);
+  Config->EnableGdbTracingHook = Enabled;
+}
+
+void ZenRuntimeConfigSetModuleCache(ZenRuntimeConfigRef Config, bool Enabled) {
+  unwrapConfigEx(Config)->EnableModuleCache = Enabled;
+}
+
+void ZenRuntimeConfigSetMultipassLazy(ZenRuntimeConfigRef Config,
+                                      bool Enabled) {
+  unwrapConfigEx(Config)->EnableMultipassLazy = Enabled;
+}
+
+void ZenRuntimeConfigSetMultipassGreedyRA(ZenRuntimeConfigRef Config,
+                                          bool Enabled) {
+  unwrapConfigEx(Config)->DisableMultipassGreedyRA = !Enabled;
+}
+
+void ZenRuntimeConfigSetMultipassLinearScanRA(ZenRuntimeConfigRef Config,
+                                              bool Enabled) {
+  unwrapConfigEx(Config)->EnableMultipassLinearScanRA = Enabled;
+}
+
+void ZenRuntimeConfigSetNumMultipassThreads(ZenRuntimeConfigRef Config,
+                                            uint32_t NumThreads) {
+  ZenRuntimeConfigEx *ConfigEx = unwrapConfigEx(Config);
+  ConfigEx->DisableMultipassMultithread = NumThreads == 0;
+  ConfigEx->NumMultipassThreads = NumThreads;
+}
+
+void ZenRuntimeConfigSetNumValidationThreads(ZenRuntimeConfigRef Config,
+                                             uint32_t NumThreads) {
+  unwrapConfigEx(Config)->NumValidationThreads = NumThreads;
+}
+
+void ZenRuntimeConfigSetNumWasmMemoryPoolSlots(ZenRuntimeConfigRef Config,
+                                               uint32_t NumSlots) {
+  unwrapConfigEx(Config)->NumWasmMemoryPoolSlots = NumSlots;
+}
+
+void ZenRuntimeConfigSetWasmMemoryImage(ZenRuntimeConfigRef Config,
+                                        bool Enabled) {
+  unwrapConfigEx(Config)->EnableWasmMemoryImage = Enabled;
+}
+
+void ZenRuntimeConfigSetThreads(ZenRuntimeConfigRef Config, bool Enabled) {
+  unwrapConfigEx(Config)->EnableThreads = Enabled;
+}
+
+void ZenRuntimeConfigSetLazyFunctionLoad(ZenRuntimeConfigRef Config,
+                                         bool Enabled) {
+  unwrapConfigEx(Config)->EnableLazyFunctionLoad = Enabled;
+}
+
+void ZenRuntimeConfigSetMultipassProfileDir(ZenRuntimeConfigRef Config,
+                                            const char *Dir) {
+  unwrapConfigEx(Config)->MultipassProfileDir = Dir;
+}
+
+void ZenRuntimeConfigSetMultipassIndirectCallCache(ZenRuntimeConfigRef Config,
+                                                   bool Enabled) {
+  unwrapConfigEx(Config)->EnableMultipassIndirectCallCache = Enabled;
+}
+
+void ZenRuntimeConfigSetNumRetainedVirtualStacks(ZenRuntimeConfigRef Config,
+                                                 uint32_t NumStacks) {
+  unwrapConfigEx(Config)->NumRetainedVirtualStacks =
+      NumStacks == 0 ? UINT32_MAX : NumStacks;
+}
+
+void ZenRuntimeConfigSetMultipassMaxRAFuncInstrs(ZenRuntimeConfigRef Config,
+                                                 uint32_t NumInstrs) {
+  unwrapConfigEx(Config)->MultipassMaxRAFuncInstrs = NumInstrs;
+}
+
+void ZenRuntimeConfigSetMultipassFuncBudgetMs(ZenRuntimeConfigRef Config,
+                                              uint32_t BudgetMs) {
+  unwrapConfigEx(Config)->MultipassFuncBudgetMs = BudgetMs;
+}
+
+void ZenRuntimeConfigSetWasmProfiler(ZenRuntimeConfigRef Config, bool Enabled,
+                                     uint32_t IntervalUs) {
+  ZenRuntimeConfigEx *ConfigEx = unwrapConfigEx(Config);
+  ConfigEx->EnableWasmProfiler = Enabled;
+  ConfigEx->WasmProfilerIntervalUs = IntervalUs;
+}
+
+void ZenRuntimeConfigSetWasmProfilerCallCounts(ZenRuntimeConfigRef Config,
+                                               bool Enabled) {
+  unwrapConfigEx(Config)->EnableWasmProfilerCallCounts = Enabled;
+}
+
+static void applyConfigEx(const ZenRuntimeConfigEx &ConfigEx,
+                          zen::runtime::RuntimeConfig &NewConfig) {
+  NewConfig.EnableModuleCache = ConfigEx.EnableModuleCache;
+  NewConfig.EnableLazyFunctionLoad = ConfigEx.EnableLazyFunctionLoad;
+#ifndef ZEN_ENABLE_SGX
+  NewConfig.NumValidationThreads = ConfigEx.NumValidationThreads;
+  NewConfig.NumWasmMemoryPoolSlots = ConfigEx.NumWasmMemoryPoolSlots;
+  NewConfig.EnableWasmMemoryImage = ConfigEx.EnableWasmMemoryImage;
+  NewConfig.EnableThreads = ConfigEx.EnableThreads;
+#endif // ZEN_ENABLE_SGX
+#ifdef ZEN_ENABLE_VIRTUAL_STACK
+  if (ConfigEx.NumRetainedVirtualStacks == UINT32_MAX) {
+    NewConfig.NumRetainedVirtualStacks = 0;
+  } else if (ConfigEx.NumRetainedVirtualStacks > 0) {
+    NewConfig.NumRetainedVirtualStacks = ConfigEx.NumRetainedVirtualStacks;
+  }
+#endif // ZEN_ENABLE_VIRTUAL_STACK
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+  NewConfig.EnableMultipassLazy = ConfigEx.EnableMultipassLazy;
+  NewConfig.DisableMultipassGreedyRA = ConfigEx.DisableMultipassGreedyRA;
+  NewConfig.EnableMultipassLinearScanRA = ConfigEx.EnableMultipassLinearScanRA;
+  NewConfig.DisableMultipassMultithread = ConfigEx.DisableMultipassMultithread;
+  if (ConfigEx.NumMultipassThreads > 0) {
+    NewConfig.NumMultipassThreads = ConfigEx.NumMultipassThreads;
+  }
+  if (ConfigEx.MultipassProfileDir) {
+    NewConfig.MultipassProfileDir = ConfigEx.MultipassProfileDir;
+  }
+  NewConfig.EnableMultipassIndirectCallCache =
+      ConfigEx.EnableMultipassIndirectCallCache;
+  NewConfig.MultipassMaxRAFuncInstrs = ConfigEx.MultipassMaxRAFuncInstrs;
+  NewConfig.MultipassFuncBudgetMs = ConfigEx.MultipassFuncBudgetMs;
+#endif // ZEN_ENABLE_MULTIPASS_JIT
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  NewConfig.EnableWasmProfiler = ConfigEx.EnableWasmProfiler;
+  if (ConfigEx.WasmProfilerIntervalUs > 0) {
+    NewConfig.WasmProfilerIntervalUs = ConfigEx.WasmProfilerIntervalUs;
+  }
+  NewConfig.EnableWasmProfilerCallCounts =
+      ConfigEx.EnableWasmProfilerCallCounts;
+#endif // ZEN_ENABLE_WASM_PROFILER
+}
+
 ZenRuntimeRef ZenCreateRuntime(ZenRuntimeConfig *Config) {
   zen::runtime::RuntimeConfig NewConfig;
   if (Config) {
@@ -149,6 +358,10 @@ ZenRuntimeRef ZenCreateRuntime(ZenRuntimeConfig *Config) {
 #endif
     NewConfig.EnableStatistics = Config->EnableStatistics;
     NewConfig.EnableGdbTracingHook = Config->EnableGdbTracingHook;
+    if (const ZenRuntimeConfigEx *ConfigEx = findConfigEx(Config)) {
+      applyConfigEx(*ConfigEx, NewConfig);
+    }
+
     using ZenRunModeCPP = zen::common::RunMode;
     switch (Config->Mode) {
     case ZenModeInterp:
@@ -174,6 +387,117 @@ void ZenDeleteRuntime(ZenRuntimeRef Runtime) {
   delete unwrap(Runtime);
 }
 
+static void fillPhaseStatistics(const zen::utils::StatisticHistogram &Hist,
+                                ZenPhaseStatistics &Phase) {
+  Phase.Count = Hist.Count;
+  Phase.TotalNs = Hist.TotalNs;
+  Phase.MaxNs = Hist.MaxNs;
+  Phase.P50Ns = Hist.getQuantile(0.5);
+  Phase.P90Ns = Hist.getQuantile(0.9);
+  Phase.P99Ns = Hist.getQuantile(0.99);
+}
+
+bool ZenGetRuntimeStatistics(ZenRuntimeRef Runtime,
+                             ZenStatisticsSnapshot *Snapshot) {
+  ZEN_ASSERT(Runtime);
+  ZEN_ASSERT(Snapshot);
+  using namespace zen::utils;
+  // The phases and counters are only appended to keep the layout of
+  // ZenStatisticsSnapshot
+  static_assert(ZenStatPhaseJITPassMCEmission + 1 ==
+                zen::common::to_underlying(StatisticPhase::NumStatisticPhases));
+  static_assert(
+      ZenStatCounterJITRegAllocDowngrades + 1 ==
+      zen::common::to_underlying(StatisticCounter::NumStatisticCounters));
+
+  std::memset(Snapshot, 0x0, sizeof(ZenStatisticsSnapshot));
+  Statistics &Stats = unwrap(Runtime)->getStatistics();
+  if (!Stats.isEnabled()) {
+    return false;
+  }
+
+  auto StatsSnapshot = std::make_unique<StatisticsSnapshot>();
+  Stats.snapshot(*StatsSnapshot);
+  for (uint32_t I = 0; I < ZenNumStatPhases; ++I) {
+    fillPhaseStatistics(StatsSnapshot->Phases[I], Snapshot->Phases[I]);
+  }
+  for (uint32_t I = 0; I < ZenNumStatCounters; ++I) {
+    Snapshot->Counters[I] = StatsSnapshot->Counters[I];
+  }
+  return true;
+}
+
+bool ZenGetRuntimePhaseStatistics(ZenRuntimeRef Runtime, ZenStatPhase Phase,
+                                  ZenPhaseStatistics *Stats) {
+  ZEN_ASSERT(Runtime);
+  ZEN_ASSERT(Stats);
+  using namespace zen::utils;
+  std::memset(Stats, 0x0, sizeof(ZenPhaseStatistics));
+  Statistics &RTStats = unwrap(Runtime)->getStatistics();
+  if (!RTStats.isEnabled() ||
+      static_cast<uint32_t>(Phase) >=
+          zen::common::to_underlying(StatisticPhase::NumStatisticPhases)) {
+    return false;
+  }
+
+  auto StatsSnapshot = std::make_unique<StatisticsSnapshot>();
+  RTStats.snapshot(*StatsSnapshot);
+  fillPhaseStatistics(StatsSnapshot->Phases[Phase], *Stats);
+  return true;
+}
+
+bool ZenGetRuntimeStatCounter(ZenRuntimeRef Runtime, ZenStatCounter Counter,
+                              uint64_t *Value) {
+  ZEN_ASSERT(Runtime);
+  ZEN_ASSERT(Value);
+  using namespace zen::utils;
+  *Value = 0;
+  Statistics &Stats = unwrap(Runtime)->getStatistics();
+  if (!Stats.isEnabled() ||
+      static_cast<uint32_t>(Counter) >=
+          zen::common::to_underlying(StatisticCounter::NumStatisticCounters)) {
+    return false;
+  }
+
+  auto StatsSnapshot = std::make_unique<StatisticsSnapshot>();
+  Stats.snapshot(*StatsSnapshot);
+  *Value = StatsSnapshot->Counters[Counter];
+  return true;
+}
+
+bool ZenWriteWasmProfile(ZenRuntimeRef Runtime, const char *Filename) {
+  ZEN_ASSERT(Runtime);
+  ZEN_ASSERT(Filename);
+#ifdef ZEN_ENABLE_WASM_PROFILER
+  zen::runtime::Runtime *RT = unwrap(Runtime);
+  zen::runtime::WasmProfiler *Profiler = RT->getWasmProfiler();
+  if (!Profiler) {
+    return false;
+  }
+  RT->stopWasmProfiler();
+  const std::string FoldedFilename(Filename);
+  if (!Profiler->writeFoldedStacks(FoldedFilename)) {
+    return false;
+  }
+  return !Profiler->isCountingCalls() ||
+         Profiler->writeCallCounts(FoldedFilename + ".calls");
+#else
+  return false;
+#endif // ZEN_ENABLE_WASM_PROFILER
+}
+
+uint32_t ZenDumpRuntimeStatistics(ZenRuntimeRef Runtime, char *OutBuf,
+                                  uint32_t OutBufSize) {
+  ZEN_ASSERT(Runtime);
+  const std::string &Text = unwrap(Runtime)->getStatistics().dumpPrometheus();
+  if (OutBuf && OutBufSize > 0) {
+    size_t CopySize = std::min<size_t>(Text.size(), OutBufSize - 1);
+    std::memcpy(OutBuf, Text.data(), CopySize);
+    OutBuf[CopySize] = '\0';
+  }
+  return static_cast<uint32_t>(Text.size());
+}
+
 bool ZenCallWasmMainFunc(ZenRuntimeRef Runtime, ZenInstanceRef Instance,
                          ZenValue OutResults[], uint32_t *NumOutResults) {
   ZEN_ASSERT(Runtime);
@@ -426,6 +750,22 @@ uint32_t ZenGetNumImportFunctions(ZenModuleRef Module) {
   return Mod->getNumImportFunctions();
 }
 
+uint32_t ZenGetRegAllocDowngradedFuncs(ZenModuleRef Module,
+                                       uint32_t *FuncIdxsOut,
+                                       uint32_t MaxNumFuncIdxs) {
+  ZEN_ASSERT(Module);
+  ZEN_ASSERT(FuncIdxsOut || MaxNumFuncIdxs == 0);
+#ifdef ZEN_ENABLE_MULTIPASS_JIT
+  zen::runtime::Module *Mod = unwrap(Module);
+  std::vector<uint32_t> FuncIdxs = Mod->getRegAllocDowngradedFuncs();
+  uint32_t NumFuncIdxs = std::min<uint32_t>(FuncIdxs.size(), MaxNumFuncIdxs);
+  std::copy_n(FuncIdxs.begin(), NumFuncIdxs, FuncIdxsOut);
+  return FuncIdxs.size();
+#else
+  return 0;
+#endif // ZEN_ENABLE_MULTIPASS_JIT
+}
+
 // ==================== Isolation ====================
 
 ZenIsolationRef ZenCreateIsolation(ZenRuntimeRef Runtime) {
@@ -534,6 +874,58 @@ uint32_t ZenGetAppMemOffset(ZenInstanceRef Instance, void *HostAddr) {
   return Inst->getMemoryOffset(HostAddr);
 }
 
+void *ZenGetAppMemSlice(ZenInstanceRef Instance, uint32_t Offset,
+                        uint32_t Size) {
+  ZEN_ASSERT(Instance);
+  zen::runtime::Instance *Inst = unwrap(Instance);
+  if (!Inst->validatedAppAddr(Offset, Size)) {
+    return nullptr;
+  }
+  return Inst->getNativeMemoryAddr(Offset);
+}
+
+static bool validateMemAccesses(zen::runtime::Instance *Inst,
+                                const ZenMemAccess Accesses[],
+                                uint32_t NumAccesses) {
+  ZEN_ASSERT(Accesses || NumAccesses == 0);
+  for (uint32_t I = 0; I < NumAccesses; ++I) {
+    if (!Inst->validatedAppAddr(Accesses[I].Offset, Accesses[I].Size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ZenReadAppMem(ZenInstanceRef Instance, const ZenMemAccess Accesses[],
+                   uint32_t NumAccesses) {
+  ZEN_ASSERT(Instance);
+  zen::runtime::Instance *Inst = unwrap(Instance);
+  if (!validateMemAccesses(Inst, Accesses, NumAccesses)) {
+    return false;
+  }
+  for (uint32_t I = 0; I < NumAccesses; ++I) {
+    const ZenMemAccess &Access = Accesses[I];
+    std::memcpy(Access.Data, Inst->getNativeMemoryAddr(Access.Offset),
+                Access.Size);
+  }
+  return true;
+}
+
+bool ZenWriteAppMem(ZenInstanceRef Instance, const ZenMemAccess Accesses[],
+                    uint32_t NumAccesses) {
+  ZEN_ASSERT(Instance);
+  zen::runtime::Instance *Inst = unwrap(Instance);
+  if (!validateMemAccesses(Inst, Accesses, NumAccesses)) {
+    return false;
+  }
+  for (uint32_t I = 0; I < NumAccesses; ++I) {
+    const ZenMemAccess &Access = Accesses[I];
+    std::memcpy(Inst->getNativeMemoryAddr(Access.Offset), Access.Data,
+                Access.Size);
+  }
+  return true;
+}
+
 void ZenSetInstanceCustomData(ZenInstanceRef Instance, void *CustomData) {
   ZEN_ASSERT(Instance);
   zen::runtime::Instance *Inst = unwrap(Instance);
@@ -598,6 +990,56 @@ void ZenInstanceProtectMemoryAgain(ZenInstanceRef Instance) {
   Inst->protectMemoryAgain();
 }
 
+// ==================== Block Executor ====================
+
+ZenBlockExecutorRef ZenCreateBlockExecutor(ZenRuntimeRef Runtime,
+                                           uint32_t NumWorkers,
+                                           bool PinWorkers) {
+  ZEN_ASSERT(Runtime);
+  zen::runtime::Runtime *RT = unwrap(Runtime);
+  return wrap(new zen::runtime::BlockExecutor(*RT, NumWorkers, PinWorkers));
+}
+
+void ZenDeleteBlockExecutor(ZenBlockExecutorRef Executor) {
+  delete unwrap(Executor);
+}
+
+uint32_t ZenGetBlockExecutorNumWorkers(ZenBlockExecutorRef Executor) {
+  ZEN_ASSERT(Executor);
+  return unwrap(Executor)->getNumWorkers();
+}
+
+void ZenExecuteBlock(ZenBlockExecutorRef Executor, const ZenExecJob Jobs[],
+                     ZenExecResult Results[], uint32_t NumJobs) {
+  ZEN_ASSERT(Executor);
+  zen::runtime::BlockExecutor *BlockExec = unwrap(Executor);
+
+  std::vector<zen::runtime::ExecJob> ExecJobs(NumJobs);
+  for (uint32_t I = 0; I < NumJobs; ++I) {
+    const ZenExecJob &InJob = Jobs[I];
+    zen::runtime::ExecJob &Job = ExecJobs[I];
+    ZEN_ASSERT(InJob.Module);
+    Job.Mod = unwrap(InJob.Module);
+    Job.FuncIdx = InJob.FuncIdx;
+    copyArgsIn(InJob.Args, InJob.NumArgs, Job.Args);
+    Job.GasLimit = InJob.GasLimit;
+  }
+
+  std::vector<zen::runtime::ExecResult> ExecResults =
+      BlockExec->executeBlock(ExecJobs);
+  for (uint32_t I = 0; I < NumJobs; ++I) {
+    const zen::runtime::ExecResult &Result = ExecResults[I];
+    ZenExecResult &OutResult = Results[I];
+    OutResult.Succeeded = Result.succeeded();
+    copyResultsOut(Result.Results, OutResult.Results, &OutResult.NumResults);
+    OutResult.GasLeft = Result.GasLeft;
+    if (!OutResult.Succeeded) {
+      const std::string &ErrMsg = Result.Err.getFormattedMessage();
+      setErrBuf(OutResult.ErrBuf, OutResult.ErrBufSize, ErrMsg.c_str());
+    }
+  }
+}
+
 // ==================== Others ====================
 
 void ZenEnableLogging() {
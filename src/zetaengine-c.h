@@ -36,6 +36,9 @@ typedef enum {
   ZenModeUnknown = 3,
 } ZenRunMode;
 
+// The layout is part of the ABI, callers may create the config by value, so
+// no field is appended. The other options are only set by the setters below
+// on the configs created by ZenCreateRuntimeConfig
 typedef struct ZenRuntimeConfig {
   // Run mode
   ZenRunMode Mode;
@@ -49,6 +52,56 @@ typedef struct ZenRuntimeConfig {
   bool EnableGdbTracingHook;
 } ZenRuntimeConfig;
 
+// Keep in sync with zen::utils::StatisticPhase
+typedef enum {
+  ZenStatPhaseLoad = 0,
+  ZenStatPhaseJITCompilation = 1,
+  ZenStatPhaseJITLazyPrecompilation = 2,
+  ZenStatPhaseJITLazyFgCompilation = 3,
+  ZenStatPhaseJITLazyBgCompilation = 4,
+  ZenStatPhaseJITLazyReleaseDelay = 5,
+  ZenStatPhaseMemoryBucketMap = 6,
+  ZenStatPhaseInstantiation = 7,
+  ZenStatPhaseExecution = 8,
+  // Number of the phases in ZenStatisticsSnapshot, the phases appended below
+  // are got by ZenGetRuntimePhaseStatistics
+  ZenNumStatPhases = 9,
+  // Passes of multipass JIT per function, nested in the compilation phases
+  ZenStatPhaseJITPassMIRBuilding = 9,
+  ZenStatPhaseJITPassCgIRLowering = 10,
+  ZenStatPhaseJITPassRegAllocAnalysis = 11,
+  ZenStatPhaseJITPassRegAlloc = 12,
+  ZenStatPhaseJITPassPostRA = 13,
+  ZenStatPhaseJITPassMCEmission = 14,
+} ZenStatPhase;
+
+// Keep in sync with zen::utils::StatisticCounter
+typedef enum {
+  ZenStatCounterGasUsed = 0,
+  ZenStatCounterTraps = 1,
+  ZenStatCounterMemoryGrows = 2,
+  ZenStatCounterMemoryGrowPages = 3,
+  // Number of the counters in ZenStatisticsSnapshot, the counters appended
+  // below are got by ZenGetRuntimeStatCounter
+  ZenNumStatCounters = 4,
+  ZenStatCounterJITCompiledFunctions = 4,
+  ZenStatCounterJITRegAllocDowngrades = 5,
+} ZenStatCounter;
+
+typedef struct ZenPhaseStatistics {
+  uint64_t Count;
+  uint64_t TotalNs;
+  uint64_t MaxNs;
+  uint64_t P50Ns;
+  uint64_t P90Ns;
+  uint64_t P99Ns;
+} ZenPhaseStatistics;
+
+typedef struct ZenStatisticsSnapshot {
+  ZenPhaseStatistics Phases[ZenNumStatPhases];
+  uint64_t Counters[ZenNumStatCounters];
+} ZenStatisticsSnapshot;
+
 typedef struct ZenRuntimeConfig *ZenRuntimeConfigRef;
 typedef struct ZenOpaqueRuntime *ZenRuntimeRef;
 typedef struct ZenOpaqueModule *ZenModuleRef;
@@ -56,6 +109,7 @@ typedef struct ZenOpaqueHostModuleDesc *ZenHostModuleDescRef;
 typedef struct ZenOpaqueHostModule *ZenHostModuleRef;
 typedef struct ZenOpaqueIsolation *ZenIsolationRef;
 typedef struct ZenOpaqueInstance *ZenInstanceRef;
+typedef struct ZenOpaqueBlockExecutor *ZenBlockExecutorRef;
 
 // ==================== Runtime ====================
 
@@ -65,6 +119,72 @@ void ZenDeleteRuntimeConfig(ZenRuntimeConfigRef Config);
 
 void ZenRuntimeConfigSetWasmMemoryMap(ZenRuntimeConfigRef Config, bool Enabled);
 
+// Setters of the options not in ZenRuntimeConfig, only for the configs created
+// by ZenCreateRuntimeConfig. The unset options keep the defaults of the
+// runtime, and the ones not supported by the build(e.g. multipass options
+// without multipass JIT) are ignored by ZenCreateRuntime
+
+void ZenRuntimeConfigSetWASI(ZenRuntimeConfigRef Config, bool Enabled);
+
+void ZenRuntimeConfigSetStatistics(ZenRuntimeConfigRef Config, bool Enabled);
+
+void ZenRuntimeConfigSetGdbTracingHook(ZenRuntimeConfigRef Config,
+                                       bool Enabled);
+
+void ZenRuntimeConfigSetModuleCache(ZenRuntimeConfigRef Config, bool Enabled);
+
+void ZenRuntimeConfigSetMultipassLazy(ZenRuntimeConfigRef Config,
+                                      bool Enabled);
+
+void ZenRuntimeConfigSetMultipassGreedyRA(ZenRuntimeConfigRef Config,
+                                          bool Enabled);
+
+void ZenRuntimeConfigSetMultipassLinearScanRA(ZenRuntimeConfigRef Config,
+                                              bool Enabled);
+
+/// \param NumThreads 0 to compile in the loading thread
+void ZenRuntimeConfigSetNumMultipassThreads(ZenRuntimeConfigRef Config,
+                                            uint32_t NumThreads);
+
+void ZenRuntimeConfigSetNumValidationThreads(ZenRuntimeConfigRef Config,
+                                             uint32_t NumThreads);
+
+void ZenRuntimeConfigSetNumWasmMemoryPoolSlots(ZenRuntimeConfigRef Config,
+                                               uint32_t NumSlots);
+
+void ZenRuntimeConfigSetWasmMemoryImage(ZenRuntimeConfigRef Config,
+                                        bool Enabled);
+
+void ZenRuntimeConfigSetThreads(ZenRuntimeConfigRef Config, bool Enabled);
+
+void ZenRuntimeConfigSetLazyFunctionLoad(ZenRuntimeConfigRef Config,
+                                         bool Enabled);
+
+/// \param Dir must be alive until ZenCreateRuntime, NULL to disable
+void ZenRuntimeConfigSetMultipassProfileDir(ZenRuntimeConfigRef Config,
+                                            const char *Dir);
+
+void ZenRuntimeConfigSetMultipassIndirectCallCache(ZenRuntimeConfigRef Config,
+                                                   bool Enabled);
+
+void ZenRuntimeConfigSetNumRetainedVirtualStacks(ZenRuntimeConfigRef Config,
+                                                 uint32_t NumStacks);
+
+/// \param NumInstrs 0 for unlimited
+void ZenRuntimeConfigSetMultipassMaxRAFuncInstrs(ZenRuntimeConfigRef Config,
+                                                 uint32_t NumInstrs);
+
+/// \param BudgetMs 0 for unlimited
+void ZenRuntimeConfigSetMultipassFuncBudgetMs(ZenRuntimeConfigRef Config,
+                                              uint32_t BudgetMs);
+
+/// \param IntervalUs sampling interval in microseconds, 0 keeps the default
+void ZenRuntimeConfigSetWasmProfiler(ZenRuntimeConfigRef Config, bool Enabled,
+                                     uint32_t IntervalUs);
+
+void ZenRuntimeConfigSetWasmProfilerCallCounts(ZenRuntimeConfigRef Config,
+                                               bool Enabled);
+
 ZenRuntimeRef ZenCreateRuntime(ZenRuntimeConfig *Config);
 
 void ZenDeleteRuntime(ZenRuntimeRef Runtime);
@@ -82,6 +202,36 @@ bool ZenCallWasmFuncByIdx(ZenRuntimeRef Runtime, ZenInstanceRef Instance,
                           uint32_t NumInArgs, ZenValue OutResults[],
                           uint32_t *NumOutResults);
 
+/// \brief aggregate the statistics recorded by all threads so far
+/// \return false if statistics not enabled in runtime config
+bool ZenGetRuntimeStatistics(ZenRuntimeRef Runtime,
+                             ZenStatisticsSnapshot *Snapshot);
+
+/// \brief aggregate the statistics of one phase recorded by all threads so
+/// far, including the phases not in ZenStatisticsSnapshot
+/// \return false if statistics not enabled in runtime config or the phase is
+/// unknown
+bool ZenGetRuntimePhaseStatistics(ZenRuntimeRef Runtime, ZenStatPhase Phase,
+                                  ZenPhaseStatistics *Stats);
+
+/// \brief aggregate one counter recorded by all threads so far, including the
+/// counters not in ZenStatisticsSnapshot
+/// \return false if statistics not enabled in runtime config or the counter
+/// is unknown
+bool ZenGetRuntimeStatCounter(ZenRuntimeRef Runtime, ZenStatCounter Counter,
+                              uint64_t *Value);
+
+/// \brief stop the wasm profiler and write the folded stacks(flamegraph.pl
+/// input) to Filename, and the call counts to <Filename>.calls if collected
+/// \return false if wasm profiler not enabled or the files can't be written
+bool ZenWriteWasmProfile(ZenRuntimeRef Runtime, const char *Filename);
+
+/// \brief dump the statistics in Prometheus text format to OutBuf
+/// (nul-terminated, truncated if OutBufSize is too small)
+/// \return the length of the whole text excluding the terminating nul
+uint32_t ZenDumpRuntimeStatistics(ZenRuntimeRef Runtime, char *OutBuf,
+                                  uint32_t OutBufSize);
+
 // ==================== Host Module ====================
 
 typedef struct ZenHostFuncDesc {
@@ -144,6 +294,16 @@ bool ZenGetImportFuncName(ZenModuleRef Module, uint32_t FuncIdx,
 
 uint32_t ZenGetNumImportFunctions(ZenModuleRef Module);
 
+/// \brief get the functions whose register allocation was downgraded by
+/// the size threshold or the compile time budget of multipass JIT, in
+/// ascending order of function index
+/// \param FuncIdxsOut receives at most MaxNumFuncIdxs function indexes
+/// \return the number of the downgraded functions, which may be larger than
+/// MaxNumFuncIdxs
+uint32_t ZenGetRegAllocDowngradedFuncs(ZenModuleRef Module,
+                                       uint32_t *FuncIdxsOut,
+                                       uint32_t MaxNumFuncIdxs);
+
 // ==================== Isolation ====================
 
 ZenIsolationRef ZenCreateIsolation(ZenRuntimeRef Runtime);
@@ -179,6 +339,33 @@ void *ZenGetHostMemAddr(ZenInstanceRef Instance, uint32_t Offset);
 
 uint32_t ZenGetAppMemOffset(ZenInstanceRef Instance, void *HostAddr);
 
+/// \brief validate [Offset, Offset + Size) of the linear memory and get its
+/// host address in one call, the view is invalidated by memory.grow
+/// \return NULL if out of bounds, then the instance has the OutOfBoundsMemory
+/// error like ZenValidateAppMemAddr
+void *ZenGetAppMemSlice(ZenInstanceRef Instance, uint32_t Offset,
+                        uint32_t Size);
+
+typedef struct ZenMemAccess {
+  // Range of the linear memory
+  uint32_t Offset;
+  uint32_t Size;
+  // Host buffer of Size bytes, read from by ZenWriteAppMem
+  void *Data;
+} ZenMemAccess;
+
+/// \brief copy the linear memory ranges to the host buffers
+/// \return false without copying anything if any range is out of bounds, then
+/// the instance has the OutOfBoundsMemory error
+bool ZenReadAppMem(ZenInstanceRef Instance, const ZenMemAccess Accesses[],
+                   uint32_t NumAccesses);
+
+/// \brief copy the host buffers to the linear memory ranges in order
+/// \return false without copying anything if any range is out of bounds, then
+/// the instance has the OutOfBoundsMemory error
+bool ZenWriteAppMem(ZenInstanceRef Instance, const ZenMemAccess Accesses[],
+                    uint32_t NumAccesses);
+
 void ZenSetInstanceCustomData(ZenInstanceRef Instance, void *CustomData);
 
 void *ZenGetInstanceCustomData(ZenInstanceRef Instance);
@@ -203,6 +390,49 @@ int32_t ZenGetInstanceExitCode(ZenInstanceRef Instance);
 // need enable it again
 void ZenInstanceProtectMemoryAgain(ZenInstanceRef Instance);
 
+// ==================== Block Executor ====================
+
+typedef struct ZenExecJob {
+  // Must stay loaded until the block is finished
+  ZenModuleRef Module;
+  uint32_t FuncIdx;
+  const ZenValue *Args;
+  uint32_t NumArgs;
+  uint64_t GasLimit;
+} ZenExecJob;
+
+typedef struct ZenExecResult {
+  bool Succeeded;
+  // Buffer provided by the caller, large enough for the function results
+  ZenValue *Results;
+  uint32_t NumResults;
+  // Gas left when the call returned or trapped
+  uint64_t GasLeft;
+  // Receives the error message if not succeeded(NULL to ignore)
+  char *ErrBuf;
+  uint32_t ErrBufSize;
+} ZenExecResult;
+
+/// \brief create a fixed pool of worker threads running the independent calls
+/// of a block, each in a fresh instance, with the same results as running them
+/// one by one
+/// \param NumWorkers 0 means the number of hardware threads
+/// \param PinWorkers bind worker I to CPU I(modulo the CPU count), only
+/// supported on Linux
+ZenBlockExecutorRef ZenCreateBlockExecutor(ZenRuntimeRef Runtime,
+                                           uint32_t NumWorkers,
+                                           bool PinWorkers);
+
+void ZenDeleteBlockExecutor(ZenBlockExecutorRef Executor);
+
+uint32_t ZenGetBlockExecutorNumWorkers(ZenBlockExecutorRef Executor);
+
+/// \brief run all jobs and wait for them to finish, Results[I] receives the
+/// result of Jobs[I]
+/// \warning not thread-safe, blocks must be executed one at a time
+void ZenExecuteBlock(ZenBlockExecutorRef Executor, const ZenExecJob Jobs[],
+                     ZenExecResult Results[], uint32_t NumJobs);
+
 // ==================== Others ====================
 
 // Warning: these two function can only be called for testing purpose, please
@@ -0,0 +1,231 @@
+;; ABI encoding of dynamic bytes arguments(head offsets, length words, data
+;; padded to 32 bytes), dominated by memory copies. The source bytes are at
+;; address 0, the encoding is written from 65536
+(module
+  (memory 2)
+  (func $nop (export "nop"))
+  (func $memcpy (param $dst i32) (param $src i32) (param $len i32)
+    block $words_done
+      loop $words
+        local.get $len
+        i32.const 8
+        i32.lt_u
+        br_if $words_done
+        local.get $dst
+        local.get $src
+        i64.load
+        i64.store
+        local.get $dst
+        i32.const 8
+        i32.add
+        local.set $dst
+        local.get $src
+        i32.const 8
+        i32.add
+        local.set $src
+        local.get $len
+        i32.const 8
+        i32.sub
+        local.set $len
+        br $words
+      end
+    end
+    block $bytes_done
+      loop $bytes
+        local.get $len
+        i32.eqz
+        br_if $bytes_done
+        local.get $dst
+        local.get $src
+        i32.load8_u
+        i32.store8
+        local.get $dst
+        i32.const 1
+        i32.add
+        local.set $dst
+        local.get $src
+        i32.const 1
+        i32.add
+        local.set $src
+        local.get $len
+        i32.const 1
+        i32.sub
+        local.set $len
+        br $bytes
+      end
+    end)
+  (func $memzero (param $dst i32) (param $len i32)
+    block $words_done
+      loop $words
+        local.get $len
+        i32.const 8
+        i32.lt_u
+        br_if $words_done
+        local.get $dst
+        i64.const 0
+        i64.store
+        local.get $dst
+        i32.const 8
+        i32.add
+        local.set $dst
+        local.get $len
+        i32.const 8
+        i32.sub
+        local.set $len
+        br $words
+      end
+    end
+    block $bytes_done
+      loop $bytes
+        local.get $len
+        i32.eqz
+        br_if $bytes_done
+        local.get $dst
+        i32.const 0
+        i32.store8
+        local.get $dst
+        i32.const 1
+        i32.add
+        local.set $dst
+        local.get $len
+        i32.const 1
+        i32.sub
+        local.set $len
+        br $bytes
+      end
+    end)
+  ;; 32-byte big-endian word
+  (func $put_u32 (param $dst i32) (param $v i32)
+    local.get $dst
+    i32.const 28
+    call $memzero
+    local.get $dst
+    local.get $v
+    i32.const 24
+    i32.shr_u
+    i32.store8 offset=28
+    local.get $dst
+    local.get $v
+    i32.const 16
+    i32.shr_u
+    i32.store8 offset=29
+    local.get $dst
+    local.get $v
+    i32.const 8
+    i32.shr_u
+    i32.store8 offset=30
+    local.get $dst
+    local.get $v
+    i32.store8 offset=31)
+  ;; encode 16 dynamic bytes arguments, returns the encoded size
+  (func $encode (param $seed i32) (result i32)
+    (local $arg i32) (local $len i32) (local $head i32) (local $tail i32)
+    (local $padded i32)
+    i32.const 65536
+    local.set $head
+    i32.const 512
+    local.set $tail
+    loop $args
+      local.get $seed
+      local.get $arg
+      i32.const 37
+      i32.mul
+      i32.add
+      i32.const 97
+      i32.rem_u
+      i32.const 8
+      i32.mul
+      i32.const 1
+      i32.add
+      local.set $len
+      local.get $head
+      local.get $tail
+      call $put_u32
+      local.get $tail
+      i32.const 65536
+      i32.add
+      local.get $len
+      call $put_u32
+      local.get $tail
+      i32.const 65568
+      i32.add
+      local.get $arg
+      i32.const 61
+      i32.mul
+      i32.const 2048
+      i32.rem_u
+      local.get $len
+      call $memcpy
+      local.get $len
+      i32.const 31
+      i32.add
+      i32.const -32
+      i32.and
+      local.set $padded
+      local.get $tail
+      i32.const 65568
+      i32.add
+      local.get $len
+      i32.add
+      local.get $padded
+      local.get $len
+      i32.sub
+      call $memzero
+      local.get $tail
+      i32.const 32
+      i32.add
+      local.get $padded
+      i32.add
+      local.set $tail
+      local.get $head
+      i32.const 32
+      i32.add
+      local.set $head
+      local.get $arg
+      i32.const 1
+      i32.add
+      local.tee $arg
+      i32.const 16
+      i32.ne
+      br_if $args
+    end
+    local.get $tail)
+  ;; run n encodings, returns the total encoded size
+  (func (export "encode") (param $n i32) (result i32)
+    (local $i i32) (local $total i32)
+    loop $fill
+      local.get $i
+      local.get $i
+      i32.const 131
+      i32.mul
+      i32.store8
+      local.get $i
+      i32.const 1
+      i32.add
+      local.tee $i
+      i32.const 4096
+      i32.ne
+      br_if $fill
+    end
+    i32.const 0
+    local.set $i
+    block $done
+      loop $next
+        local.get $i
+        local.get $n
+        i32.ge_u
+        br_if $done
+        local.get $total
+        local.get $i
+        call $encode
+        i32.add
+        local.set $total
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $next
+      end
+    end
+    local.get $total)
+)
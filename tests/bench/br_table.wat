@@ -0,0 +1,451 @@
+;; br_table dispatch over 16, 64 and 256 distinct cases, the selector is
+;; spread by a multiplicative hash so the branch predictor can't learn it
+(module
+  (func $nop (export "nop"))
+  (func $select16 (param $sel i32) (result i32)
+    block block block block block block block block
+    block block block block block block block block
+    local.get $sel
+    br_table 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 15
+    end i32.const 1 return
+    end i32.const 2 return
+    end i32.const 3 return
+    end i32.const 4 return
+    end i32.const 5 return
+    end i32.const 6 return
+    end i32.const 7 return
+    end i32.const 8 return
+    end i32.const 9 return
+    end i32.const 10 return
+    end i32.const 11 return
+    end i32.const 12 return
+    end i32.const 13 return
+    end i32.const 14 return
+    end i32.const 15 return
+    end i32.const 16 return
+  )
+  (func $select64 (param $sel i32) (result i32)
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    local.get $sel
+    br_table 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24
+      25 26 27 28 29 30 31 32 33 34 35 36 37 38 39 40 41 42 43 44 45 46 47 48
+      49 50 51 52 53 54 55 56 57 58 59 60 61 62 63 63
+    end i32.const 1 return
+    end i32.const 2 return
+    end i32.const 3 return
+    end i32.const 4 return
+    end i32.const 5 return
+    end i32.const 6 return
+    end i32.const 7 return
+    end i32.const 8 return
+    end i32.const 9 return
+    end i32.const 10 return
+    end i32.const 11 return
+    end i32.const 12 return
+    end i32.const 13 return
+    end i32.const 14 return
+    end i32.const 15 return
+    end i32.const 16 return
+    end i32.const 17 return
+    end i32.const 18 return
+    end i32.const 19 return
+    end i32.const 20 return
+    end i32.const 21 return
+    end i32.const 22 return
+    end i32.const 23 return
+    end i32.const 24 return
+    end i32.const 25 return
+    end i32.const 26 return
+    end i32.const 27 return
+    end i32.const 28 return
+    end i32.const 29 return
+    end i32.const 30 return
+    end i32.const 31 return
+    end i32.const 32 return
+    end i32.const 33 return
+    end i32.const 34 return
+    end i32.const 35 return
+    end i32.const 36 return
+    end i32.const 37 return
+    end i32.const 38 return
+    end i32.const 39 return
+    end i32.const 40 return
+    end i32.const 41 return
+    end i32.const 42 return
+    end i32.const 43 return
+    end i32.const 44 return
+    end i32.const 45 return
+    end i32.const 46 return
+    end i32.const 47 return
+    end i32.const 48 return
+    end i32.const 49 return
+    end i32.const 50 return
+    end i32.const 51 return
+    end i32.const 52 return
+    end i32.const 53 return
+    end i32.const 54 return
+    end i32.const 55 return
+    end i32.const 56 return
+    end i32.const 57 return
+    end i32.const 58 return
+    end i32.const 59 return
+    end i32.const 60 return
+    end i32.const 61 return
+    end i32.const 62 return
+    end i32.const 63 return
+    end i32.const 64 return
+  )
+  (func $select256 (param $sel i32) (result i32)
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    block block block block block block block block
+    local.get $sel
+    br_table 0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24
+      25 26 27 28 29 30 31 32 33 34 35 36 37 38 39 40 41 42 43 44 45 46 47 48
+      49 50 51 52 53 54 55 56 57 58 59 60 61 62 63 64 65 66 67 68 69 70 71 72
+      73 74 75 76 77 78 79 80 81 82 83 84 85 86 87 88 89 90 91 92 93 94 95 96
+      97 98 99 100 101 102 103 104 105 106 107 108 109 110 111 112 113 114 115
+      116 117 118 119 120 121 122 123 124 125 126 127 128 129 130 131 132 133
+      134 135 136 137 138 139 140 141 142 143 144 145 146 147 148 149 150 151
+      152 153 154 155 156 157 158 159 160 161 162 163 164 165 166 167 168 169
+      170 171 172 173 174 175 176 177 178 179 180 181 182 183 184 185 186 187
+      188 189 190 191 192 193 194 195 196 197 198 199 200 201 202 203 204 205
+      206 207 208 209 210 211 212 213 214 215 216 217 218 219 220 221 222 223
+      224 225 226 227 228 229 230 231 232 233 234 235 236 237 238 239 240 241
+      242 243 244 245 246 247 248 249 250 251 252 253 254 255 255
+    end i32.const 1 return
+    end i32.const 2 return
+    end i32.const 3 return
+    end i32.const 4 return
+    end i32.const 5 return
+    end i32.const 6 return
+    end i32.const 7 return
+    end i32.const 8 return
+    end i32.const 9 return
+    end i32.const 10 return
+    end i32.const 11 return
+    end i32.const 12 return
+    end i32.const 13 return
+    end i32.const 14 return
+    end i32.const 15 return
+    end i32.const 16 return
+    end i32.const 17 return
+    end i32.const 18 return
+    end i32.const 19 return
+    end i32.const 20 return
+    end i32.const 21 return
+    end i32.const 22 return
+    end i32.const 23 return
+    end i32.const 24 return
+    end i32.const 25 return
+    end i32.const 26 return
+    end i32.const 27 return
+    end i32.const 28 return
+    end i32.const 29 return
+    end i32.const 30 return
+    end i32.const 31 return
+    end i32.const 32 return
+    end i32.const 33 return
+    end i32.const 34 return
+    end i32.const 35 return
+    end i32.const 36 return
+    end i32.const 37 return
+    end i32.const 38 return
+    end i32.const 39 return
+    end i32.const 40 return
+    end i32.const 41 return
+    end i32.const 42 return
+    end i32.const 43 return
+    end i32.const 44 return
+    end i32.const 45 return
+    end i32.const 46 return
+    end i32.const 47 return
+    end i32.const 48 return
+    end i32.const 49 return
+    end i32.const 50 return
+    end i32.const 51 return
+    end i32.const 52 return
+    end i32.const 53 return
+    end i32.const 54 return
+    end i32.const 55 return
+    end i32.const 56 return
+    end i32.const 57 return
+    end i32.const 58 return
+    end i32.const 59 return
+    end i32.const 60 return
+    end i32.const 61 return
+    end i32.const 62 return
+    end i32.const 63 return
+    end i32.const 64 return
+    end i32.const 65 return
+    end i32.const 66 return
+    end i32.const 67 return
+    end i32.const 68 return
+    end i32.const 69 return
+    end i32.const 70 return
+    end i32.const 71 return
+    end i32.const 72 return
+    end i32.const 73 return
+    end i32.const 74 return
+    end i32.const 75 return
+    end i32.const 76 return
+    end i32.const 77 return
+    end i32.const 78 return
+    end i32.const 79 return
+    end i32.const 80 return
+    end i32.const 81 return
+    end i32.const 82 return
+    end i32.const 83 return
+    end i32.const 84 return
+    end i32.const 85 return
+    end i32.const 86 return
+    end i32.const 87 return
+    end i32.const 88 return
+    end i32.const 89 return
+    end i32.const 90 return
+    end i32.const 91 return
+    end i32.const 92 return
+    end i32.const 93 return
+    end i32.const 94 return
+    end i32.const 95 return
+    end i32.const 96 return
+    end i32.const 97 return
+    end i32.const 98 return
+    end i32.const 99 return
+    end i32.const 100 return
+    end i32.const 101 return
+    end i32.const 102 return
+    end i32.const 103 return
+    end i32.const 104 return
+    end i32.const 105 return
+    end i32.const 106 return
+    end i32.const 107 return
+    end i32.const 108 return
+    end i32.const 109 return
+    end i32.const 110 return
+    end i32.const 111 return
+    end i32.const 112 return
+    end i32.const 113 return
+    end i32.const 114 return
+    end i32.const 115 return
+    end i32.const 116 return
+    end i32.const 117 return
+    end i32.const 118 return
+    end i32.const 119 return
+    end i32.const 120 return
+    end i32.const 121 return
+    end i32.const 122 return
+    end i32.const 123 return
+    end i32.const 124 return
+    end i32.const 125 return
+    end i32.const 126 return
+    end i32.const 127 return
+    end i32.const 128 return
+    end i32.const 129 return
+    end i32.const 130 return
+    end i32.const 131 return
+    end i32.const 132 return
+    end i32.const 133 return
+    end i32.const 134 return
+    end i32.const 135 return
+    end i32.const 136 return
+    end i32.const 137 return
+    end i32.const 138 return
+    end i32.const 139 return
+    end i32.const 140 return
+    end i32.const 141 return
+    end i32.const 142 return
+    end i32.const 143 return
+    end i32.const 144 return
+    end i32.const 145 return
+    end i32.const 146 return
+    end i32.const 147 return
+    end i32.const 148 return
+    end i32.const 149 return
+    end i32.const 150 return
+    end i32.const 151 return
+    end i32.const 152 return
+    end i32.const 153 return
+    end i32.const 154 return
+    end i32.const 155 return
+    end i32.const 156 return
+    end i32.const 157 return
+    end i32.const 158 return
+    end i32.const 159 return
+    end i32.const 160 return
+    end i32.const 161 return
+    end i32.const 162 return
+    end i32.const 163 return
+    end i32.const 164 return
+    end i32.const 165 return
+    end i32.const 166 return
+    end i32.const 167 return
+    end i32.const 168 return
+    end i32.const 169 return
+    end i32.const 170 return
+    end i32.const 171 return
+    end i32.const 172 return
+    end i32.const 173 return
+    end i32.const 174 return
+    end i32.const 175 return
+    end i32.const 176 return
+    end i32.const 177 return
+    end i32.const 178 return
+    end i32.const 179 return
+    end i32.const 180 return
+    end i32.const 181 return
+    end i32.const 182 return
+    end i32.const 183 return
+    end i32.const 184 return
+    end i32.const 185 return
+    end i32.const 186 return
+    end i32.const 187 return
+    end i32.const 188 return
+    end i32.const 189 return
+    end i32.const 190 return
+    end i32.const 191 return
+    end i32.const 192 return
+    end i32.const 193 return
+    end i32.const 194 return
+    end i32.const 195 return
+    end i32.const 196 return
+    end i32.const 197 return
+    end i32.const 198 return
+    end i32.const 199 return
+    end i32.const 200 return
+    end i32.const 201 return
+    end i32.const 202 return
+    end i32.const 203 return
+    end i32.const 204 return
+    end i32.const 205 return
+    end i32.const 206 return
+    end i32.const 207 return
+    end i32.const 208 return
+    end i32.const 209 return
+    end i32.const 210 return
+    end i32.const 211 return
+    end i32.const 212 return
+    end i32.const 213 return
+    end i32.const 214 return
+    end i32.const 215 return
+    end i32.const 216 return
+    end i32.const 217 return
+    end i32.const 218 return
+    end i32.const 219 return
+    end i32.const 220 return
+    end i32.const 221 return
+    end i32.const 222 return
+    end i32.const 223 return
+    end i32.const 224 return
+    end i32.const 225 return
+    end i32.const 226 return
+    end i32.const 227 return
+    end i32.const 228 return
+    end i32.const 229 return
+    end i32.const 230 return
+    end i32.const 231 return
+    end i32.const 232 return
+    end i32.const 233 return
+    end i32.const 234 return
+    end i32.const 235 return
+    end i32.const 236 return
+    end i32.const 237 return
+    end i32.const 238 return
+    end i32.const 239 return
+    end i32.const 240 return
+    end i32.const 241 return
+    end i32.const 242 return
+    end i32.const 243 return
+    end i32.const 244 return
+    end i32.const 245 return
+    end i32.const 246 return
+    end i32.const 247 return
+    end i32.const 248 return
+    end i32.const 249 return
+    end i32.const 250 return
+    end i32.const 251 return
+    end i32.const 252 return
+    end i32.const 253 return
+    end i32.const 254 return
+    end i32.const 255 return
+    end i32.const 256 return
+  )
+  (func (export "dispatch16") (param $n i32) (result i32)
+    (local $i i32)
+    (local $acc i32)
+    (block $done
+      (loop $loop
+        (br_if $done (i32.ge_u (local.get $i) (local.get $n)))
+        (local.set $acc
+          (i32.add (local.get $acc)
+            (call $select16
+              (i32.shr_u (i32.mul (local.get $i) (i32.const 0x9e3779b1))
+                         (i32.const 28)))))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $loop)))
+    (local.get $acc))
+  (func (export "dispatch64") (param $n i32) (result i32)
+    (local $i i32)
+    (local $acc i32)
+    (block $done
+      (loop $loop
+        (br_if $done (i32.ge_u (local.get $i) (local.get $n)))
+        (local.set $acc
+          (i32.add (local.get $acc)
+            (call $select64
+              (i32.shr_u (i32.mul (local.get $i) (i32.const 0x9e3779b1))
+                         (i32.const 26)))))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $loop)))
+    (local.get $acc))
+  (func (export "dispatch256") (param $n i32) (result i32)
+    (local $i i32)
+    (local $acc i32)
+    (block $done
+      (loop $loop
+        (br_if $done (i32.ge_u (local.get $i) (local.get $n)))
+        (local.set $acc
+          (i32.add (local.get $acc)
+            (call $select256
+              (i32.shr_u (i32.mul (local.get $i) (i32.const 0x9e3779b1))
+                         (i32.const 24)))))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $loop)))
+    (local.get $acc))
+)
@@ -0,0 +1,58 @@
+;; call_indirect dispatch over a table of 32 functions, the mask selects
+;; how many of them a site calls: 0 for a monomorphic site, 31 for a
+;; megamorphic one
+(module
+  (type $unary (func (param i32) (result i32)))
+  (table 32 funcref)
+  (elem (i32.const 0)
+    $add1 $add2 $add3 $add4 $add5 $add6 $add7 $add8 $add9 $add10 $add11 $add12
+    $add13 $add14 $add15 $add16 $add17 $add18 $add19 $add20 $add21 $add22
+    $add23 $add24 $add25 $add26 $add27 $add28 $add29 $add30 $add31 $add32)
+  (func $add1 (type $unary) (i32.add (local.get 0) (i32.const 1)))
+  (func $add2 (type $unary) (i32.add (local.get 0) (i32.const 2)))
+  (func $add3 (type $unary) (i32.add (local.get 0) (i32.const 3)))
+  (func $add4 (type $unary) (i32.add (local.get 0) (i32.const 4)))
+  (func $add5 (type $unary) (i32.add (local.get 0) (i32.const 5)))
+  (func $add6 (type $unary) (i32.add (local.get 0) (i32.const 6)))
+  (func $add7 (type $unary) (i32.add (local.get 0) (i32.const 7)))
+  (func $add8 (type $unary) (i32.add (local.get 0) (i32.const 8)))
+  (func $add9 (type $unary) (i32.add (local.get 0) (i32.const 9)))
+  (func $add10 (type $unary) (i32.add (local.get 0) (i32.const 10)))
+  (func $add11 (type $unary) (i32.add (local.get 0) (i32.const 11)))
+  (func $add12 (type $unary) (i32.add (local.get 0) (i32.const 12)))
+  (func $add13 (type $unary) (i32.add (local.get 0) (i32.const 13)))
+  (func $add14 (type $unary) (i32.add (local.get 0) (i32.const 14)))
+  (func $add15 (type $unary) (i32.add (local.get 0) (i32.const 15)))
+  (func $add16 (type $unary) (i32.add (local.get 0) (i32.const 16)))
+  (func $add17 (type $unary) (i32.add (local.get 0) (i32.const 17)))
+  (func $add18 (type $unary) (i32.add (local.get 0) (i32.const 18)))
+  (func $add19 (type $unary) (i32.add (local.get 0) (i32.const 19)))
+  (func $add20 (type $unary) (i32.add (local.get 0) (i32.const 20)))
+  (func $add21 (type $unary) (i32.add (local.get 0) (i32.const 21)))
+  (func $add22 (type $unary) (i32.add (local.get 0) (i32.const 22)))
+  (func $add23 (type $unary) (i32.add (local.get 0) (i32.const 23)))
+  (func $add24 (type $unary) (i32.add (local.get 0) (i32.const 24)))
+  (func $add25 (type $unary) (i32.add (local.get 0) (i32.const 25)))
+  (func $add26 (type $unary) (i32.add (local.get 0) (i32.const 26)))
+  (func $add27 (type $unary) (i32.add (local.get 0) (i32.const 27)))
+  (func $add28 (type $unary) (i32.add (local.get 0) (i32.const 28)))
+  (func $add29 (type $unary) (i32.add (local.get 0) (i32.const 29)))
+  (func $add30 (type $unary) (i32.add (local.get 0) (i32.const 30)))
+  (func $add31 (type $unary) (i32.add (local.get 0) (i32.const 31)))
+  (func $add32 (type $unary) (i32.add (local.get 0) (i32.const 32)))
+  (func $nop (export "nop"))
+  (func $dispatch (export "dispatch") (param $n i32) (param $mask i32)
+    (result i32)
+    (local $i i32)
+    (local $acc i32)
+    (block $done
+      (loop $loop
+        (br_if $done (i32.ge_u (local.get $i) (local.get $n)))
+        (local.set $acc
+          (call_indirect (type $unary)
+            (local.get $acc)
+            (i32.and (local.get $i) (local.get $mask))))
+        (local.set $i (i32.add (local.get $i) (i32.const 1)))
+        (br $loop)))
+    (local.get $acc))
+)
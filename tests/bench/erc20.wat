@@ -0,0 +1,124 @@
+;; ERC-20 style token transfers over a storage map kept in linear memory(open
+;; addressing, 4096 slots of (key, value) from address 0)
+(module
+  (memory 2)
+  (func $nop (export "nop"))
+  (func $slot (param $key i64) (result i32)
+    (local $addr i32) (local $k i64)
+    local.get $key
+    i64.const 0x9E3779B97F4A7C15
+    i64.mul
+    i64.const 52
+    i64.shr_u
+    i32.wrap_i64
+    i32.const 4
+    i32.shl
+    local.set $addr
+    block $found
+      loop $probe
+        local.get $addr
+        i64.load
+        local.tee $k
+        local.get $key
+        i64.eq
+        br_if $found
+        local.get $k
+        i64.eqz
+        br_if $found
+        local.get $addr
+        i32.const 16
+        i32.add
+        i32.const 65535
+        i32.and
+        local.set $addr
+        br $probe
+      end
+    end
+    local.get $addr)
+  (func $sload (param $key i64) (result i64)
+    (local $addr i32)
+    local.get $key
+    call $slot
+    local.tee $addr
+    i64.load
+    i64.eqz
+    if (result i64)
+      i64.const 0
+    else
+      local.get $addr
+      i64.load offset=8
+    end)
+  (func $sstore (param $key i64) (param $value i64)
+    (local $addr i32)
+    local.get $key
+    call $slot
+    local.tee $addr
+    local.get $key
+    i64.store
+    local.get $addr
+    local.get $value
+    i64.store offset=8)
+  ;; mint to account 1, then run n transfers, returns the balance of account 1
+  (func (export "transfers") (param $n i32) (result i64)
+    (local $i i32) (local $from i64) (local $to i64) (local $amount i64)
+    (local $bal i64)
+    i64.const 1
+    i64.const 1000000000000
+    call $sstore
+    block $done
+      loop $next
+        local.get $i
+        local.get $n
+        i32.ge_u
+        br_if $done
+        local.get $i
+        i32.const 64
+        i32.rem_u
+        i32.const 1
+        i32.add
+        i64.extend_i32_u
+        local.set $from
+        local.get $i
+        i32.const 7
+        i32.mul
+        i32.const 1000
+        i32.rem_u
+        i32.const 1
+        i32.add
+        i64.extend_i32_u
+        local.set $to
+        local.get $i
+        i32.const 100
+        i32.rem_u
+        i32.const 1
+        i32.add
+        i64.extend_i32_u
+        local.set $amount
+        local.get $from
+        call $sload
+        local.tee $bal
+        local.get $amount
+        i64.ge_u
+        if
+          local.get $from
+          local.get $bal
+          local.get $amount
+          i64.sub
+          call $sstore
+          local.get $to
+          local.get $to
+          call $sload
+          local.get $amount
+          i64.add
+          call $sstore
+        end
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $next
+      end
+    end
+    i64.const 1
+    call $sload)
+)
@@ -0,0 +1,215 @@
+;; Keccak-f[1600] permutations, the state is kept at address 0 across calls
+(module
+  (memory 1)
+  ;; round constants
+  (data (i32.const 1024) "\01\00\00\00\00\00\00\00\82\80\00\00\00\00\00\00\8a\80\00\00\00\00\00\80\00\80\00\80\00\00\00\80\8b\80\00\00\00\00\00\00\01\00\00\80\00\00\00\00\81\80\00\80\00\00\00\80\09\80\00\00\00\00\00\80\8a\00\00\00\00\00\00\00\88\00\00\00\00\00\00\00\09\80\00\80\00\00\00\00\0a\00\00\80\00\00\00\00\8b\80\00\80\00\00\00\00\8b\00\00\00\00\00\00\80\89\80\00\00\00\00\00\80\03\80\00\00\00\00\00\80\02\80\00\00\00\00\00\80\80\00\00\00\00\00\00\80\0a\80\00\00\00\00\00\00\0a\00\00\80\00\00\00\80\81\80\00\80\00\00\00\80\80\80\00\00\00\00\00\80\01\00\00\80\00\00\00\00\08\80\00\80\00\00\00\80")
+  ;; rotation offsets of lane x+5y
+  (data (i32.const 1280) "\00\01\3e\1c\1b\24\2c\06\37\14\03\0a\2b\19\27\29\2d\0f\15\08\12\02\3d\38\0e")
+  ;; destination lane of lane x+5y in the pi step
+  (data (i32.const 1312) "\00\0a\14\05\0f\10\01\0b\15\06\07\11\02\0c\16\17\08\12\03\0d\0e\18\09\13\04")
+  (func $nop (export "nop"))
+  ;; A at 0, B at 256, C at 512
+  (func $permute
+    (local $round i32) (local $x i32) (local $y i32) (local $i i32)
+    (local $d i64)
+    loop $rounds
+      ;; theta
+      i32.const 0
+      local.set $x
+      loop $theta_c
+        local.get $x
+        i32.const 3
+        i32.shl
+        local.tee $i
+        local.get $i
+        i64.load
+        local.get $i
+        i64.load offset=40
+        i64.xor
+        local.get $i
+        i64.load offset=80
+        i64.xor
+        local.get $i
+        i64.load offset=120
+        i64.xor
+        local.get $i
+        i64.load offset=160
+        i64.xor
+        i64.store offset=512
+        local.get $x
+        i32.const 1
+        i32.add
+        local.tee $x
+        i32.const 5
+        i32.ne
+        br_if $theta_c
+      end
+      i32.const 0
+      local.set $x
+      loop $theta_d
+        local.get $x
+        i32.const 4
+        i32.add
+        i32.const 5
+        i32.rem_u
+        i32.const 3
+        i32.shl
+        i64.load offset=512
+        local.get $x
+        i32.const 1
+        i32.add
+        i32.const 5
+        i32.rem_u
+        i32.const 3
+        i32.shl
+        i64.load offset=512
+        i64.const 1
+        i64.rotl
+        i64.xor
+        local.set $d
+        local.get $x
+        i32.const 3
+        i32.shl
+        local.set $i
+        loop $theta_y
+          local.get $i
+          local.get $i
+          i64.load
+          local.get $d
+          i64.xor
+          i64.store
+          local.get $i
+          i32.const 40
+          i32.add
+          local.tee $i
+          i32.const 200
+          i32.lt_u
+          br_if $theta_y
+        end
+        local.get $x
+        i32.const 1
+        i32.add
+        local.tee $x
+        i32.const 5
+        i32.ne
+        br_if $theta_d
+      end
+      ;; rho and pi
+      i32.const 0
+      local.set $i
+      loop $rho_pi
+        local.get $i
+        i32.load8_u offset=1312
+        i32.const 3
+        i32.shl
+        local.get $i
+        i32.const 3
+        i32.shl
+        i64.load
+        local.get $i
+        i64.load8_u offset=1280
+        i64.rotl
+        i64.store offset=256
+        local.get $i
+        i32.const 1
+        i32.add
+        local.tee $i
+        i32.const 25
+        i32.ne
+        br_if $rho_pi
+      end
+      ;; chi, y is the byte offset of the row
+      i32.const 0
+      local.set $y
+      loop $chi_y
+        i32.const 0
+        local.set $x
+        loop $chi_x
+          local.get $y
+          local.get $x
+          i32.const 3
+          i32.shl
+          i32.add
+          local.get $y
+          local.get $x
+          i32.const 3
+          i32.shl
+          i32.add
+          i64.load offset=256
+          local.get $y
+          local.get $x
+          i32.const 1
+          i32.add
+          i32.const 5
+          i32.rem_u
+          i32.const 3
+          i32.shl
+          i32.add
+          i64.load offset=256
+          i64.const -1
+          i64.xor
+          local.get $y
+          local.get $x
+          i32.const 2
+          i32.add
+          i32.const 5
+          i32.rem_u
+          i32.const 3
+          i32.shl
+          i32.add
+          i64.load offset=256
+          i64.and
+          i64.xor
+          i64.store
+          local.get $x
+          i32.const 1
+          i32.add
+          local.tee $x
+          i32.const 5
+          i32.ne
+          br_if $chi_x
+        end
+        local.get $y
+        i32.const 40
+        i32.add
+        local.tee $y
+        i32.const 200
+        i32.lt_u
+        br_if $chi_y
+      end
+      ;; iota
+      i32.const 0
+      i32.const 0
+      i64.load
+      local.get $round
+      i32.const 3
+      i32.shl
+      i64.load offset=1024
+      i64.xor
+      i64.store
+      local.get $round
+      i32.const 1
+      i32.add
+      local.tee $round
+      i32.const 24
+      i32.ne
+      br_if $rounds
+    end)
+  ;; apply the permutation n times, returns the first lane
+  (func (export "keccak") (param $n i32) (result i64)
+    block $done
+      loop $next
+        local.get $n
+        i32.eqz
+        br_if $done
+        call $permute
+        local.get $n
+        i32.const 1
+        i32.sub
+        local.set $n
+        br $next
+      end
+    end
+    i32.const 0
+    i64.load)
+)
@@ -0,0 +1,21 @@
+;; Runs out of gas under 'depth' nested calls, measures the cost of a gas
+;; limit trap. The gas function is the one inserted by gas metering
+(module
+  (func $use_gas (export "__instrumented_use_gas") (param i64))
+  (func $nop (export "nop"))
+  (func $out_of_gas (export "out_of_gas") (param $depth i32) (result i32)
+    local.get $depth
+    if
+      local.get $depth
+      i32.const 1
+      i32.sub
+      call $out_of_gas
+      return
+    end
+    loop
+      i64.const 1000
+      call $use_gas
+      br 0
+    end
+    i32.const 0)
+)
@@ -0,0 +1,17 @@
+;; Traps with unreachable under 'depth' nested calls, measures the cost of
+;; a revert
+(module
+  (func $nop (export "nop"))
+  (func $revert (export "revert") (param $depth i32) (result i32)
+    local.get $depth
+    i32.eqz
+    if
+      unreachable
+    end
+    local.get $depth
+    i32.const 1
+    i32.sub
+    call $revert
+    i32.const 1
+    i32.add)
+)
@@ -0,0 +1,222 @@
+;; This test case file is designed to test the loads folded into the memory
+;; operands of x86 arithmetic and compare instructions in multipass JIT: the
+;; operand order of non-commutative instructions, loads with multiple uses, and
+;; memory writes between a load and its use, which must not be reordered.
+
+(module
+  (memory 1)
+
+  ;; Overwrites the values at 0 and 8, and returns the value $reset writes at 0
+  (func $clobber (result i32)
+    (i32.store (i32.const 0) (i32.const 1000))
+    (i64.store (i32.const 8) (i64.const 1000))
+    (i32.const 100))
+
+  (func $reset
+    (i32.store (i32.const 0) (i32.const 100))
+    (i64.store (i32.const 8) (i64.const 0x100000005))
+    (i32.store (i32.const 16) (i32.const 0xffffffff)))
+
+  ;; Operand order
+
+  (func (export "sub_load_rhs") (param $x i32) (result i32)
+    (call $reset)
+    (i32.sub (local.get $x) (i32.load (i32.const 0))))
+
+  (func (export "sub_load_lhs") (param $x i32) (result i32)
+    (call $reset)
+    (i32.sub (i32.load (i32.const 0)) (local.get $x)))
+
+  (func (export "sub_load_both") (result i32)
+    (call $reset)
+    (i32.sub (i32.load (i32.const 0)) (i32.load (i32.const 16))))
+
+  (func (export "sub64_load_rhs") (param $x i64) (result i64)
+    (call $reset)
+    (i64.sub (local.get $x) (i64.load (i32.const 8))))
+
+  (func (export "sub64_load_lhs") (param $x i64) (result i64)
+    (call $reset)
+    (i64.sub (i64.load (i32.const 8)) (local.get $x)))
+
+  (func (export "add_load_lhs") (param $x i32) (result i32)
+    (call $reset)
+    (i32.add (i32.load (i32.const 0)) (local.get $x)))
+
+  (func (export "mul_load_lhs") (param $x i32) (result i32)
+    (call $reset)
+    (i32.mul (i32.load (i32.const 0)) (local.get $x)))
+
+  (func (export "bitwise_load") (param $x i64) (result i64)
+    (call $reset)
+    (i64.xor
+      (i64.and (i64.load (i32.const 8)) (local.get $x))
+      (i64.or (local.get $x) (i64.load (i32.const 8)))))
+
+  (func (export "load_with_offset") (param $p i32) (param $x i32) (result i32)
+    (call $reset)
+    (i32.add
+      (local.get $x)
+      (i32.load offset=4 (i32.add (local.get $p) (i32.const 4)))))
+
+  ;; Loads with multiple uses
+
+  (func (export "tee_load_twice") (param $x i32) (result i32)
+    (local $v i32)
+    (call $reset)
+    (i32.add
+      (i32.sub (local.tee $v (i32.load (i32.const 0))) (local.get $x))
+      (local.get $v)))
+
+  (func (export "tee_load_self") (result i32)
+    (local $v i32)
+    (call $reset)
+    (i32.sub (local.tee $v (i32.load (i32.const 0))) (local.get $v)))
+
+  (func (export "load_used_after_store") (param $x i32) (result i32)
+    (local $v i32)
+    (call $reset)
+    (local.set $v (i32.load (i32.const 0)))
+    (i32.store (i32.const 0) (local.get $x))
+    (i32.mul (local.get $v) (i32.load (i32.const 0))))
+
+  ;; Memory writes between a load and its use
+
+  (func (export "sub_load_then_call") (result i32)
+    (call $reset)
+    (i32.sub (i32.load (i32.const 0)) (call $clobber)))
+
+  (func (export "add_load_then_call") (result i32)
+    (call $reset)
+    (i32.add (i32.load (i32.const 0)) (call $clobber)))
+
+  (func (export "add64_load_then_call") (result i64)
+    (call $reset)
+    (i64.add (i64.load (i32.const 8)) (i64.extend_i32_u (call $clobber))))
+
+  (func (export "add_load_then_store") (result i32)
+    (call $reset)
+    (i32.add
+      (i32.load (i32.const 0))
+      (block (result i32)
+        (i32.store (i32.const 0) (i32.const 7))
+        (i32.const 1))))
+
+  (func (export "load_across_store") (param $x i32) (result i32)
+    (call $reset)
+    (i32.load (i32.const 0))
+    (i32.store (i32.const 0) (i32.const 7))
+    (i32.add (local.get $x)))
+
+  (func (export "eq_load_then_call") (result i32)
+    (call $reset)
+    (i32.eq (i32.load (i32.const 0)) (call $clobber)))
+
+  (func (export "br_if_load_then_call") (result i32)
+    (call $reset)
+    (block
+      (br_if 0 (i32.ne (i32.load (i32.const 0)) (call $clobber)))
+      (return (i32.const 1)))
+    (i32.const 0))
+
+  (func (export "if_load64_then_store") (result i32)
+    (call $reset)
+    (if (result i32)
+      (i64.eq
+        (i64.load (i32.const 8))
+        (block (result i64)
+          (i64.store (i32.const 8) (i64.const 1))
+          (i64.const 1)))
+      (then (i32.const 0))
+      (else (i32.const 1))))
+
+  ;; Compares of loads
+
+  (func (export "br_if_load_imm") (param $x i32) (result i32)
+    (call $reset)
+    (i32.store (i32.const 0) (local.get $x))
+    (block
+      (br_if 0 (i32.lt_s (i32.load (i32.const 0)) (i32.const 100)))
+      (return (i32.const 1)))
+    (i32.const 0))
+
+  (func (export "gt_load_rhs") (param $x i32) (result i32)
+    (call $reset)
+    (i32.gt_u (local.get $x) (i32.load (i32.const 16))))
+
+  (func (export "lt64_load_lhs") (param $x i64) (result i32)
+    (call $reset)
+    (i64.lt_s (i64.load (i32.const 8)) (local.get $x)))
+
+  ;; Extending loads are not folded
+
+  (func (export "add_load32_u") (param $x i64) (result i64)
+    (call $reset)
+    (i64.add (i64.load32_u (i32.const 16)) (local.get $x)))
+
+  (func (export "add_load32_s") (param $x i64) (result i64)
+    (call $reset)
+    (i64.add (i64.load32_s (i32.const 16)) (local.get $x)))
+
+  (func (export "add_load8_u") (param $x i32) (result i32)
+    (call $reset)
+    (i32.add (local.get $x) (i32.load8_u (i32.const 16))))
+
+  (func (export "eq_load16_s") (param $x i32) (result i32)
+    (call $reset)
+    (i32.eq (i32.load16_s (i32.const 16)) (local.get $x)))
+
+  ;; Folded loads are bounds checked
+
+  (func (export "add_load_at") (param $p i32) (param $x i32) (result i32)
+    (i32.add (local.get $x) (i32.load (local.get $p))))
+)
+
+(assert_return (invoke "sub_load_rhs" (i32.const 1)) (i32.const -99))
+(assert_return (invoke "sub_load_lhs" (i32.const 1)) (i32.const 99))
+(assert_return (invoke "sub_load_both") (i32.const 101))
+(assert_return (invoke "sub64_load_rhs" (i64.const 5)) (i64.const -0x100000000))
+(assert_return (invoke "sub64_load_lhs" (i64.const 5)) (i64.const 0x100000000))
+(assert_return (invoke "add_load_lhs" (i32.const -1)) (i32.const 99))
+(assert_return (invoke "mul_load_lhs" (i32.const 3)) (i32.const 300))
+(assert_return (invoke "bitwise_load" (i64.const 0xff00000001))
+  (i64.const 0xfe00000004))
+(assert_return (invoke "load_with_offset" (i32.const -4) (i32.const 1))
+  (i32.const 1))
+(assert_return (invoke "load_with_offset" (i32.const 8) (i32.const 1))
+  (i32.const 0))
+
+(assert_return (invoke "tee_load_twice" (i32.const 1)) (i32.const 199))
+(assert_return (invoke "tee_load_self") (i32.const 0))
+(assert_return (invoke "load_used_after_store" (i32.const 3)) (i32.const 300))
+
+(assert_return (invoke "sub_load_then_call") (i32.const 0))
+(assert_return (invoke "add_load_then_call") (i32.const 200))
+(assert_return (invoke "add64_load_then_call") (i64.const 0x100000069))
+(assert_return (invoke "add_load_then_store") (i32.const 101))
+(assert_return (invoke "load_across_store" (i32.const 1)) (i32.const 101))
+(assert_return (invoke "eq_load_then_call") (i32.const 1))
+(assert_return (invoke "br_if_load_then_call") (i32.const 1))
+(assert_return (invoke "if_load64_then_store") (i32.const 1))
+
+(assert_return (invoke "br_if_load_imm" (i32.const 99)) (i32.const 0))
+(assert_return (invoke "br_if_load_imm" (i32.const 100)) (i32.const 1))
+(assert_return (invoke "br_if_load_imm" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "gt_load_rhs" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "gt_load_rhs" (i32.const -2)) (i32.const 0))
+(assert_return (invoke "lt64_load_lhs" (i64.const 0x100000006)) (i32.const 1))
+(assert_return (invoke "lt64_load_lhs" (i64.const 0x100000005)) (i32.const 0))
+
+(assert_return (invoke "add_load32_u" (i64.const 1)) (i64.const 0x100000000))
+(assert_return (invoke "add_load32_s" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "add_load8_u" (i32.const 1)) (i32.const 256))
+(assert_return (invoke "eq_load16_s" (i32.const -1)) (i32.const 1))
+
+(assert_return (invoke "add_load_at" (i32.const 65532) (i32.const 1))
+  (i32.const 1))
+(assert_trap (invoke "add_load_at" (i32.const 65533) (i32.const 1))
+  "out of bounds memory access")
+(assert_trap (invoke "add_load_at" (i32.const -1) (i32.const 1))
+  "out of bounds memory access")
+(assert_trap (invoke "load_with_offset" (i32.const -8) (i32.const 1))
+  "out of bounds memory access")
@@ -0,0 +1,130 @@
+;; Keeps more values live than there are registers, across calls and loops,
+;; so that the register allocators have to spill and reload them.
+
+(module
+  (func $id (param i64) (result i64) (local.get 0))
+
+  ;; All the values stay on the operand stack until the final sum
+  (func (export "stack_across_calls") (param $n i64) (result i64)
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 3)) (i64.const 0)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 4)) (i64.const 1)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 5)) (i64.const 2)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 6)) (i64.const 3)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 7)) (i64.const 4)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 8)) (i64.const 5)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 9)) (i64.const 6)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 10)) (i64.const 7)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 11)) (i64.const 8)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 12)) (i64.const 9)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 13)) (i64.const 10)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 14)) (i64.const 11)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 15)) (i64.const 12)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 16)) (i64.const 13)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 17)) (i64.const 14)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 18)) (i64.const 15)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 19)) (i64.const 16)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 20)) (i64.const 17)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 21)) (i64.const 18)))
+    (call $id (i64.add (i64.mul (local.get $n) (i64.const 22)) (i64.const 19)))
+    (i64.add)
+    (i64.xor)
+    (i64.sub)
+    (i64.add)
+    (i64.xor)
+    (i64.sub)
+    (i64.add)
+    (i64.xor)
+    (i64.sub)
+    (i64.add)
+    (i64.xor)
+    (i64.sub)
+    (i64.add)
+    (i64.xor)
+    (i64.sub)
+    (i64.add)
+    (i64.xor)
+    (i64.sub)
+    (i64.add)
+  )
+
+  ;; All the locals are live through every iteration
+  (func (export "locals_in_loop") (param $n i32) (param $x i64) (result i64)
+    (local $l0 i64)
+    (local $l1 i64)
+    (local $l2 i64)
+    (local $l3 i64)
+    (local $l4 i64)
+    (local $l5 i64)
+    (local $l6 i64)
+    (local $l7 i64)
+    (local $l8 i64)
+    (local $l9 i64)
+    (local $l10 i64)
+    (local $l11 i64)
+    (local $l12 i64)
+    (local $l13 i64)
+    (local $l14 i64)
+    (local $l15 i64)
+    (local $l16 i64)
+    (local $l17 i64)
+    (local $l18 i64)
+    (local $l19 i64)
+    (local.set $l0 (i64.add (local.get $x) (i64.const 1)))
+    (local.set $l1 (i64.add (local.get $x) (i64.const 8)))
+    (local.set $l2 (i64.add (local.get $x) (i64.const 15)))
+    (local.set $l3 (i64.add (local.get $x) (i64.const 22)))
+    (local.set $l4 (i64.add (local.get $x) (i64.const 29)))
+    (local.set $l5 (i64.add (local.get $x) (i64.const 36)))
+    (local.set $l6 (i64.add (local.get $x) (i64.const 43)))
+    (local.set $l7 (i64.add (local.get $x) (i64.const 50)))
+    (local.set $l8 (i64.add (local.get $x) (i64.const 57)))
+    (local.set $l9 (i64.add (local.get $x) (i64.const 64)))
+    (local.set $l10 (i64.add (local.get $x) (i64.const 71)))
+    (local.set $l11 (i64.add (local.get $x) (i64.const 78)))
+    (local.set $l12 (i64.add (local.get $x) (i64.const 85)))
+    (local.set $l13 (i64.add (local.get $x) (i64.const 92)))
+    (local.set $l14 (i64.add (local.get $x) (i64.const 99)))
+    (local.set $l15 (i64.add (local.get $x) (i64.const 106)))
+    (local.set $l16 (i64.add (local.get $x) (i64.const 113)))
+    (local.set $l17 (i64.add (local.get $x) (i64.const 120)))
+    (local.set $l18 (i64.add (local.get $x) (i64.const 127)))
+    (local.set $l19 (i64.add (local.get $x) (i64.const 134)))
+    (block $done
+      (loop $next
+        (br_if $done (i32.eqz (local.get $n)))
+        (local.set $l0 (i64.add (local.get $l0) (call $id (local.get $l1))))
+        (local.set $l1 (i64.add (local.get $l1) (call $id (local.get $l2))))
+        (local.set $l2 (i64.add (local.get $l2) (call $id (local.get $l3))))
+        (local.set $l3 (i64.add (local.get $l3) (call $id (local.get $l4))))
+        (local.set $l4 (i64.add (local.get $l4) (call $id (local.get $l5))))
+        (local.set $l5 (i64.add (local.get $l5) (call $id (local.get $l6))))
+        (local.set $l6 (i64.add (local.get $l6) (call $id (local.get $l7))))
+        (local.set $l7 (i64.add (local.get $l7) (call $id (local.get $l8))))
+        (local.set $l8 (i64.add (local.get $l8) (call $id (local.get $l9))))
+        (local.set $l9 (i64.add (local.get $l9) (call $id (local.get $l10))))
+        (local.set $l10 (i64.add (local.get $l10) (call $id (local.get $l11))))
+        (local.set $l11 (i64.add (local.get $l11) (call $id (local.get $l12))))
+        (local.set $l12 (i64.add (local.get $l12) (call $id (local.get $l13))))
+        (local.set $l13 (i64.add (local.get $l13) (call $id (local.get $l14))))
+        (local.set $l14 (i64.add (local.get $l14) (call $id (local.get $l15))))
+        (local.set $l15 (i64.add (local.get $l15) (call $id (local.get $l16))))
+        (local.set $l16 (i64.add (local.get $l16) (call $id (local.get $l17))))
+        (local.set $l17 (i64.add (local.get $l17) (call $id (local.get $l18))))
+        (local.set $l18 (i64.add (local.get $l18) (call $id (local.get $l19))))
+        (local.set $l19 (i64.add (local.get $l19) (call $id (local.get $l0))))
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $next)
+      )
+    )
+    (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (i64.xor (local.get $l0) (i64.rotl (local.get $l1) (i64.const 1))) (i64.rotl (local.get $l2) (i64.const 2))) (i64.rotl (local.get $l3) (i64.const 3))) (i64.rotl (local.get $l4) (i64.const 4))) (i64.rotl (local.get $l5) (i64.const 5))) (i64.rotl (local.get $l6) (i64.const 6))) (i64.rotl (local.get $l7) (i64.const 7))) (i64.rotl (local.get $l8) (i64.const 8))) (i64.rotl (local.get $l9) (i64.const 9))) (i64.rotl (local.get $l10) (i64.const 10))) (i64.rotl (local.get $l11) (i64.const 11))) (i64.rotl (local.get $l12) (i64.const 12))) (i64.rotl (local.get $l13) (i64.const 13))) (i64.rotl (local.get $l14) (i64.const 14))) (i64.rotl (local.get $l15) (i64.const 15))) (i64.rotl (local.get $l16) (i64.const 16))) (i64.rotl (local.get $l17) (i64.const 17))) (i64.rotl (local.get $l18) (i64.const 18))) (i64.rotl (local.get $l19) (i64.const 19)))
+  )
+)
+
+(assert_return (invoke "stack_across_calls" (i64.const 0)) (i64.const 48))
+(assert_return (invoke "stack_across_calls" (i64.const 1)) (i64.const 112))
+(assert_return (invoke "stack_across_calls" (i64.const -1)) (i64.const -40))
+(assert_return (invoke "stack_across_calls" (i64.const 4886718345)) (i64.const 145781457072))
+(assert_return (invoke "locals_in_loop" (i32.const 0) (i64.const 0)) (i64.const 91083533))
+(assert_return (invoke "locals_in_loop" (i32.const 1) (i64.const 5)) (i64.const 40782037))
+(assert_return (invoke "locals_in_loop" (i32.const 10) (i64.const -3)) (i64.const 17589944320))
+(assert_return (invoke "locals_in_loop" (i32.const 100) (i64.const 9223372036854775807)) (i64.const -6268586938305088006))
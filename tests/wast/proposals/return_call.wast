@@ -0,0 +1,282 @@
+;; Test `return_call` operator
+
+(module
+  (import "spectest" "print_i32" (func $print_i32 (param i32)))
+
+  ;; Auxiliary definitions
+  (func $const-i32 (result i32) (i32.const 0x132))
+  (func $const-i64 (result i64) (i64.const 0x164))
+  (func $const-f32 (result f32) (f32.const 0xf32))
+  (func $const-f64 (result f64) (f64.const 0xf64))
+
+  (func $id-i32 (param i32) (result i32) (local.get 0))
+  (func $id-i64 (param i64) (result i64) (local.get 0))
+  (func $id-f32 (param f32) (result f32) (local.get 0))
+  (func $id-f64 (param f64) (result f64) (local.get 0))
+
+  (func $f32-i32 (param f32 i32) (result i32) (local.get 1))
+  (func $i32-i64 (param i32 i64) (result i64) (local.get 1))
+  (func $f64-f32 (param f64 f32) (result f32) (local.get 1))
+  (func $i64-f64 (param i64 f64) (result f64) (local.get 1))
+
+  ;; More arguments than argument registers, some are passed on the stack
+  (func $sum-i32 (param i32 i32 i32 i32 i32 i32 i32 i32 i32 i32) (result i32)
+    (i32.add
+      (i32.add
+        (i32.add (i32.add (local.get 0) (local.get 1))
+                 (i32.add (local.get 2) (local.get 3)))
+        (i32.add (i32.add (local.get 4) (local.get 5))
+                 (i32.add (local.get 6) (local.get 7))))
+      (i32.add (local.get 8) (local.get 9))))
+  (func $sum-f64 (param f64 f64 f64 f64 f64 f64 f64 f64 f64 f64) (result f64)
+    (f64.add
+      (f64.add
+        (f64.add (f64.add (local.get 0) (local.get 1))
+                 (f64.add (local.get 2) (local.get 3)))
+        (f64.add (f64.add (local.get 4) (local.get 5))
+                 (f64.add (local.get 6) (local.get 7))))
+      (f64.add (local.get 8) (local.get 9))))
+
+  ;; Typing
+
+  (func (export "type-i32") (result i32) (return_call $const-i32))
+  (func (export "type-i64") (result i64) (return_call $const-i64))
+  (func (export "type-f32") (result f32) (return_call $const-f32))
+  (func (export "type-f64") (result f64) (return_call $const-f64))
+
+  (func (export "type-first-i32") (result i32)
+    (return_call $id-i32 (i32.const 32)))
+  (func (export "type-first-i64") (result i64)
+    (return_call $id-i64 (i64.const 64)))
+  (func (export "type-first-f32") (result f32)
+    (return_call $id-f32 (f32.const 1.32)))
+  (func (export "type-first-f64") (result f64)
+    (return_call $id-f64 (f64.const 1.64)))
+
+  (func (export "type-second-i32") (result i32)
+    (return_call $f32-i32 (f32.const 32.1) (i32.const 32)))
+  (func (export "type-second-i64") (result i64)
+    (return_call $i32-i64 (i32.const 32) (i64.const 64)))
+  (func (export "type-second-f32") (result f32)
+    (return_call $f64-f32 (f64.const 64) (f32.const 32)))
+  (func (export "type-second-f64") (result f64)
+    (return_call $i64-f64 (i64.const 64) (f64.const 64.1)))
+
+  (func (export "type-many-i32") (result i32)
+    (return_call $sum-i32
+      (i32.const 1) (i32.const 2) (i32.const 3) (i32.const 4) (i32.const 5)
+      (i32.const 6) (i32.const 7) (i32.const 8) (i32.const 9) (i32.const 10)))
+  (func (export "type-many-f64") (result f64)
+    (return_call $sum-f64
+      (f64.const 1) (f64.const 2) (f64.const 3) (f64.const 4) (f64.const 5)
+      (f64.const 6) (f64.const 7) (f64.const 8) (f64.const 9) (f64.const 10)))
+
+  ;; The arguments are computed from the locals being replaced
+  (func (export "swap") (param i32 i32) (result i32)
+    (if (result i32) (i32.eqz (local.get 0))
+      (then (local.get 1))
+      (else (return_call $f32-i32 (f32.const 0) (i32.sub (local.get 1) (local.get 0))))
+    )
+  )
+
+  ;; Imported callee
+  (func (export "type-import") (param i32)
+    (return_call $print_i32 (local.get 0)))
+
+  ;; Composition
+
+  (func (export "as-select-first") (result i32)
+    (select (return_call $const-i32) (i32.const 2) (i32.const 3))
+  )
+  (func (export "as-br_if-cond") (result i32)
+    (block (result i32) (br_if 0 (i32.const 1) (return_call $const-i32)))
+  )
+  (func (export "as-block-last") (result i32)
+    (block (result i32) (nop) (return_call $const-i32))
+  )
+  (func (export "as-loop-last") (result i32)
+    (loop (result i32) (nop) (return_call $const-i32))
+  )
+  (func (export "as-if-then") (param i32) (result i32)
+    (if (result i32) (local.get 0)
+      (then (return_call $id-i32 (i32.const 1)))
+      (else (i32.const 2))
+    )
+  )
+
+  ;; Recursion
+
+  (func $fac-acc (export "fac-acc") (param i64 i64) (result i64)
+    (if (result i64) (i64.eqz (local.get 0))
+      (then (local.get 1))
+      (else
+        (return_call $fac-acc
+          (i64.sub (local.get 0) (i64.const 1))
+          (i64.mul (local.get 0) (local.get 1))
+        )
+      )
+    )
+  )
+
+  (func $count (export "count") (param i64) (result i64)
+    (if (result i64) (i64.eqz (local.get 0))
+      (then (local.get 0))
+      (else (return_call $count (i64.sub (local.get 0) (i64.const 1))))
+    )
+  )
+
+  (func $even (export "even") (param i64) (result i32)
+    (if (result i32) (i64.eqz (local.get 0))
+      (then (i32.const 44))
+      (else (return_call $odd (i64.sub (local.get 0) (i64.const 1))))
+    )
+  )
+  (func $odd (export "odd") (param i64) (result i32)
+    (if (result i32) (i64.eqz (local.get 0))
+      (then (i32.const 99))
+      (else (return_call $even (i64.sub (local.get 0) (i64.const 1))))
+    )
+  )
+
+  ;; Tail calls with arguments on the stack
+  (func $count-many (export "count-many")
+    (param i32 i32 i32 i32 i32 i32 i32 i32 i32 i32) (result i32)
+    (if (result i32) (i32.eqz (local.get 0))
+      (then
+        (i32.add
+          (i32.add (i32.add (local.get 1) (local.get 2))
+                   (i32.add (local.get 3) (local.get 4)))
+          (i32.add
+            (i32.add (i32.add (local.get 5) (local.get 6))
+                     (i32.add (local.get 7) (local.get 8)))
+            (local.get 9))))
+      (else
+        (return_call $count-many
+          (i32.sub (local.get 0) (i32.const 1))
+          (local.get 2) (local.get 3) (local.get 4) (local.get 5)
+          (local.get 6) (local.get 7) (local.get 8) (local.get 9)
+          (i32.add (local.get 1) (i32.const 1))))
+    )
+  )
+)
+
+(assert_return (invoke "type-i32") (i32.const 0x132))
+(assert_return (invoke "type-i64") (i64.const 0x164))
+(assert_return (invoke "type-f32") (f32.const 0xf32))
+(assert_return (invoke "type-f64") (f64.const 0xf64))
+
+(assert_return (invoke "type-first-i32") (i32.const 32))
+(assert_return (invoke "type-first-i64") (i64.const 64))
+(assert_return (invoke "type-first-f32") (f32.const 1.32))
+(assert_return (invoke "type-first-f64") (f64.const 1.64))
+
+(assert_return (invoke "type-second-i32") (i32.const 32))
+(assert_return (invoke "type-second-i64") (i64.const 64))
+(assert_return (invoke "type-second-f32") (f32.const 32))
+(assert_return (invoke "type-second-f64") (f64.const 64.1))
+
+(assert_return (invoke "type-many-i32") (i32.const 55))
+(assert_return (invoke "type-many-f64") (f64.const 55))
+
+(assert_return (invoke "swap" (i32.const 0) (i32.const 7)) (i32.const 7))
+(assert_return (invoke "swap" (i32.const 3) (i32.const 10)) (i32.const 7))
+
+(assert_return (invoke "type-import" (i32.const 42)))
+
+(assert_return (invoke "as-select-first") (i32.const 0x132))
+(assert_return (invoke "as-br_if-cond") (i32.const 0x132))
+(assert_return (invoke "as-block-last") (i32.const 0x132))
+(assert_return (invoke "as-loop-last") (i32.const 0x132))
+(assert_return (invoke "as-if-then" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "as-if-then" (i32.const 0)) (i32.const 2))
+
+(assert_return (invoke "fac-acc" (i64.const 0) (i64.const 1)) (i64.const 1))
+(assert_return (invoke "fac-acc" (i64.const 1) (i64.const 1)) (i64.const 1))
+(assert_return (invoke "fac-acc" (i64.const 5) (i64.const 1)) (i64.const 120))
+(assert_return
+  (invoke "fac-acc" (i64.const 25) (i64.const 1))
+  (i64.const 7034535277573963776)
+)
+
+;; Multipass lowers tail calls to call + return, keep the depth within the
+;; call stack of all the modes
+(assert_return (invoke "count" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "count" (i64.const 1000)) (i64.const 0))
+
+(assert_return (invoke "even" (i64.const 0)) (i32.const 44))
+(assert_return (invoke "even" (i64.const 1)) (i32.const 99))
+(assert_return (invoke "even" (i64.const 100)) (i32.const 44))
+(assert_return (invoke "even" (i64.const 77)) (i32.const 99))
+(assert_return (invoke "even" (i64.const 1000)) (i32.const 44))
+(assert_return (invoke "odd" (i64.const 0)) (i32.const 99))
+(assert_return (invoke "odd" (i64.const 1)) (i32.const 44))
+(assert_return (invoke "odd" (i64.const 200)) (i32.const 99))
+(assert_return (invoke "odd" (i64.const 77)) (i32.const 44))
+(assert_return (invoke "odd" (i64.const 999)) (i32.const 44))
+
+(assert_return
+  (invoke "count-many"
+    (i32.const 1000) (i32.const 1) (i32.const 2) (i32.const 3) (i32.const 4)
+    (i32.const 5) (i32.const 6) (i32.const 7) (i32.const 8) (i32.const 9))
+  (i32.const 1045)
+)
+
+
+;; Invalid typing
+
+(assert_invalid
+  (module
+    (func $type-void-vs-num (result i32) (return_call 1) (i32.const 0))
+    (func)
+  )
+  "type mismatch"
+)
+(assert_invalid
+  (module
+    (func $type-num-vs-num (result i32) (return_call 1) (i32.const 0))
+    (func (result i64) (i64.const 1))
+  )
+  "type mismatch"
+)
+
+(assert_invalid
+  (module
+    (func $arity-0-vs-1 (return_call 1))
+    (func (param i32))
+  )
+  "type mismatch"
+)
+(assert_invalid
+  (module
+    (func $arity-0-vs-2 (return_call 1))
+    (func (param f64 i32))
+  )
+  "type mismatch"
+)
+
+(assert_invalid
+  (module
+    (func $type-first-void-vs-num (return_call 1 (nop) (i32.const 1)))
+    (func (param i32 i32))
+  )
+  "type mismatch"
+)
+(assert_invalid
+  (module
+    (func $type-first-num-vs-num (return_call 1 (f64.const 1) (i32.const 1)))
+    (func (param i32 f64))
+  )
+  "type mismatch"
+)
+
+
+;; Unbound function
+
+(assert_invalid
+  (module (func $unbound-func (return_call 1)))
+  "unknown function"
+)
+(assert_invalid
+  (module (func $large-func (return_call 1012321300)))
+  "unknown function"
+)
@@ -0,0 +1,93 @@
+;; Test memory.atomic.wait32, memory.atomic.wait64 and memory.atomic.notify
+;; in a single thread, waking waiters is covered by the thread group tests
+
+(module
+  (memory 1 1 shared)
+
+  (func (export "init") (param $value i64) (i64.store (i32.const 0) (local.get $value)))
+
+  (func (export "memory.atomic.notify") (param $addr i32) (param $count i32) (result i32)
+    (memory.atomic.notify (local.get $addr) (local.get $count))
+  )
+  (func (export "memory.atomic.wait32") (param $addr i32) (param $expected i32) (param $timeout i64) (result i32)
+    (memory.atomic.wait32 (local.get $addr) (local.get $expected) (local.get $timeout))
+  )
+  (func (export "memory.atomic.wait64") (param $addr i32) (param $expected i64) (param $timeout i64) (result i32)
+    (memory.atomic.wait64 (local.get $addr) (local.get $expected) (local.get $timeout))
+  )
+)
+
+(invoke "init" (i64.const 0xffffffffffff))
+
+;; No thread is waiting
+(assert_return (invoke "memory.atomic.notify" (i32.const 0) (i32.const 0)) (i32.const 0))
+(assert_return (invoke "memory.atomic.notify" (i32.const 0) (i32.const 10)) (i32.const 0))
+(assert_return (invoke "memory.atomic.notify" (i32.const 0) (i32.const -1)) (i32.const 0))
+
+;; The loaded value isn't the expected one
+(assert_return (invoke "memory.atomic.wait32" (i32.const 0) (i32.const 0) (i64.const -1)) (i32.const 1))
+(assert_return (invoke "memory.atomic.wait32" (i32.const 4) (i32.const 0xffff) (i64.const -1)) (i32.const 1))
+(assert_return (invoke "memory.atomic.wait64" (i32.const 0) (i64.const 0) (i64.const -1)) (i32.const 1))
+
+;; Timed out
+(assert_return (invoke "memory.atomic.wait32" (i32.const 0) (i32.const 0xffffffff) (i64.const 0)) (i32.const 2))
+(assert_return (invoke "memory.atomic.wait32" (i32.const 4) (i32.const 0xffff) (i64.const 0)) (i32.const 2))
+(assert_return (invoke "memory.atomic.wait32" (i32.const 8) (i32.const 0) (i64.const 1000)) (i32.const 2))
+(assert_return (invoke "memory.atomic.wait64" (i32.const 0) (i64.const 0xffffffffffff) (i64.const 0)) (i32.const 2))
+
+;; Unaligned
+(assert_trap (invoke "memory.atomic.notify" (i32.const 1) (i32.const 1)) "unaligned atomic")
+(assert_trap (invoke "memory.atomic.wait32" (i32.const 2) (i32.const 0) (i64.const 0)) "unaligned atomic")
+(assert_trap (invoke "memory.atomic.wait64" (i32.const 4) (i64.const 0) (i64.const 0)) "unaligned atomic")
+
+;; Out of bounds
+(assert_trap (invoke "memory.atomic.notify" (i32.const 65536) (i32.const 1)) "out of bounds memory access")
+(assert_trap (invoke "memory.atomic.wait32" (i32.const 65536) (i32.const 0) (i64.const 0)) "out of bounds memory access")
+(assert_trap (invoke "memory.atomic.wait64" (i32.const 65536) (i64.const 0) (i64.const 0)) "out of bounds memory access")
+
+;; No thread can wait on an unshared memory, so notify never wakes any
+
+(module
+  (memory 1 1)
+
+  (func (export "memory.atomic.notify") (param $addr i32) (param $count i32) (result i32)
+    (memory.atomic.notify (local.get $addr) (local.get $count))
+  )
+  (func (export "memory.atomic.wait32") (param $addr i32) (param $expected i32) (param $timeout i64) (result i32)
+    (memory.atomic.wait32 (local.get $addr) (local.get $expected) (local.get $timeout))
+  )
+  (func (export "memory.atomic.wait64") (param $addr i32) (param $expected i64) (param $timeout i64) (result i32)
+    (memory.atomic.wait64 (local.get $addr) (local.get $expected) (local.get $timeout))
+  )
+)
+
+(assert_return (invoke "memory.atomic.notify" (i32.const 0) (i32.const 1)) (i32.const 0))
+(assert_trap (invoke "memory.atomic.wait32" (i32.const 0) (i32.const 0) (i64.const 0)) "expected shared memory")
+(assert_trap (invoke "memory.atomic.wait64" (i32.const 0) (i64.const 0) (i64.const 0)) "expected shared memory")
+
+;; Validation
+
+(assert_invalid
+  (module
+    (memory 1 1 shared)
+    (func (result i32)
+      (memory.atomic.wait32 (i32.const 0) (i64.const 0) (i64.const 0))
+    )
+  )
+  "type mismatch"
+)
+(assert_invalid
+  (module
+    (memory 1 1 shared)
+    (func (result i32)
+      (memory.atomic.wait64 (i32.const 0) (i64.const 0) (i32.const 0))
+    )
+  )
+  "type mismatch"
+)
+(assert_invalid
+  (module
+    (func (result i32) (memory.atomic.notify (i32.const 0) (i32.const 0)))
+  )
+  "unknown memory"
+)
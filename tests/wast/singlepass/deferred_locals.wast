@@ -0,0 +1,141 @@
+;; The singlepass JIT pushes a local on stack itself for local.get, and copies
+;; it only when the local is assigned, or a block is entered, before the value
+;; is consumed. The copies may take temp stack slots above the temporaries
+;; released before them.
+
+(module
+  (func (export "get_then_set") (result i32)
+    (local $x i32)
+    (local.set $x (i32.const 1))
+    (local.get $x)
+    (local.set $x (i32.const 2))
+    (i32.sub (local.get $x)))
+
+  (func (export "get_then_tee") (result i64)
+    (local $x i64)
+    (local.set $x (i64.const 10))
+    (local.get $x)
+    (i64.sub (local.tee $x (i64.const 3))))
+
+  (func (export "get_then_block") (param $p i32) (result i32)
+    (local $x i32)
+    (local.set $x (i32.const 3))
+    (local.get $x)
+    (block
+      (br_if 0 (local.get $p))
+      (local.set $x (i32.const 10)))
+    (i32.sub (local.get $x)))
+
+  (func (export "get_then_loop") (result f64)
+    (local $x f64)
+    (local.set $x (f64.const 1.5))
+    (local.get $x)
+    (loop $l
+      (local.set $x (f64.add (local.get $x) (f64.const 1)))
+      (br_if $l (f64.lt (local.get $x) (f64.const 4))))
+    (f64.sub (local.get $x)))
+
+  (func (export "get_then_if") (param $p i32) (result i32)
+    (local $x i32)
+    (local.set $x (i32.const 7))
+    (local.get $x)
+    (if (local.get $p)
+      (then (local.set $x (i32.const 100)))
+      (else (local.set $x (i32.const 200))))
+    (i32.sub (local.get $x)))
+
+  ;; More copies than temporary registers, so some of them are in temp stack
+  ;; slots, and the operands between them are consumed first
+  (func (export "many_copies") (result i64)
+    (local $a i64) (local $b i64) (local $c i64) (local $d i64)
+    (local $e i64) (local $f i64) (local $g i64) (local $h i64)
+    (local.set $a (i64.const 1))
+    (local.set $b (i64.const 2))
+    (local.set $c (i64.const 3))
+    (local.set $d (i64.const 4))
+    (local.set $e (i64.const 5))
+    (local.set $f (i64.const 6))
+    (local.set $g (i64.const 7))
+    (local.set $h (i64.const 8))
+    (local.get $a)
+    (i64.mul (local.get $b) (i64.const 10))
+    (local.get $c)
+    (i64.mul (local.get $d) (i64.const 10))
+    (local.get $e)
+    (i64.mul (local.get $f) (i64.const 10))
+    (local.get $g)
+    (i64.mul (local.get $h) (i64.const 10))
+    (block
+      (local.set $a (i64.const 0))
+      (local.set $c (i64.const 0))
+      (local.set $e (i64.const 0))
+      (local.set $g (i64.const 0)))
+    ;; 1 - (20 - (3 - (40 - (5 - (60 - (7 - 80))))))
+    (i64.sub)
+    (i64.sub)
+    (i64.sub)
+    (i64.sub)
+    (i64.sub)
+    (i64.sub)
+    (i64.sub)
+    ;; The slots are reused by the next copies
+    (local.get $a)
+    (local.get $b)
+    (local.set $a (i64.const 1000))
+    (local.set $b (i64.const 100))
+    (i64.sub)
+    (i64.add (local.get $a))
+    (i64.add (local.get $b))
+    (i64.add (local.get $c))
+    (i64.add))
+
+  (func (export "many_float_copies") (result f64)
+    (local $a f64) (local $b f64) (local $c f64) (local $d f64)
+    (local $e f64) (local $f f64) (local $g f64) (local $h f64)
+    (local $i f64) (local $j f64)
+    (local.set $a (f64.const 1))
+    (local.set $b (f64.const 2))
+    (local.set $c (f64.const 3))
+    (local.set $d (f64.const 4))
+    (local.set $e (f64.const 5))
+    (local.set $f (f64.const 6))
+    (local.set $g (f64.const 7))
+    (local.set $h (f64.const 8))
+    (local.set $i (f64.const 9))
+    (local.set $j (f64.const 10))
+    (local.get $a)
+    (local.get $b)
+    (local.get $c)
+    (local.get $d)
+    (local.get $e)
+    (f64.mul (local.get $f) (f64.const 2))
+    (local.get $g)
+    (local.get $h)
+    (local.get $i)
+    (local.get $j)
+    (block
+      (local.set $a (f64.const 0))
+      (local.set $j (f64.const 0)))
+    ;; 1 - (2 - (3 - (4 - (5 - (12 - (7 - (8 - (9 - 10))))))))
+    (f64.sub)
+    (f64.sub)
+    (f64.sub)
+    (f64.sub)
+    (f64.sub)
+    (f64.sub)
+    (f64.sub)
+    (f64.sub)
+    (f64.sub)
+    (f64.add (local.get $a))
+    (f64.add (local.get $j)))
+)
+
+(assert_return (invoke "get_then_set") (i32.const -1))
+(assert_return (invoke "get_then_tee") (i64.const 7))
+(assert_return (invoke "get_then_block" (i32.const 0)) (i32.const -7))
+(assert_return (invoke "get_then_block" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "get_then_loop") (f64.const -3))
+(assert_return (invoke "get_then_if" (i32.const 1)) (i32.const -93))
+(assert_return (invoke "get_then_if" (i32.const 0)) (i32.const -193))
+(assert_return (invoke "many_copies") (i64.const 914))
+(assert_return (invoke "many_float_copies") (f64.const -11))
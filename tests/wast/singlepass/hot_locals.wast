@@ -0,0 +1,84 @@
+;; Hot locals, used inside loops, are kept in caller-saved registers by the
+;; x64 singlepass JIT. Their values must survive the calls made after the
+;; loops, even when the callee keeps its own hot locals in the same registers.
+
+(module
+  (memory 1)
+
+  ;; Clobbers the registers of its own hot locals
+  (func $clobber_int (param $n i32) (result i32)
+    (local $i i32) (local $acc i64)
+    (loop $l
+      (local.set $acc
+        (i64.add (local.get $acc) (i64.const 0x1111111111111111)))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $l (i32.lt_u (local.get $i) (local.get $n))))
+    (i32.wrap_i64 (local.get $acc)))
+
+  (func $clobber_float (param $n i32) (result f64)
+    (local $i i32) (local $x f64) (local $y f32)
+    (loop $l
+      (local.set $x (f64.add (local.get $x) (f64.const 1000.5)))
+      (local.set $y (f32.sub (local.get $y) (f32.const 3.25)))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $l (i32.lt_u (local.get $i) (local.get $n))))
+    (f64.add (local.get $x) (f64.promote_f32 (local.get $y))))
+
+  (func (export "int_across_call") (param $n i32) (result i64)
+    (local $i i32) (local $acc i64)
+    (loop $l
+      (local.set $acc (i64.add (local.get $acc) (i64.const 3)))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $l (i32.lt_u (local.get $i) (local.get $n))))
+    (drop (call $clobber_int (i32.const 5)))
+    (i64.add (local.get $acc) (i64.extend_i32_u (local.get $i))))
+
+  (func (export "float_across_call") (param $n i32) (result f64)
+    (local $i i32) (local $x f64) (local $y f32)
+    (loop $l
+      (local.set $x (f64.add (local.get $x) (f64.const 0.5)))
+      (local.set $y (f32.add (local.get $y) (f32.const 2)))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $l (i32.lt_u (local.get $i) (local.get $n))))
+    (drop (call $clobber_float (i32.const 5)))
+    (f64.add (local.get $x) (f64.promote_f32 (local.get $y))))
+
+  ;; The call's arguments and result live next to the hot local
+  (func (export "result_across_call") (param $n i32) (result i32)
+    (local $i i32) (local $acc i32)
+    (loop $l
+      (local.set $acc (i32.add (local.get $acc) (i32.const 7)))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $l (i32.lt_u (local.get $i) (local.get $n))))
+    (i32.sub
+      (call $clobber_int (local.get $acc))
+      (local.get $acc)))
+
+  (func (export "int_across_memory_grow") (param $n i32) (result i32)
+    (local $i i32) (local $acc i32)
+    (loop $l
+      (local.set $acc (i32.add (local.get $acc) (i32.const 2)))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $l (i32.lt_u (local.get $i) (local.get $n))))
+    (drop (memory.grow (i32.const 0)))
+    (local.get $acc))
+
+  ;; Calls inside the loop, the locals are not pinned
+  (func (export "call_in_loop") (param $n i32) (result i64)
+    (local $i i32) (local $acc i64)
+    (loop $l
+      (local.set $acc
+        (i64.add (local.get $acc)
+                 (i64.extend_i32_u (call $clobber_int (i32.const 1)))))
+      (local.set $i (i32.add (local.get $i) (i32.const 1)))
+      (br_if $l (i32.lt_u (local.get $i) (local.get $n))))
+    (local.get $acc))
+)
+
+(assert_return (invoke "int_across_call" (i32.const 10)) (i64.const 40))
+(assert_return (invoke "int_across_call" (i32.const 1)) (i64.const 4))
+(assert_return (invoke "float_across_call" (i32.const 4)) (f64.const 10))
+(assert_return (invoke "result_across_call" (i32.const 3))
+  (i32.const 0x66666650))
+(assert_return (invoke "int_across_memory_grow" (i32.const 6)) (i32.const 12))
+(assert_return (invoke "call_in_loop" (i32.const 3)) (i64.const 0x33333333))
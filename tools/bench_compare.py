@@ -0,0 +1,74 @@
+#!/bin/python3
+import argparse
+import json
+import sys
+
+
+def load_results(filepath):
+    with open(filepath, "r") as f:
+        doc = json.load(f)
+    return {r["name"]: r for r in doc["results"]}
+
+
+def main():
+    """
+    Usage: ./bench_compare.py baseline.json current.json [--threshold 0.05]
+    Show: the median time change of every benchmark in both dtvm_bench results
+    Exit with 1 if any benchmark is slower than the baseline by more than the
+    threshold(and by more than --min-delta-ns)
+    """
+    parser = argparse.ArgumentParser(description="Compare dtvm_bench results")
+    parser.add_argument("baseline", help="baseline JSON results")
+    parser.add_argument("current", help="current JSON results")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=0.05,
+        help="relative slowdown of the median reported as regression",
+    )
+    parser.add_argument(
+        "--min-delta-ns",
+        type=int,
+        default=1000,
+        help="absolute slowdown below which no regression is reported",
+    )
+    args = parser.parse_args()
+
+    baseline = load_results(args.baseline)
+    current = load_results(args.current)
+
+    row = "%-48s %14s %14s %9s%s"
+    regressions = []
+    print(row % ("benchmark", "baseline(ns)", "current(ns)", "change", ""))
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            print(row % (name, baseline[name]["median_ns"], "-", "removed", ""))
+            continue
+        if name not in baseline:
+            print(row % (name, "-", current[name]["median_ns"], "new", ""))
+            continue
+        old = baseline[name]["median_ns"]
+        new = current[name]["median_ns"]
+        change = (new - old) / old if old > 0 else 0.0
+        mark = ""
+        if change > args.threshold and new - old > args.min_delta_ns:
+            mark = " REGRESSION"
+            regressions.append(name)
+        elif change < -args.threshold and old - new > args.min_delta_ns:
+            mark = " improved"
+        percent = "%+.1f%%" % (change * 100)
+        print(row % (name, old, new, percent, mark))
+
+    if regressions:
+        print(
+            "\n%d regression(s) over %.1f%%:"
+            % (len(regressions), args.threshold * 100)
+        )
+        for name in regressions:
+            print("  " + name)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())